@@ -42,6 +42,71 @@ void BTCBase58RunAllTests() {
     BTCAssertHexEncodesToBase58(@"ecac89cad93923c02321", @"EJDM8drfXA6uyA");
     BTCAssertHexEncodesToBase58(@"10c8511e", @"Rt5zm");
     BTCAssertHexEncodesToBase58(@"00000000000000000000", @"1111111111");
+    BTCAssertHexEncodesToBase58(@"0000287fb4cd", @"11233QC4");
+
+    // Whitespace around the string is allowed, but not inside.
+    NSCAssert([BTCDataFromBase58(@" \t2g\n") isEqual:BTCDataFromHex(@"61")], @"should skip whitespace around base58 string");
+    NSCAssert(BTCDataFromBase58(@"2g 2g") == nil, @"should reject whitespace inside base58 string");
+
+    // Checksum
+    NSCAssert([BTCDataFromBase58Check(@"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L") isEqual:BTCDataFromHex(@"00eb15231dfceb60925886b67d065299925915aeb1")], @"should decode base58check");
+    NSCAssert([BTCBase58CheckStringWithData(BTCDataFromHex(@"00eb15231dfceb60925886b67d065299925915aeb1")) isEqual:@"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L"], @"should encode base58check");
+    BTCAssertDetectsInvalidBase58(@"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9M");
+
+    // Round trip of data of all lengths up to a serialized extended key with checksum, with and without leading zeroes.
+    NSMutableArray* items = [NSMutableArray array];
+    for (NSUInteger length = 0; length <= 82; length++) {
+        NSMutableData* data = BTCRandomDataWithLength(length);
+        if (length % 3 == 0) memset(data.mutableBytes, 0, MIN(length, length % 5));
+        NSCAssert([BTCDataFromBase58(BTCBase58StringWithData(data)) isEqual:data], @"should decode encoded data");
+        NSCAssert([BTCDataFromBase58Check(BTCBase58CheckStringWithData(data)) isEqual:data], @"should decode encoded data with checksum");
+        [items addObject:data];
+    }
+
+    // Batch API
+    NSArray* strings = BTCBase58CheckStringBatch(items);
+    NSCAssert(strings.count == items.count, @"should encode all items");
+    NSMutableArray* stringsWithInvalidOnes = [strings mutableCopy];
+    [stringsWithInvalidOnes addObject:@"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9M"];
+    [stringsWithInvalidOnes addObject:@"lLoO"];
+    NSArray* decoded = BTCDataFromBase58CheckBatch(stringsWithInvalidOnes);
+    NSCAssert(decoded.count == stringsWithInvalidOnes.count, @"should decode all items");
+    for (NSUInteger i = 0; i < items.count; i++) {
+        NSCAssert([strings[i] isEqual:BTCBase58CheckStringWithData(items[i])], @"batch encoding should match single encoding");
+        NSCAssert([decoded[i] isEqual:items[i]], @"batch decoding should match original data");
+    }
+    NSCAssert(decoded[items.count] == [NSNull null], @"should detect invalid checksum in batch");
+    NSCAssert(decoded[items.count + 1] == [NSNull null], @"should detect invalid characters in batch");
+    NSCAssert(BTCDataFromBase58CheckBatch(@[]).count == 0, @"empty batch");
+
+    // Benchmark with 25-byte addresses.
+    {
+        const NSUInteger count = 100000;
+        NSMutableArray* addresses = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            NSMutableData* data = BTCRandomDataWithLength(21);
+            ((unsigned char*)data.mutableBytes)[0] = 0;
+            [addresses addObject:data];
+        }
+
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        NSMutableArray* strings = [NSMutableArray arrayWithCapacity:count];
+        for (NSData* data in addresses) {
+            [strings addObject:BTCBase58CheckStringWithData(data)];
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        for (NSString* string in strings) {
+            BTCDataFromBase58Check(string);
+        }
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+        BTCBase58CheckStringBatch(addresses);
+        CFAbsoluteTime t4 = CFAbsoluteTimeGetCurrent();
+        BTCDataFromBase58CheckBatch(strings);
+        CFAbsoluteTime t5 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"Base58Check of %@ addresses: encode %.1f ms, decode %.1f ms, batch encode %.1f ms, batch decode %.1f ms",
+              @(count), (t2 - t1) * 1000.0, (t3 - t2) * 1000.0, (t4 - t3) * 1000.0, (t5 - t4) * 1000.0);
+    }
 
     if ((0)) {
         // Search for vanity prefix
@@ -41,3 +41,10 @@ char* BTCBase58CheckCStringWithData(NSData* data);
 // Same as above, but returns an immutable autoreleased string. Suitable for non-sensitive data.
 NSString* BTCBase58CheckStringWithData(NSData* data);
 
+
+// Decodes an array of Base58Check strings. Checksums are verified in parallel lanes (see BTCHash256Buffers).
+// Returns an array of NSMutableData with NSNull in place of invalid strings.
+NSArray* /* [NSMutableData | NSNull] */ BTCDataFromBase58CheckBatch(NSArray* /* [NSString] */ strings);
+
+// Encodes an array of NSData items with checksums. Equivalent to calling BTCBase58CheckStringWithData for each item.
+NSArray* /* [NSString] */ BTCBase58CheckStringBatch(NSArray* /* [NSData] */ dataItems);
@@ -2,214 +2,267 @@
 
 #import "BTCBase58.h"
 #import "BTCData.h"
-#import <openssl/bn.h>
+#import "BTCSHA256.h"
+
+// Numbers are converted between bases in fixed-size limbs instead of a bignum:
+// bytes are read in 32-bit words and accumulated into limbs holding 5 Base58 digits each (base 58^5),
+// Base58 digits are read in chunks of 5 and accumulated into 32-bit limbs.
+// 58^5 < 2^32, so every step is a single 64-bit multiply-add per limb.
 
 static const char* BTCBase58Alphabet = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
 
-NSMutableData* BTCDataFromBase58(NSString* string) {
-    return BTCDataFromBase58CString([string cStringUsingEncoding:NSASCIIStringEncoding]);
+#define BTCBase58ChunkDigits 5
+#define BTCBase58ChunkBase   656356768u // 58^5
+
+// Limbs for data up to 128 bytes long live on the stack, longer data uses the heap.
+#define BTCBase58StackLimbs 40
+
+static const uint32_t BTCBase58Powers[BTCBase58ChunkDigits + 1] = {1, 58, 3364, 195112, 11316496, 656356768};
+
+// Value of each Base58 character, -1 for characters outside the alphabet.
+static const int8_t BTCBase58Digits[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+    -1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+    -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+
+
+#pragma mark - Codec
+
+
+
+// Maximum number of characters needed to encode data of the given length.
+// Each zero byte becomes "1", other bytes take log(256)/log(58) = 1.37 characters.
+static size_t BTCBase58EncodedCapacity(size_t length) {
+    return length * 138 / 100 + 1;
 }
 
-NSMutableData* BTCDataFromBase58Check(NSString* string) {
-    return BTCDataFromBase58CheckCString([string cStringUsingEncoding:NSASCIIStringEncoding]);
+// Writes Base58 characters of the data to the output without a zero terminator and returns their number.
+// Output must have room for BTCBase58EncodedCapacity(length) characters.
+static size_t BTCBase58EncodeBytes(char* output, const unsigned char* bytes, size_t length) {
+    // Leading zeroes encoded as base58 ones ("1")
+    size_t zeros = 0;
+    while (zeros < length && bytes[zeros] == 0) zeros++;
+    memset(output, BTCBase58Alphabet[0], zeros);
+    bytes += zeros;
+    length -= zeros;
+
+    // Each limb holds at least 29 bits.
+    size_t capacity = (length * 8 + 28) / 29 + 1;
+    uint32_t stackLimbs[BTCBase58StackLimbs];
+    uint32_t* limbs = capacity <= BTCBase58StackLimbs ? stackLimbs : malloc(capacity * sizeof(uint32_t));
+    size_t count = 0;
+
+    // Big endian bytes are read in 32-bit words, the first word takes the remainder.
+    size_t wordLength = length % 4;
+    if (wordLength == 0) wordLength = 4;
+    for (size_t i = 0; i < length; i += wordLength, wordLength = 4) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < wordLength; j++) {
+            carry = (carry << 8) | bytes[i + j];
+        }
+        for (size_t j = 0; j < count; j++) {
+            uint64_t t = ((uint64_t)limbs[j] << (8 * wordLength)) + carry;
+            limbs[j] = (uint32_t)(t % BTCBase58ChunkBase);
+            carry = t / BTCBase58ChunkBase;
+        }
+        while (carry > 0) {
+            limbs[count++] = (uint32_t)(carry % BTCBase58ChunkBase);
+            carry /= BTCBase58ChunkBase;
+        }
+    }
+
+    // Expand limbs to digits starting from the most significant one and skipping its leading zero digits.
+    char* p = output + zeros;
+    for (size_t j = count; j > 0; j--) {
+        char digits[BTCBase58ChunkDigits];
+        uint32_t limb = limbs[j - 1];
+        for (int k = BTCBase58ChunkDigits - 1; k >= 0; k--) {
+            digits[k] = BTCBase58Alphabet[limb % 58];
+            limb /= 58;
+        }
+        int k = 0;
+        if (j == count) {
+            while (digits[k] == BTCBase58Alphabet[0]) k++;
+        }
+        for (; k < BTCBase58ChunkDigits; k++) {
+            *p++ = digits[k];
+        }
+    }
+
+    BTCSecureMemset(limbs, 0, count * sizeof(uint32_t));
+    if (limbs != stackLimbs) free(limbs);
+    return p - output;
 }
 
-NSMutableData* BTCDataFromBase58CString(const char* cstring) {
-    if (cstring == NULL) return nil;
-    
-    // empty string -> empty data.
-    if (cstring[0] == '\0') return [NSMutableData data];
-    
-    NSMutableData* result = nil;
-    
-    BN_CTX* pctx = BN_CTX_new();
-    __block BIGNUM bn58;   BN_init(&bn58);   BN_set_word(&bn58, 58);
-    __block BIGNUM bn;     BN_init(&bn);     BN_zero(&bn);
-    __block BIGNUM bnChar; BN_init(&bnChar);
-    
-    void(^finish)() = ^{
-        if (pctx) BN_CTX_free(pctx);
-        BN_clear_free(&bn58);
-        BN_clear_free(&bn);
-        BN_clear_free(&bnChar);
-    };
-    
+// Finds the range of Base58 characters in the string ignoring leading and trailing whitespace.
+// Returns NO if the string contains any other characters.
+static BOOL BTCBase58GetDigitsRange(const char* cstring, const char** beginOut, const char** endOut) {
     while (isspace(*cstring)) cstring++;
-    
-    
-    // Convert big endian string to bignum
-    for (const char* p = cstring; *p; p++) {
-        const char* p1 = strchr(BTCBase58Alphabet, *p);
-        if (p1 == NULL) {
-            while (isspace(*p))
-                p++;
-            if (*p != '\0') {
-                finish();
-                return nil;
-            }
-            break;
+    const char* end = cstring;
+    while (BTCBase58Digits[(unsigned char)*end] >= 0) end++;
+    for (const char* p = end; *p; p++) {
+        if (!isspace(*p)) return NO;
+    }
+    *beginOut = cstring;
+    *endOut = end;
+    return YES;
+}
+
+// Writes decoded bytes of the Base58 characters to the output and returns their number.
+// Characters must be valid. Output must have room for (end - begin) bytes.
+static size_t BTCBase58DecodeDigits(unsigned char* output, const char* begin, const char* end) {
+    // Leading ones are decoded as zero bytes.
+    size_t zeros = 0;
+    while (begin < end && *begin == BTCBase58Alphabet[0]) {
+        output[zeros++] = 0;
+        begin++;
+    }
+    size_t length = end - begin;
+
+    // Each character takes less than 6 bits.
+    size_t capacity = (length * 6 + 31) / 32 + 1;
+    uint32_t stackLimbs[BTCBase58StackLimbs];
+    uint32_t* limbs = capacity <= BTCBase58StackLimbs ? stackLimbs : malloc(capacity * sizeof(uint32_t));
+    size_t count = 0;
+
+    // Digits are read in chunks of 5, the first chunk takes the remainder.
+    size_t chunkLength = length % BTCBase58ChunkDigits;
+    if (chunkLength == 0) chunkLength = BTCBase58ChunkDigits;
+    for (const char* p = begin; p < end; p += chunkLength, chunkLength = BTCBase58ChunkDigits) {
+        uint64_t carry = 0;
+        for (size_t k = 0; k < chunkLength; k++) {
+            carry = carry * 58 + BTCBase58Digits[(unsigned char)p[k]];
         }
-        
-        BN_set_word(&bnChar, (BN_ULONG)(p1 - BTCBase58Alphabet));
-        
-        if (!BN_mul(&bn, &bn, &bn58, pctx)) {
-            finish();
-            return nil;
+        uint64_t multiplier = BTCBase58Powers[chunkLength];
+        for (size_t j = 0; j < count; j++) {
+            uint64_t t = (uint64_t)limbs[j] * multiplier + carry;
+            limbs[j] = (uint32_t)t;
+            carry = t >> 32;
         }
-        
-        if (!BN_add(&bn, &bn, &bnChar)) {
-            finish();
-            return nil;
+        if (carry > 0) {
+            limbs[count++] = (uint32_t)carry;
         }
     }
-    
-    // Get bignum as little endian data
-    
-    NSMutableData* bndata = nil;
-    {
-        size_t bnsize = BN_bn2mpi(&bn, NULL);
-        if (bnsize <= 4) {
-            bndata = [NSMutableData data];
-        } else {
-            bndata = [NSMutableData dataWithLength:bnsize];
-            BN_bn2mpi(&bn, bndata.mutableBytes);
-            [bndata replaceBytesInRange:NSMakeRange(0, 4) withBytes:NULL length:0];
-            BTCDataReverse(bndata);
+
+    // Write limbs in big endian order without leading zero bytes.
+    unsigned char* p = output + zeros;
+    for (size_t j = count; j > 0; j--) {
+        uint32_t limb = limbs[j - 1];
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            unsigned char byte = (limb >> shift) & 0xff;
+            if (p == output + zeros && byte == 0) continue;
+            *p++ = byte;
         }
     }
-    size_t bnsize = bndata.length;
-    
-    // Trim off sign byte if present
-    if (bnsize >= 2
-        && ((unsigned char*)bndata.bytes)[bnsize - 1] == 0
-        && ((unsigned char*)bndata.bytes)[bnsize - 2] >= 0x80) {
-        bnsize -= 1;
-        [bndata setLength:bnsize];
+
+    BTCSecureMemset(limbs, 0, count * sizeof(uint32_t));
+    if (limbs != stackLimbs) free(limbs);
+    return p - output;
+}
+
+// Returns YES if the last 4 bytes are the first bytes of BTCHash256 of the preceding bytes.
+static BOOL BTCBase58VerifyChecksum(const unsigned char* bytes, size_t length) {
+    if (length < 4) return NO;
+    unsigned char hash[32];
+    BTCHash256Bytes(hash, bytes, length - 4);
+    BOOL valid = (memcmp(hash, bytes + length - 4, 4) == 0);
+    BTCSecureMemset(hash, 0, sizeof(hash));
+    return valid;
+}
+
+// Returns a malloc'ed zero-terminated string with Base58 encoding of the bytes followed by the checksum, if it is not NULL.
+static char* BTCBase58CStringWithBytes(const unsigned char* bytes, size_t length, const unsigned char* checksum) {
+    unsigned char stackBuffer[128];
+    const unsigned char* payload = bytes;
+    unsigned char* buffer = NULL;
+    if (checksum) {
+        length += 4;
+        buffer = length <= sizeof(stackBuffer) ? stackBuffer : malloc(length);
+        memcpy(buffer, bytes, length - 4);
+        memcpy(buffer + length - 4, checksum, 4);
+        payload = buffer;
+    }
+
+    char* string = malloc(BTCBase58EncodedCapacity(length) + 1);
+    string[BTCBase58EncodeBytes(string, payload, length)] = '\0';
+
+    if (buffer) {
+        BTCSecureMemset(buffer, 0, length);
+        if (buffer != stackBuffer) free(buffer);
     }
-    
-    // Restore leading zeros
-    int nLeadingZeros = 0;
-    for (const char* p = cstring; *p == BTCBase58Alphabet[0]; p++)
-        nLeadingZeros++;
-    
-    result = [NSMutableData dataWithLength:nLeadingZeros + bnsize];
-    
-    // Copy the bignum to the beginning of array. We'll reverse it then and zeros will become leading zeros.
-    [result replaceBytesInRange:NSMakeRange(0, bnsize) withBytes:bndata.bytes length:bnsize];
-    
-    // Convert little endian data to big endian
-    BTCDataReverse(result);
-    
-    finish();
-    
+    return string;
+}
+
+
+
+
+#pragma mark - Public API
+
+
+
+
+NSMutableData* BTCDataFromBase58(NSString* string) {
+    return BTCDataFromBase58CString([string cStringUsingEncoding:NSASCIIStringEncoding]);
+}
+
+NSMutableData* BTCDataFromBase58Check(NSString* string) {
+    return BTCDataFromBase58CheckCString([string cStringUsingEncoding:NSASCIIStringEncoding]);
+}
+
+NSMutableData* BTCDataFromBase58CString(const char* cstring) {
+    if (cstring == NULL) return nil;
+
+    const char* begin = NULL;
+    const char* end = NULL;
+    if (!BTCBase58GetDigitsRange(cstring, &begin, &end)) return nil;
+
+    NSMutableData* result = [NSMutableData dataWithLength:end - begin];
+    result.length = BTCBase58DecodeDigits(result.mutableBytes, begin, end);
     return result;
 }
 
 NSMutableData* BTCDataFromBase58CheckCString(const char* cstring) {
-    if (cstring == NULL) return nil;
-    
     NSMutableData* result = BTCDataFromBase58CString(cstring);
-    size_t length = result.length;
-    if (length < 4) {
-        return nil;
-    }
-    NSData* hash = BTCHash256([result subdataWithRange:NSMakeRange(0, length - 4)]);
-    
+    if (!result) return nil;
+
     // Last 4 bytes should be equal first 4 bytes of the hash.
-    if (memcmp(hash.bytes, result.bytes + length - 4, 4) != 0) {
+    if (!BTCBase58VerifyChecksum(result.bytes, result.length)) {
+        BTCDataClear(result);
         return nil;
     }
-    [result setLength:length - 4];
+    [result setLength:result.length - 4];
     return result;
 }
 
 
 char* BTCBase58CStringWithData(NSData* data) {
     if (!data) return NULL;
-    
-    BN_CTX* pctx = BN_CTX_new();
-    __block BIGNUM bn58; BN_init(&bn58); BN_set_word(&bn58, 58);
-    __block BIGNUM bn0;  BN_init(&bn0);  BN_zero(&bn0);
-    __block BIGNUM bn; BN_init(&bn); BN_zero(&bn);
-    __block BIGNUM dv; BN_init(&dv); BN_zero(&dv);
-    __block BIGNUM rem; BN_init(&rem); BN_zero(&rem);
-    
-    void(^finish)() = ^{
-        if (pctx) BN_CTX_free(pctx);
-        BN_clear_free(&bn58);
-        BN_clear_free(&bn0);
-        BN_clear_free(&bn);
-        BN_clear_free(&dv);
-        BN_clear_free(&rem);
-    };
-    
-    // Convert big endian data to little endian.
-    // Extra zero at the end make sure bignum will interpret as a positive number.
-    NSMutableData* tmp = BTCReversedMutableData(data);
-    tmp.length += 1;
-    
-    // Convert little endian data to bignum
-    {
-        NSUInteger size = tmp.length;
-        NSMutableData* mdata = [tmp mutableCopy];
-        
-        // Reverse to convert to OpenSSL bignum endianess
-        BTCDataReverse(mdata);
-        
-        // BIGNUM's byte stream format expects 4 bytes of
-        // big endian size data info at the front
-        [mdata replaceBytesInRange:NSMakeRange(0, 0) withBytes:"\0\0\0\0" length:4];
-        unsigned char* bytes = mdata.mutableBytes;
-        bytes[0] = (size >> 24) & 0xff;
-        bytes[1] = (size >> 16) & 0xff;
-        bytes[2] = (size >> 8) & 0xff;
-        bytes[3] = (size >> 0) & 0xff;
-        
-        BN_mpi2bn(bytes, (int)mdata.length, &bn);
-    }
-    
-    // Expected size increase from base58 conversion is approximately 137%
-    // use 138% to be safe
-    NSMutableData* stringData = [NSMutableData dataWithCapacity:data.length*138/100 + 1];
-    
-    while (BN_cmp(&bn, &bn0) > 0) {
-        if (!BN_div(&dv, &rem, &bn, &bn58, pctx)) {
-            finish();
-            return nil;
-        }
-        BN_copy(&bn, &dv);
-        unsigned long c = BN_get_word(&rem);
-        [stringData appendBytes:BTCBase58Alphabet + c length:1];
-    }
-    finish();
-    
-    // Leading zeroes encoded as base58 ones ("1")
-    const unsigned char* pbegin = data.bytes;
-    const unsigned char* pend = data.bytes + data.length;
-    for (const unsigned char* p = pbegin; p < pend && *p == 0; p++) {
-        [stringData appendBytes:BTCBase58Alphabet + 0 length:1];
-    }
-    
-    // Convert little endian std::string to big endian
-    BTCDataReverse(stringData);
-    
-    [stringData appendBytes:"" length:1];
-    
-    char* r = malloc(stringData.length);
-    memcpy(r, stringData.bytes, stringData.length);
-    BTCDataClear(stringData);
-    return r;
+    return BTCBase58CStringWithBytes(data.bytes, data.length, NULL);
 }
 
 // String in Base58 with checksum
-char* BTCBase58CheckCStringWithData(NSData* immutabledata) {
-    if (!immutabledata) return NULL;
+char* BTCBase58CheckCStringWithData(NSData* data) {
+    if (!data) return NULL;
     // add 4-byte hash check to the end
-    NSMutableData* data = [immutabledata mutableCopy];
-    NSData* checksum = BTCHash256(data);
-    [data appendBytes:checksum.bytes length:4];
-    char* result = BTCBase58CStringWithData(data);
-    BTCDataClear(data);
+    unsigned char checksum[32];
+    BTCHash256Bytes(checksum, data.bytes, data.length);
+    char* result = BTCBase58CStringWithBytes(data.bytes, data.length, checksum);
+    BTCSecureMemset(checksum, 0, sizeof(checksum));
     return result;
 }
 
@@ -235,5 +288,78 @@ NSString* BTCBase58CheckStringWithData(NSData* data) {
 
 
 
+#pragma mark - Batch API
+
+
+
+
+NSArray* BTCDataFromBase58CheckBatch(NSArray* strings) {
+    NSUInteger count = strings.count;
+    NSMutableArray* items = [NSMutableArray arrayWithCapacity:count];
+    const unsigned char** payloads = malloc(MAX(count, 1) * sizeof(*payloads));
+    size_t* lengths = malloc(MAX(count, 1) * sizeof(*lengths));
+
+    // Decode all strings first, then verify checksums of valid ones in parallel lanes.
+    NSUInteger validCount = 0;
+    for (NSString* string in strings) {
+        NSMutableData* data = BTCDataFromBase58(string);
+        if (data.length >= 4) {
+            payloads[validCount] = data.bytes;
+            lengths[validCount] = data.length - 4;
+            validCount++;
+            [items addObject:data];
+        } else {
+            [items addObject:[NSNull null]];
+        }
+    }
+
+    unsigned char* hashes = malloc(MAX(validCount, 1) * 32);
+    BTCHash256Buffers(hashes, payloads, lengths, validCount);
+
+    NSUInteger validIndex = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        NSMutableData* data = items[i];
+        if ((id)data == [NSNull null]) continue;
+        if (memcmp(hashes + 32 * validIndex, payloads[validIndex] + lengths[validIndex], 4) == 0) {
+            [data setLength:lengths[validIndex]];
+        } else {
+            BTCDataClear(data);
+            items[i] = [NSNull null];
+        }
+        validIndex++;
+    }
+
+    BTCSecureMemset(hashes, 0, MAX(validCount, 1) * 32);
+    free(hashes);
+    free(payloads);
+    free(lengths);
+    return items;
+}
+
+NSArray* BTCBase58CheckStringBatch(NSArray* dataItems) {
+    NSUInteger count = dataItems.count;
+    const unsigned char** messages = malloc(MAX(count, 1) * sizeof(*messages));
+    size_t* lengths = malloc(MAX(count, 1) * sizeof(*lengths));
+    for (NSUInteger i = 0; i < count; i++) {
+        NSData* data = dataItems[i];
+        messages[i] = data.bytes;
+        lengths[i] = data.length;
+    }
+
+    unsigned char* checksums = malloc(MAX(count, 1) * 32);
+    BTCHash256Buffers(checksums, messages, lengths, count);
 
+    NSMutableArray* strings = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        char* s = BTCBase58CStringWithBytes(messages[i], lengths[i], checksums + 32 * i);
+        [strings addObject:[NSString stringWithCString:s encoding:NSASCIIStringEncoding]];
+        BTCSecureClearCString(s);
+        free(s);
+    }
 
+    BTCSecureMemset(checksums, 0, MAX(count, 1) * 32);
+    free(checksums);
+    free(messages);
+    free(lengths);
+    return strings;
+}
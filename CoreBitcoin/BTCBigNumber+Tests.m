@@ -2,6 +2,7 @@
 
 #import "BTCBigNumber+Tests.h"
 #import "BTCData.h"
+#import "BTCBigNumberPool.h"
 
 @implementation BTCBigNumber (Tests)
 
@@ -97,6 +98,49 @@
         BTCBigNumber* bn2 = [[BTCBigNumber alloc] initWithSignedLittleEndian:data];
         NSLog(@"bn = %@", [bn2 hexString]);
     }
+
+    [self testPool];
+}
+
++ (void) testPool {
+    NSAssert([[[[BTCBigNumber alloc] initWithDecimalString:@"-123456789012345678901234567890"] decimalString]
+              isEqual:@"-123456789012345678901234567890"], @"Decimal string should be parsed and printed back");
+    NSAssert([[[[BTCBigNumber alloc] initWithString:@"zz" base:36] stringInBase:36] isEqual:@"zz"], @"Base 36 string should be parsed and printed back");
+
+    BTCBigNumberPoolStatistics stats1 = BTCBigNumberPoolGetStatistics();
+
+    // Nested frames share the thread's context. Numbers are cleared when the outermost frame is closed.
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    NSAssert(ctx, @"Pool should provide a context");
+    BIGNUM* secret = BN_CTX_get(ctx);
+    BN_set_word(secret, 0xdeadbeef);
+    BN_CTX* ctx2 = BTCBigNumberPoolBegin();
+    NSAssert(ctx2 == ctx, @"Nested frame should use the same context");
+    BIGNUM* inner = BN_CTX_get(ctx2);
+    NSAssert(inner != secret, @"Nested frame should not reuse numbers of the outer frame");
+    BTCBigNumberPoolEnd(ctx2);
+    NSAssert(BN_get_word(secret) == 0xdeadbeef, @"Closing a nested frame should not clear numbers of the outer frame");
+    BTCBigNumberPoolEnd(ctx);
+    for (int i = 0; i < secret->dmax; i++) {
+        NSAssert(secret->d[i] == 0, @"Pooled numbers should be cleared when the outermost frame is closed");
+    }
+
+    BTCBigNumberPoolStatistics stats2 = BTCBigNumberPoolGetStatistics();
+    NSAssert(stats2.frames >= stats1.frames + 2, @"Both frames should be counted");
+    NSAssert(stats2.clears >= stats1.clears + 1, @"Only the outermost frame should clear the pool");
+
+    // Benchmark: arithmetic used to allocate a new BN_CTX for every operation.
+    BTCMutableBigNumber* bn = [[BTCMutableBigNumber alloc] initWithUInt64:0xdeadf00ddeadbeef];
+    BTCBigNumber* n = [[BTCBigNumber alloc] initWithString:@"FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141" base:16];
+    CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+    for (int i = 0; i < 100000; i++) {
+        [bn multiply:n mod:n];
+        [bn add:n mod:n];
+    }
+    CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+    BTCBigNumberPoolStatistics stats3 = BTCBigNumberPoolGetStatistics();
+    NSLog(@"BTCBigNumberPool: 200000 modular operations in %.1f ms, %@ contexts created in total for %@ frames",
+          (t2 - t1) * 1000.0, @(stats3.contextsCreated), @(stats3.frames));
 }
 
 @end
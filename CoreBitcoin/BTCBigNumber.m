@@ -2,6 +2,7 @@
 
 #import "BTCBigNumber.h"
 #import "BTCData.h"
+#import "BTCBigNumberPool.h"
 
 #define BTCBigNumberCompare(a, b) (BN_cmp(&(a->_bignum), &(b->_bignum)))
 
@@ -300,9 +301,6 @@
             0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     };
     
-    BN_CTX* pctx = NULL;
-    BIGNUM bnBase; BN_init(&bnBase); BN_set_word(&bnBase, (BN_ULONG)base);
-    
     while (1) {
         unsigned char c = (unsigned char)*psz++;
         if (c == 0) break; // break when null-terminator is hit
@@ -324,8 +322,7 @@
             } else if (base == 32) {
                 BN_lshift(&_bignum, &_bignum, 5);
             } else {
-                if (!pctx) pctx = BN_CTX_new();
-                BN_mul(&_bignum, &_bignum, &bnBase, pctx);
+                BN_mul_word(&_bignum, (BN_ULONG)base);
             }
             
             BN_add_word(&_bignum, n);
@@ -335,9 +332,6 @@
     if (isNegative) {
         BN_set_negative(&_bignum, 1);
     }
-    
-    BN_free(&bnBase);
-    if (pctx) BN_CTX_free(pctx);
 }
 
 - (NSString*) stringInBase:(NSUInteger)base {
@@ -345,26 +339,25 @@
     
     NSMutableData* resultData = nil;
     
-    BN_CTX* pctx = BN_CTX_new();
-    BIGNUM bnBase; BN_init(&bnBase); BN_set_word(&bnBase, (BN_ULONG)base);
-    BIGNUM bn0;    BN_init(&bn0);    BN_zero(&bn0);
-    BIGNUM bn;     BN_init(&bn);     BN_copy(&bn, &_bignum);
-    
-    BN_set_negative(&bn, false);
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
+    if (!pctx) return nil;
+    BIGNUM* bn = BN_CTX_get(pctx);
+    if (!bn || !BN_copy(bn, &_bignum)) {
+        BTCBigNumberPoolEnd(pctx);
+        return nil;
+    }
     
-    BIGNUM dv;  BN_init(&dv);
-    BIGNUM rem; BN_init(&rem);
+    BN_set_negative(bn, false);
     
-    if (BN_cmp(&bn, &bn0) == 0) {
+    if (BN_is_zero(bn)) {
         resultData = [NSMutableData dataWithBytes:"0" length:1];
     } else {
-        while (BN_cmp(&bn, &bn0) > 0) {
-            if (!BN_div(&dv, &rem, &bn, &bnBase, pctx)) {
-                NSLog(@"BTCBigNumber: stringInBase failed to BN_div");
+        while (!BN_is_zero(bn)) {
+            BN_ULONG c = BN_div_word(bn, (BN_ULONG)base);
+            if (c == (BN_ULONG)-1) {
+                NSLog(@"BTCBigNumber: stringInBase failed to BN_div_word");
                 break;
             }
-            BN_copy(&bn, &dv);
-            BN_ULONG c = BN_get_word(&rem);
             
             if (!resultData) resultData = [NSMutableData data];
             
@@ -379,12 +372,7 @@
         }
     }
     
-    BN_clear_free(&dv);
-    BN_clear_free(&rem);
-    BN_clear_free(&bn);
-    BN_free(&bn0);
-    BN_free(&bnBase);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return resultData ? [[NSString alloc] initWithData:resultData encoding:NSASCIIStringEncoding] : nil;
 }
 
@@ -417,10 +405,11 @@
     if (size <= 3) {
         result = (uint32_t)(BN_get_word(&_bignum) << 8*(3-size));
     } else {
-        BIGNUM bn;
-        BN_init(&bn);
-        BN_rshift(&bn, &_bignum, 8*(size-3));
-        result = (uint32_t)BN_get_word(&bn);
+        BN_CTX* pctx = BTCBigNumberPoolBegin();
+        if (!pctx) return 0;
+        BIGNUM* bn = BN_CTX_get(pctx);
+        if (bn && BN_rshift(bn, &_bignum, 8*(size-3))) result = (uint32_t)BN_get_word(bn);
+        BTCBigNumberPoolEnd(pctx);
     }
     // The 0x00800000 bit denotes the sign.
     // Thus, if it is already set, divide the mantissa by 256 and increase the exponent.
@@ -614,11 +603,11 @@
 // Returns an array of two new BTCBigNumber instances: @[ quotient, remainder ]
 - (NSArray*) divmod:(BTCBigNumber*)other
 {
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BTCBigNumber* r = [BTCBigNumber new];
     BTCBigNumber* m = [BTCBigNumber new];
     BN_div(&(r->_bignum), &(m->_bignum), &(self->_bignum), &(other->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return @[r, m];
 }
 
@@ -629,9 +618,9 @@
 
 - (void) withContext:(void(^)(BN_CTX* pctx))block
 {
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     block(pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
 }
 
 
@@ -689,9 +678,9 @@
 }
 
 - (instancetype) add:(BTCBigNumber*)other mod:(BTCBigNumber*)mod {
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mod_add(&(self->_bignum), &(self->_bignum), &(other->_bignum), &(mod->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
@@ -701,37 +690,37 @@
 }
 
 - (instancetype) subtract:(BTCBigNumber*)other mod:(BTCBigNumber*)mod {
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mod_sub(&(self->_bignum), &(self->_bignum), &(other->_bignum), &(mod->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) multiply:(BTCBigNumber*)other { // *=
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mul(&(self->_bignum), &(self->_bignum), &(other->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) multiply:(BTCBigNumber*)other mod:(BTCBigNumber *)mod {
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mod_mul(&(self->_bignum), &(self->_bignum), &(other->_bignum), &(mod->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) divide:(BTCBigNumber*)other { // /=
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_div(&(self->_bignum), NULL, &(self->_bignum), &(other->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) mod:(BTCBigNumber*)other { // %=
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_div(NULL, &(self->_bignum), &(self->_bignum), &(other->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
@@ -755,23 +744,23 @@
 }
 
 - (instancetype) inverseMod:(BTCBigNumber*)mod { // (a^-1) mod n
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mod_inverse(&(self->_bignum), &(self->_bignum), &(mod->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) exp:(BTCBigNumber*)power { // pow(self, p)
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_exp(&(self->_bignum), &(self->_bignum), &(power->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
 - (instancetype) exp:(BTCBigNumber*)power mod:(BTCBigNumber *)mod { // pow(self,p) % m
-    BN_CTX* pctx = BN_CTX_new();
+    BN_CTX* pctx = BTCBigNumberPoolBegin();
     BN_mod_exp(&(self->_bignum), &(self->_bignum), &(power->_bignum), &(mod->_bignum), pctx);
-    BN_CTX_free(pctx);
+    BTCBigNumberPoolEnd(pctx);
     return self;
 }
 
@@ -0,0 +1,37 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+#import <openssl/bn.h>
+
+// Per-thread pool of OpenSSL BN_CTX and scratch BIGNUMs.
+// Each thread lazily gets one BN_CTX that lives until the thread exits, so arithmetic in
+// BTCBigNumber, BTCCurvePoint and BTCKey does not allocate a new context for every call.
+//
+//     BN_CTX* ctx = BTCBigNumberPoolBegin();
+//     if (!ctx) return nil;
+//     BIGNUM* bn = BN_CTX_get(ctx);
+//     ...
+//     BTCBigNumberPoolEnd(ctx);
+//
+// Scratch numbers are taken with BN_CTX_get() and stay valid until the matching BTCBigNumberPoolEnd().
+// Frames can be nested: functions using the pool may call each other.
+
+// Opens a new frame in the context of the current thread and returns the context.
+// Returns NULL if the context cannot be allocated.
+BN_CTX* BTCBigNumberPoolBegin(void);
+
+// Closes the frame opened by BTCBigNumberPoolBegin().
+// When the outermost frame is closed, all numbers in the pool are cleared, including temporaries
+// used by OpenSSL inside the context, so no secret values remain in memory between calls.
+void BTCBigNumberPoolEnd(BN_CTX* ctx);
+
+// Counters for all threads since the process started.
+typedef struct {
+    int64_t contextsCreated;  // Contexts allocated: one for each thread that used the pool.
+    int64_t contextsReleased; // Contexts freed when their threads exited.
+    int64_t frames;           // Calls to BTCBigNumberPoolBegin(): every one of them used to allocate a BN_CTX.
+    int64_t clears;           // Outermost frames closed, each followed by clearing of the pool.
+} BTCBigNumberPoolStatistics;
+
+// Returns a snapshot of the pool counters.
+BTCBigNumberPoolStatistics BTCBigNumberPoolGetStatistics(void);
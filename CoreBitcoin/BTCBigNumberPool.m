@@ -0,0 +1,99 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBigNumberPool.h"
+#import <libkern/OSAtomic.h>
+#include <pthread.h>
+
+// Number of pooled BIGNUMs that are always cleared when the outermost frame is closed.
+// Numbers beyond it are cleared as long as they have allocated storage.
+// Leaves room for temporaries of BN_mod_inverse and EC_POINT_mul that may be left
+// unallocated in the middle of the pool.
+#define BTCBigNumberPoolClearCount 32
+
+typedef struct {
+    BN_CTX* ctx;
+    NSUInteger depth;
+} BTCBigNumberPoolThreadState;
+
+static pthread_key_t BTCBigNumberPoolKey;
+static BTCBigNumberPoolStatistics BTCBigNumberPoolCounters;
+
+// Overwrites values and storage of the numbers in the pool.
+// BN_CTX_get() resets a number to zero, but leaves its old bytes in memory.
+static void BTCBigNumberPoolClear(BN_CTX* ctx) {
+    BN_CTX_start(ctx);
+    for (int i = 0; ; i++) {
+        BIGNUM* bn = BN_CTX_get(ctx);
+        if (!bn) break;
+        if (i >= BTCBigNumberPoolClearCount && !bn->d) break;
+        BN_clear(bn);
+    }
+    BN_CTX_end(ctx);
+}
+
+static void BTCBigNumberPoolThreadExit(void* value) {
+    BTCBigNumberPoolThreadState* state = value;
+    if (state->ctx) {
+        BTCBigNumberPoolClear(state->ctx);
+        BN_CTX_free(state->ctx);
+        OSAtomicIncrement64(&BTCBigNumberPoolCounters.contextsReleased);
+    }
+    free(state);
+}
+
+static void BTCBigNumberPoolCreateKey(void) {
+    pthread_key_create(&BTCBigNumberPoolKey, BTCBigNumberPoolThreadExit);
+}
+
+static BTCBigNumberPoolThreadState* BTCBigNumberPoolCurrentState(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, BTCBigNumberPoolCreateKey);
+
+    BTCBigNumberPoolThreadState* state = pthread_getspecific(BTCBigNumberPoolKey);
+    if (state) return state;
+
+    state = calloc(1, sizeof(*state));
+    if (!state) return NULL;
+    state->ctx = BN_CTX_new();
+    if (!state->ctx) {
+        NSLog(@"BTCBigNumberPool: BN_CTX_new() failed");
+        free(state);
+        return NULL;
+    }
+    if (pthread_setspecific(BTCBigNumberPoolKey, state) != 0) {
+        BN_CTX_free(state->ctx);
+        free(state);
+        return NULL;
+    }
+    OSAtomicIncrement64(&BTCBigNumberPoolCounters.contextsCreated);
+    return state;
+}
+
+BN_CTX* BTCBigNumberPoolBegin(void) {
+    BTCBigNumberPoolThreadState* state = BTCBigNumberPoolCurrentState();
+    if (!state) return NULL;
+    BN_CTX_start(state->ctx);
+    state->depth++;
+    OSAtomicIncrement64(&BTCBigNumberPoolCounters.frames);
+    return state->ctx;
+}
+
+void BTCBigNumberPoolEnd(BN_CTX* ctx) {
+    if (!ctx) return;
+    BTCBigNumberPoolThreadState* state = pthread_getspecific(BTCBigNumberPoolKey);
+    NSCAssert(state && state->ctx == ctx && state->depth > 0, @"BTCBigNumberPoolEnd must be called on the thread that called BTCBigNumberPoolBegin");
+    BN_CTX_end(ctx);
+    if (--state->depth == 0) {
+        BTCBigNumberPoolClear(ctx);
+        OSAtomicIncrement64(&BTCBigNumberPoolCounters.clears);
+    }
+}
+
+BTCBigNumberPoolStatistics BTCBigNumberPoolGetStatistics(void) {
+    BTCBigNumberPoolStatistics stats;
+    stats.contextsCreated  = OSAtomicAdd64(0, &BTCBigNumberPoolCounters.contextsCreated);
+    stats.contextsReleased = OSAtomicAdd64(0, &BTCBigNumberPoolCounters.contextsReleased);
+    stats.frames           = OSAtomicAdd64(0, &BTCBigNumberPoolCounters.frames);
+    stats.clears           = OSAtomicAdd64(0, &BTCBigNumberPoolCounters.clears);
+    return stats;
+}
@@ -8,6 +8,7 @@
 #import "BTCKeychain.h"
 #import "BTCCurvePoint.h"
 #import "BTCBigNumber.h"
+#import "BTCBigNumberPool.h"
 #include <openssl/ec.h>
 #include <openssl/ecdsa.h>
 #include <openssl/evp.h>
@@ -296,7 +297,7 @@
     
     invp = [[p mutableCopy] inverseMod:[BTCCurvePoint curveOrder]];
     
-    P = [[BTCCurvePoint generator] multiply:invp];
+    P = [[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:invp];
     Q = [[P copy] multiply:q];
     
     NSAssert(P, @"P should be valid");
@@ -393,16 +394,17 @@
     ECDSA_SIG sigValue;
     ECDSA_SIG *sig = &sigValue;
     
-    BIGNUM r; BN_init(&r); BN_copy(&r, Kx.BIGNUM);
-    BIGNUM s; BN_init(&s); BN_copy(&s, unblindedSignature.BIGNUM);
+    // r and s are cleared together with the pool when the frame is closed.
+    BN_CTX *ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return nil;
     
-    sig->r = &r;
-    sig->s = &s;
+    BIGNUM *r = BN_CTX_get(ctx); BN_copy(r, Kx.BIGNUM);
+    BIGNUM *s = BN_CTX_get(ctx); BN_copy(s, unblindedSignature.BIGNUM);
     
-    // The remaining code is taken from BTCKey where we produce a canonical signature.
+    sig->r = r;
+    sig->s = s;
     
-    BN_CTX *ctx = BN_CTX_new();
-    BN_CTX_start(ctx);
+    // The remaining code is taken from BTCKey where we produce a canonical signature.
     
     EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_secp256k1);
     BIGNUM *order = BN_CTX_get(ctx);
@@ -413,8 +415,6 @@
         // enforce low S values, by negating the value (modulo the order) if above order/2.
         BN_sub(sig->s, order, sig->s);
     }
-    BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
     EC_GROUP_free(group);
     
     unsigned int sigSize = 72; // typical size of a ECDSA signature (when both numbers are 33 bytes).
@@ -424,11 +424,9 @@
     unsigned char *pos = (unsigned char *)signature.mutableBytes;
     sigSize = i2d_ECDSA_SIG(sig, &pos);
 
-    // Do not free sig as its pointers belong to external parameters
+    // Do not free sig as its pointers belong to the pool.
     // ECDSA_SIG_free(sig);
-    // Instead, clear individual bignums.
-    BN_clear_free(&r);
-    BN_clear_free(&s);
+    BTCBigNumberPoolEnd(ctx);
     
     // Shrink to fit actual size
     [signature setLength:sigSize];
@@ -0,0 +1,12 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBlock.h"
+
+@interface BTCBlock (Tests)
+
++ (void) runAllTests;
+
+// Serialized genesis block of the main network.
++ (NSData*) genesisBlockData;
+
+@end
@@ -0,0 +1,183 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBlock+Tests.h"
+#import "BTCTransaction+Tests.h"
+#import "BTCBlockHeader.h"
+#import "BTCTransaction.h"
+#import "BTCTransactionInput.h"
+#import "BTCTransactionOutput.h"
+#import "BTCProtocolSerialization.h"
+#import "BTCScript.h"
+#import "BTCAddress.h"
+#import "BTCData.h"
+
+@implementation BTCBlock (Tests)
+
++ (void) runAllTests {
+    [self testGenesisBlock];
+    [self testLazyParsing];
+    [self testWitnessTransactions];
+    [self testMalformedBlocks];
+    [self testSignatureOperations];
+}
+
++ (NSData*) genesisBlockData {
+    return BTCDataFromHex(@"0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a29ab5f49ffff001d1dac2b7c01"
+                          "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4d04ffff001d0104455468652054696d65732030332f4a616e2f32303039204368616e63656c6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f757420666f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000");
+}
+
+// Builds a block with a number of distinct transactions.
++ (BTCBlock*) sampleBlockWithTransactionsCount:(NSUInteger)count {
+    BTCBlock* genesis = [[BTCBlock alloc] initWithData:[self genesisBlockData]];
+    BTCTransaction* coinbase = genesis.transactions[0];
+
+    NSMutableArray* txs = [NSMutableArray array];
+    for (NSUInteger i = 0; i < count; i++) {
+        BTCTransaction* tx = [coinbase copy];
+        tx.lockTime = (uint32_t)i;
+        [txs addObject:tx];
+    }
+    BTCBlock* block = [[BTCBlock alloc] init];
+    block.transactions = txs;
+    [block updateMerkleTree];
+    return block;
+}
+
++ (void) testGenesisBlock {
+    NSData* data = [self genesisBlockData];
+
+    BTCBlockHeader* header = [[BTCBlockHeader alloc] initWithData:data];
+    NSAssert(header, @"should parse header from the block data");
+    NSAssert([header.blockID isEqual:@"000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f"], @"should compute genesis block hash");
+    NSAssert([header.data isEqual:[data subdataWithRange:NSMakeRange(0, 80)]], @"header should serialize back to the same bytes");
+    NSAssert(header.time == 1231006505, @"should parse time");
+    NSAssert(header.nonce == 2083236893, @"should parse nonce");
+
+    for (NSNumber* lazy in @[@NO, @YES]) {
+        BTCBlock* block = [[BTCBlock alloc] initWithData:data lazy:lazy.boolValue];
+        NSAssert(block, @"should parse genesis block");
+        NSAssert([block.blockID isEqual:header.blockID], @"block hash should match header hash");
+        NSAssert(block.transactionsCount == 1, @"genesis block has one transaction");
+        NSAssert([[block transactionHashAtIndex:0] isEqual:BTCReversedData(BTCDataFromHex(@"4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b"))], @"should compute coinbase txid");
+        NSAssert([[block computeMerkleRootHash] isEqual:block.header.merkleRootHash], @"merkle root should match header");
+        NSAssert([block.data isEqual:data], @"block should serialize back to the same bytes");
+        NSAssert([[block transactionAtIndex:0] isCoinbase], @"first transaction should be coinbase");
+    }
+
+    NSInputStream* stream = [NSInputStream inputStreamWithData:data];
+    [stream open];
+    BTCBlock* block = [[BTCBlock alloc] initWithStream:stream];
+    [stream close];
+    NSAssert(block, @"should parse genesis block from stream");
+    NSAssert([block.data isEqual:data], @"block parsed from stream should serialize back to the same bytes");
+}
+
++ (void) testLazyParsing {
+    BTCBlock* sample = [self sampleBlockWithTransactionsCount:100];
+    NSData* data = sample.data;
+
+    BTCBlock* eager = [[BTCBlock alloc] initWithData:data];
+    BTCBlock* lazy = [[BTCBlock alloc] initWithData:data lazy:YES];
+    NSAssert(eager && lazy, @"should parse sample block");
+    NSAssert(lazy.transactionsCount == 100, @"should count transactions");
+    NSAssert([lazy.header.merkleRootHash isEqual:[lazy computeMerkleRootHash]], @"txids of raw transactions should match merkle root");
+
+    for (NSUInteger i = 0; i < 100; i++) {
+        NSAssert([[lazy transactionHashAtIndex:i] isEqual:[eager transactionHashAtIndex:i]], @"lazy and eager txids should match");
+        NSAssert([[lazy transactionDataAtIndex:i] isEqual:[eager transactionDataAtIndex:i]], @"lazy and eager tx data should match");
+    }
+
+    BTCTransaction* tx = [lazy transactionAtIndex:42];
+    NSAssert(tx == [lazy transactionAtIndex:42], @"decoded transaction should be cached");
+    NSAssert(tx.lockTime == 42, @"should decode the right transaction");
+
+    // Modifications of decoded transactions must be reflected in the block.
+    tx.lockTime = 1000;
+    NSAssert(![lazy.data isEqual:data], @"block payload should reflect modified transaction");
+    NSAssert(![lazy.header.merkleRootHash isEqual:[lazy computeMerkleRootHash]], @"merkle root should reflect modified transaction");
+    tx.lockTime = 42;
+    NSAssert([lazy.data isEqual:data], @"block payload should be restored");
+
+    BTCBlock* copy = [lazy copy];
+    NSAssert([copy.data isEqual:data], @"copy of the lazy block should have the same payload");
+    [copy transactionAtIndex:42].lockTime = 1000;
+    NSAssert(tx.lockTime == 42, @"copy should not share decoded transactions");
+
+    NSArray* txs = lazy.transactions;
+    NSAssert(txs.count == 100, @"should decode all transactions");
+    NSAssert(txs[42] == tx, @"should reuse already decoded transactions");
+    NSAssert([lazy.data isEqual:data], @"fully decoded block should have the same payload");
+}
+
++ (void) testWitnessTransactions {
+    BTCBlock* genesis = [[BTCBlock alloc] initWithData:[self genesisBlockData]];
+    BTCTransaction* witnessTx = [[BTCTransaction alloc] initWithData:[BTCTransaction sampleWitnessTransactionData]];
+    BTCBlock* sample = [[BTCBlock alloc] init];
+    sample.transactions = @[genesis.transactions[0], witnessTx];
+    [sample updateMerkleTree];
+    NSData* data = sample.data;
+
+    BTCBlock* lazy = [[BTCBlock alloc] initWithData:data lazy:YES];
+    NSAssert(lazy, @"should parse block with segwit transaction lazily");
+    NSAssert([[lazy transactionHashAtIndex:1] isEqual:witnessTx.transactionHash], @"txid of raw segwit transaction should not cover witness");
+    NSAssert([[lazy computeMerkleRootHash] isEqual:sample.header.merkleRootHash], @"merkle root should be computed from txids");
+    NSAssert([[lazy transactionDataAtIndex:1] isEqual:witnessTx.data], @"raw transaction should include witness");
+    NSAssert([lazy transactionAtIndex:1].hasWitness, @"decoded transaction should have witness");
+
+    BTCBlock* eager = [[BTCBlock alloc] initWithData:data];
+    NSAssert([eager.data isEqual:data], @"block with segwit transaction should round-trip");
+}
+
++ (void) testMalformedBlocks {
+    NSData* data = [self sampleBlockWithTransactionsCount:3].data;
+
+    for (NSUInteger length = 0; length < data.length; length += 7) {
+        NSData* truncated = [data subdataWithRange:NSMakeRange(0, length)];
+        NSAssert(![[BTCBlock alloc] initWithData:truncated], @"truncated block should not parse");
+        NSAssert(![[BTCBlock alloc] initWithData:truncated lazy:YES], @"truncated block should not parse lazily");
+    }
+
+    // Absurd transaction count should be rejected before allocating anything.
+    NSMutableData* bogus = [[data subdataWithRange:NSMakeRange(0, 80)] mutableCopy];
+    [bogus appendData:[BTCProtocolSerialization dataForVarInt:0xFFFFFFFFULL]];
+    NSAssert(![[BTCBlock alloc] initWithData:bogus lazy:YES], @"should reject absurd transaction count");
+}
+
++ (void) testSignatureOperations {
+    BTCBlock* genesis = [[BTCBlock alloc] initWithData:[self genesisBlockData]];
+    NSAssert(genesis.sigOpCount == 1, @"genesis block pays to a pubkey with OP_CHECKSIG");
+    
+    BTCTransaction* coinbase = genesis.transactions[0];
+    NSAssert([coinbase P2SHSigOpCountWithSpentOutputs:nil] == 0, @"coinbase has no P2SH sigops");
+    
+    NSArray* pubkeys = @[BTCDataFromHex(@"0102"), BTCDataFromHex(@"0304"), BTCDataFromHex(@"0506")];
+    BTCScript* redeemScript = [[BTCScript alloc] initWithPublicKeys:pubkeys signaturesRequired:2];
+    
+    BTCTransaction* funding = [[BTCTransaction alloc] init];
+    BTCTransactionInput* fundingInput = [[BTCTransactionInput alloc] init];
+    fundingInput.previousHash = coinbase.transactionHash;
+    fundingInput.previousIndex = 0;
+    fundingInput.signatureScript = [[BTCScript alloc] initWithString:@"[01]"];
+    [funding addInput:fundingInput];
+    [funding addOutput:[[BTCTransactionOutput alloc] initWithValue:1000 script:redeemScript.scriptHashScript]];
+    
+    BTCTransaction* spending = [[BTCTransaction alloc] init];
+    BTCTransactionInput* spendingInput = [[BTCTransactionInput alloc] init];
+    spendingInput.previousHash = funding.transactionHash;
+    spendingInput.previousIndex = 0;
+    spendingInput.signatureScript = [[[BTCScript alloc] initWithString:@"0 [01] [02]"] appendData:redeemScript.data];
+    [spending addInput:spendingInput];
+    BTCAddress* address = [BTCPublicKeyAddress addressWithData:BTCDataFromHex(@"7ab89f9fae3f8043dcee5f7b5467a0f0a6e2f7e1")];
+    [spending addOutput:[[BTCTransactionOutput alloc] initWithValue:1000 script:[[BTCScript alloc] initWithAddress:address]]];
+    
+    NSAssert(spending.sigOpCount == 1, @"legacy count does not look into the redeem script");
+    NSAssert([spending P2SHSigOpCountWithSpentOutputs:funding.outputs] == 3, @"should count sigops in the redeem script");
+    NSAssert([spending P2SHSigOpCountWithSpentOutputs:nil] == 0, @"inputs without known outputs are not counted");
+    
+    BTCBlock* block = [[BTCBlock alloc] init];
+    block.transactions = @[coinbase, funding, spending];
+    NSAssert(block.sigOpCount == 2, @"should sum legacy sigops of all transactions");
+    NSAssert([block P2SHSigOpCountWithOutputLookup:nil] == 3, @"should find outputs created in the same block");
+}
+
+@end
@@ -3,11 +3,21 @@
 #import <Foundation/Foundation.h>
 
 @class BTCBlockHeader;
+@class BTCOutpoint;
+@class BTCTransaction;
+@class BTCTransactionOutput;
 @interface BTCBlock : NSObject <NSCopying>
 
 @property(nonatomic, readonly) BTCBlockHeader* header;
+
+// Array of BTCTransaction objects.
+// For lazily parsed block, accessing this property decodes all transactions.
+// Setting this property discards lazily parsed transactions.
 @property(nonatomic) NSArray* transactions;
 
+// Number of transactions in the block. Does not decode transactions.
+@property(nonatomic, readonly) NSUInteger transactionsCount;
+
 @property(nonatomic, readonly) NSData* blockHash;
 @property(nonatomic, readonly) NSString* blockID;
 @property(nonatomic, readonly) NSData* data; // serialized form of the block
@@ -28,6 +38,15 @@
 @property(nonatomic) NSDictionary* userInfo;
 
 
+// Number of signature operations in all transactions counted by legacy rules.
+// Valid block must not have more than BTC_MAX_BLOCK_SIGOPS. See CheckBlock() in bitcoind.
+@property(nonatomic, readonly) NSUInteger sigOpCount;
+
+// Number of signature operations in P2SH redeem scripts of all transactions.
+// Outputs created earlier in the block are found without calling the lookup block.
+// Inputs spending unknown outputs are not counted. See ConnectBlock() in bitcoind.
+- (NSUInteger) P2SHSigOpCountWithOutputLookup:(BTCTransactionOutput* (^)(BTCOutpoint* outpoint))outputLookup;
+
 // Computes merkle root hash from the current transaction array.
 - (NSData*) computeMerkleRootHash;
 
@@ -38,4 +57,26 @@
 // Instantiates an empty block with a given header.
 - (id) initWithHeader:(BTCBlockHeader*)header;
 
+// Parses block with all its transactions.
+- (id) initWithData:(NSData*)data;
+
+// Parses block from data buffer.
+// If lazy is YES, only validates the structure and records the location of each transaction.
+// Transactions are decoded on first access, so header- and txid-only workflows
+// do not instantiate any inputs or outputs. Lazy block is not thread-safe.
+- (id) initWithData:(NSData*)data lazy:(BOOL)lazy;
+
+// Parses block from input stream.
+- (id) initWithStream:(NSInputStream*)stream;
+
+// Returns transaction at a given index decoding it if needed.
+- (BTCTransaction*) transactionAtIndex:(NSUInteger)index;
+
+// Returns serialized transaction at a given index without decoding it.
+// Returned data references the block buffer without copying.
+- (NSData*) transactionDataAtIndex:(NSUInteger)index;
+
+// Returns hash of the transaction at a given index without decoding it.
+- (NSData*) transactionHashAtIndex:(NSUInteger)index;
+
 @end
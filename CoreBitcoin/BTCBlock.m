@@ -2,13 +2,100 @@
 
 #import "BTCBlock.h"
 #import "BTCBlockHeader.h"
+#import "BTCTransaction.h"
+#import "BTCTransactionInput.h"
+#import "BTCTransactionOutput.h"
+#import "BTCOutpoint.h"
+#import "BTCMerkleTree.h"
+#import "BTCProtocolSerialization.h"
+#import "BTCData.h"
+#import "BTCSHA256.h"
 #import "BTCHashID.h"
+#import <CommonCrypto/CommonCrypto.h>
+
+// Smallest possible serialized transaction: version, 1 input with empty script, 1 output with empty script, lock time.
+static const NSUInteger BTCBlockMinTransactionLength = 4 + 1 + 41 + 1 + 9 + 4;
+
+// Location of a serialized transaction within the block and location of its witness data (BIP144), if any.
+typedef struct {
+    NSRange range;
+    NSRange witnessRange;
+} BTCBlockTransactionRange;
+
+// Validates structure of a transaction and advances the cursor past it without instantiating any objects.
+// Location of the witness data (or an empty range) is returned in witnessRangeOut.
+static BOOL BTCDataCursorSkipTransaction(BTCDataCursor* cursor, NSRange* witnessRangeOut) {
+    uint64_t inputsCount = 0;
+    uint64_t count = 0;
+    uint64_t length = 0;
+    unsigned char flags = 0;
+    BOOL extended = NO;
+
+    *witnessRangeOut = NSMakeRange(0, 0);
+
+    if (!BTCDataCursorSkip(cursor, 4)) return NO; // version
+
+    if (!BTCDataCursorReadVarInt(cursor, &inputsCount)) return NO;
+    if (inputsCount == 0) {
+        // BIP144 marker and flag (see -[BTCTransaction parseCursor:]).
+        if (!BTCDataCursorReadBytes(cursor, &flags, 1)) return NO;
+        extended = YES;
+        if (flags != 0 && !BTCDataCursorReadVarInt(cursor, &inputsCount)) return NO;
+    }
+    if (inputsCount > BTCDataCursorRemaining(cursor) / 41) return NO;
+    for (uint64_t i = 0; i < inputsCount; i++) {
+        if (!BTCDataCursorSkip(cursor, 32 + 4)) return NO; // outpoint
+        if (!BTCDataCursorReadVarInt(cursor, &length)) return NO;
+        if (length > BTCDataCursorRemaining(cursor)) return NO;
+        if (!BTCDataCursorSkip(cursor, (NSUInteger)length + 4)) return NO; // script and sequence
+    }
+
+    if (!extended || flags != 0) {
+        if (!BTCDataCursorReadVarInt(cursor, &count)) return NO;
+        if (count > BTCDataCursorRemaining(cursor) / 9) return NO;
+        for (uint64_t i = 0; i < count; i++) {
+            if (!BTCDataCursorSkip(cursor, 8)) return NO; // value
+            if (!BTCDataCursorReadVarInt(cursor, &length)) return NO;
+            if (length > BTCDataCursorRemaining(cursor)) return NO;
+            if (!BTCDataCursorSkip(cursor, (NSUInteger)length)) return NO; // script
+        }
+    }
+
+    if (flags & 1) {
+        flags ^= 1;
+        NSUInteger witnessLocation = cursor->offset;
+        BOOL hasWitness = NO;
+        for (uint64_t i = 0; i < inputsCount; i++) {
+            if (!BTCDataCursorReadVarInt(cursor, &count)) return NO;
+            if (count > BTCDataCursorRemaining(cursor)) return NO;
+            hasWitness = hasWitness || count > 0;
+            for (uint64_t j = 0; j < count; j++) {
+                if (!BTCDataCursorReadVarInt(cursor, &length)) return NO;
+                if (length > BTCDataCursorRemaining(cursor)) return NO;
+                if (!BTCDataCursorSkip(cursor, (NSUInteger)length)) return NO; // witness item
+            }
+        }
+        if (!hasWitness) return NO;
+        *witnessRangeOut = NSMakeRange(witnessLocation, cursor->offset - witnessLocation);
+    }
+    if (flags != 0) return NO;
+
+    if (!BTCDataCursorSkip(cursor, 4)) return NO; // lock time
+
+    return YES;
+}
 
 @interface BTCBlock ()
 @property(nonatomic, readwrite) BTCBlockHeader* header;
 @end
 
-@implementation BTCBlock
+@implementation BTCBlock {
+    // Lazily parsed block keeps its serialized form and an array of BTCBlockTransactionRange (one per transaction).
+    // Decoded transactions are cached in _lazyTransactions (NSNull for not yet decoded ones).
+    NSData* _lazyData;
+    NSData* _lazyRanges;
+    NSMutableArray* _lazyTransactions;
+}
 
 - (id) init {
     if (self = [super init]) {
@@ -25,9 +112,13 @@
 }
 
 - (id) initWithData:(NSData*)data {
+    return [self initWithData:data lazy:NO];
+}
+
+- (id) initWithData:(NSData*)data lazy:(BOOL)lazy {
     if (self = [super init])
     {
-        if (![self parseData:data]) return nil;
+        if (![self parseData:data lazy:lazy]) return nil;
     }
     return self;
 }
@@ -39,19 +130,164 @@
     return self;
 }
 
-- (BOOL) parseData:(NSData*)data {
+- (BOOL) parseData:(NSData*)data lazy:(BOOL)lazy {
+    if (!data) return NO;
+
+    data = [data copy];
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+
+    _header = [[BTCBlockHeader alloc] initWithCursor:&cursor];
+    if (!_header) return NO;
+
+    uint64_t txCount = 0;
+    if (!BTCDataCursorReadVarInt(&cursor, &txCount)) return NO;
+
+    // Sanity check to avoid allocating huge arrays for malformed data.
+    if (txCount > BTCDataCursorRemaining(&cursor) / BTCBlockMinTransactionLength) return NO;
 
-    // TODO
+    if (!lazy) {
+        NSMutableArray* txs = [NSMutableArray arrayWithCapacity:(NSUInteger)txCount];
+        for (uint64_t i = 0; i < txCount; i++) {
+            BTCTransaction* tx = [[BTCTransaction alloc] initWithCursor:&cursor];
+            if (!tx) return NO;
+            [txs addObject:tx];
+        }
+        _transactions = txs;
+        return YES;
+    }
+
+    NSMutableData* ranges = [NSMutableData dataWithLength:(NSUInteger)txCount * sizeof(BTCBlockTransactionRange)];
+    BTCBlockTransactionRange* rangesPtr = ranges.mutableBytes;
+    for (uint64_t i = 0; i < txCount; i++) {
+        NSUInteger location = cursor.offset;
+        if (!BTCDataCursorSkipTransaction(&cursor, &rangesPtr[i].witnessRange)) return NO;
+        rangesPtr[i].range = NSMakeRange(location, cursor.offset - location);
+    }
 
+    _lazyData = data;
+    _lazyRanges = ranges;
+    _lazyTransactions = [NSMutableArray arrayWithCapacity:(NSUInteger)txCount];
+    for (uint64_t i = 0; i < txCount; i++) {
+        [_lazyTransactions addObject:[NSNull null]];
+    }
     return YES;
 }
 
-- (BOOL) parseStream:(NSStream*)stream {
-    // TODO
+- (BOOL) parseStream:(NSInputStream*)stream {
+    if (!stream) return NO;
+    if (stream.streamStatus == NSStreamStatusClosed) return NO;
+    if (stream.streamStatus == NSStreamStatusNotOpen) return NO;
+
+    _header = [[BTCBlockHeader alloc] initWithStream:stream];
+    if (!_header) return NO;
+
+    uint64_t txCount = 0;
+    if ([BTCProtocolSerialization readVarInt:&txCount fromStream:stream] == 0) return NO;
+
+    NSMutableArray* txs = [NSMutableArray array];
+    for (uint64_t i = 0; i < txCount; i++) {
+        BTCTransaction* tx = [[BTCTransaction alloc] initWithStream:stream];
+        if (!tx) return NO;
+        [txs addObject:tx];
+    }
+    _transactions = txs;
 
     return YES;
 }
 
+
+
+#pragma mark - Transactions
+
+
+- (BOOL) isLazy {
+    return _lazyRanges != nil;
+}
+
+- (NSArray*) transactions {
+    if ([self isLazy]) {
+        NSUInteger count = self.transactionsCount;
+        NSMutableArray* txs = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCTransaction* tx = [self transactionAtIndex:i];
+            if (!tx) return nil;
+            [txs addObject:tx];
+        }
+        // All transactions are decoded now, no need to keep the lazy state.
+        self.transactions = txs;
+    }
+    return _transactions;
+}
+
+- (void) setTransactions:(NSArray *)transactions {
+    _transactions = transactions;
+    _lazyData = nil;
+    _lazyRanges = nil;
+    _lazyTransactions = nil;
+}
+
+- (NSUInteger) transactionsCount {
+    if ([self isLazy]) {
+        return _lazyRanges.length / sizeof(BTCBlockTransactionRange);
+    }
+    return _transactions.count;
+}
+
+- (BTCTransaction*) transactionAtIndex:(NSUInteger)index {
+    if (![self isLazy]) {
+        return _transactions[index];
+    }
+    id tx = _lazyTransactions[index];
+    if (tx == [NSNull null]) {
+        tx = [[BTCTransaction alloc] initWithData:[self transactionDataAtIndex:index]];
+        if (!tx) return nil;
+        _lazyTransactions[index] = tx;
+    }
+    return tx;
+}
+
+- (NSData*) transactionDataAtIndex:(NSUInteger)index {
+    if (![self isLazy]) {
+        return [_transactions[index] data];
+    }
+    id tx = _lazyTransactions[index];
+    if (tx != [NSNull null]) {
+        // Decoded transaction may have been modified.
+        return [tx data];
+    }
+    NSRange range = ((const BTCBlockTransactionRange*)_lazyRanges.bytes)[index].range;
+    BTCDataCursor cursor = BTCDataCursorMake(_lazyData);
+    cursor.offset = range.location;
+    return BTCDataCursorReadData(&cursor, range.length);
+}
+
+- (NSData*) transactionHashAtIndex:(NSUInteger)index {
+    if (![self isLazy]) {
+        return [_transactions[index] transactionHash];
+    }
+    id tx = _lazyTransactions[index];
+    if (tx != [NSNull null]) {
+        return [tx transactionHash];
+    }
+    BTCBlockTransactionRange range = ((const BTCBlockTransactionRange*)_lazyRanges.bytes)[index];
+    if (range.witnessRange.length == 0) {
+        return BTCHash256([self transactionDataAtIndex:index]);
+    }
+
+    // Transaction hash does not cover marker, flag and witness data, so we hash the remaining parts.
+    const unsigned char* bytes = (const unsigned char*)_lazyData.bytes;
+    NSUInteger inputsLocation = range.range.location + 4 + 2;
+    NSUInteger lockTimeLocation = NSMaxRange(range.witnessRange);
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256Update(&ctx, bytes + range.range.location, 4);
+    BTCSHA256Update(&ctx, bytes + inputsLocation, range.witnessRange.location - inputsLocation);
+    BTCSHA256Update(&ctx, bytes + lockTimeLocation, NSMaxRange(range.range) - lockTimeLocation);
+    NSMutableData* hash = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    BTCSHA256Final(hash.mutableBytes, &ctx);
+    return BTCSHA256(hash);
+}
+
 - (NSData*) blockHash {
     return self.header.blockHash;
 }
@@ -69,7 +305,11 @@
 
     [data appendData:self.header.data];
 
-    // TODO: add transactions.
+    NSUInteger count = self.transactionsCount;
+    [data appendData:[BTCProtocolSerialization dataForVarInt:count]];
+    for (NSUInteger i = 0; i < count; i++) {
+        [data appendData:[self transactionDataAtIndex:i]];
+    }
 
     return data;
 }
@@ -104,13 +344,90 @@
 }
 
 
+#pragma mark - Signature Operations
+
+
+- (NSUInteger) sigOpCount {
+    NSUInteger count = 0;
+    NSUInteger txcount = self.transactionsCount;
+    for (NSUInteger i = 0; i < txcount; i++) {
+        count += [self transactionAtIndex:i].sigOpCount;
+    }
+    return count;
+}
+
+- (NSUInteger) P2SHSigOpCountWithOutputLookup:(BTCTransactionOutput* (^)(BTCOutpoint* outpoint))outputLookup {
+    // Outputs created in this block can be spent by the following transactions.
+    NSMutableDictionary* blockOutputs = [NSMutableDictionary dictionary];
+    
+    NSUInteger count = 0;
+    NSUInteger txcount = self.transactionsCount;
+    for (NSUInteger i = 0; i < txcount; i++) {
+        BTCTransaction* tx = [self transactionAtIndex:i];
+        if (!tx.isCoinbase) {
+            NSMutableArray* outputs = [NSMutableArray arrayWithCapacity:tx.inputs.count];
+            for (BTCTransactionInput* txin in tx.inputs) {
+                BTCOutpoint* outpoint = txin.outpoint;
+                BTCTransactionOutput* txout = blockOutputs[outpoint];
+                if (!txout && outputLookup) {
+                    txout = outputLookup(outpoint);
+                }
+                [outputs addObject:txout ?: [NSNull null]];
+            }
+            count += [tx P2SHSigOpCountWithSpentOutputs:outputs];
+        }
+        NSData* txhash = tx.transactionHash;
+        uint32_t outputIndex = 0;
+        for (BTCTransactionOutput* txout in tx.outputs) {
+            blockOutputs[[[BTCOutpoint alloc] initWithHash:txhash index:outputIndex]] = txout;
+            outputIndex++;
+        }
+    }
+    return count;
+}
+
+
 #pragma mark - Merkle Tree
 
 
 // Computes merkle root hash from the current transaction array.
 - (NSData*) computeMerkleRootHash {
-    // TODO
-    return nil;
+    NSUInteger count = self.transactionsCount;
+    NSMutableArray* hashes = [NSMutableArray arrayWithCapacity:count];
+
+    // Transactions without witness data which were not decoded yet are hashed in one batch right from the block data.
+    const unsigned char** messages = malloc(MAX(count, 1) * sizeof(*messages));
+    size_t* lengths = malloc(MAX(count, 1) * sizeof(*lengths));
+    NSUInteger* indexes = malloc(MAX(count, 1) * sizeof(*indexes));
+    size_t batchCount = 0;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if ([self isLazy] && _lazyTransactions[i] == [NSNull null]) {
+            BTCBlockTransactionRange range = ((const BTCBlockTransactionRange*)_lazyRanges.bytes)[i];
+            if (range.witnessRange.length == 0) {
+                messages[batchCount] = (const unsigned char*)_lazyData.bytes + range.range.location;
+                lengths[batchCount] = range.range.length;
+                indexes[batchCount] = i;
+                batchCount++;
+                [hashes addObject:[NSNull null]];
+                continue;
+            }
+        }
+        [hashes addObject:[self transactionHashAtIndex:i]];
+    }
+
+    if (batchCount > 0) {
+        NSMutableData* digests = [NSMutableData dataWithLength:32 * batchCount];
+        BTCHash256Buffers(digests.mutableBytes, messages, lengths, batchCount);
+        for (size_t k = 0; k < batchCount; k++) {
+            hashes[indexes[k]] = [digests subdataWithRange:NSMakeRange(32 * k, 32)];
+        }
+    }
+
+    free(messages);
+    free(lengths);
+    free(indexes);
+    return [[BTCMerkleTree alloc] initWithHashes:hashes].merkleRoot;
 }
 
 - (void) updateMerkleTree {
@@ -120,6 +437,16 @@
 - (id) copyWithZone:(NSZone *)zone {
     BTCBlock* b = [[BTCBlock alloc] init];
     b.header = [self->_header copy];
+    if ([self isLazy]) {
+        // Serialized data is immutable and can be shared. Only decoded transactions need to be copied.
+        b->_lazyData = self->_lazyData;
+        b->_lazyRanges = self->_lazyRanges;
+        b->_lazyTransactions = [[NSMutableArray alloc] initWithCapacity:self->_lazyTransactions.count];
+        for (id tx in self->_lazyTransactions) {
+            [b->_lazyTransactions addObject:[tx copy]];
+        }
+        return b;
+    }
     b.transactions = [[NSArray alloc] initWithArray:self.transactions copyItems:YES]; // so each element is copied individually
     return b;
 }
@@ -0,0 +1,9 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBlockFileReader.h"
+
+@interface BTCBlockFileReader (Tests)
+
++ (void) runAllTests;
+
+@end
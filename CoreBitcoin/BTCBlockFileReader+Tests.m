@@ -0,0 +1,107 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBlockFileReader+Tests.h"
+#import "BTCBlock+Tests.h"
+#import "BTCBlock.h"
+#import "BTCNetwork.h"
+#import "BTCErrors.h"
+
+@implementation BTCBlockFileReader (Tests)
+
++ (void) runAllTests {
+    [self testReadingBlockFile];
+    [self testTruncatedBlockFile];
+    [self testParallelReading];
+}
+
++ (NSURL*) temporaryFileWithData:(NSData*)data {
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"blk%@.dat", [NSUUID UUID].UUIDString]];
+    [data writeToFile:path atomically:YES];
+    return [NSURL fileURLWithPath:path];
+}
+
++ (void) appendRecord:(NSData*)blockData toData:(NSMutableData*)data network:(BTCNetwork*)network {
+    uint32_t magic = OSSwapHostToLittleInt32(network.magic);
+    uint32_t length = OSSwapHostToLittleInt32((uint32_t)blockData.length);
+    [data appendBytes:&magic length:4];
+    [data appendBytes:&length length:4];
+    [data appendData:blockData];
+}
+
++ (void) testReadingBlockFile {
+    NSData* genesis = [BTCBlock genesisBlockData];
+
+    NSMutableData* file = [NSMutableData data];
+    [self appendRecord:genesis toData:file network:[BTCNetwork mainnet]];
+    [file appendData:[@"garbage" dataUsingEncoding:NSASCIIStringEncoding]];
+    [self appendRecord:genesis toData:file network:[BTCNetwork mainnet]];
+    [self appendRecord:genesis toData:file network:[BTCNetwork testnet]]; // skipped: different magic
+    [file increaseLengthBy:1000]; // zero padding as preallocated by bitcoind
+
+    NSURL* url = [self temporaryFileWithData:file];
+
+    NSError* error = nil;
+    BTCBlockFileReader* reader = [[BTCBlockFileReader alloc] initWithURL:url network:[BTCNetwork mainnet] error:&error];
+    NSAssert(reader, @"should map the file");
+
+    NSMutableArray* offsets = [NSMutableArray array];
+    BOOL result = [reader enumerateBlocksLazily:YES usingBlock:^(BTCBlock *block, NSUInteger offset, BOOL *stop) {
+        NSAssert([block.data isEqual:genesis], @"should read the genesis block");
+        [offsets addObject:@(offset)];
+    } error:&error];
+    NSAssert(result, @"should read the file");
+    NSAssert([offsets isEqual:(@[@8, @(8 + genesis.length + 7 + 8)])], @"should find two mainnet blocks and report their offsets");
+
+    __block NSUInteger count = 0;
+    [reader enumerateBlockDataUsingBlock:^(NSData *blockData, NSUInteger offset, BOOL *stop) {
+        count++;
+        *stop = YES;
+    } error:&error];
+    NSAssert(count == 1, @"should stop enumeration");
+
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
++ (void) testTruncatedBlockFile {
+    NSMutableData* file = [NSMutableData data];
+    [self appendRecord:[BTCBlock genesisBlockData] toData:file network:[BTCNetwork mainnet]];
+    file.length = file.length - 1;
+
+    NSURL* url = [self temporaryFileWithData:file];
+    NSError* error = nil;
+    BTCBlockFileReader* reader = [[BTCBlockFileReader alloc] initWithURL:url network:[BTCNetwork mainnet] error:&error];
+    BOOL result = [reader enumerateBlocksLazily:NO usingBlock:^(BTCBlock *block, NSUInteger offset, BOOL *stop) {
+        NSAssert(0, @"should not yield truncated block");
+    } error:&error];
+    NSAssert(!result, @"should fail on truncated record");
+    NSAssert(error.code == BTCErrorMalformedBlockFile, @"should report malformed block file");
+
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
++ (void) testParallelReading {
+    NSMutableArray* urls = [NSMutableArray array];
+    for (int i = 0; i < 8; i++) {
+        NSMutableData* file = [NSMutableData data];
+        for (int j = 0; j < 10; j++) {
+            [self appendRecord:[BTCBlock genesisBlockData] toData:file network:[BTCNetwork mainnet]];
+        }
+        [urls addObject:[self temporaryFileWithData:file]];
+    }
+
+    __block NSUInteger count = 0;
+    NSError* error = nil;
+    BOOL result = [BTCBlockFileReader enumerateBlocksInFiles:urls network:[BTCNetwork mainnet] lazily:YES usingBlock:^(BTCBlock *block, NSURL *url, NSUInteger offset, BOOL *stop) {
+        @synchronized(urls) {
+            count++;
+        }
+    } error:&error];
+    NSAssert(result, @"should read all files");
+    NSAssert(count == 80, @"should read all blocks from all files");
+
+    for (NSURL* url in urls) {
+        [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+    }
+}
+
+@end
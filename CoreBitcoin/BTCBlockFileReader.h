@@ -0,0 +1,48 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+
+@class BTCBlock;
+@class BTCNetwork;
+
+// Reads blocks from blk*.dat files written by Bitcoin Core.
+// Every record in the file is: network magic (4 bytes), block length (uint32 LE) and serialized block.
+// The file is memory-mapped, so only the pages that are actually touched are loaded from disk.
+@interface BTCBlockFileReader : NSObject
+
+// URL of the block file.
+@property(nonatomic, readonly) NSURL* URL;
+
+// Network which magic number is used to find block records.
+@property(nonatomic, readonly) BTCNetwork* network;
+
+// Memory-mapped contents of the file.
+@property(nonatomic, readonly) NSData* data;
+
+// Maps the file into memory. Returns nil and sets the error if the file cannot be mapped.
+// Network defaults to mainnet.
+- (id) initWithURL:(NSURL*)url network:(BTCNetwork*)network error:(NSError**)errorOut;
+
+// Enumerates serialized blocks in the order they appear in the file.
+// Block data references the mapped file without copying.
+// Offset is the location of the block in the file (right after the magic and length prefix).
+// Bytes between records that do not start with the magic number (e.g. zero padding at the end of file) are skipped.
+// Returns NO and sets the error if the file contains a truncated record.
+- (BOOL) enumerateBlockDataUsingBlock:(void(^)(NSData* blockData, NSUInteger offset, BOOL* stop))block error:(NSError**)errorOut;
+
+// Enumerates parsed blocks in the order they appear in the file.
+// If lazy is YES, transactions are decoded on first access (see -[BTCBlock initWithData:lazy:]).
+// Returns NO and sets the error if the file is malformed or a block cannot be parsed.
+- (BOOL) enumerateBlocksLazily:(BOOL)lazy usingBlock:(void(^)(BTCBlock* block, NSUInteger offset, BOOL* stop))block error:(NSError**)errorOut;
+
+// Enumerates blocks in several files in parallel. Blocks within one file are enumerated in order,
+// but the callback is invoked concurrently for different files, so it must be thread-safe.
+// Setting *stop to YES stops enumeration of all files.
+// Returns NO and sets the error to the first encountered error. Other files are not affected by an error in one file.
++ (BOOL) enumerateBlocksInFiles:(NSArray* /* [NSURL] */)urls
+                        network:(BTCNetwork*)network
+                         lazily:(BOOL)lazy
+                     usingBlock:(void(^)(BTCBlock* block, NSURL* url, NSUInteger offset, BOOL* stop))block
+                          error:(NSError**)errorOut;
+
+@end
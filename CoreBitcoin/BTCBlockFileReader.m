@@ -0,0 +1,118 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCBlockFileReader.h"
+#import "BTCBlock.h"
+#import "BTCNetwork.h"
+#import "BTCErrors.h"
+#import "BTCProtocolSerialization.h"
+
+@implementation BTCBlockFileReader
+
+- (id) initWithURL:(NSURL*)url network:(BTCNetwork*)network error:(NSError**)errorOut {
+    if (self = [super init]) {
+        _URL = url;
+        _network = network ?: [BTCNetwork mainnet];
+        _data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedAlways error:errorOut];
+        if (!_data) return nil;
+    }
+    return self;
+}
+
+- (NSError*) errorWithDescription:(NSString*)description offset:(NSUInteger)offset {
+    NSString* message = [NSString stringWithFormat:NSLocalizedString(@"%@ at offset %@ in %@.", @""), description, @(offset), _URL.lastPathComponent ?: @"block file"];
+    return [NSError errorWithDomain:BTCErrorDomain code:BTCErrorMalformedBlockFile userInfo:@{NSLocalizedDescriptionKey: message}];
+}
+
+- (BOOL) enumerateBlockDataUsingBlock:(void(^)(NSData* blockData, NSUInteger offset, BOOL* stop))block error:(NSError**)errorOut {
+    NSData* data = _data;
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    uint32_t magic = OSSwapHostToLittleInt32(_network.magic);
+
+    while (BTCDataCursorRemaining(&cursor) >= 8) {
+        const unsigned char* record = cursor.bytes + cursor.offset;
+
+        // Resynchronize on the next magic number if the record does not start with it.
+        if (memcmp(record, &magic, 4) != 0) {
+            const unsigned char* next = memmem(record + 1, BTCDataCursorRemaining(&cursor) - 1, &magic, 4);
+            if (!next) break;
+            cursor.offset = next - cursor.bytes;
+            continue;
+        }
+
+        NSUInteger recordOffset = cursor.offset;
+        uint32_t length = 0;
+        BTCDataCursorSkip(&cursor, 4);
+        BTCDataCursorReadUInt32(&cursor, &length);
+
+        NSUInteger offset = cursor.offset;
+        NSData* blockData = BTCDataCursorReadData(&cursor, length);
+        if (!blockData) {
+            if (errorOut) *errorOut = [self errorWithDescription:NSLocalizedString(@"Truncated block record", @"") offset:recordOffset];
+            return NO;
+        }
+
+        BOOL stop = NO;
+        @autoreleasepool {
+            block(blockData, offset, &stop);
+        }
+        if (stop) break;
+    }
+    return YES;
+}
+
+- (BOOL) enumerateBlocksLazily:(BOOL)lazy usingBlock:(void(^)(BTCBlock* block, NSUInteger offset, BOOL* stop))block error:(NSError**)errorOut {
+    __block NSError* parseError = nil;
+    BOOL result = [self enumerateBlockDataUsingBlock:^(NSData* blockData, NSUInteger offset, BOOL* stop) {
+        BTCBlock* b = [[BTCBlock alloc] initWithData:blockData lazy:lazy];
+        if (!b) {
+            parseError = [self errorWithDescription:NSLocalizedString(@"Malformed block", @"") offset:offset];
+            *stop = YES;
+            return;
+        }
+        block(b, offset, stop);
+    } error:errorOut];
+
+    if (parseError) {
+        if (errorOut) *errorOut = parseError;
+        return NO;
+    }
+    return result;
+}
+
++ (BOOL) enumerateBlocksInFiles:(NSArray*)urls
+                        network:(BTCNetwork*)network
+                         lazily:(BOOL)lazy
+                     usingBlock:(void(^)(BTCBlock* block, NSURL* url, NSUInteger offset, BOOL* stop))block
+                          error:(NSError**)errorOut {
+    __block volatile BOOL stopAll = NO;
+    __block NSError* firstError = nil;
+    NSObject* lock = [[NSObject alloc] init];
+
+    dispatch_apply(urls.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        if (stopAll) return;
+
+        NSURL* url = urls[i];
+        NSError* error = nil;
+        BTCBlockFileReader* reader = [[BTCBlockFileReader alloc] initWithURL:url network:network error:&error];
+
+        BOOL success = reader && [reader enumerateBlocksLazily:lazy usingBlock:^(BTCBlock* b, NSUInteger offset, BOOL* stop) {
+            block(b, url, offset, stop);
+            if (*stop) stopAll = YES;
+            if (stopAll) *stop = YES;
+        } error:&error];
+
+        if (!success) {
+            @synchronized(lock) {
+                if (!firstError) firstError = error;
+            }
+        }
+    });
+
+    if (firstError) {
+        if (errorOut) *errorOut = firstError;
+        return NO;
+    }
+    return YES;
+}
+
+@end
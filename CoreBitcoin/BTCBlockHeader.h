@@ -1,6 +1,7 @@
 // CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
 
 #import <Foundation/Foundation.h>
+#import "BTCProtocolSerialization.h"
 
 static const int32_t BTCBlockCurrentVersion = 2;
 
@@ -46,5 +47,8 @@ static const int32_t BTCBlockCurrentVersion = 2;
 // Parses input stream
 - (id) initWithStream:(NSInputStream*)stream;
 
+// Parses header from the cursor and advances it by 80 bytes.
+- (id) initWithCursor:(BTCDataCursor*)cursor;
+
 
 @end
@@ -38,6 +38,13 @@
     return self;
 }
 
+- (id) initWithCursor:(BTCDataCursor*)cursor {
+    if (self = [self init]) {
+        if (![self parseCursor:cursor]) return nil;
+    }
+    return self;
+}
+
 - (NSString*) previousBlockID {
     return BTCIDFromHash(self.previousBlockHash);
 }
@@ -88,18 +95,43 @@
 }
 
 - (BOOL) parseData:(NSData*)data {
-    
-    // TODO
-    
-    return YES;
+    if (!data) return NO;
+    data = [data copy];
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    return [self parseCursor:&cursor];
 }
 
-- (BOOL) parseStream:(NSStream*)stream {
-    // TODO
-    
+- (BOOL) parseCursor:(BTCDataCursor*)cursor {
+    if (BTCDataCursorRemaining(cursor) < [BTCBlockHeader headerLength]) return NO;
+
+    uint32_t version = 0;
+    BTCDataCursorReadUInt32(cursor, &version);
+    _version = (int32_t)version;
+    _previousBlockHash = BTCDataCursorReadData(cursor, 32);
+    _merkleRootHash = BTCDataCursorReadData(cursor, 32);
+    BTCDataCursorReadUInt32(cursor, &_time);
+    BTCDataCursorReadUInt32(cursor, &_difficultyTarget);
+    BTCDataCursorReadUInt32(cursor, &_nonce);
+
     return YES;
 }
 
+- (BOOL) parseStream:(NSInputStream*)stream {
+    if (!stream) return NO;
+    if (stream.streamStatus == NSStreamStatusClosed) return NO;
+    if (stream.streamStatus == NSStreamStatusNotOpen) return NO;
+
+    unsigned char buffer[80];
+    NSUInteger length = [BTCBlockHeader headerLength];
+    NSUInteger total = 0;
+    while (total < length) {
+        NSInteger n = [stream read:buffer + total maxLength:length - total];
+        if (n <= 0) return NO;
+        total += n;
+    }
+    return [self parseData:[NSData dataWithBytes:buffer length:length]];
+}
+
 - (id) copyWithZone:(NSZone *)zone {
     BTCBlockHeader* bh = [[BTCBlockHeader alloc] init];
     bh.version = self->_version;
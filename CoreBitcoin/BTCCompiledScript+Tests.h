@@ -0,0 +1,9 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCCompiledScript.h"
+
+@interface BTCCompiledScript (Tests)
+
++ (void) runAllTests;
+
+@end
@@ -0,0 +1,134 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCCompiledScript+Tests.h"
+#import "BTCScript.h"
+#import "BTCScriptMachine.h"
+#import "BTCData.h"
+
+@implementation BTCCompiledScript (Tests)
+
++ (void) runAllTests {
+    [self testInstructions];
+    [self testBranchTargets];
+    [self testCounts];
+    [self testReuse];
+    [self testSkippedBranches];
+}
+
++ (BTCCompiledScript*) compile:(NSString*)string {
+    BTCScript* script = [[BTCScript alloc] initWithString:string];
+    NSAssert(script, @"test script should be valid");
+    return script.compiledScript;
+}
+
++ (void) testInstructions {
+    BTCScript* script = [[BTCScript alloc] initWithString:@"0 [0102] OP_DUP 1:[03]"];
+    BTCCompiledScript* compiledScript = script.compiledScript;
+    NSAssert([compiledScript.data isEqual:script.data], @"compiled script should refer to the script data");
+    NSAssert(compiledScript.instructionsCount == 4, @"each chunk should become an instruction");
+
+    const BTCScriptInstruction* instructions = compiledScript.instructions;
+    NSAssert(instructions[0].opcode == OP_0 && instructions[0].dataLength == 0, @"OP_0 pushes empty data");
+    NSAssert(instructions[1].offset == 1 && instructions[1].dataOffset == 2 && instructions[1].dataLength == 2, @"pushdata should point to its bytes");
+    NSAssert(instructions[2].opcode == OP_DUP && instructions[2].offset == 4, @"opcode should be recorded with its offset");
+    NSAssert(instructions[3].opcode == OP_PUSHDATA1 && instructions[3].dataOffset == 7 && instructions[3].dataLength == 1, @"length prefix should be skipped");
+
+    NSAssert([[compiledScript subScriptFromIndex:2].data isEqual:[script subScriptFromIndex:2].data], @"subscript should match the one of the script");
+    NSAssert([compiledScript subScriptFromIndex:4].data.length == 0, @"subscript after the last instruction should be empty");
+
+    // Chunks no longer match the cached binary after deleting opcodes, compiled script should follow the chunks.
+    script = [[BTCScript alloc] initWithString:@"1 OP_CODESEPARATOR 2"];
+    [script deleteOccurrencesOfOpcode:OP_CODESEPARATOR];
+    NSAssert([script.compiledScript.data isEqual:BTCDataFromHex(@"5152")], @"compiled script should match the chunks");
+    NSAssert(script.compiledScript.instructions[1].offset == 1, @"offsets should be recomputed");
+}
+
++ (void) testBranchTargets {
+    BTCCompiledScript* compiledScript = [self compile:@"1 OP_IF 2 OP_ELSE 3 OP_ELSE 4 OP_ENDIF"];
+    const BTCScriptInstruction* instructions = compiledScript.instructions;
+    NSAssert(instructions[1].branchTarget == 3, @"OP_IF should jump to OP_ELSE");
+    NSAssert(instructions[3].branchTarget == 5, @"OP_ELSE should jump to the next OP_ELSE");
+    NSAssert(instructions[5].branchTarget == 7, @"OP_ELSE should jump to OP_ENDIF");
+    NSAssert(instructions[7].branchTarget == BTCScriptInstructionNoTarget, @"OP_ENDIF has no target");
+    NSAssert(instructions[1].branchOpCount == 0, @"small integers are not counted as operations");
+
+    compiledScript = [self compile:@"OP_IF OP_IF OP_DUP OP_ENDIF OP_ELSE OP_ENDIF"];
+    instructions = compiledScript.instructions;
+    NSAssert(instructions[0].branchTarget == 4 && instructions[0].branchOpCount == 3, @"nested branches should be skipped as a whole");
+    NSAssert(instructions[1].branchTarget == 3 && instructions[1].branchOpCount == 1, @"nested branch should have its own target");
+
+    // Instructions failing the script even when not executed must not be jumped over.
+    compiledScript = [self compile:@"OP_IF OP_CAT OP_ELSE OP_DUP OP_ENDIF"];
+    NSAssert(compiledScript.instructions[0].branchTarget == BTCScriptInstructionNoTarget, @"disabled opcode should prevent the jump");
+    NSAssert(compiledScript.instructions[2].branchTarget == 4, @"clean branch should have a target");
+
+    compiledScript = [self compile:@"OP_IF OP_IF OP_VERIF OP_ENDIF OP_ENDIF"];
+    NSAssert(compiledScript.instructions[0].branchTarget == BTCScriptInstructionNoTarget, @"OP_VERIF should prevent the jump");
+
+    NSMutableData* bigData = [NSMutableData dataWithLength:521];
+    BTCScript* script = [[[BTCScript alloc] initWithString:@"OP_IF"] appendData:bigData];
+    [script appendOpcode:OP_ENDIF];
+    NSAssert(script.compiledScript.instructions[0].branchTarget == BTCScriptInstructionNoTarget, @"oversized push should prevent the jump");
+
+    compiledScript = [self compile:@"OP_IF OP_ELSE"];
+    NSAssert(compiledScript.instructions[0].branchTarget == 1, @"OP_IF should jump to OP_ELSE");
+    NSAssert(compiledScript.instructions[1].branchTarget == BTCScriptInstructionNoTarget, @"unterminated branch has no target");
+}
+
++ (void) testCounts {
+    BTCCompiledScript* compiledScript = [self compile:@"OP_DUP OP_HASH160 [0102030405060708090a0b0c0d0e0f1011121314] OP_EQUALVERIFY OP_CHECKSIG"];
+    NSAssert(compiledScript.opCount == 4, @"pushdata should not be counted as an operation");
+    NSAssert(compiledScript.sigOpCount == 1 && compiledScript.accurateSigOpCount == 1, @"checksig counts as one sigop");
+
+    compiledScript = [self compile:@"OP_CHECKSIGVERIFY 2 [01] [02] [03] 3 OP_CHECKMULTISIG"];
+    NSAssert(compiledScript.opCount == 2, @"should count operations");
+    NSAssert(compiledScript.sigOpCount == 21, @"legacy rules count multisig as 20 sigops");
+    NSAssert(compiledScript.accurateSigOpCount == 4, @"accurate rules count multisig as the number of keys");
+
+    compiledScript = [self compile:@"[03] OP_CHECKMULTISIGVERIFY"];
+    NSAssert(compiledScript.accurateSigOpCount == 20, @"multisig without a small integer counts as 20 sigops");
+
+    compiledScript = [self compile:@""];
+    NSAssert(compiledScript.instructionsCount == 0 && compiledScript.opCount == 0 && compiledScript.sigOpCount == 0, @"empty script has no instructions");
+}
+
++ (void) testReuse {
+    BTCScript* script = [[BTCScript alloc] initWithString:@"OP_DUP OP_DROP"];
+    BTCCompiledScript* compiledScript = script.compiledScript;
+    NSAssert(script.compiledScript == compiledScript, @"compiled script should be reused");
+
+    [script appendOpcode:OP_1];
+    NSAssert(script.compiledScript != compiledScript, @"compiled script should be rebuilt after modification");
+    NSAssert(script.compiledScript.instructionsCount == 3, @"compiled script should include the appended opcode");
+
+    NSData* data = BTCDataFromHex(@"52ae");
+    BTCCompiledScript* cached = [BTCCompiledScript compiledScriptWithData:data];
+    NSAssert(cached && [cached.data isEqual:data], @"should compile binary script");
+    NSAssert([BTCCompiledScript compiledScriptWithData:[data mutableCopy]] == cached, @"should reuse compiled script for the same data");
+    NSAssert([BTCCompiledScript compiledScriptWithData:BTCDataFromHex(@"4c05")] == nil, @"should not compile invalid script");
+}
+
++ (void) testSkippedBranches {
+    // Skipped operations are still counted towards the limit of 201 operations.
+    NSMutableString* string = [NSMutableString stringWithString:@"0 OP_IF"];
+    for (int i = 0; i < 198; i++) [string appendString:@" OP_NOP"];
+    [string appendString:@" OP_ENDIF 1"];
+
+    BTCScriptMachine* scriptMachine = [[BTCScriptMachine alloc] init];
+    NSError* error = nil;
+    NSAssert([scriptMachine runScript:[[BTCScript alloc] initWithString:string] error:&error], @"200 operations are allowed");
+    NSAssert([scriptMachine.stack isEqual:@[BTCDataFromHex(@"01")]], @"branch should be skipped");
+
+    [string replaceOccurrencesOfString:@"OP_IF" withString:@"OP_IF OP_NOP OP_NOP" options:0 range:NSMakeRange(0, string.length)];
+    scriptMachine = [[BTCScriptMachine alloc] init];
+    NSAssert(![scriptMachine runScript:[[BTCScript alloc] initWithString:string] error:&error], @"202 operations are not allowed");
+
+    scriptMachine = [[BTCScriptMachine alloc] init];
+    NSAssert(![scriptMachine runScript:[[BTCScript alloc] initWithString:@"0 OP_IF OP_MUL OP_ENDIF 1"] error:&error], @"disabled opcode fails in a skipped branch");
+
+    scriptMachine = [[BTCScriptMachine alloc] init];
+    NSAssert([scriptMachine runScript:[[BTCScript alloc] initWithString:@"1 OP_NOTIF OP_RETURN OP_ELSE 2 OP_ENDIF"] error:&error], @"else branch should be executed");
+    NSAssert([scriptMachine.stack isEqual:@[BTCDataFromHex(@"02")]], @"only the else branch should affect the stack");
+}
+
+@end
@@ -0,0 +1,74 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+#import "BTCOpcode.h"
+
+// Marks an instruction without a branch target.
+static const uint32_t BTCScriptInstructionNoTarget = UINT32_MAX;
+
+// A single operation of a compiled script. All offsets are relative to BTCCompiledScript.data.
+typedef struct {
+    // Raw opcode byte. For pushdata operations it is the length byte or OP_PUSHDATA<1,2,4>.
+    uint8_t opcode;
+
+    // Offset of the first byte of the operation (its opcode).
+    uint32_t offset;
+
+    // Location of the pushed data. Both are zero for non-push operations.
+    uint32_t dataOffset;
+    uint32_t dataLength;
+
+    // For OP_IF, OP_NOTIF and OP_ELSE: index of the matching OP_ELSE or OP_ENDIF.
+    // It is set only if all instructions in between can be skipped without looking at them
+    // (no disabled opcodes, no OP_VERIF/OP_VERNOTIF and no oversized pushes).
+    // Otherwise it is BTCScriptInstructionNoTarget.
+    uint32_t branchTarget;
+
+    // Number of operations counted towards the per-script limit between this instruction
+    // and its branch target (exclusively). Zero if there is no branch target.
+    uint32_t branchOpCount;
+} BTCScriptInstruction;
+
+@class BTCScript;
+
+// Flat representation of a script prepared for execution by BTCScriptMachine.
+// Instructions refer to the script bytes instead of holding copies of the pushed data,
+// conditional branches have their targets resolved and operation counts are precomputed.
+// Compiled script is immutable and can be shared between threads.
+// Use -[BTCScript compiledScript] to get an instance; it is built once per script.
+@interface BTCCompiledScript : NSObject
+
+// Binary script which the instructions refer to.
+@property(nonatomic, readonly) NSData* data;
+
+// Array of instructions. Index of each instruction matches the index of the chunk in the original BTCScript.
+@property(nonatomic, readonly) const BTCScriptInstruction* instructions;
+@property(nonatomic, readonly) NSUInteger instructionsCount;
+
+// Number of operations counted towards the limit of 201 operations per script (all opcodes above OP_16).
+@property(nonatomic, readonly) NSUInteger opCount;
+
+// Number of signature operations as counted by legacy rules:
+// OP_CHECKSIG and OP_CHECKSIGVERIFY count as 1, OP_CHECKMULTISIG and OP_CHECKMULTISIGVERIFY count as 20.
+@property(nonatomic, readonly) NSUInteger sigOpCount;
+
+// Number of signature operations as counted for P2SH redeem scripts:
+// OP_CHECKMULTISIG and OP_CHECKMULTISIGVERIFY preceded by OP_<N> count as N.
+@property(nonatomic, readonly) NSUInteger accurateSigOpCount;
+
+// Initializes compiled script with binary data and a list of instructions parsed from it.
+// Only offsets and opcodes are used, branch targets are computed here.
+// Returns nil if the data is longer than 4 Gb.
+- (id) initWithData:(NSData*)data instructions:(const BTCScriptInstruction*)instructions count:(NSUInteger)count;
+
+// Returns a compiled script for the binary script, reusing a previously compiled one if possible.
+// Useful for scripts which are parsed again and again (e.g. the same P2SH redeem script in many inputs).
+// Returns nil if the data is not a valid script.
++ (BTCCompiledScript*) compiledScriptWithData:(NSData*)data;
+
+// Returns a script starting with the instruction at the given index (inclusively).
+// Returns an empty script if the index is equal to the number of instructions.
+// Equivalent to -[BTCScript subScriptFromIndex:].
+- (BTCScript*) subScriptFromIndex:(NSUInteger)index;
+
+@end
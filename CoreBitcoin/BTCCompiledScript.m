@@ -0,0 +1,127 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCCompiledScript.h"
+#import "BTCScript.h"
+
+// Maximum number of compiled scripts kept by +compiledScriptWithData:
+static const NSUInteger BTCCompiledScriptCacheLimit = 10000;
+
+// Pushes longer than this make the script fail even in a non-executed branch.
+static const uint32_t BTCCompiledScriptMaxElementSize = 520;
+
+// Returns YES if the instruction fails the script even when it is not executed.
+static BOOL BTCScriptInstructionFailsUnconditionally(const BTCScriptInstruction* instruction) {
+    BTCOpcode opcode = instruction->opcode;
+    if (opcode <= OP_PUSHDATA4) return instruction->dataLength > BTCCompiledScriptMaxElementSize;
+    return BTCOpcodeIsDisabled(opcode) || opcode == OP_VERIF || opcode == OP_VERNOTIF;
+}
+
+@implementation BTCCompiledScript {
+    BTCScriptInstruction* _instructions;
+}
+
+- (id) initWithData:(NSData*)data instructions:(const BTCScriptInstruction*)instructions count:(NSUInteger)count {
+    if (data.length >= UINT32_MAX) return nil;
+
+    if (self = [super init]) {
+        _data = [data copy] ?: [NSData data];
+        _instructionsCount = count;
+        _instructions = malloc(MAX(count, 1) * sizeof(BTCScriptInstruction));
+        if (count > 0) memcpy(_instructions, instructions, count * sizeof(BTCScriptInstruction));
+
+        [self compile];
+    }
+    return self;
+}
+
+- (void) dealloc {
+    free(_instructions);
+}
+
+- (const BTCScriptInstruction*) instructions {
+    return _instructions;
+}
+
+// Computes operation counts and branch targets.
+- (void) compile {
+    NSUInteger count = _instructionsCount;
+
+    // Prefix sums: number of counted operations and unconditionally failing instructions before index i.
+    uint32_t* opCounts = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t* failCounts = malloc((count + 1) * sizeof(uint32_t));
+
+    // Indexes of open OP_IF/OP_NOTIF/OP_ELSE instructions waiting for their OP_ELSE/OP_ENDIF.
+    uint32_t* branches = malloc(MAX(count, 1) * sizeof(uint32_t));
+    NSUInteger branchesCount = 0;
+
+    opCounts[0] = 0;
+    failCounts[0] = 0;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        BTCScriptInstruction* instruction = &_instructions[i];
+        BTCOpcode opcode = instruction->opcode;
+
+        instruction->branchTarget = BTCScriptInstructionNoTarget;
+        instruction->branchOpCount = 0;
+
+        opCounts[i + 1] = opCounts[i] + (opcode > OP_16 ? 1 : 0);
+        failCounts[i + 1] = failCounts[i] + (BTCScriptInstructionFailsUnconditionally(instruction) ? 1 : 0);
+
+        if (opcode == OP_IF || opcode == OP_NOTIF) {
+            branches[branchesCount++] = (uint32_t)i;
+        } else if ((opcode == OP_ELSE || opcode == OP_ENDIF) && branchesCount > 0) {
+            uint32_t branchIndex = branches[--branchesCount];
+
+            // Instructions strictly between the branch and its target can be skipped
+            // only if none of them would fail the script when not executed.
+            if (failCounts[i] == failCounts[branchIndex + 1]) {
+                _instructions[branchIndex].branchTarget = (uint32_t)i;
+                _instructions[branchIndex].branchOpCount = opCounts[i] - opCounts[branchIndex + 1];
+            }
+
+            // OP_ELSE opens a new branch that lasts until the next OP_ELSE or OP_ENDIF.
+            if (opcode == OP_ELSE) branches[branchesCount++] = (uint32_t)i;
+        }
+    }
+
+    _opCount = opCounts[count];
+    BTCScriptBytesCountSigOps(_data.bytes, _data.length, &_sigOpCount, &_accurateSigOpCount);
+
+    free(opCounts);
+    free(failCounts);
+    free(branches);
+}
+
++ (BTCCompiledScript*) compiledScriptWithData:(NSData*)data {
+    if (!data) return nil;
+
+    static NSCache* cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc] init];
+        cache.countLimit = BTCCompiledScriptCacheLimit;
+    });
+
+    BTCCompiledScript* compiledScript = [cache objectForKey:data];
+    if (compiledScript) return compiledScript;
+
+    compiledScript = [[BTCScript alloc] initWithData:data].compiledScript;
+    if (compiledScript) [cache setObject:compiledScript forKey:compiledScript.data];
+    return compiledScript;
+}
+
+- (BTCScript*) subScriptFromIndex:(NSUInteger)index {
+    if (index > _instructionsCount) {
+        [NSException raise:NSRangeException format:@"Instruction index %@ is out of bounds (%@ instructions).", @(index), @(_instructionsCount)];
+    }
+    if (index == _instructionsCount) return [[BTCScript alloc] init];
+    NSUInteger offset = _instructions[index].offset;
+    return [[BTCScript alloc] initWithData:[_data subdataWithRange:NSMakeRange(offset, _data.length - offset)]];
+}
+
+- (NSString*) description {
+    return [NSString stringWithFormat:@"<%@:0x%p %@ instructions, %@ ops, %@ sigops>", [self class], self,
+            @(_instructionsCount), @(_opCount), @(_sigOpCount)];
+}
+
+@end
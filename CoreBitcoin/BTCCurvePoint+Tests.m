@@ -4,12 +4,20 @@
 #import "BTCKey.h"
 #import "BTCBigNumber.h"
 #import "BTCCurvePoint+Tests.h"
+#import "BTCSecp256k1.h"
 
 @implementation BTCCurvePoint (Tests)
 
 + (void) runAllTests {
-    [self testPublicKey];
-    [self testDiffieHellman];
+    BTCSecp256k1Backend defaultBackend = BTCSecp256k1GetBackend();
+    for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+        if (!BTCSecp256k1SetBackend(backend.integerValue)) continue;
+        [self testPublicKey];
+        [self testDiffieHellman];
+        [self testArithmetic];
+        [self testGeneratorMultiplication];
+    }
+    BTCSecp256k1SetBackend(defaultBackend);
 }
 
 + (void) testPublicKey {
@@ -76,4 +84,53 @@
 }
 
 
++ (void) testArithmetic {
+    BTCBigNumber* a = [[BTCBigNumber alloc] initWithUnsignedBigEndian:BTCHash256([@"a" dataUsingEncoding:NSUTF8StringEncoding])];
+    BTCBigNumber* b = [[BTCBigNumber alloc] initWithUnsignedBigEndian:BTCHash256([@"b" dataUsingEncoding:NSUTF8StringEncoding])];
+    BTCBigNumber* sum = [[a mutableCopy] add:b mod:[BTCCurvePoint curveOrder]];
+
+    BTCCurvePoint* A = [[BTCCurvePoint generator] multiply:a];
+    BTCCurvePoint* B = [[BTCCurvePoint generator] multiply:b];
+
+    NSAssert([[[A copy] add:B] isEqual:[[BTCCurvePoint generator] multiply:sum]], @"a*G + b*G = (a + b)*G");
+    NSAssert([[[A copy] addGeneratorMultipliedBy:b] isEqual:[[A copy] add:B]], @"a*G + b*G = (a + b)*G");
+    NSAssert([[[A copy] add:A] isEqual:[[A copy] multiply:[[BTCBigNumber alloc] initWithInt32:2]]], @"A + A = 2*A");
+
+    // Results at infinity.
+    BTCBigNumber* minusA = [[[BTCCurvePoint curveOrder] mutableCopy] subtract:a];
+    NSAssert([[[A copy] addGeneratorMultipliedBy:minusA] isInfinity], @"a*G + (n - a)*G = O");
+    NSAssert([[[A copy] multiply:[BTCCurvePoint curveOrder]] isInfinity], @"n*A = O");
+}
+
+
++ (void) testGeneratorMultiplication {
+    BTCBigNumber* order = [BTCCurvePoint curveOrder];
+    NSArray* numbers = @[
+                         [BTCBigNumber one],
+                         [[BTCBigNumber alloc] initWithInt32:15],
+                         [[BTCBigNumber alloc] initWithInt32:16],
+                         [[order mutableCopy] subtract:[BTCBigNumber one]],
+                         [[order mutableCopy] add:[BTCBigNumber one]],
+                         [[BTCBigNumber alloc] initWithUnsignedBigEndian:BTCHash256([@"x" dataUsingEncoding:NSUTF8StringEncoding])],
+                         [[BTCBigNumber alloc] initWithUnsignedBigEndian:BTCDataFromHex(@"ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff")],
+                         ];
+    for (BTCBigNumber* number in numbers) {
+        BTCCurvePoint* expected = [[BTCCurvePoint generator] multiply:number];
+        BTCCurvePoint* point = [[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:number];
+        NSAssert([point isEqual:expected], @"Table must give the same result as generic multiplication");
+    }
+
+    NSAssert([[[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:[BTCBigNumber zero]] isInfinity], @"0*G = O");
+    NSAssert([[[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:order] isInfinity], @"n*G = O");
+
+    BTCBigNumber* number = numbers[5];
+    CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+    for (int i = 0; i < 500; i++) [[BTCCurvePoint generator] multiply:number];
+    CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+    for (int i = 0; i < 500; i++) [[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:number];
+    CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+    NSLog(@"BTCCurvePoint: 500 multiplications of G in %.4f sec generic, %.4f sec with precomputed table.", t1 - t0, t2 - t1);
+}
+
+
 @end
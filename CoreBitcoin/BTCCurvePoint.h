@@ -28,12 +28,20 @@
 // Returns the generator point. Same as [BTCCurvePoint alloc] init].
 + (instancetype) generator;
 
+// Returns OpenSSL group for secp256k1 shared by all points.
+// It holds precomputed multiples of the generator, so use it for EC_KEY and EC_POINT_mul to speed up operations with G.
++ (const EC_GROUP*) EC_GROUP;
+
 // Returns order of the secp256k1 curve (FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141).
 + (BTCBigNumber*) curveOrder;
 
 // Initializes point with its binary representation (corresponds to -data).
 - (id) initWithData:(NSData*)data;
 
+// Initializes point with number*G using a table of multiples of the generator built once per process.
+// Much faster than [[BTCCurvePoint generator] multiply:number]. With the native backend it runs in constant time.
+- (id) initWithGeneratorMultipliedBy:(BTCBigNumber*)number;
+
 // Initializes point with OpenSSL EC_POINT.
 - (id) initWithEC_POINT:(const EC_POINT*)ecpoint;
 
@@ -4,31 +4,60 @@
 #import "BTCKey.h"
 #import "BTCData.h"
 #import "BTCBigNumber.h"
+#import "BTCSecp256k1.h"
+#import "BTCBigNumberPool.h"
 #include <openssl/bn.h>
 #include <openssl/ecdsa.h>
 #include <openssl/evp.h>
 
+// Returns secp256k1 group with precomputed multiples of the generator, built once and shared by all points.
+// EC_POINT_mul uses the precomputation whenever the generator is multiplied via its first scalar argument.
+static const EC_GROUP* BTCCurvePointGroup(void) {
+    static EC_GROUP* group = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+        if (!group) {
+            NSLog(@"BTCCurvePoint: EC_GROUP_new_by_curve_name(NID_secp256k1) failed");
+            return;
+        }
+        if (!EC_GROUP_precompute_mult(group, NULL)) {
+            NSLog(@"BTCCurvePoint: EC_GROUP_precompute_mult() failed");
+        }
+    });
+    return group;
+}
+
+#if BTCSecp256k1NativeAvailable
+// Writes a non-negative number below 2^256 as a 32-byte big-endian scalar for the native backend.
+static BOOL BTCCurvePointGetScalar(unsigned char* scalar32, BTCBigNumber* number) {
+    const BIGNUM* bn = number.BIGNUM;
+    int length = BN_num_bytes(bn);
+    if (BN_is_negative(bn) || length > 32) return NO;
+    memset(scalar32, 0, 32);
+    BN_bn2bin(bn, scalar32 + 32 - length);
+    return YES;
+}
+#endif
+
 @implementation BTCCurvePoint {
-    EC_GROUP* _group;
+    const EC_GROUP* _group;
     EC_POINT* _point;
-    BN_CTX*   _bnctx;
 }
 
 - (void) dealloc {
     if (_point) EC_POINT_clear_free(_point);
     _point = NULL;
-    
-    if (_group) EC_GROUP_free(_group);
-    _group = NULL;
-    
-    if (_bnctx) BN_CTX_free(_bnctx);
-    _bnctx = NULL;
 }
 
 + (instancetype) generator {
     return [[self alloc] init];
 }
 
++ (const EC_GROUP*) EC_GROUP {
+    return BTCCurvePointGroup();
+}
+
 + (BTCBigNumber*) curveOrder {
     static BTCBigNumber* order;
     static dispatch_once_t onceToken;
@@ -42,11 +71,9 @@
     if (self = [super init]) {
         _group = NULL;
         _point = NULL;
-        _bnctx   = NULL;
         
-        _group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+        _group = BTCCurvePointGroup();
         if (!_group) {
-            NSLog(@"BTCCurvePoint: EC_GROUP_new_by_curve_name(NID_secp256k1) failed");
             goto finish;
         }
         
@@ -56,16 +83,9 @@
             goto finish;
         }
         
-        _bnctx = BN_CTX_new();
-        if (!_bnctx) {
-            NSLog(@"BTCCurvePoint: BN_CTX_new() failed");
-            goto finish;
-        }
-        
         return self;
         
     finish:
-        if (_group) EC_GROUP_free(_group);
         if (_point) EC_POINT_clear_free(_point);
         
         return nil;
@@ -86,18 +106,40 @@
 - (id) initWithData:(NSData*)data {
     if (self = [self initEmpty]) {
         
-        BIGNUM* bn = BN_bin2bn(data.bytes, (int)data.length, NULL);
-        if (!bn) {
-            return nil;
-        }
+        BN_CTX* ctx = BTCBigNumberPoolBegin();
+        if (!ctx) return nil;
         
-        if (!EC_POINT_bn2point(_group, bn, _point, _bnctx)) {
-            if (bn) BN_clear_free(bn);
-            return nil;
-        }
+        BIGNUM* bn = BN_CTX_get(ctx);
+        BOOL success = bn &&
+                       BN_bin2bn(data.bytes, (int)data.length, bn) &&
+                       EC_POINT_bn2point(_group, bn, _point, ctx);
         
-        // Point is imported, only need to cleanup an intermediate BIGNUM structure.
-        if (bn) BN_clear_free(bn);
+        // Intermediate BIGNUM is cleared together with the pool.
+        BTCBigNumberPoolEnd(ctx);
+        if (!success) return nil;
+    }
+    return self;
+}
+
+- (id) initWithGeneratorMultipliedBy:(BTCBigNumber*)number {
+    if (!number) return nil;
+
+    if (self = [self initEmpty]) {
+#if BTCSecp256k1NativeAvailable
+        if (BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative) {
+            BTCSecp256k1Point point;
+            unsigned char scalar[32];
+            BOOL success = BTCCurvePointGetScalar(scalar, number) &&
+                           BTCSecp256k1GeneratorMultiply(&point, scalar) &&
+                           [self setNativePoint:&point];
+            BTCSecureMemset(scalar, 0, sizeof(scalar));
+            if (success) return self;
+        }
+#endif
+        BN_CTX* ctx = BTCBigNumberPoolBegin();
+        BOOL success = ctx && EC_POINT_mul(_group, _point, number.BIGNUM, NULL, NULL, ctx);
+        BTCBigNumberPoolEnd(ctx);
+        if (!success) return nil;
     }
     return self;
 }
@@ -115,14 +157,12 @@
 - (NSData*) data {
     NSMutableData* data = [NSMutableData dataWithLength:33];
     
-    BIGNUM* bn = BN_new();
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return nil;
     
-    if (!bn) {
-        return nil;
-    }
-    
-    if (!EC_POINT_point2bn(_group, _point, POINT_CONVERSION_COMPRESSED, bn, _bnctx)) {
-        if (bn) BN_clear_free(bn);
+    BIGNUM* bn = BN_CTX_get(ctx);
+    if (!bn || !EC_POINT_point2bn(_group, _point, POINT_CONVERSION_COMPRESSED, bn, ctx)) {
+        BTCBigNumberPoolEnd(ctx);
         return nil;
     }
     
@@ -130,7 +170,7 @@
     
     BN_bn2bin(bn, data.mutableBytes);
     
-    if (bn) BN_clear_free(bn);
+    BTCBigNumberPoolEnd(ctx);
     
     return data;
 }
@@ -142,29 +182,70 @@
 // These modify the receiver. To create another point use -copy: [[point copy] multiply:number]
 - (instancetype) multiply:(BTCBigNumber*)number {
     if (!number) return nil;
-    
-    if (!EC_POINT_mul(_group, _point, NULL, _point, number.BIGNUM, _bnctx)) {
-        return nil;
+
+#if BTCSecp256k1NativeAvailable
+    if (BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative) {
+        BTCSecp256k1Point point;
+        unsigned char scalar[32];
+        BOOL success = [self getNativePoint:&point] &&
+                       BTCCurvePointGetScalar(scalar, number) &&
+                       BTCSecp256k1PointMultiply(&point, scalar) &&
+                       [self setNativePoint:&point];
+        BTCSecureMemset(scalar, 0, sizeof(scalar));
+        if (success) return self;
     }
+#endif
+    
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL success = ctx && EC_POINT_mul(_group, _point, NULL, _point, number.BIGNUM, ctx);
+    BTCBigNumberPoolEnd(ctx);
+    if (!success) return nil;
     return self;
 }
 
 - (instancetype) add:(BTCCurvePoint*)otherPoint {
     if (!otherPoint) return nil;
-    
-    if (!EC_POINT_add(_group, _point, _point, otherPoint.EC_POINT, _bnctx)) {
-        return nil;
+
+#if BTCSecp256k1NativeAvailable
+    if (BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative) {
+        BTCSecp256k1Point point, other;
+        if ([self getNativePoint:&point] &&
+            [otherPoint getNativePoint:&other] &&
+            BTCSecp256k1PointAdd(&point, &other) &&
+            [self setNativePoint:&point]) {
+            return self;
+        }
     }
+#endif
+    
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL success = ctx && EC_POINT_add(_group, _point, _point, otherPoint.EC_POINT, ctx);
+    BTCBigNumberPoolEnd(ctx);
+    if (!success) return nil;
     return self;
 }
 
 // Efficiently adds n*G to the receiver. Equivalent to [point add:[[G copy] multiply:number]]
 - (instancetype) addGeneratorMultipliedBy:(BTCBigNumber*)number {
     if (!number) return nil;
-    
-    if (!EC_POINT_mul(_group, _point, number.BIGNUM, _point, BN_value_one(), _bnctx)) {
-        return nil;
+
+#if BTCSecp256k1NativeAvailable
+    if (BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative) {
+        BTCSecp256k1Point point;
+        unsigned char scalar[32];
+        BOOL success = [self getNativePoint:&point] &&
+                       BTCCurvePointGetScalar(scalar, number) &&
+                       BTCSecp256k1PointAddGeneratorMultiple(&point, scalar) &&
+                       [self setNativePoint:&point];
+        BTCSecureMemset(scalar, 0, sizeof(scalar));
+        if (success) return self;
     }
+#endif
+    
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL success = ctx && EC_POINT_mul(_group, _point, number.BIGNUM, _point, BN_value_one(), ctx);
+    BTCBigNumberPoolEnd(ctx);
+    if (!success) return nil;
     
     return self;
 }
@@ -174,29 +255,55 @@
 }
 
 - (BTCBigNumber*) x {
-    BN_CTX_start(_bnctx);
-    BIGNUM* bn = BN_CTX_get(_bnctx);
-    if (!EC_POINT_get_affine_coordinates_GFp(_group, _point, bn /* x */, NULL  /* y */, _bnctx)) {
-        BN_CTX_end(_bnctx);
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return nil;
+    BIGNUM* bn = BN_CTX_get(ctx);
+    if (!bn || !EC_POINT_get_affine_coordinates_GFp(_group, _point, bn /* x */, NULL  /* y */, ctx)) {
+        BTCBigNumberPoolEnd(ctx);
         return nil;
     }
     BTCBigNumber* result = [[BTCBigNumber alloc] initWithBIGNUM:bn];
-    BN_CTX_end(_bnctx);
+    BTCBigNumberPoolEnd(ctx);
     return result;
 }
 
 - (BTCBigNumber*) y {
-    BN_CTX_start(_bnctx);
-    BIGNUM* bn = BN_CTX_get(_bnctx);
-    if (!EC_POINT_get_affine_coordinates_GFp(_group, _point, NULL /* x */, bn  /* y */, _bnctx)) {
-        BN_CTX_end(_bnctx);
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return nil;
+    BIGNUM* bn = BN_CTX_get(ctx);
+    if (!bn || !EC_POINT_get_affine_coordinates_GFp(_group, _point, NULL /* x */, bn  /* y */, ctx)) {
+        BTCBigNumberPoolEnd(ctx);
         return nil;
     }
     BTCBigNumber* result = [[BTCBigNumber alloc] initWithBIGNUM:bn];
-    BN_CTX_end(_bnctx);
+    BTCBigNumberPoolEnd(ctx);
     return result;
 }
 
+#if BTCSecp256k1NativeAvailable
+
+// Native backend handles only finite points and scalars in [0, 2^256).
+// Methods above fall back to OpenSSL when these return NO (e.g. when the result is a point at infinity).
+
+- (BOOL) getNativePoint:(BTCSecp256k1Point*)point {
+    unsigned char bytes[65];
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL success = ctx && EC_POINT_point2oct(_group, _point, POINT_CONVERSION_UNCOMPRESSED, bytes, sizeof(bytes), ctx) == sizeof(bytes);
+    BTCBigNumberPoolEnd(ctx);
+    return success && BTCSecp256k1PointParse(point, bytes, sizeof(bytes));
+}
+
+- (BOOL) setNativePoint:(const BTCSecp256k1Point*)point {
+    unsigned char bytes[65];
+    BTCSecp256k1PointSerialize(bytes, point, NO);
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL success = ctx && 1 == EC_POINT_oct2point(_group, _point, bytes, sizeof(bytes), ctx);
+    BTCBigNumberPoolEnd(ctx);
+    return success;
+}
+
+#endif
+
 // Clears internal point data.
 - (void) clear {
     if (_point) EC_POINT_clear_free(_point);
@@ -219,7 +326,10 @@
 
 - (BOOL) isEqual:(BTCCurvePoint*)otherPoint {
     if (![otherPoint isKindOfClass:[self class]]) return NO;
-    return 0 == EC_POINT_cmp(_group, _point, otherPoint.EC_POINT, _bnctx);
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    BOOL equal = ctx && 0 == EC_POINT_cmp(_group, _point, otherPoint.EC_POINT, ctx);
+    BTCBigNumberPoolEnd(ctx);
+    return equal;
 }
 
 - (NSUInteger) hash {
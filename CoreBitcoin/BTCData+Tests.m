@@ -5,6 +5,10 @@
 #import "BTCBase58.h"
 #import "NS+BTCBase58.h"
 #import "BTCData+Tests.h"
+#import "BTCSHA256.h"
+#import "BTCRIPEMD160.h"
+#import "BTCHex.h"
+#import "BTCHashID.h"
 
 @implementation NSData (BTC_Tests)
 
@@ -32,6 +36,11 @@
     NSAssert([BTCDataWithUTF8CString("hello").BTCHash160.hex
               isEqual:@"b6a9c8c230722b7c748331a8b450f05566dc7d0f"], @"Test vector");
 
+    [self testSHA256Implementations];
+    [self testBatchHashing];
+    [self testRIPEMD160];
+    [self testHex];
+
     NSAssert([BTCDataFromHex(@"deadBEEF") isEqualToData:[NSData dataWithBytes:"\xde\xad\xBE\xEF" length:4]], @"Init data with hex string");
 
     NSAssert([BTCDataFromHex(@"0xdeadBEEF") isEqualToData:[NSData dataWithBytes:"\xde\xad\xBE\xEF" length:4]], @"Init data with hex string");
@@ -133,4 +142,270 @@
 //    }
 }
 
++ (void) testSHA256Implementations {
+    BTCSHA256Implementation defaultImplementation = BTCSHA256GetImplementation();
+    NSAssert(BTCSHA256SetImplementation(BTCSHA256ImplementationCommonCrypto), @"CommonCrypto is always available");
+
+    NSData* message = BTCRandomDataWithLength(1000);
+    NSData* expected = BTCSHA256(message);
+
+    for (BTCSHA256Implementation impl = BTCSHA256ImplementationCommonCrypto; impl <= BTCSHA256ImplementationARMv8; impl++) {
+        if (!BTCSHA256SetImplementation(impl)) continue;
+
+        NSAssert([BTCDataWithUTF8CString("hello").SHA256.hex
+                  isEqual:@"2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824"], @"Test vector");
+        NSAssert([BTCDataWithUTF8CString("hello").BTCHash256.hex
+                  isEqual:@"9595c9df90075148eb06860365df33584b75bff782a510c6cd4883a419833d50"], @"Test vector");
+        NSAssert([BTCSHA256Concat(BTCDataWithUTF8CString("hel"), BTCDataWithUTF8CString("lo")).hex
+                  isEqual:@"2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824"], @"Test vector");
+
+        // RFC 4231 test cases 2 and 6.
+        NSAssert([BTCHMACSHA256(BTCDataWithUTF8CString("Jefe"), BTCDataWithUTF8CString("what do ya want for nothing?")).hex
+                  isEqual:@"5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"], @"HMAC test vector");
+        NSMutableData* longKey = [NSMutableData dataWithLength:131];
+        memset(longKey.mutableBytes, 0xaa, longKey.length);
+        NSAssert([BTCHMACSHA256(longKey, BTCDataWithUTF8CString("Test Using Larger Than Block-Size Key - Hash Key First")).hex
+                  isEqual:@"60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"], @"HMAC test vector with a long key");
+
+        NSAssert([BTCSHA256(message) isEqual:expected], @"All implementations must produce the same hash");
+
+        // Streaming in uneven chunks, continuing from a copy of the intermediate state.
+        BTCSHA256Context ctx;
+        BTCSHA256Init(&ctx);
+        NSUInteger offset = 0;
+        for (NSUInteger chunk = 1; offset < message.length; chunk = chunk * 3 + 1) {
+            NSUInteger length = MIN(chunk, message.length - offset);
+            BTCSHA256Update(&ctx, (const unsigned char*)message.bytes + offset, length);
+            offset += length;
+        }
+        BTCSHA256Context copy = ctx;
+        unsigned char digest[32];
+        BTCSHA256Final(digest, &ctx);
+        NSAssert([[NSData dataWithBytes:digest length:32] isEqual:expected], @"Streaming hash must match");
+        BTCSHA256Final(digest, &copy);
+        NSAssert([[NSData dataWithBytes:digest length:32] isEqual:expected], @"Copied context must produce the same hash");
+
+        BTCHash256Bytes(digest, message.bytes, message.length);
+        NSAssert([[NSData dataWithBytes:digest length:32] isEqual:BTCSHA256(expected)], @"Hash256 must match");
+
+        // Benchmark
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < 100000; i++) {
+            BTCHash256Bytes(digest, message.bytes, 80);
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        NSLog(@"SHA256 implementation %@: 100000 block header hashes in %.1f ms", @(impl), (t2 - t1) * 1000.0);
+    }
+
+    BTCSHA256SetImplementation(defaultImplementation);
+}
+
++ (void) testBatchHashing {
+    // Messages of all lengths around block boundaries, more than fits in the widest kernel.
+    NSMutableArray* items = [NSMutableArray array];
+    for (NSUInteger length = 0; length <= 200; length++) {
+        [items addObject:BTCRandomDataWithLength(length)];
+    }
+    [items addObject:BTCDataWithUTF8CString("hello")];
+
+    NSArray* sha256 = BTCSHA256Batch(items);
+    NSArray* hash256 = BTCHash256Batch(items);
+    NSAssert(sha256.count == items.count && hash256.count == items.count, @"One digest per item");
+    for (NSUInteger i = 0; i < items.count; i++) {
+        NSAssert([sha256[i] isEqual:BTCSHA256(items[i])], @"Batch SHA256 must match BTCSHA256");
+        NSAssert([hash256[i] isEqual:BTCHash256(items[i])], @"Batch Hash256 must match BTCHash256");
+    }
+    NSAssert([[hash256.lastObject hex] isEqual:@"9595c9df90075148eb06860365df33584b75bff782a510c6cd4883a419833d50"], @"Test vector");
+    NSAssert(BTCSHA256Batch(@[]).count == 0, @"Empty batch");
+
+    // Pairs of hashes, including a count that does not fill all the lanes.
+    for (NSUInteger count = 0; count <= 3 * BTCSHA256BatchLanes() + 1; count++) {
+        NSMutableData* pairs = BTCRandomDataWithLength(64 * count);
+        NSMutableData* output = [NSMutableData dataWithLength:32 * count];
+        BTCHash256Pairs(output.mutableBytes, pairs.bytes, count);
+        for (NSUInteger i = 0; i < count; i++) {
+            NSData* expected = BTCHash256([pairs subdataWithRange:NSMakeRange(64 * i, 64)]);
+            NSAssert([[output subdataWithRange:NSMakeRange(32 * i, 32)] isEqual:expected], @"Pair hash must match BTCHash256");
+        }
+
+        // In-place hashing produces the same result.
+        BTCHash256Pairs(pairs.mutableBytes, pairs.bytes, count);
+        NSAssert([[pairs subdataWithRange:NSMakeRange(0, 32 * count)] isEqual:output], @"In-place pair hashing");
+    }
+
+    // Benchmark
+    {
+        const NSUInteger count = 100000;
+        NSMutableData* pairs = BTCRandomDataWithLength(64 * count);
+        NSMutableData* output = [NSMutableData dataWithLength:32 * count];
+
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCHash256([NSData dataWithBytesNoCopy:(unsigned char*)pairs.mutableBytes + 64 * i length:64 freeWhenDone:NO]);
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        BTCHash256Pairs(output.mutableBytes, pairs.bytes, count);
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"BTCHash256 of %@ pairs: one by one %.1f ms, batch of %@ lanes %.1f ms", @(count), (t2 - t1) * 1000.0, @(BTCSHA256BatchLanes()), (t3 - t2) * 1000.0);
+    }
+}
+
++ (void) testRIPEMD160 {
+    NSAssert([[[NSData alloc] init].RIPEMD160.hex
+              isEqual:@"9c1185a5c5e9fc54612808977ee8f548b2258d31"], @"Test vector");
+    NSAssert([BTCDataWithUTF8CString("a").RIPEMD160.hex
+              isEqual:@"0bdc9d2d256b3ee9daae347be6f4dc835a467ffe"], @"Test vector");
+    NSAssert([BTCDataWithUTF8CString("abcdefghijklmnopqrstuvwxyz").RIPEMD160.hex
+              isEqual:@"f71c27109c692c1b56bbdceb5b9d2865b3708dbc"], @"Test vector");
+    NSAssert([BTCDataWithUTF8CString("12345678901234567890123456789012345678901234567890123456789012345678901234567890").RIPEMD160.hex
+              isEqual:@"9b752e45573d4b39f4dbd3323cab82bf63326bfb"], @"Test vector");
+
+    // Streaming in uneven chunks must match hashing at once.
+    NSData* message = BTCRandomDataWithLength(1000);
+    BTCRIPEMD160Context ctx;
+    BTCRIPEMD160Init(&ctx);
+    NSUInteger offset = 0;
+    for (NSUInteger chunk = 1; offset < message.length; chunk = chunk * 3 + 1) {
+        NSUInteger length = MIN(chunk, message.length - offset);
+        BTCRIPEMD160Update(&ctx, (const unsigned char*)message.bytes + offset, length);
+        offset += length;
+    }
+    unsigned char digest[20];
+    BTCRIPEMD160Final(digest, &ctx);
+    NSAssert([[NSData dataWithBytes:digest length:20] isEqual:BTCRIPEMD160(message)], @"Streaming hash must match");
+
+    BTCHash160Bytes(digest, message.bytes, message.length);
+    NSAssert([[NSData dataWithBytes:digest length:20] isEqual:BTCRIPEMD160(BTCSHA256(message))], @"Hash160 must match");
+
+    // Batch of messages of all lengths around block boundaries.
+    NSMutableArray* items = [NSMutableArray array];
+    for (NSUInteger length = 0; length <= 200; length++) {
+        [items addObject:BTCRandomDataWithLength(length)];
+    }
+    [items addObject:BTCDataWithUTF8CString("hello")];
+
+    NSArray* hash160 = BTCHash160Batch(items);
+    NSAssert(hash160.count == items.count, @"One digest per item");
+    for (NSUInteger i = 0; i < items.count; i++) {
+        NSAssert([hash160[i] isEqual:BTCHash160(items[i])], @"Batch Hash160 must match BTCHash160");
+    }
+    NSAssert([[hash160.lastObject hex] isEqual:@"b6a9c8c230722b7c748331a8b450f05566dc7d0f"], @"Test vector");
+    NSAssert(BTCHash160Batch(@[]).count == 0, @"Empty batch");
+
+    // Benchmark with 33-byte compressed public keys.
+    {
+        const NSUInteger count = 100000;
+        NSMutableData* pubkeys = BTCRandomDataWithLength(33 * count);
+        NSMutableData* output = [NSMutableData dataWithLength:20 * count];
+        const unsigned char** messages = malloc(count * sizeof(*messages));
+        size_t* lengths = malloc(count * sizeof(*lengths));
+        for (NSUInteger i = 0; i < count; i++) {
+            messages[i] = (const unsigned char*)pubkeys.bytes + 33 * i;
+            lengths[i] = 33;
+        }
+
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCRIPEMD160(BTCSHA256([NSData dataWithBytesNoCopy:(void*)messages[i] length:33 freeWhenDone:NO]));
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCHash160Bytes((unsigned char*)output.mutableBytes + 20 * i, messages[i], 33);
+        }
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+        BTCHash160Buffers(output.mutableBytes, messages, lengths, count);
+        CFAbsoluteTime t4 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"BTCHash160 of %@ pubkeys: two steps %.1f ms, fused %.1f ms, batch of %@ lanes %.1f ms",
+              @(count), (t2 - t1) * 1000.0, (t3 - t2) * 1000.0, @(BTCSHA256BatchLanes()), (t4 - t3) * 1000.0);
+
+        free(messages);
+        free(lengths);
+    }
+}
+
++ (void) testHex {
+    NSAssert([BTCHexFromData([NSData data]) isEqual:@""], @"Empty data");
+    NSAssert(BTCHexFromData(nil) == nil, @"Nil data");
+    NSAssert([BTCDataFromHex(@"") isEqual:[NSData data]], @"Empty string");
+    NSAssert([BTCHexFromData(BTCDataWithUTF8CString("hello")) isEqual:@"68656c6c6f"], @"Test vector");
+    NSAssert([BTCUppercaseHexFromData(BTCDataWithUTF8CString("hello")) isEqual:@"68656C6C6F"], @"Test vector");
+
+    NSData* expected = BTCDataWithUTF8CString("\x01\xab\xcd\xef");
+    NSAssert([BTCDataFromHex(@"01abcdef") isEqual:expected], @"Lowercase");
+    NSAssert([BTCDataFromHex(@"01ABCDEF") isEqual:expected], @"Uppercase");
+    NSAssert([BTCDataFromHex(@"01aBcDeF") isEqual:expected], @"Mixed case");
+    NSAssert([BTCDataFromHex(@"0x01abcdef") isEqual:expected], @"0x prefix");
+    NSAssert([BTCDataFromHex(@" 0X 01abcdef\n") isEqual:expected], @"Whitespace around");
+    NSAssert([BTCDataWithHexCString("01abcdef") isEqual:expected], @"C string");
+
+    NSAssert(BTCDataFromHex(nil) == nil, @"Nil string");
+    NSAssert(BTCDataWithHexCString(NULL) == nil, @"NULL string");
+    NSAssert(BTCDataFromHex(@"01abcde") == nil, @"Odd length");
+    NSAssert(BTCDataFromHex(@"01ab cdef") == nil, @"Whitespace inside");
+    NSAssert(BTCDataFromHex(@"01abcdeg") == nil, @"Invalid character");
+    NSAssert(BTCDataFromHex(@"01abcdef\u00e9\u00e9") == nil, @"Non-ASCII characters");
+    NSAssert(BTCDataFromHex(@"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdeX") == nil, @"Invalid character after a SIMD block");
+    NSAssert(BTCDataFromHex(@"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abc:ef") == nil, @"Character right after '9'");
+    NSAssert(BTCDataFromHex(@"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abc`ef") == nil, @"Character right before 'a'");
+
+    // Random data of all lengths around SIMD block sizes.
+    for (NSUInteger length = 0; length <= 100; length++) {
+        NSData* data = BTCRandomDataWithLength(length);
+        NSString* hex = BTCHexFromData(data);
+        NSString* uppercaseHex = BTCUppercaseHexFromData(data);
+        NSAssert(hex.length == 2 * length, @"Two characters per byte");
+        NSAssert([hex isEqual:[uppercaseHex lowercaseString]], @"Cases must match");
+        NSAssert([BTCDataFromHex(hex) isEqual:data], @"Round trip");
+        NSAssert([BTCDataFromHex(uppercaseHex) isEqual:data], @"Round trip from uppercase");
+
+        NSString* reversedHex = BTCHexStringWithBytes(data.bytes, data.length, NO, YES);
+        NSAssert([reversedHex isEqual:BTCHexFromData(BTCReversedData(data))], @"Reversed encoding");
+        NSAssert([BTCHexDataFromString(hex, YES) isEqual:BTCReversedData(data)], @"Reversed decoding");
+
+        for (NSUInteger i = 0; i < hex.length; i++) {
+            NSMutableString* broken = [hex mutableCopy];
+            [broken replaceCharactersInRange:NSMakeRange(i, 1) withString:@"z"];
+            NSAssert(BTCDataFromHex(broken) == nil, @"Invalid character at any position");
+        }
+    }
+
+    // Transaction IDs are hex of the reversed hash.
+    NSString* txid = @"4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b";
+    NSData* hash = BTCHashFromID(txid);
+    NSAssert(hash.length == 32, @"Hash length");
+    NSAssert([BTCHexFromData(hash) isEqual:@"3ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a"], @"Hash bytes are reversed");
+    NSAssert([BTCIDFromHash(hash) isEqual:txid], @"ID round trip");
+    NSAssert(BTCIDFromHash(nil) == nil, @"Nil hash");
+
+    // Benchmark with 32-byte hashes.
+    {
+        const NSUInteger count = 100000;
+        NSData* hash = BTCRandomDataWithLength(32);
+        NSString* hex = BTCHexFromData(hash);
+        const char* hexCString = hex.UTF8String;
+        char buffer[64];
+
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCHexEncode(buffer, hash.bytes, 32, NO);
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCHexDecode(buffer, hexCString, 32);
+        }
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < count; i++) {
+            @autoreleasepool {
+                BTCIDFromHash(BTCHashFromID(hex));
+            }
+        }
+        CFAbsoluteTime t4 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"Hex of %@ hashes: encode %.1f ms, decode %.1f ms, ID round trip %.1f ms",
+              @(count), (t2 - t1) * 1000.0, (t3 - t2) * 1000.0, (t4 - t3) * 1000.0);
+    }
+}
+
 @end
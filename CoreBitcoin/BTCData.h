@@ -61,6 +61,7 @@ NSMutableData* BTCDataRange(NSData* data, NSRange range);
 
 // Core hash functions that we need.
 // If the argument is nil, returns nil.
+// SHA-256 functions use SHA-NI or ARMv8 instructions when the CPU supports them (see BTCSHA256.h).
 NSMutableData* BTCSHA1(NSData* data);
 NSMutableData* BTCSHA256(NSData* data);
 NSMutableData* BTCSHA512(NSData* data);
@@ -72,11 +73,9 @@ NSMutableData* BTCHash256Concat(NSData* data1, NSData* data2);  // SHA256(SHA256
 NSMutableData* BTCHMACSHA256(NSData* key, NSData* data);
 NSMutableData* BTCHMACSHA512(NSData* key, NSData* data);
 
-#if BTCDataRequiresOpenSSL
-// RIPEMD160 today is provided only by OpenSSL. SHA1 and SHA2 are provided by CommonCrypto framework.
+// RIPEMD160 is implemented natively (see BTCRIPEMD160.h). SHA1 and SHA2 are provided by CommonCrypto framework.
 NSMutableData* BTCRIPEMD160(NSData* data);
 NSMutableData* BTCHash160(NSData* data); // == RIPEMD160(SHA256(data)) (aka Hash160 in BitcoinQT)
-#endif
 
 // 160-bit zero string
 NSMutableData* BTCZero160();
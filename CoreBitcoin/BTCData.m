@@ -1,9 +1,11 @@
 // Oleg Andreev <oleganza@gmail.com>
 
 #import "BTCData.h"
+#import "BTCSHA256.h"
+#import "BTCRIPEMD160.h"
+#import "BTCHex.h"
 #import <CommonCrypto/CommonCrypto.h>
 #if BTCDataRequiresOpenSSL
-#include <openssl/ripemd.h>
 #include <openssl/evp.h>
 #endif
 
@@ -123,96 +125,33 @@ NSData* BTCDataWithHexString(NSString* hexString) { // deprecated
 
 // Init with hex string (lower- or uppercase, with optional 0x prefix)
 NSData* BTCDataFromHex(NSString* hexString) {
-    return BTCDataWithHexCString([hexString cStringUsingEncoding:NSASCIIStringEncoding]);
+    return BTCHexDataFromString(hexString, NO);
 }
 
 // Init with zero-terminated hex string (lower- or uppercase, with optional 0x prefix)
 NSData* BTCDataWithHexCString(const char* hexCString) {
-    if (hexCString == NULL) return nil;
-    
-    const unsigned char *psz = (const unsigned char*)hexCString;
-    
-    while (isspace(*psz)) psz++;
-    
-    // Skip optional 0x prefix
-    if (psz[0] == '0' && tolower(psz[1]) == 'x') psz += 2;
-        
-        while (isspace(*psz)) psz++;
-    
-    size_t len = strlen((const char*)psz);
-    
-    // If the string is not full number of bytes (each byte 2 hex characters), return nil.
-    if (len % 2 != 0) return nil;
-    
-    unsigned char* buf = (unsigned char*)malloc(len/2);
-    
-    static const signed char digits[256] = {
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-         0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
-        -1,0xa,0xb,0xc,0xd,0xe,0xf, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1,0xa,0xb,0xc,0xd,0xe,0xf, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
-    };
-    
-    unsigned char* bufpointer = buf;
-    
-    while (1) {
-        unsigned char c1 = (unsigned char)*psz++;
-        signed char n1 = digits[c1];
-        if (n1 == (signed char)-1) break; // break when null-terminator is hit
-        
-        unsigned char c2 = (unsigned char)*psz++;
-        signed char n2 = digits[c2];
-        if (n2 == (signed char)-1) break; // break when null-terminator is hit
-        
-        *bufpointer = (unsigned char)((n1 << 4) | n2);
-        bufpointer++;
-    }
-    
-    return [[NSData alloc] initWithBytesNoCopy:buf length:len/2];
+    return BTCHexDataFromCString(hexCString, NO);
 }
 
 
-NSString* BTCHexFromDataWithFormat(NSData* data, const char* format) {
-    if (!data) return nil;
-    
-    NSUInteger length = data.length;
-    if (length == 0) return @"";
-    
-    NSMutableData* resultdata = [NSMutableData dataWithLength:length * 2];
-    char *dest = resultdata.mutableBytes;
-    unsigned const char *src = data.bytes;
-    for (int i = 0; i < length; ++i) {
-        sprintf(dest + i*2, format, (unsigned int)(src[i]));
-    }
-    return [[NSString alloc] initWithData:resultdata encoding:NSASCIIStringEncoding];
-}
-
 NSString* BTCHexStringFromData(NSData* data) { // deprecated
-    return BTCHexFromDataWithFormat(data, "%02x");
+    if (!data) return nil;
+    return BTCHexStringWithBytes(data.bytes, data.length, NO, NO);
 }
 
 NSString* BTCUppercaseHexStringFromData(NSData* data) { // deprecated
-    return BTCHexFromDataWithFormat(data, "%02X");
+    if (!data) return nil;
+    return BTCHexStringWithBytes(data.bytes, data.length, YES, NO);
 }
 
 NSString* BTCHexFromData(NSData* data) {
-    return BTCHexFromDataWithFormat(data, "%02x");
+    if (!data) return nil;
+    return BTCHexStringWithBytes(data.bytes, data.length, NO, NO);
 }
 
 NSString* BTCUppercaseHexFromData(NSData* data) {
-    return BTCHexFromDataWithFormat(data, "%02X");
+    if (!data) return nil;
+    return BTCHexStringWithBytes(data.bytes, data.length, YES, NO);
 }
 
 
@@ -285,12 +224,10 @@ NSMutableData* BTCSHA256(NSData* data) {
     if (!data) return nil;
     unsigned char digest[CC_SHA256_DIGEST_LENGTH];
 
-    __block CC_SHA256_CTX ctx;
-    CC_SHA256_Init(&ctx);
-    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    CC_SHA256_Final(digest, &ctx);
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256UpdateWithData(&ctx, data);
+    BTCSHA256Final(digest, &ctx);
 
     NSMutableData* result = [NSMutableData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
     BTCSecureMemset(digest, 0, CC_SHA256_DIGEST_LENGTH);
@@ -317,15 +254,11 @@ NSMutableData* BTCSHA256Concat(NSData* data1, NSData* data2) {
     if (!data1 || !data2) return nil;
     unsigned char digest[CC_SHA256_DIGEST_LENGTH];
     
-    __block CC_SHA256_CTX ctx;
-    CC_SHA256_Init(&ctx);
-    [data1 enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    [data2 enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    CC_SHA256_Final(digest, &ctx);
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256UpdateWithData(&ctx, data1);
+    BTCSHA256UpdateWithData(&ctx, data2);
+    BTCSHA256Final(digest, &ctx);
     
     NSMutableData* result = [NSMutableData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
     BTCSecureMemset(digest, 0, CC_SHA256_DIGEST_LENGTH);
@@ -336,13 +269,11 @@ NSMutableData* BTCHash256(NSData* data) {
     if (!data) return nil;
     unsigned char digest1[CC_SHA256_DIGEST_LENGTH];
     unsigned char digest2[CC_SHA256_DIGEST_LENGTH];
-    __block CC_SHA256_CTX ctx;
-    CC_SHA256_Init(&ctx);
-    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    CC_SHA256_Final(digest1, &ctx);
-    CC_SHA256(digest1, CC_SHA256_DIGEST_LENGTH, digest2);
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256UpdateWithData(&ctx, data);
+    BTCSHA256Final(digest1, &ctx);
+    BTCSHA256Bytes(digest2, digest1, CC_SHA256_DIGEST_LENGTH);
     NSMutableData* result = [NSMutableData dataWithBytes:digest2 length:CC_SHA256_DIGEST_LENGTH];
     BTCSecureMemset(digest1, 0, CC_SHA256_DIGEST_LENGTH);
     BTCSecureMemset(digest2, 0, CC_SHA256_DIGEST_LENGTH);
@@ -355,16 +286,12 @@ NSMutableData* BTCHash256Concat(NSData* data1, NSData* data2) {
     unsigned char digest1[CC_SHA256_DIGEST_LENGTH];
     unsigned char digest2[CC_SHA256_DIGEST_LENGTH];
     
-    __block CC_SHA256_CTX ctx;
-    CC_SHA256_Init(&ctx);
-    [data1 enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    [data2 enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    CC_SHA256_Final(digest1, &ctx);
-    CC_SHA256(digest1, CC_SHA256_DIGEST_LENGTH, digest2);
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256UpdateWithData(&ctx, data1);
+    BTCSHA256UpdateWithData(&ctx, data2);
+    BTCSHA256Final(digest1, &ctx);
+    BTCSHA256Bytes(digest2, digest1, CC_SHA256_DIGEST_LENGTH);
     
     NSMutableData* result = [NSMutableData dataWithBytes:digest2 length:CC_SHA256_DIGEST_LENGTH];
     BTCSecureMemset(digest1, 0, CC_SHA256_DIGEST_LENGTH);
@@ -388,9 +315,36 @@ NSMutableData* BTCHMACSHA256(NSData* key, NSData* data) {
     if (!key) return nil;
     if (!data) return nil;
     unsigned char digest[CC_SHA256_DIGEST_LENGTH];
-    CCHmac(kCCHmacAlgSHA256, key.bytes, key.length, data.bytes, data.length, digest);
+    unsigned char keyBlock[64] = {0};
+    unsigned char pad[64];
+
+    // RFC 2104: keys longer than the block size are hashed first.
+    if (key.length > sizeof(keyBlock)) {
+        BTCSHA256Context ctx;
+        BTCSHA256Init(&ctx);
+        BTCSHA256UpdateWithData(&ctx, key);
+        BTCSHA256Final(keyBlock, &ctx);
+    } else {
+        [key getBytes:keyBlock length:key.length];
+    }
+
+    BTCSHA256Context ctx;
+    for (size_t i = 0; i < sizeof(pad); i++) pad[i] = keyBlock[i] ^ 0x36;
+    BTCSHA256Init(&ctx);
+    BTCSHA256Update(&ctx, pad, sizeof(pad));
+    BTCSHA256UpdateWithData(&ctx, data);
+    BTCSHA256Final(digest, &ctx);
+
+    for (size_t i = 0; i < sizeof(pad); i++) pad[i] = keyBlock[i] ^ 0x5c;
+    BTCSHA256Init(&ctx);
+    BTCSHA256Update(&ctx, pad, sizeof(pad));
+    BTCSHA256Update(&ctx, digest, sizeof(digest));
+    BTCSHA256Final(digest, &ctx);
+
     NSMutableData* result = [NSMutableData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH];
     BTCSecureMemset(digest, 0, CC_SHA256_DIGEST_LENGTH);
+    BTCSecureMemset(keyBlock, 0, sizeof(keyBlock));
+    BTCSecureMemset(pad, 0, sizeof(pad));
     return result;
 }
 
@@ -404,43 +358,31 @@ NSMutableData* BTCHMACSHA512(NSData* key, NSData* data) {
     return result;
 }
 
-#if BTCDataRequiresOpenSSL
-
 NSMutableData* BTCRIPEMD160(NSData* data) {
     if (!data) return nil;
-    unsigned char digest[RIPEMD160_DIGEST_LENGTH];
-    __block RIPEMD160_CTX ctx;
-    RIPEMD160_Init(&ctx);
+    unsigned char digest[20];
+    BTCRIPEMD160Context ctx;
+    BTCRIPEMD160Init(&ctx);
     [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        RIPEMD160_Update(&ctx, bytes, (size_t)byteRange.length);
+        BTCRIPEMD160Update(&ctx, bytes, byteRange.length);
     }];
-    RIPEMD160_Final(digest, &ctx);
+    BTCRIPEMD160Final(digest, &ctx);
 
-    NSMutableData* result = [NSMutableData dataWithBytes:digest length:RIPEMD160_DIGEST_LENGTH];
-    BTCSecureMemset(digest, 0, RIPEMD160_DIGEST_LENGTH);
+    NSMutableData* result = [NSMutableData dataWithBytes:digest length:20];
+    BTCSecureMemset(digest, 0, 20);
     return result;
 }
 
 NSMutableData* BTCHash160(NSData* data) {
     if (!data) return nil;
-    unsigned char digest1[CC_SHA256_DIGEST_LENGTH];
-    unsigned char digest2[RIPEMD160_DIGEST_LENGTH];
-    __block CC_SHA256_CTX ctx;
-    CC_SHA256_Init(&ctx);
-    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
-        CC_SHA256_Update(&ctx, bytes, (CC_LONG)byteRange.length);
-    }];
-    CC_SHA256_Final(digest1, &ctx);
-    RIPEMD160(digest1, CC_SHA256_DIGEST_LENGTH, digest2);
-    
-    NSMutableData* result = [NSMutableData dataWithBytes:digest2 length:RIPEMD160_DIGEST_LENGTH];
-    BTCSecureMemset(digest1, 0, CC_SHA256_DIGEST_LENGTH);
-    BTCSecureMemset(digest2, 0, RIPEMD160_DIGEST_LENGTH);
+    unsigned char digest[20];
+    BTCHash160Bytes(digest, data.bytes, data.length);
+
+    NSMutableData* result = [NSMutableData dataWithBytes:digest length:20];
+    BTCSecureMemset(digest, 0, 20);
     return result;
 }
 
-#endif
-
 
 
 
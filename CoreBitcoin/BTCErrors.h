@@ -20,6 +20,9 @@ typedef NS_ENUM(NSUInteger, BTCErrorCode) {
     BTCErrorPaymentRequestInvalidResponse    = 7001,
     BTCErrorPaymentRequestTooBig             = 7002,
 
+    // Block file errors
+    BTCErrorMalformedBlockFile               = 8001,
+
     // Secret Sharing errors
     BTCErrorIncompatibleSecret               = 10001,
     BTCErrorInsufficientShares               = 10002,
@@ -1,12 +1,13 @@
 // CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
 
 #import "BTCHashID.h"
-#import "BTCData.h"
+#import "BTCHex.h"
 
 NSData* BTCHashFromID(NSString* identifier) {
-    return BTCReversedData(BTCDataFromHex(identifier));
+    return BTCHexDataFromString(identifier, YES);
 }
 
 NSString* BTCIDFromHash(NSData* hash) {
-    return BTCHexFromData(BTCReversedData(hash));
+    if (!hash) return nil;
+    return BTCHexStringWithBytes(hash.bytes, hash.length, NO, YES);
 }
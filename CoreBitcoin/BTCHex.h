@@ -0,0 +1,29 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+
+// Change to 0 to exclude SSSE3, AVX2 and NEON kernels from the build and always convert one byte at a time.
+#define BTCHexSIMDEnabled 1
+
+// Hex encoding and decoding into caller-provided buffers.
+// The best kernel for the CPU is selected at runtime. Functions in BTCData.h and BTCHashID.h use these.
+// "Reversed" variants convert bytes in reverse order, like in transaction and block IDs,
+// without making a reversed copy of the data.
+
+// Writes 2*length lowercase or uppercase hex characters of the bytes to the output. Does not write a zero terminator.
+void BTCHexEncode(char* output, const void* bytes, size_t length, BOOL uppercase);
+void BTCHexEncodeReversed(char* output, const void* bytes, size_t length, BOOL uppercase);
+
+// Decodes 2*length lowercase or uppercase hex characters into length bytes.
+// Returns NO if any character is not a hex digit. Contents of the output are undefined in this case.
+BOOL BTCHexDecode(void* output, const char* hex, size_t length);
+BOOL BTCHexDecodeReversed(void* output, const char* hex, size_t length);
+
+// Returns a hex string of the bytes. Characters are written directly into the storage of the string.
+NSString* BTCHexStringWithBytes(const void* bytes, size_t length, BOOL uppercase, BOOL reversed);
+
+// Decodes a hex string with optional 0x prefix and whitespace around it.
+// Characters are read directly from the storage of the string when possible, without an intermediate C string.
+// Returns nil if the string contains anything else or an odd number of hex digits.
+NSMutableData* BTCHexDataFromString(NSString* string, BOOL reversed);
+NSMutableData* BTCHexDataFromCString(const char* cstring, BOOL reversed);
@@ -0,0 +1,421 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCHex.h"
+#include <pthread.h>
+#include <string.h>
+
+#if BTCHexSIMDEnabled && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BTCHexX86Available 1
+#include <immintrin.h>
+#else
+#define BTCHexX86Available 0
+#endif
+
+#if BTCHexSIMDEnabled && defined(__aarch64__) && defined(__ARM_NEON)
+#define BTCHexNEONAvailable 1
+#include <arm_neon.h>
+#else
+#define BTCHexNEONAvailable 0
+#endif
+
+static const char* BTCHexLowercaseAlphabet = "0123456789abcdef";
+static const char* BTCHexUppercaseAlphabet = "0123456789ABCDEF";
+
+// Value of each hex digit, -1 for other characters.
+static const signed char BTCHexDigits[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1,0xa,0xb,0xc,0xd,0xe,0xf, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,0xa,0xb,0xc,0xd,0xe,0xf, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+
+
+#pragma mark - Scalar
+
+
+// Kernels convert bytes [offset, length) and leave the beginning to the caller.
+// For reversed conversion byte k of the data is the (length - 1 - k)-th byte in the hex string.
+
+static void BTCHexEncodeScalar(char* output, const unsigned char* bytes, size_t offset, size_t length, const char* alphabet, BOOL reversed) {
+    for (size_t k = offset; k < length; k++) {
+        unsigned char byte = reversed ? bytes[length - 1 - k] : bytes[k];
+        output[2*k]     = alphabet[byte >> 4];
+        output[2*k + 1] = alphabet[byte & 0x0f];
+    }
+}
+
+static BOOL BTCHexDecodeScalar(unsigned char* output, const char* hex, size_t offset, size_t length, BOOL reversed) {
+    signed char invalid = 0;
+    for (size_t k = offset; k < length; k++) {
+        signed char n1 = BTCHexDigits[(unsigned char)hex[2*k]];
+        signed char n2 = BTCHexDigits[(unsigned char)hex[2*k + 1]];
+        invalid |= n1 | n2;
+        output[reversed ? length - 1 - k : k] = (unsigned char)(((unsigned char)n1 << 4) | (n2 & 0x0f));
+    }
+    return invalid >= 0;
+}
+
+
+
+
+#pragma mark - SSSE3 and AVX2
+
+
+#if BTCHexX86Available
+
+// 128-bit steps are always inlined, so the AVX2 kernels use them for the tail without
+// switching between VEX and legacy SSE encodings, which is slow on many CPUs.
+
+// Reverses 16 bytes.
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i BTCHexReverseSSSE3(__m128i v) {
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// Writes 32 hex characters of 16 bytes using a table of 16 hex digits.
+__attribute__((target("ssse3"), always_inline))
+static inline void BTCHexEncode16SSSE3(char* output, __m128i v, __m128i table) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(table, _mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*)output, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(output + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+// Returns values of 16 hex digits and sets bits of invalid characters in the mask.
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i BTCHexDecodeDigitsSSSE3(__m128i chars, __m128i* invalid) {
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)), _mm_cmpgt_epi8(_mm_set1_epi8(10), digit));
+    __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)), _mm_cmpgt_epi8(_mm_set1_epi8(6), letter));
+    *invalid = _mm_or_si128(*invalid, _mm_andnot_si128(_mm_or_si128(isDigit, isLetter), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// Returns 16 bytes of 32 hex characters.
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i BTCHexDecode16SSSE3(const char* hex, __m128i* invalid) {
+    const __m128i weights = _mm_set1_epi16(0x0110); // 16 for the first digit of a pair, 1 for the second one.
+    __m128i a = BTCHexDecodeDigitsSSSE3(_mm_loadu_si128((const __m128i*)hex), invalid);
+    __m128i b = BTCHexDecodeDigitsSSSE3(_mm_loadu_si128((const __m128i*)(hex + 16)), invalid);
+    return _mm_packus_epi16(_mm_maddubs_epi16(a, weights), _mm_maddubs_epi16(b, weights));
+}
+
+__attribute__((target("ssse3")))
+static size_t BTCHexEncodeSSSE3(char* output, const unsigned char* bytes, size_t length, const char* alphabet, BOOL reversed) {
+    const __m128i table = _mm_loadu_si128((const __m128i*)alphabet);
+    size_t k = 0;
+    for (; k + 16 <= length; k += 16) {
+        __m128i v;
+        if (reversed) {
+            v = BTCHexReverseSSSE3(_mm_loadu_si128((const __m128i*)(bytes + length - k - 16)));
+        } else {
+            v = _mm_loadu_si128((const __m128i*)(bytes + k));
+        }
+        BTCHexEncode16SSSE3(output + 2*k, v, table);
+    }
+    return k;
+}
+
+__attribute__((target("ssse3")))
+static size_t BTCHexDecodeSSSE3(unsigned char* output, const char* hex, size_t length, BOOL reversed, BOOL* valid) {
+    __m128i invalid = _mm_setzero_si128();
+    size_t k = 0;
+    for (; k + 16 <= length; k += 16) {
+        __m128i v = BTCHexDecode16SSSE3(hex + 2*k, &invalid);
+        if (reversed) {
+            _mm_storeu_si128((__m128i*)(output + length - k - 16), BTCHexReverseSSSE3(v));
+        } else {
+            _mm_storeu_si128((__m128i*)(output + k), v);
+        }
+    }
+    *valid = _mm_movemask_epi8(invalid) == 0;
+    return k;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i BTCHexDecodeDigitsAVX2(__m256i chars, __m256i* invalid) {
+    __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(digit, _mm256_set1_epi8(-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(10), digit));
+    __m256i isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(letter, _mm256_set1_epi8(-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(6), letter));
+    *invalid = _mm256_or_si256(*invalid, _mm256_andnot_si256(_mm256_or_si256(isDigit, isLetter), _mm256_set1_epi8(-1)));
+    return _mm256_or_si256(_mm256_and_si256(isDigit, digit), _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+// Reverses all 32 bytes: within each 128-bit lane, then the lanes.
+__attribute__((target("avx2")))
+static inline __m256i BTCHexReverseAVX2(__m256i v) {
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+__attribute__((target("avx2")))
+static size_t BTCHexEncodeAVX2(char* output, const unsigned char* bytes, size_t length, const char* alphabet, BOOL reversed) {
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)alphabet));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t k = 0;
+    for (; k + 32 <= length; k += 32) {
+        __m256i v;
+        if (reversed) {
+            v = BTCHexReverseAVX2(_mm256_loadu_si256((const __m256i*)(bytes + length - k - 32)));
+        } else {
+            v = _mm256_loadu_si256((const __m256i*)(bytes + k));
+        }
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+        // Unpacking works within lanes: first half holds bytes 0-7 and 16-23, second half holds bytes 8-15 and 24-31.
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(output + 2*k), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)(output + 2*k + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    if (k + 16 <= length) {
+        __m128i v;
+        if (reversed) {
+            v = BTCHexReverseSSSE3(_mm_loadu_si128((const __m128i*)(bytes + length - k - 16)));
+        } else {
+            v = _mm_loadu_si128((const __m128i*)(bytes + k));
+        }
+        BTCHexEncode16SSSE3(output + 2*k, v, _mm256_castsi256_si128(table));
+        k += 16;
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static size_t BTCHexDecodeAVX2(unsigned char* output, const char* hex, size_t length, BOOL reversed, BOOL* valid) {
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    __m256i invalid = _mm256_setzero_si256();
+    size_t k = 0;
+    for (; k + 32 <= length; k += 32) {
+        __m256i a = BTCHexDecodeDigitsAVX2(_mm256_loadu_si256((const __m256i*)(hex + 2*k)), &invalid);
+        __m256i b = BTCHexDecodeDigitsAVX2(_mm256_loadu_si256((const __m256i*)(hex + 2*k + 32)), &invalid);
+        // Packing works within lanes, so the 64-bit quarters come out as a0 b0 a1 b1.
+        __m256i v = _mm256_packus_epi16(_mm256_maddubs_epi16(a, weights), _mm256_maddubs_epi16(b, weights));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        if (reversed) {
+            _mm256_storeu_si256((__m256i*)(output + length - k - 32), BTCHexReverseAVX2(v));
+        } else {
+            _mm256_storeu_si256((__m256i*)(output + k), v);
+        }
+    }
+    __m128i invalidTail = _mm_setzero_si128();
+    if (k + 16 <= length) {
+        __m128i v = BTCHexDecode16SSSE3(hex + 2*k, &invalidTail);
+        if (reversed) {
+            _mm_storeu_si128((__m128i*)(output + length - k - 16), BTCHexReverseSSSE3(v));
+        } else {
+            _mm_storeu_si128((__m128i*)(output + k), v);
+        }
+        k += 16;
+    }
+    *valid = _mm256_testz_si256(invalid, invalid) && _mm_testz_si128(invalidTail, invalidTail);
+    return k;
+}
+
+#endif
+
+
+
+
+#pragma mark - NEON
+
+
+#if BTCHexNEONAvailable
+
+static size_t BTCHexEncodeNEON(char* output, const unsigned char* bytes, size_t length, const char* alphabet, BOOL reversed) {
+    const uint8x16_t table = vld1q_u8((const uint8_t*)alphabet);
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+    size_t k = 0;
+    for (; k + 16 <= length; k += 16) {
+        uint8x16_t v;
+        if (reversed) {
+            v = vrev64q_u8(vld1q_u8(bytes + length - k - 16));
+            v = vextq_u8(v, v, 8);
+        } else {
+            v = vld1q_u8(bytes + k);
+        }
+        uint8x16x2_t chars;
+        chars.val[0] = vqtbl1q_u8(table, vshrq_n_u8(v, 4));
+        chars.val[1] = vqtbl1q_u8(table, vandq_u8(v, mask));
+        vst2q_u8((uint8_t*)output + 2*k, chars); // interleaves high and low digits
+    }
+    return k;
+}
+
+// Returns values of 16 hex digits and sets invalid characters in the mask.
+static inline uint8x16_t BTCHexDecodeDigitsNEON(uint8x16_t chars, uint8x16_t* invalid) {
+    uint8x16_t digit = vsubq_u8(chars, vdupq_n_u8('0'));
+    uint8x16_t letter = vsubq_u8(vorrq_u8(chars, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t isDigit = vcltq_u8(digit, vdupq_n_u8(10));
+    uint8x16_t isLetter = vcltq_u8(letter, vdupq_n_u8(6));
+    *invalid = vorrq_u8(*invalid, vmvnq_u8(vorrq_u8(isDigit, isLetter)));
+    return vbslq_u8(isDigit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+}
+
+static size_t BTCHexDecodeNEON(unsigned char* output, const char* hex, size_t length, BOOL reversed, BOOL* valid) {
+    uint8x16_t invalid = vdupq_n_u8(0);
+    size_t k = 0;
+    for (; k + 16 <= length; k += 16) {
+        uint8x16x2_t chars = vld2q_u8((const uint8_t*)hex + 2*k); // separates high and low digits
+        uint8x16_t hi = BTCHexDecodeDigitsNEON(chars.val[0], &invalid);
+        uint8x16_t lo = BTCHexDecodeDigitsNEON(chars.val[1], &invalid);
+        uint8x16_t v = vorrq_u8(vshlq_n_u8(hi, 4), lo);
+        if (reversed) {
+            v = vrev64q_u8(v);
+            vst1q_u8(output + length - k - 16, vextq_u8(v, v, 8));
+        } else {
+            vst1q_u8(output + k, v);
+        }
+    }
+    *valid = vmaxvq_u8(invalid) == 0;
+    return k;
+}
+
+#endif
+
+
+
+
+#pragma mark - Dispatch
+
+
+// SIMD kernels convert the longest prefix they can and return its length.
+// For reversed conversion the prefix is the end of the data.
+typedef struct {
+    size_t (*encode)(char* output, const unsigned char* bytes, size_t length, const char* alphabet, BOOL reversed);
+    size_t (*decode)(unsigned char* output, const char* hex, size_t length, BOOL reversed, BOOL* valid);
+} BTCHexEngine;
+
+static BTCHexEngine BTCHexSelectedEngine = { NULL, NULL };
+
+static void BTCHexSelectEngine(void) {
+#if BTCHexX86Available
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        BTCHexSelectedEngine = (BTCHexEngine){ BTCHexEncodeAVX2, BTCHexDecodeAVX2 };
+    } else if (__builtin_cpu_supports("ssse3")) {
+        BTCHexSelectedEngine = (BTCHexEngine){ BTCHexEncodeSSSE3, BTCHexDecodeSSSE3 };
+    }
+#endif
+#if BTCHexNEONAvailable
+    BTCHexSelectedEngine = (BTCHexEngine){ BTCHexEncodeNEON, BTCHexDecodeNEON };
+#endif
+}
+
+static const BTCHexEngine* BTCHexCurrentEngine(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, BTCHexSelectEngine);
+    return &BTCHexSelectedEngine;
+}
+
+static void BTCHexEncodeBytes(char* output, const unsigned char* bytes, size_t length, BOOL uppercase, BOOL reversed) {
+    const char* alphabet = uppercase ? BTCHexUppercaseAlphabet : BTCHexLowercaseAlphabet;
+    const BTCHexEngine* engine = BTCHexCurrentEngine();
+    size_t offset = engine->encode ? engine->encode(output, bytes, length, alphabet, reversed) : 0;
+    BTCHexEncodeScalar(output, bytes, offset, length, alphabet, reversed);
+}
+
+static BOOL BTCHexDecodeBytes(unsigned char* output, const char* hex, size_t length, BOOL reversed) {
+    const BTCHexEngine* engine = BTCHexCurrentEngine();
+    BOOL valid = YES;
+    size_t offset = engine->decode ? engine->decode(output, hex, length, reversed, &valid) : 0;
+    return BTCHexDecodeScalar(output, hex, offset, length, reversed) && valid;
+}
+
+
+
+
+#pragma mark - Public API
+
+
+void BTCHexEncode(char* output, const void* bytes, size_t length, BOOL uppercase) {
+    BTCHexEncodeBytes(output, bytes, length, uppercase, NO);
+}
+
+void BTCHexEncodeReversed(char* output, const void* bytes, size_t length, BOOL uppercase) {
+    BTCHexEncodeBytes(output, bytes, length, uppercase, YES);
+}
+
+BOOL BTCHexDecode(void* output, const char* hex, size_t length) {
+    return BTCHexDecodeBytes(output, hex, length, NO);
+}
+
+BOOL BTCHexDecodeReversed(void* output, const char* hex, size_t length) {
+    return BTCHexDecodeBytes(output, hex, length, YES);
+}
+
+NSString* BTCHexStringWithBytes(const void* bytes, size_t length, BOOL uppercase, BOOL reversed) {
+    if (length == 0) return @"";
+    char* characters = malloc(2 * length);
+    if (!characters) return nil;
+    BTCHexEncodeBytes(characters, bytes, length, uppercase, reversed);
+    return [[NSString alloc] initWithBytesNoCopy:characters length:2 * length encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+NSMutableData* BTCHexDataFromCString(const char* cstring, BOOL reversed) {
+    if (cstring == NULL) return nil;
+
+    const unsigned char *psz = (const unsigned char*)cstring;
+
+    while (isspace(*psz)) psz++;
+
+    // Skip optional 0x prefix
+    if (psz[0] == '0' && tolower(psz[1]) == 'x') psz += 2;
+
+    while (isspace(*psz)) psz++;
+
+    size_t len = strlen((const char*)psz);
+    while (len > 0 && isspace(psz[len - 1])) len--;
+
+    // If the string is not full number of bytes (each byte 2 hex characters), return nil.
+    if (len % 2 != 0) return nil;
+
+    NSMutableData* data = [NSMutableData dataWithLength:len / 2];
+    if (!BTCHexDecodeBytes(data.mutableBytes, (const char*)psz, len / 2, reversed)) return nil;
+    return data;
+}
+
+NSMutableData* BTCHexDataFromString(NSString* string, BOOL reversed) {
+    if (!string) return nil;
+
+    const char* cstring = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingASCII);
+    if (cstring) return BTCHexDataFromCString(cstring, reversed);
+
+    // Strings that do not store ASCII characters contiguously are copied into a temporary buffer,
+    // on the stack for transaction and block IDs.
+    NSUInteger length = string.length;
+    char stackBuffer[256];
+    char* buffer = length < sizeof(stackBuffer) ? stackBuffer : malloc(length + 1);
+    if (!buffer) return nil;
+
+    NSUInteger usedLength = 0;
+    BOOL ascii = [string getBytes:buffer
+                        maxLength:length
+                       usedLength:&usedLength
+                         encoding:NSASCIIStringEncoding
+                          options:0
+                            range:NSMakeRange(0, length)
+                   remainingRange:NULL] && usedLength == length;
+    buffer[usedLength] = '\0';
+
+    NSMutableData* data = ascii ? BTCHexDataFromCString(buffer, reversed) : nil;
+    if (buffer != stackBuffer) free(buffer);
+    return data;
+}
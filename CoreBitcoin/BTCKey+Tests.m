@@ -4,17 +4,24 @@
 #import "BTCKey.h"
 #import "BTCAddress.h"
 #import "NSData+BTCData.h"
+#import "BTCSecp256k1.h"
 
 @implementation BTCKey (Tests)
 
 + (void) runAllTests {
-    [self testRFC6979];
-    [self testDiffieHellman];
-    [self testCanonicality];
-    [self testRandomKeys];
-    [self testBasicSigning];
-    [self testECDSA];
-    [self testBitcoinSignedMessage];
+    BTCSecp256k1Backend defaultBackend = BTCSecp256k1GetBackend();
+    for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+        if (!BTCSecp256k1SetBackend(backend.integerValue)) continue;
+        [self testRFC6979];
+        [self testDiffieHellman];
+        [self testCanonicality];
+        [self testRandomKeys];
+        [self testBasicSigning];
+        [self testECDSA];
+        [self testBitcoinSignedMessage];
+    }
+    BTCSecp256k1SetBackend(defaultBackend);
+    [self testBackendCompatibility];
 }
 
 + (void) testRFC6979 {
@@ -225,4 +232,74 @@
 
 
 
++ (void) testBackendCompatibility {
+    BTCSecp256k1Backend defaultBackend = BTCSecp256k1GetBackend();
+    if (!BTCSecp256k1SetBackend(BTCSecp256k1BackendNative)) return;
+
+    BTCKey*(^keyWithBackend)(BTCSecp256k1Backend, NSData*) = ^(BTCSecp256k1Backend backend, NSData* secret) {
+        BTCSecp256k1SetBackend(backend);
+        return [[BTCKey alloc] initWithPrivateKey:secret];
+    };
+
+    for (int n = 0; n < 100; n++) {
+        NSData* secret = [[NSString stringWithFormat:@"Key %d", n] dataUsingEncoding:NSUTF8StringEncoding].SHA256;
+        NSData* hash = [[NSString stringWithFormat:@"Message %d", n] dataUsingEncoding:NSUTF8StringEncoding].SHA256;
+
+        BTCKey* opensslKey = keyWithBackend(BTCSecp256k1BackendOpenSSL, secret);
+        NSData* opensslSignature = [opensslKey signatureForHash:hash];
+        NSData* opensslCompactSignature = [opensslKey compactSignatureForHash:hash];
+
+        BTCKey* nativeKey = keyWithBackend(BTCSecp256k1BackendNative, secret);
+        NSData* nativeSignature = [nativeKey signatureForHash:hash];
+        NSData* nativeCompactSignature = [nativeKey compactSignatureForHash:hash];
+
+        NSAssert([nativeKey.compressedPublicKey isEqual:opensslKey.compressedPublicKey], @"Public keys must match");
+        NSAssert([nativeKey.uncompressedPublicKey isEqual:opensslKey.uncompressedPublicKey], @"Public keys must match");
+        NSAssert([nativeSignature isEqual:opensslSignature], @"Deterministic signatures must match");
+
+        for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+            BTCSecp256k1SetBackend(backend.integerValue);
+
+            BTCKey* publicKey = [[BTCKey alloc] initWithPublicKey:(n % 2) ? opensslKey.compressedPublicKey : opensslKey.uncompressedPublicKey];
+            NSAssert([publicKey isValidSignature:nativeSignature hash:hash], @"Signature must be valid");
+            NSAssert(![publicKey isValidSignature:nativeSignature hash:secret], @"Signature must not be valid for another hash");
+
+            NSAssert([[BTCKey verifyCompactSignature:opensslCompactSignature forHash:hash] isEqual:opensslKey], @"Must recover the public key");
+            NSAssert([[BTCKey verifyCompactSignature:nativeCompactSignature forHash:hash] isEqual:opensslKey], @"Must recover the public key");
+        }
+    }
+
+    // Invalid public keys are rejected by both backends.
+    for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+        BTCSecp256k1SetBackend(backend.integerValue);
+        NSData* notOnCurve = BTCDataFromHex(@"02ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+        NSAssert([[BTCKey alloc] initWithPublicKey:notOnCurve].publicKey == nil, @"Must reject invalid public key");
+    }
+
+    // Performance of both backends.
+    NSData* secret = BTCDataFromHex(@"c4bbcb1fbec99d65bf59d85c8cb62ee2db963f0fe106f483d9afa73bd4e39a8a");
+    NSData* hash = [@"Test message" dataUsingEncoding:NSUTF8StringEncoding].SHA256;
+    for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+        BTCKey* key = keyWithBackend(backend.integerValue, secret);
+        NSData* signature = [key signatureForHash:hash];
+        NSData* compactSignature = [key compactSignatureForHash:hash];
+        NSData* publicKey = key.compressedPublicKey;
+
+        CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < 200; i++) [key signatureForHash:hash];
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < 200; i++) [[[BTCKey alloc] initWithPublicKey:publicKey] isValidSignature:signature hash:hash];
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < 200; i++) [BTCKey verifyCompactSignature:compactSignature forHash:hash];
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"BTCKey (%@): 200 signatures in %.4f sec, 200 verifications in %.4f sec, 200 recoveries in %.4f sec.",
+              backend.integerValue == BTCSecp256k1BackendNative ? @"native" : @"OpenSSL", t1 - t0, t2 - t1, t3 - t2);
+    }
+
+    BTCSecp256k1SetBackend(defaultBackend);
+}
+
+
+
 @end
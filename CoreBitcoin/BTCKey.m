@@ -7,6 +7,8 @@
 #import "BTCBigNumber.h"
 #import "BTCProtocolSerialization.h"
 #import "BTCErrors.h"
+#import "BTCSecp256k1.h"
+#import "BTCBigNumberPool.h"
 #include <CommonCrypto/CommonCrypto.h>
 #include <openssl/ec.h>
 #include <openssl/ecdsa.h>
@@ -26,6 +28,12 @@ static int     BTCRegenerateKey(EC_KEY *eckey, BIGNUM *priv_key);
 static NSData* BTCSignatureHashForBinaryMessage(NSData* data);
 static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const unsigned char *msg, int msglen, int recid, int check);
 
+#if BTCSecp256k1NativeAvailable
+static inline BOOL BTCKeyUsesNativeBackend(void) {
+    return BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative;
+}
+#endif
+
 @interface BTCKey ()
 @end
 
@@ -34,6 +42,11 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     EC_KEY* _key;
     NSMutableData* _publicKey;
     BOOL _publicKeyCompressed;
+#if BTCSecp256k1NativeAvailable
+    // Public key decoded for the native backend (see -loadNativePublicKey).
+    BTCSecp256k1Point _nativePublicKey;
+    BOOL _nativePublicKeyValid;
+#endif
 }
 
 - (id) initWithNewKeyPair:(BOOL)createKeyPair {
@@ -102,6 +115,7 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 
     if (_key) EC_KEY_free(_key);
     _key = NULL;
+    [self invalidateNativePublicKey];
 
     _cleared = YES;
 }
@@ -111,6 +125,16 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     CHECK_IF_CLEARED;
 
     if (hash.length == 0 || signature.length == 0) return NO;
+
+#if BTCSecp256k1NativeAvailable
+    // Signatures which are not strict DER are left to OpenSSL which may be more lenient.
+    unsigned char r[32], s[32];
+    if (BTCKeyUsesNativeBackend() && hash.length == 32 &&
+        BTCSecp256k1ParseDERSignature(r, s, signature.bytes, signature.length) &&
+        [self loadNativePublicKey]) {
+        return BTCSecp256k1Verify(r, s, hash.bytes, &_nativePublicKey);
+    }
+#endif
     
     // -1 = error, 0 = bad sig, 1 = good
     if (ECDSA_verify(0, (unsigned char*)hash.bytes,      (int)hash.length,
@@ -157,6 +181,19 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     //       does not make the signature any less secure.
     //
 
+#if BTCSecp256k1NativeAvailable
+    if (BTCKeyUsesNativeBackend() && hash.length == 32) {
+        unsigned char r[32], s[32];
+        if (![self signHashNatively:hash r:r s:s recoveryId:NULL]) return nil;
+        NSMutableData* signature = [NSMutableData dataWithLength:72];
+        signature.length = BTCSecp256k1SerializeDERSignature(signature.mutableBytes, r, s);
+        if (appendHashType) {
+            [signature appendBytes:&hashType length:sizeof(hashType)];
+        }
+        return signature;
+    }
+#endif
+
     ECDSA_SIG sigValue;
     ECDSA_SIG *sig = NULL;
 
@@ -174,7 +211,7 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 
     BTCDataClear(kdata);
 
-    BTCCurvePoint* K = [[BTCCurvePoint generator] multiply:k];
+    BTCCurvePoint* K = [[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:k];
     BTCBigNumber* Kx = K.x;
 
     BTCBigNumber* hashBN = [[BTCBigNumber alloc] initWithUnsignedBigEndian:hash];
@@ -185,8 +222,12 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 
     //NSLog(@"ECDSA: r = %@", Kx.hexString);
     //NSLog(@"ECDSA: s = %@", signatureBN.hexString);
-    BIGNUM r; BN_init(&r); BN_copy(&r, Kx.BIGNUM);
-    BIGNUM s; BN_init(&s); BN_copy(&s, signatureBN.BIGNUM);
+
+    // r and s live in the pool until the signature is encoded and are cleared when the frame is closed.
+    BN_CTX *ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return nil;
+    BIGNUM *r = BN_CTX_get(ctx); BN_copy(r, Kx.BIGNUM);
+    BIGNUM *s = BN_CTX_get(ctx); BN_copy(s, signatureBN.BIGNUM);
 
     [privkeyBN clear];
     [k clear];
@@ -195,11 +236,8 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     [Kx clear];
     [signatureBN clear];
 
-    sig->r = &r;
-    sig->s = &s;
-
-    BN_CTX *ctx = BN_CTX_new();
-    BN_CTX_start(ctx);
+    sig->r = r;
+    sig->s = s;
 
     const EC_GROUP *group = EC_KEY_get0_group(_key);
     BIGNUM *order = BN_CTX_get(ctx);
@@ -210,14 +248,13 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
         // enforce low S values, by negating the value (modulo the order) if above order/2.
         BN_sub(sig->s, order, sig->s);
     }
-    BN_CTX_end(ctx);
-    BN_CTX_free(ctx);
     unsigned int sigSize = ECDSA_size(_key);
 
     NSMutableData* signature = [NSMutableData dataWithLength:sigSize + 16]; // Make sure it is big enough
 
     unsigned char *pos = (unsigned char *)signature.mutableBytes;
     sigSize = i2d_ECDSA_SIG(sig, &pos);
+    BTCBigNumberPoolEnd(ctx);
 
     [signature setLength:sigSize];  // Shrink to fit actual size
 
@@ -329,6 +366,13 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 - (NSMutableData*) publicKeyWithCompression:(BOOL)compression {
     CHECK_IF_CLEARED;
     if (!_key) return nil;
+#if BTCSecp256k1NativeAvailable
+    if (BTCKeyUsesNativeBackend() && [self loadNativePublicKey]) {
+        NSMutableData* data = [[NSMutableData alloc] initWithLength:compression ? BTCCompressedPubkeyLength : BTCUncompressedPubkeyLength];
+        BTCSecp256k1PointSerialize(data.mutableBytes, &_nativePublicKey, compression);
+        return data;
+    }
+#endif
     EC_KEY_set_conv_form(_key, compression ? POINT_CONVERSION_COMPRESSED : POINT_CONVERSION_UNCOMPRESSED);
     int length = i2o_ECPublicKey(_key, NULL);
     if (!length) return nil;
@@ -387,6 +431,19 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     _publicKeyCompressed = ([self lengthOfPubKey:_publicKey] == BTCCompressedPubkeyLength);
     
     [self prepareKeyIfNeeded];
+    [self invalidateNativePublicKey];
+
+#if BTCSecp256k1NativeAvailable
+    // Decompressing the point natively is much faster than in OpenSSL.
+    if (BTCKeyUsesNativeBackend()) {
+        BTCSecp256k1Point point;
+        if (!BTCSecp256k1PointParse(&point, publicKey.bytes, publicKey.length) || ![self setNativePublicKey:&point]) {
+            _publicKey = nil;
+            _publicKeyCompressed = NO;
+        }
+        return;
+    }
+#endif
     
     const unsigned char* bytes = publicKey.bytes;
     if (!o2i_ECPublicKey(&_key, &bytes, publicKey.length)) {
@@ -401,6 +458,7 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     
     BTCDataClear(_publicKey); _publicKey = nil;
     [self prepareKeyIfNeeded];
+    [self invalidateNativePublicKey];
     
     const unsigned char* bytes = DERPrivateKey.bytes;
     if (!d2i_ECPrivateKey(&_key, &bytes, DERPrivateKey.length)) {
@@ -414,15 +472,18 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     
     BTCDataClear(_publicKey); _publicKey = nil;
     [self prepareKeyIfNeeded];
+    [self invalidateNativePublicKey];
 
     if (!_key) return;
     
-    BIGNUM *bignum = BN_bin2bn(privateKey.bytes, (int)privateKey.length, BN_new());
-    
-    if (!bignum) return;
+    BN_CTX *ctx = BTCBigNumberPoolBegin();
+    if (!ctx) return;
     
-    BTCRegenerateKey(_key, bignum);
-    BN_clear_free(bignum);
+    BIGNUM *bignum = BN_CTX_get(ctx);
+    if (bignum && BN_bin2bn(privateKey.bytes, (int)privateKey.length, bignum)) {
+        BTCRegenerateKey(_key, bignum);
+    }
+    BTCBigNumberPoolEnd(ctx);
 }
 
 - (BOOL) isPublicKeyCompressed {
@@ -451,8 +512,9 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 - (void) prepareKeyIfNeeded {
     CHECK_IF_CLEARED;
     if (_key) return;
-    _key = EC_KEY_new_by_curve_name(NID_secp256k1);
-    if (!_key) {
+    // Shared group brings precomputed multiples of the generator used by signing and verification.
+    _key = EC_KEY_new();
+    if (!_key || !EC_KEY_set_group(_key, [BTCCurvePoint EC_GROUP])) {
         // This should not generally happen.
     }
 }
@@ -460,6 +522,62 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
 
 
 
+#pragma mark - Native Backend
+
+
+
+// Forgets the decoded public key. Must be called whenever _key changes.
+- (void) invalidateNativePublicKey {
+#if BTCSecp256k1NativeAvailable
+    _nativePublicKeyValid = NO;
+#endif
+}
+
+#if BTCSecp256k1NativeAvailable
+
+// Decodes the public key from OpenSSL key if needed. Returns NO if there is no valid public key.
+// Uncompressed form is used so that the point does not need to be decompressed again.
+- (BOOL) loadNativePublicKey {
+    if (_nativePublicKeyValid) return YES;
+    const EC_POINT* point = _key ? EC_KEY_get0_public_key(_key) : NULL;
+    if (!point) return NO;
+    unsigned char bytes[BTCUncompressedPubkeyLength];
+    if (EC_POINT_point2oct(EC_KEY_get0_group(_key), point, POINT_CONVERSION_UNCOMPRESSED, bytes, sizeof(bytes), NULL) != sizeof(bytes)) return NO;
+    _nativePublicKeyValid = BTCSecp256k1PointParse(&_nativePublicKey, bytes, sizeof(bytes));
+    return _nativePublicKeyValid;
+}
+
+// Sets public key decoded by the native backend and updates OpenSSL key with its uncompressed form.
+- (BOOL) setNativePublicKey:(const BTCSecp256k1Point*)point {
+    [self prepareKeyIfNeeded];
+    unsigned char bytes[BTCUncompressedPubkeyLength];
+    BTCSecp256k1PointSerialize(bytes, point, NO);
+    const unsigned char* cursor = bytes;
+    if (!o2i_ECPublicKey(&_key, &cursor, sizeof(bytes))) {
+        _nativePublicKeyValid = NO;
+        return NO;
+    }
+    _nativePublicKey = *point;
+    _nativePublicKeyValid = YES;
+    return YES;
+}
+
+// Signs a 32-byte hash with the RFC6979 nonce (see -signatureNonceForHash:). S is always low.
+- (BOOL) signHashNatively:(NSData*)hash r:(unsigned char*)r s:(unsigned char*)s recoveryId:(int*)recid {
+    NSMutableData* privkey = self.privateKey;
+    if (!privkey) return NO;
+    NSMutableData* nonce = [self signatureNonceForHash:hash];
+    BOOL success = nonce && BTCSecp256k1Sign(r, s, recid, hash.bytes, privkey.bytes, nonce.bytes);
+    BTCDataClear(privkey);
+    BTCDataClear(nonce);
+    return success;
+}
+
+#endif
+
+
+
+
 #pragma mark - NSObject
 
 
@@ -611,6 +729,15 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
     int hashlength = (int)hash.length;
     
     int rec = -1;
+
+#if BTCSecp256k1NativeAvailable
+    // Native signature is deterministic and the recovery id comes for free instead of trying all four keys.
+    if (BTCKeyUsesNativeBackend() && hashlength == 32) {
+        if (![self signHashNatively:hash r:sigbytes + 1 s:sigbytes + 33 recoveryId:&rec]) return nil;
+        sigbytes[0] = 0x1b + rec + (self.isPublicKeyCompressed ? 4 : 0);
+        return sigdata;
+    }
+#endif
     
     unsigned char *p64 = (sigbytes + 1); // first byte is reserved for header.
     
@@ -668,6 +795,15 @@ static int     ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const
         // Invalid variant of a pubkey.
         return nil;
     }
+
+#if BTCSecp256k1NativeAvailable
+    if (BTCKeyUsesNativeBackend() && hash.length == 32) {
+        BTCSecp256k1Point point;
+        if (!BTCSecp256k1Recover(&point, &p64[0], &p64[32], hash.bytes, rec)) return nil;
+        if (![key setNativePublicKey:&point]) return nil;
+        return key;
+    }
+#endif
     ECDSA_SIG *sig = ECDSA_SIG_new();
     BN_bin2bn(&p64[0],  32, sig->r);
     BN_bin2bn(&p64[32], 32, sig->s);
@@ -974,27 +1110,17 @@ static NSData* BTCSignatureHashForBinaryMessage(NSData* msg) {
 
 
 static int BTCRegenerateKey(EC_KEY *eckey, BIGNUM *priv_key) {
-    BN_CTX *ctx = NULL;
-    EC_POINT *pub_key = NULL;
-    
     if (!eckey) return 0;
-    
-    const EC_GROUP *group = EC_KEY_get0_group(eckey);
-    
-    BOOL success = NO;
-    if ((ctx = BN_CTX_new())) {
-        if ((pub_key = EC_POINT_new(group))) {
-            if (EC_POINT_mul(group, pub_key, priv_key, NULL, NULL, ctx)) {
-                EC_KEY_set_private_key(eckey, priv_key);
-                EC_KEY_set_public_key(eckey, pub_key);
-                success = YES;
-            }
-        }
-    }
-    
-    if (pub_key) EC_POINT_free(pub_key);
-    if (ctx) BN_CTX_free(ctx);
-    
+
+    BTCMutableBigNumber* privkeyBN = [[BTCMutableBigNumber alloc] initWithBIGNUM:priv_key];
+    BTCCurvePoint* pubkeyPoint = [[BTCCurvePoint alloc] initWithGeneratorMultipliedBy:privkeyBN];
+    [privkeyBN clear];
+
+    if (!pubkeyPoint) return 0;
+
+    BOOL success = EC_KEY_set_private_key(eckey, priv_key) &&
+                   EC_KEY_set_public_key(eckey, pubkeyPoint.EC_POINT);
+    [pubkeyPoint clear];
     return success;
 }
 
@@ -1026,8 +1152,7 @@ static int ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const unsi
     int i = recid / 2;
     
     const EC_GROUP *group = EC_KEY_get0_group(eckey);
-    if ((ctx = BN_CTX_new()) == NULL) { ret = -1; goto err; }
-    BN_CTX_start(ctx);
+    if ((ctx = BTCBigNumberPoolBegin()) == NULL) { ret = -1; goto err; }
     order = BN_CTX_get(ctx);
     if (!EC_GROUP_get_order(group, order, ctx)) { ret = -2; goto err; }
     x = BN_CTX_get(ctx);
@@ -1064,10 +1189,7 @@ static int ECDSA_SIG_recover_key_GFp(EC_KEY *eckey, ECDSA_SIG *ecsig, const unsi
     ret = 1;
     
 err:
-    if (ctx) {
-        BN_CTX_end(ctx);
-        BN_CTX_free(ctx);
-    }
+    BTCBigNumberPoolEnd(ctx);
     if (R != NULL) EC_POINT_free(R);
     if (O != NULL) EC_POINT_free(O);
     if (Q != NULL) EC_POINT_free(Q);
@@ -5,6 +5,7 @@
 #import "BTCBase58.h"
 #import "BTCKey.h"
 #import "BTCAddress.h"
+#import "BTCSecp256k1.h"
 
 @implementation BTCKeychain (Tests)
 
@@ -12,6 +13,13 @@
     [self testPaths];
     [self testStandardTestVectors];
     [self testZeroPaddedPrivateKeys];
+
+    BTCSecp256k1Backend defaultBackend = BTCSecp256k1GetBackend();
+    for (NSNumber* backend in @[ @(BTCSecp256k1BackendOpenSSL), @(BTCSecp256k1BackendNative) ]) {
+        if (!BTCSecp256k1SetBackend(backend.integerValue)) continue;
+        [self testScanning];
+    }
+    BTCSecp256k1SetBackend(defaultBackend);
 }
 
 + (void) testPaths {
@@ -237,4 +245,81 @@
 
 }
 
++ (void) testScanning {
+    BTCKeychain* keychain = [[BTCKeychain alloc] initWithSeed:[@"stress test" dataUsingEncoding:NSUTF8StringEncoding]];
+    BTCKeychain* pubchain = keychain.publicKeychain;
+
+    // Same as BIP32.org (see testZeroPaddedPrivateKeys)
+    BTCAddress* address70 = [BTCAddress addressWithString:@"1FZQfsXwAoUcn9WVwbfRb4jMMkPJEozLWH"];
+    BTCAddress* address227 = [BTCAddress addressWithString:@"1LRbeWJC3sLGRk7ob82djVYTNhsH2UdR4f"];
+    BTCAddress* address455 = [BTCAddress addressWithString:@"1HSr4B5Hr3hc7vAzNHbp7SV7rsFzUhQSeF"];
+
+    NSAssert([keychain findKeychainForAddress:address70 hardened:YES limit:100].index == 70, @"must find hardened key");
+    NSAssert([[keychain findKeychainForAddress:address70 hardened:YES limit:100] isEqual:[keychain derivedKeychainAtIndex:70 hardened:YES]], @"must return derived keychain");
+    NSAssert([keychain findKeychainForAddress:address70 hardened:YES limit:70] == nil, @"must respect the limit");
+    NSAssert([keychain findKeychainForAddress:address70 hardened:YES from:71 limit:1000] == nil, @"must respect the start index");
+    NSAssert([keychain findKeychainForAddress:address70 hardened:NO limit:100] == nil, @"must not find hardened key with normal derivation");
+    NSAssert([pubchain findKeychainForAddress:address70 hardened:YES limit:100] == nil, @"public keychain cannot scan hardened keys");
+
+    NSArray* hardenedKeychains = [keychain findKeychainsForAddresses:@[ address455, address70, address227, address70 ] hardened:YES limit:512];
+    NSAssert(hardenedKeychains.count == 3, @"must find all addresses once");
+    NSAssert([hardenedKeychains[0] isEqual:[keychain derivedKeychainAtIndex:70 hardened:YES]], @"must be sorted by index");
+    NSAssert([hardenedKeychains[1] isEqual:[keychain derivedKeychainAtIndex:227 hardened:YES]], @"must be sorted by index");
+    NSAssert([hardenedKeychains[2] isEqual:[keychain derivedKeychainAtIndex:455 hardened:YES]], @"must be sorted by index");
+
+    // Normal derivation with all kinds of targets.
+    NSArray* indexes = @[ @0, @5, @63, @64, @130, @333 ];
+    NSMutableArray* addresses = [NSMutableArray array];
+    NSMutableArray* pubkeys = [NSMutableArray array];
+    for (NSNumber* index in indexes) {
+        BTCKey* key = [keychain keyAtIndex:index.unsignedIntValue];
+        [addresses addObject:(index.unsignedIntValue % 2) ? key.privateKeyAddress : key.compressedPublicKeyAddress];
+        [pubkeys addObject:[[BTCKey alloc] initWithPublicKey:key.uncompressedPublicKey]];
+    }
+    [addresses addObject:[BTCScriptHashAddress addressWithData:address70.data]]; // P2SH is not supported
+    [addresses addObject:address70];
+
+    NSArray* keychains = [keychain findKeychainsForAddresses:addresses hardened:NO limit:400];
+    NSAssert(keychains.count == indexes.count, @"must find all addresses");
+    for (NSUInteger i = 0; i < indexes.count; i++) {
+        NSAssert([keychains[i] isEqual:[keychain derivedKeychainAtIndex:[indexes[i] unsignedIntValue]]], @"must find keychain for each address");
+    }
+
+    keychains = [keychain findKeychainsForPublicKeys:pubkeys hardened:NO from:5 limit:126];
+    NSAssert(keychains.count == 4, @"must find public keys in range");
+    NSAssert([keychains.firstObject isEqual:[keychain derivedKeychainAtIndex:5]], @"must find public keys in range");
+    NSAssert([keychains.lastObject isEqual:[keychain derivedKeychainAtIndex:130]], @"must find public keys in range");
+    NSAssert([keychain findKeychainForPublicKey:pubkeys.lastObject hardened:NO limit:400].index == 333, @"must find public key");
+
+    // Public keychain derives the same keys, but cannot match private keys.
+    keychains = [pubchain findKeychainsForAddresses:addresses hardened:NO limit:400];
+    NSAssert(keychains.count == 3, @"must find only public key addresses");
+    NSAssert([keychains[1] isEqual:[pubchain derivedKeychainAtIndex:64]], @"must return public keychains");
+    NSAssert(![keychains[1] isPrivate], @"must return public keychains");
+    NSAssert([pubchain findKeychainForPublicKey:pubkeys[1] hardened:NO limit:400].index == 5, @"must find public key with public keychain");
+
+    NSAssert([keychain findKeychainsForAddresses:@[] hardened:NO limit:100].count == 0, @"nothing to find");
+    NSAssert([keychain findKeychainsForAddresses:addresses hardened:NO limit:0].count == 0, @"nothing to scan");
+    NSAssert([keychain findKeychainForAddress:addresses[0] hardened:NO from:BTCKeychainMaxIndex limit:100] == nil, @"must stop at the maximum index");
+
+    // Benchmark of a gap limit scan that finds nothing.
+    {
+        const NSUInteger limit = 1000;
+        BTCKeychain* externalChain = [[keychain.bitcoinMainnetKeychain keychainForAccount:0] derivedKeychainAtIndex:0];
+
+        CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+        for (uint32_t i = 0; i < limit; i++) {
+            BTCKeychain* child = [externalChain derivedKeychainAtIndex:i];
+            NSAssert(![child.identifier isEqual:address70.data], @"must not be found");
+            [child clear];
+        }
+        CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+        NSAssert([externalChain findKeychainForAddress:address70 hardened:NO limit:limit] == nil, @"must not be found");
+        CFAbsoluteTime t3 = CFAbsoluteTimeGetCurrent();
+
+        NSLog(@"BTCKeychain scan of %@ keys with %@ backend: one by one %.1f ms, parallel %.1f ms", @(limit),
+              BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative ? @"native" : @"OpenSSL", (t2 - t1) * 1000.0, (t3 - t2) * 1000.0);
+    }
+}
+
 @end
@@ -171,19 +171,30 @@ static const uint32_t BTCKeychainMaxIndex = 0x7fffffff;
 
 
 // Scanning methods.
+// Child keys are derived in parallel on all processors. With normal derivation only public keys are derived,
+// so public-only keychains can find public keys and public key addresses as well.
+// Hardened derivation and BTCPrivateKeyAddress require a private key.
 
 // Scans child keys till one is found that matches the given address.
 // Only BTCPublicKeyAddress and BTCPrivateKeyAddress are supported. For others nil is returned.
 // Limit is maximum number of keys to scan. If no key is found, returns nil.
-// Returns nil if the receiver does not contain private key.
 - (BTCKeychain*) findKeychainForAddress:(BTCAddress*)address hardened:(BOOL)hardened limit:(NSUInteger)limit;
 - (BTCKeychain*) findKeychainForAddress:(BTCAddress*)address hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit;
 
 // Scans child keys till one is found that matches the given public key.
 // Limit is maximum number of keys to scan. If no key is found, returns nil.
-// Returns nil if the receiver does not contain private key.
 - (BTCKeychain*) findKeychainForPublicKey:(BTCKey*)pubkey hardened:(BOOL)hardened limit:(NSUInteger)limit;
 - (BTCKeychain*) findKeychainForPublicKey:(BTCKey*)pubkey hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit;
 
+// Scans child keys for a set of addresses (e.g. when restoring a wallet) and returns keychains for all of them found within the limit.
+// Keychains are sorted by index. A keychain matching several addresses is returned once.
+// Scanning stops as soon as every address is found. Unsupported addresses are ignored.
+- (NSArray* /* [BTCKeychain] */) findKeychainsForAddresses:(NSArray* /* [BTCAddress] */)addresses hardened:(BOOL)hardened limit:(NSUInteger)limit;
+- (NSArray* /* [BTCKeychain] */) findKeychainsForAddresses:(NSArray* /* [BTCAddress] */)addresses hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit;
+
+// Scans child keys for a set of public keys and returns keychains for all of them found within the limit, sorted by index.
+- (NSArray* /* [BTCKeychain] */) findKeychainsForPublicKeys:(NSArray* /* [BTCKey] */)pubkeys hardened:(BOOL)hardened limit:(NSUInteger)limit;
+- (NSArray* /* [BTCKeychain] */) findKeychainsForPublicKeys:(NSArray* /* [BTCKey] */)pubkeys hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit;
+
 @end
 
@@ -8,6 +8,12 @@
 #import "BTCBase58.h"
 #import "BTCAddress.h"
 #import "BTCNetwork.h"
+#import "BTCRIPEMD160.h"
+#import "BTCSecp256k1.h"
+#import "BTCBigNumberPool.h"
+#import <CommonCrypto/CommonCrypto.h>
+#import <libkern/OSAtomic.h>
+#include <openssl/ec.h>
 
 #define CHECK_IF_CLEARED if (_cleared) { [[NSException exceptionWithName:@"BTCKeychain: instance was already cleared." reason:@"" userInfo:nil] raise]; }
 
@@ -32,6 +38,264 @@
 @property(nonatomic) NSMutableData* publicKey;
 @end
 
+// Number of consecutive indexes derived by a scanning worker at a time.
+// Public keys of a chunk are hashed together and, with OpenSSL, converted to affine coordinates with a single inversion.
+#define BTCKeychainScanChunkSize 64
+
+typedef NS_ENUM(unsigned char, BTCKeychainScanTargetType) {
+    BTCKeychainScanTargetHash160    = 1, // 20-byte hash of a compressed public key
+    BTCKeychainScanTargetPublicKey  = 2, // 33-byte compressed public key
+    BTCKeychainScanTargetPrivateKey = 3, // 32-byte private key
+};
+
+// Target is compared as a whole, so unused bytes must be zero.
+typedef struct {
+    unsigned char type;
+    unsigned char bytes[33];
+} BTCKeychainScanTarget;
+
+typedef struct {
+    const unsigned char* chainCode;  // 32 bytes
+    const unsigned char* privateKey; // 32 bytes, NULL for public-only keychains (required for hardened derivation and private key targets)
+    const unsigned char* publicKey;  // 33 bytes
+    BOOL hardened;
+    BOOL native;
+
+    // Sorted targets and the lowest index found for each of them (INT64_MAX if not found yet).
+    BTCKeychainScanTarget* targets;
+    volatile int64_t* found;
+    size_t targetCount;
+    volatile int64_t remaining;
+
+    BOOL needsHash160s;
+    BOOL needsPublicKeys;
+    BOOL needsPrivateKeys;
+} BTCKeychainScan;
+
+static const unsigned char BTCKeychainCurveOrder[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41
+};
+
+// Computes (a + b) mod n for big-endian numbers below the curve order. Returns NO if the result is zero.
+static BOOL BTCKeychainScalarAdd(unsigned char* result, const unsigned char* a, const unsigned char* b) {
+    unsigned int carry = 0;
+    for (int i = 31; i >= 0; i--) {
+        carry += (unsigned int)a[i] + b[i];
+        result[i] = (unsigned char)carry;
+        carry >>= 8;
+    }
+    if (carry || memcmp(result, BTCKeychainCurveOrder, 32) >= 0) {
+        int borrow = 0;
+        for (int i = 31; i >= 0; i--) {
+            int diff = (int)result[i] - BTCKeychainCurveOrder[i] - borrow;
+            result[i] = (unsigned char)diff;
+            borrow = diff < 0;
+        }
+    }
+    unsigned char bits = 0;
+    for (int i = 0; i < 32; i++) bits |= result[i];
+    return bits != 0;
+}
+
+static int BTCKeychainScanTargetCompare(const void* a, const void* b) {
+    return memcmp(a, b, sizeof(BTCKeychainScanTarget));
+}
+
+static void BTCKeychainScanMatch(BTCKeychainScan* scan, BTCKeychainScanTargetType type, const unsigned char* bytes, size_t length, uint32_t index) {
+    BTCKeychainScanTarget candidate;
+    memset(&candidate, 0, sizeof(candidate));
+    candidate.type = type;
+    memcpy(candidate.bytes, bytes, length);
+
+    BTCKeychainScanTarget* target = bsearch(&candidate, scan->targets, scan->targetCount, sizeof(candidate), BTCKeychainScanTargetCompare);
+    BTCSecureMemset(&candidate, 0, sizeof(candidate));
+    if (!target) return;
+
+    volatile int64_t* found = scan->found + (target - scan->targets);
+    int64_t previous = *found;
+    while (index < previous) {
+        if (OSAtomicCompareAndSwap64Barrier(previous, index, found)) {
+            if (previous == INT64_MAX) OSAtomicDecrement64Barrier(&scan->remaining);
+            break;
+        }
+        previous = *found;
+    }
+}
+
+// Returns YES when every target was found at an index below the given one, so that scanning further cannot change the result.
+static BOOL BTCKeychainScanIsFinished(BTCKeychainScan* scan, uint32_t index) {
+    if (OSAtomicAdd64Barrier(0, &scan->remaining) > 0) return NO;
+    for (size_t i = 0; i < scan->targetCount; i++) {
+        if (scan->found[i] >= index) return NO;
+    }
+    return YES;
+}
+
+// Computes compressed public keys of derived keys using OpenSSL. Invalid derivations are marked in the valid array.
+// Children are computed as IL*G + 1*parent in a single multiplication or, for hardened derivation, as childPrivateKey*G,
+// and converted to affine coordinates all together.
+static void BTCKeychainScanPublicKeysOpenSSL(BTCKeychainScan* scan, unsigned char tweaks[][32], unsigned char publicKeys[][33], BOOL* valid, uint32_t count) {
+    const EC_GROUP* group = [BTCCurvePoint EC_GROUP];
+    BN_CTX* ctx = BTCBigNumberPoolBegin();
+    if (!ctx) {
+        memset(valid, 0, count * sizeof(*valid));
+        return;
+    }
+    BIGNUM* scalar = BN_CTX_get(ctx);
+    EC_POINT* parent = EC_POINT_new(group);
+    EC_POINT* points[BTCKeychainScanChunkSize];
+    size_t pointCount = 0;
+
+    BOOL success = scalar && parent && (scan->hardened || EC_POINT_oct2point(group, parent, scan->publicKey, 33, ctx));
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!valid[i]) continue;
+        EC_POINT* point = success ? EC_POINT_new(group) : NULL;
+        if (point &&
+            BN_bin2bn(tweaks[i], 32, scalar) &&
+            EC_POINT_mul(group, point, scalar, scan->hardened ? NULL : parent, scan->hardened ? NULL : BN_value_one(), ctx) &&
+            !EC_POINT_is_at_infinity(group, point)) {
+            points[pointCount++] = point;
+        } else {
+            if (point) EC_POINT_clear_free(point);
+            valid[i] = NO;
+        }
+    }
+
+    if (pointCount > 0 && !EC_POINTs_make_affine(group, pointCount, points, ctx)) {
+        memset(valid, 0, count * sizeof(*valid));
+    }
+
+    for (uint32_t i = 0, p = 0; i < count; i++) {
+        if (!valid[i]) continue;
+        if (EC_POINT_point2oct(group, points[p++], POINT_CONVERSION_COMPRESSED, publicKeys[i], 33, ctx) != 33) valid[i] = NO;
+    }
+
+    for (size_t p = 0; p < pointCount; p++) {
+        EC_POINT_clear_free(points[p]);
+    }
+    if (parent) EC_POINT_free(parent);
+    BTCBigNumberPoolEnd(ctx);
+}
+
+#if BTCSecp256k1NativeAvailable
+static void BTCKeychainScanPublicKeysNative(BTCKeychainScan* scan, unsigned char tweaks[][32], unsigned char publicKeys[][33], BOOL* valid, uint32_t count) {
+    BTCSecp256k1Point parent;
+    if (!scan->hardened && !BTCSecp256k1PointParse(&parent, scan->publicKey, 33)) {
+        memset(valid, 0, count * sizeof(*valid));
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!valid[i]) continue;
+        BTCSecp256k1Point point;
+        if (scan->hardened) {
+            valid[i] = BTCSecp256k1GeneratorMultiply(&point, tweaks[i]);
+        } else {
+            point = parent;
+            valid[i] = BTCSecp256k1PointAddGeneratorMultiple(&point, tweaks[i]);
+        }
+        if (valid[i]) BTCSecp256k1PointSerialize(publicKeys[i], &point, YES);
+    }
+}
+#endif
+
+// Derives keys at indexes [first, first + count) and records matching targets.
+static void BTCKeychainScanChunk(BTCKeychainScan* scan, uint32_t first, uint32_t count) {
+    unsigned char tweaks[BTCKeychainScanChunkSize][32];      // IL for public derivation, child private key for hardened
+    unsigned char privateKeys[BTCKeychainScanChunkSize][32];
+    unsigned char publicKeys[BTCKeychainScanChunkSize][33];
+    unsigned char hash160s[BTCKeychainScanChunkSize][20];
+    BOOL valid[BTCKeychainScanChunkSize];
+
+    unsigned char data[37];
+    unsigned char digest[CC_SHA512_DIGEST_LENGTH];
+    size_t prefixLength = 33;
+    if (scan->hardened) {
+        data[0] = 0;
+        memcpy(data + 1, scan->privateKey, 32);
+    } else {
+        memcpy(data, scan->publicKey, 33);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t indexBE = OSSwapHostToBigInt32(scan->hardened ? (0x80000000 | (first + i)) : (first + i));
+        memcpy(data + prefixLength, &indexBE, sizeof(indexBE));
+        CCHmac(kCCHmacAlgSHA512, scan->chainCode, 32, data, sizeof(data), digest);
+
+        // Factor is too big, this derivation is invalid.
+        valid[i] = memcmp(digest, BTCKeychainCurveOrder, 32) < 0;
+        if (!valid[i]) continue;
+
+        if (scan->hardened || scan->needsPrivateKeys) {
+            valid[i] = BTCKeychainScalarAdd(privateKeys[i], scan->privateKey, digest);
+        }
+        memcpy(tweaks[i], scan->hardened ? privateKeys[i] : digest, 32);
+    }
+
+    if (scan->needsPublicKeys) {
+#if BTCSecp256k1NativeAvailable
+        if (scan->native) {
+            BTCKeychainScanPublicKeysNative(scan, tweaks, publicKeys, valid, count);
+        } else
+#endif
+        BTCKeychainScanPublicKeysOpenSSL(scan, tweaks, publicKeys, valid, count);
+    }
+
+    // Hashes are computed only for valid keys and stored in the same order.
+    if (scan->needsHash160s) {
+        size_t hashCount = 0;
+        const unsigned char* messages[BTCKeychainScanChunkSize];
+        size_t lengths[BTCKeychainScanChunkSize];
+        for (uint32_t i = 0; i < count; i++) {
+            if (!valid[i]) continue;
+            messages[hashCount] = publicKeys[i];
+            lengths[hashCount++] = 33;
+        }
+        BTCHash160Buffers(&hash160s[0][0], messages, lengths, hashCount);
+    }
+
+    for (uint32_t i = 0, h = 0; i < count; i++) {
+        if (!valid[i]) continue;
+        if (scan->needsHash160s)    BTCKeychainScanMatch(scan, BTCKeychainScanTargetHash160, hash160s[h++], 20, first + i);
+        if (scan->needsPublicKeys)  BTCKeychainScanMatch(scan, BTCKeychainScanTargetPublicKey, publicKeys[i], 33, first + i);
+        if (scan->needsPrivateKeys) BTCKeychainScanMatch(scan, BTCKeychainScanTargetPrivateKey, privateKeys[i], 32, first + i);
+    }
+
+    BTCSecureMemset(tweaks, 0, sizeof(tweaks));
+    BTCSecureMemset(privateKeys, 0, sizeof(privateKeys));
+    BTCSecureMemset(data, 0, sizeof(data));
+    BTCSecureMemset(digest, 0, sizeof(digest));
+}
+
+// Scans indexes [startIndex, startIndex + count) on all processors.
+// Workers take chunks in order, so chunks are skipped only after all targets were found at lower indexes,
+// and every target gets the same index as with a serial scan.
+static void BTCKeychainScanRun(BTCKeychainScan* scan, uint32_t startIndex, uint32_t count) {
+    uint32_t chunkCount = (count + BTCKeychainScanChunkSize - 1) / BTCKeychainScanChunkSize;
+    NSUInteger workers = MIN(MAX([NSProcessInfo processInfo].activeProcessorCount, 1), chunkCount);
+
+    __block volatile int64_t nextChunk = -1;
+
+    void (^worker)(size_t) = ^(size_t w) {
+        while (YES) {
+            int64_t c = OSAtomicIncrement64Barrier(&nextChunk);
+            if (c >= (int64_t)chunkCount) break;
+
+            uint32_t first = startIndex + (uint32_t)c * BTCKeychainScanChunkSize;
+            if (BTCKeychainScanIsFinished(scan, first)) break;
+            BTCKeychainScanChunk(scan, first, MIN(BTCKeychainScanChunkSize, startIndex + count - first));
+        }
+    };
+
+    if (workers <= 1) {
+        if (chunkCount > 0) worker(0);
+    } else {
+        dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), worker);
+    }
+}
+
+
 @implementation BTCKeychain {
     BOOL _cleared;
 }
@@ -476,55 +740,8 @@
 }
 
 - (BTCKeychain*) findKeychainForAddress:(BTCAddress*)address hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit {
-    CHECK_IF_CLEARED;
-
     if (!address) return nil;
-    if (!self.isPrivate) return nil;
-    
-    if ([address isKindOfClass:[BTCPrivateKeyAddress class]]) {
-        BTCPrivateKeyAddress* privkeyAddress = (BTCPrivateKeyAddress*)address;
-        BTCKey* key = privkeyAddress.key;
-        NSMutableData* privkeyData = key.privateKey;
-        
-        BTCKeychain* result = nil;
-        
-        for (uint32_t i = startIndex; i < (startIndex + limit); i++) {
-            BTCKeychain* keychain = [self derivedKeychainAtIndex:i hardened:hardened];
-            
-            if ([keychain.privateKey isEqual:privkeyData]) {
-                result = keychain;
-                break;
-            }
-            
-            [keychain clear];
-        }
-        
-        [key clear];
-        BTCDataClear(privkeyData);
-        
-        return result;
-    }
-    
-    if ([address isKindOfClass:[BTCPublicKeyAddress class]]) {
-        NSData* hash160 = ((BTCPublicKeyAddress*)address).data;
-        
-        BTCKeychain* result = nil;
-        
-        for (uint32_t i = startIndex; i < (startIndex + limit); i++) {
-            BTCKeychain* keychain = [self derivedKeychainAtIndex:i hardened:hardened];
-            
-            if ([keychain.identifier isEqual:hash160]) {
-                result = keychain;
-                break;
-            }
-            
-            [keychain clear];
-        }
-        
-        return result;
-    }
-    
-    return nil;
+    return [[self findKeychainsForAddresses:@[ address ] hardened:hardened from:startIndex limit:limit] firstObject];
 }
 
 
@@ -535,28 +752,152 @@
 }
 
 - (BTCKeychain*) findKeychainForPublicKey:(BTCKey*)pubkey hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit {
+    if (!pubkey) return nil;
+    return [[self findKeychainsForPublicKeys:@[ pubkey ] hardened:hardened from:startIndex limit:limit] firstObject];
+}
+
+
+// Scans child keys for all given addresses and returns keychains for the ones found, sorted by index.
+- (NSArray*) findKeychainsForAddresses:(NSArray*)addresses hardened:(BOOL)hardened limit:(NSUInteger)limit {
+    return [self findKeychainsForAddresses:addresses hardened:hardened from:0 limit:limit];
+}
+
+- (NSArray*) findKeychainsForAddresses:(NSArray*)addresses hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit {
     CHECK_IF_CLEARED;
 
-    if (!pubkey) return nil;
-    if (!self.isPrivate) return nil;
-    
-    NSData* data = pubkey.compressedPublicKey;
-    
-    BTCKeychain* result = nil;
-    
-    for (uint32_t i = startIndex; i < (startIndex + limit); i++) {
-        BTCKeychain* keychain = [self derivedKeychainAtIndex:i hardened:hardened];
-        
-        if ([keychain.publicKey isEqual:data]) {
-            result = keychain;
-            break;
+    NSMutableData* targets = [NSMutableData dataWithCapacity:addresses.count * sizeof(BTCKeychainScanTarget)];
+    BTCKeychainScanTarget target;
+
+    for (BTCAddress* address in addresses) {
+        memset(&target, 0, sizeof(target));
+
+        if ([address isKindOfClass:[BTCPrivateKeyAddress class]]) {
+            // Private keys can only be matched by a private keychain.
+            if (!_privateKey) continue;
+
+            BTCKey* key = ((BTCPrivateKeyAddress*)address).key;
+            NSMutableData* privkeyData = key.privateKey;
+            if (privkeyData.length == 32) {
+                target.type = BTCKeychainScanTargetPrivateKey;
+                memcpy(target.bytes, privkeyData.bytes, 32);
+            }
+            [key clear];
+            BTCDataClear(privkeyData);
+        } else if ([address isKindOfClass:[BTCPublicKeyAddress class]]) {
+            target.type = BTCKeychainScanTargetHash160;
+            memcpy(target.bytes, address.data.bytes, 20);
         }
-        
-        [keychain clear];
+
+        if (target.type) [targets appendBytes:&target length:sizeof(target)];
     }
-    
-    BTCDataClear(data);
-    
+    BTCSecureMemset(&target, 0, sizeof(target));
+
+    return [self findKeychainsForTargets:targets hardened:hardened from:startIndex limit:limit];
+}
+
+
+// Scans child keys for all given public keys and returns keychains for the ones found, sorted by index.
+- (NSArray*) findKeychainsForPublicKeys:(NSArray*)pubkeys hardened:(BOOL)hardened limit:(NSUInteger)limit {
+    return [self findKeychainsForPublicKeys:pubkeys hardened:hardened from:0 limit:limit];
+}
+
+- (NSArray*) findKeychainsForPublicKeys:(NSArray*)pubkeys hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit {
+    CHECK_IF_CLEARED;
+
+    NSMutableData* targets = [NSMutableData dataWithCapacity:pubkeys.count * sizeof(BTCKeychainScanTarget)];
+
+    for (BTCKey* pubkey in pubkeys) {
+        NSData* data = pubkey.compressedPublicKey;
+        if (data.length != 33) continue;
+
+        BTCKeychainScanTarget target;
+        memset(&target, 0, sizeof(target));
+        target.type = BTCKeychainScanTargetPublicKey;
+        memcpy(target.bytes, data.bytes, 33);
+        [targets appendBytes:&target length:sizeof(target)];
+    }
+
+    return [self findKeychainsForTargets:targets hardened:hardened from:startIndex limit:limit];
+}
+
+
+// Derives child keys on all processors and returns keychains matching any of the targets, sorted by index.
+// Targets are cleared when done.
+- (NSArray*) findKeychainsForTargets:(NSMutableData*)targets hardened:(BOOL)hardened from:(uint32_t)startIndex limit:(NSUInteger)limit {
+    // As we use explicit parameter "hardened", do not allow higher bit set.
+    if ((0x80000000 & startIndex) != 0) {
+        BTCDataClear(targets);
+        @throw [NSException exceptionWithName:@"BTCKeychain Exception"
+                                       reason:@"Indexes >= 0x80000000 are invalid. Use hardened:YES argument instead." userInfo:nil];
+    }
+
+    NSMutableArray* result = [NSMutableArray array];
+
+    BTCKeychainScanTarget* sortedTargets = targets.mutableBytes;
+    size_t targetCount = targets.length / sizeof(BTCKeychainScanTarget);
+
+    // Not possible to derive hardened keychain without a private key.
+    if (targetCount == 0 || limit == 0 || (hardened && !_privateKey)) {
+        BTCDataClear(targets);
+        return result;
+    }
+
+    // Indexes above BTCKeychainMaxIndex are never scanned.
+    uint32_t count = (uint32_t)MIN(limit, (NSUInteger)BTCKeychainMaxIndex - startIndex + 1);
+
+    qsort(sortedTargets, targetCount, sizeof(*sortedTargets), BTCKeychainScanTargetCompare);
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < targetCount; i++) {
+        if (uniqueCount > 0 && BTCKeychainScanTargetCompare(&sortedTargets[uniqueCount - 1], &sortedTargets[i]) == 0) continue;
+        sortedTargets[uniqueCount++] = sortedTargets[i];
+    }
+
+    NSMutableData* found = [NSMutableData dataWithLength:uniqueCount * sizeof(int64_t)];
+
+    BTCKeychainScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.chainCode = _chainCode.bytes;
+    scan.privateKey = _privateKey.bytes;
+    scan.publicKey = self.publicKey.bytes; // computed here, so workers do not touch the keychain
+    scan.hardened = hardened;
+#if BTCSecp256k1NativeAvailable
+    scan.native = (BTCSecp256k1GetBackend() == BTCSecp256k1BackendNative);
+#endif
+    scan.targets = sortedTargets;
+    scan.targetCount = uniqueCount;
+    scan.found = found.mutableBytes;
+    scan.remaining = uniqueCount;
+
+    for (size_t i = 0; i < uniqueCount; i++) {
+        scan.found[i] = INT64_MAX;
+        switch (sortedTargets[i].type) {
+            case BTCKeychainScanTargetHash160:
+                scan.needsHash160s = YES;
+                scan.needsPublicKeys = YES;
+                break;
+            case BTCKeychainScanTargetPublicKey:
+                scan.needsPublicKeys = YES;
+                break;
+            case BTCKeychainScanTargetPrivateKey:
+                scan.needsPrivateKeys = YES;
+                break;
+        }
+    }
+
+    BTCKeychainScanRun(&scan, startIndex, count);
+
+    NSMutableIndexSet* indexes = [NSMutableIndexSet indexSet];
+    for (size_t i = 0; i < uniqueCount; i++) {
+        if (scan.found[i] != INT64_MAX) [indexes addIndex:(NSUInteger)scan.found[i]];
+    }
+
+    [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+        BTCKeychain* keychain = [self derivedKeychainAtIndex:(uint32_t)index hardened:hardened];
+        if (keychain) [result addObject:keychain];
+    }];
+
+    BTCDataClear(targets);
+
     return result;
 }
 
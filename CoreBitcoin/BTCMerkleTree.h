@@ -11,7 +11,7 @@
 // See also CVE-2012-2459.
 @property(nonatomic, readonly) BOOL hasTailDuplicates;
 
-// Builds a merkle tree based on raw hashes.
+// Builds a merkle tree based on raw 256-bit hashes. Merkle root is nil if any hash is not 32 bytes long.
 - (id) initWithHashes:(NSArray*)hashes;
 
 // Builds a merkle tree based on transaction hashes.
@@ -2,6 +2,7 @@
 
 #import "BTCMerkleTree.h"
 #import "BTCData.h"
+#import "BTCSHA256.h"
 
 @interface BTCMerkleTree ()
 @property(nonatomic, readwrite) NSData* merkleRoot;
@@ -26,11 +27,7 @@
 
 - (id) initWithDataItems:(NSArray* /* [NSData] */)dataItems {
     if (dataItems.count == 0) return nil;
-    NSMutableArray* hashes = [NSMutableArray arrayWithCapacity:dataItems.count];
-    for (NSData* data in dataItems) {
-        [hashes addObject:BTCHash256(data)];
-    }
-    return [self initWithHashes:hashes];
+    return [self initWithHashes:BTCHash256Batch(dataItems)];
 }
 
 - (NSData*) merkleRoot {
@@ -84,22 +81,31 @@
        known ways of changing the transactions without affecting the merkle
        root.
     */
-    NSMutableArray* tree = [self.hashes mutableCopy];
+    NSArray* hashes = self.hashes;
     _hasTailDuplicates = NO;
-    NSInteger j = 0;
-    for (NSInteger size = (NSInteger)tree.count; size > 1; size = (size + 1) / 2) {
-        for (NSInteger i = 0; i < size; i += 2) {
-            NSInteger i2 = MIN(i + 1, size - 1);
-            if (i2 == i + 1 && i2 + 1 == size && [tree[j+i] isEqual:tree[j+i2]]) {
-                // Two identical hashes at the end of the list at a particular level.
-                _hasTailDuplicates = YES;
-            }
-            NSData* hash = BTCHash256Concat(tree[j+i], tree[j+i2]);
-            [tree addObject:hash];
+    if (hashes.count == 1) return hashes.firstObject;
+
+    // Each level is stored as consecutive 32-byte hashes, so pairs of nodes are hashed in batches in place.
+    // One more slot is reserved for the duplicate of the last hash on levels with an odd number of nodes.
+    size_t size = hashes.count;
+    NSMutableData* level = [NSMutableData dataWithLength:32 * (size + 1)];
+    unsigned char* nodes = level.mutableBytes;
+    for (NSUInteger i = 0; i < size; i++) {
+        NSData* hash = hashes[i];
+        if (hash.length != 32) return nil; // not a 256-bit hash
+        memcpy(nodes + 32 * i, hash.bytes, 32);
+    }
+
+    for (; size > 1; size = (size + 1) / 2) {
+        if (size % 2 == 1) {
+            memcpy(nodes + 32 * size, nodes + 32 * (size - 1), 32);
+        } else if (memcmp(nodes + 32 * (size - 2), nodes + 32 * (size - 1), 32) == 0) {
+            // Two identical hashes at the end of the list at a particular level.
+            _hasTailDuplicates = YES;
         }
-        j += size;
+        BTCHash256Pairs(nodes, nodes, (size + 1) / 2);
     }
-    return tree.lastObject;
+    return [NSData dataWithBytes:nodes length:32];
 }
 
 @end
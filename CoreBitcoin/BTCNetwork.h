@@ -42,6 +42,10 @@
 // Default port for TCP connections.
 @property(nonatomic) uint32_t defaultPort;
 
+// Magic number that starts every network message and every block record in blk*.dat files.
+// Stored as a little-endian uint32: 0xD9B4BEF9 for mainnet (bytes f9 be b4 d9).
+@property(nonatomic) uint32_t magic;
+
 // Maximum target for the proof of work: CBigNum(~uint256(0) >> 32) for mainnet.
 @property(nonatomic) BTCBigNumber* proofOfWorkLimit;
 
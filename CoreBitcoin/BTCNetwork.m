@@ -3,6 +3,7 @@
 #import "BTCNetwork.h"
 #import "BTCBigNumber.h"
 #import "BTCKey.h"
+#import "BTCData.h"
 
 @implementation BTCNetwork {
     BOOL _isMainnet;
@@ -30,6 +31,9 @@
         
         network = [[BTCNetwork alloc] initWithName:@"mainnet" paymentProtocolName:@"main"];
         network->_isMainnet = YES;
+        network.magic = 0xD9B4BEF9;
+        network.defaultPort = 8333;
+        network.genesisBlockHash = BTCReversedData(BTCDataFromHex(@"000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f"));
 
         // TODO: set all parameters here.
         
@@ -44,6 +48,9 @@
         
         network = [[BTCNetwork alloc] initWithName:@"testnet3" paymentProtocolName:@"test"];
         network->_isTestnet = YES;
+        network.magic = 0x0709110B;
+        network.defaultPort = 18333;
+        network.genesisBlockHash = BTCReversedData(BTCDataFromHex(@"000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943"));
         
         // TODO: set all parameters here.
         
@@ -96,12 +103,13 @@
 
 
 - (id) copyWithZone:(NSZone *)zone {
-    BTCNetwork* network = [[BTCNetwork alloc] copy];
+    BTCNetwork* network = [[BTCNetwork alloc] initWithName:self.name paymentProtocolName:_paymentProtocolName];
     
+    network->_isMainnet      = _isMainnet;
     network->_isTestnet      = _isTestnet;
-    network.name             = self.name;
     network.genesisBlockHash = self.genesisBlockHash;
     network.defaultPort      = self.defaultPort;
+    network.magic            = self.magic;
     network.proofOfWorkLimit = [self.proofOfWorkLimit copy];
     network.checkpoints      = [self.checkpoints copy];
     
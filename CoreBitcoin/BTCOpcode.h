@@ -180,6 +180,10 @@ BTCOpcode BTCOpcodeForSmallInteger(NSInteger smallInteger);
 // If incorrect opcode is given, NSIntegerMax is returned.
 NSInteger BTCSmallIntegerFromOpcode(BTCOpcode opcode);
 
+// Returns YES for opcodes that are disabled in Bitcoin (OP_CAT, OP_MUL etc.)
+// Script is invalid if it contains a disabled opcode, even inside a non-executed branch.
+BOOL BTCOpcodeIsDisabled(BTCOpcode opcode);
+
 
 
 
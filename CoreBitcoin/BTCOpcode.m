@@ -158,3 +158,22 @@ NSInteger BTCSmallIntegerFromOpcode(BTCOpcode opcode) {
     return NSIntegerMax;
 }
 
+// Returns YES for opcodes that are disabled in Bitcoin (OP_CAT, OP_MUL etc.)
+BOOL BTCOpcodeIsDisabled(BTCOpcode opcode) {
+    return (opcode == OP_CAT ||
+            opcode == OP_SUBSTR ||
+            opcode == OP_LEFT ||
+            opcode == OP_RIGHT ||
+            opcode == OP_INVERT ||
+            opcode == OP_AND ||
+            opcode == OP_OR ||
+            opcode == OP_XOR ||
+            opcode == OP_2MUL ||
+            opcode == OP_2DIV ||
+            opcode == OP_MUL ||
+            opcode == OP_DIV ||
+            opcode == OP_MOD ||
+            opcode == OP_LSHIFT ||
+            opcode == OP_RSHIFT);
+}
+
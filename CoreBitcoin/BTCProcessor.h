@@ -23,6 +23,9 @@ typedef NS_ENUM(NSUInteger, BTCProcessorError) {
     // Proof of work is below the minimum possible since the last checkpoint.
     BTCProcessorErrorBelowCheckpointProofOfWork,
     
+    // Block has more signature operations than allowed by BTC_MAX_BLOCK_SIGOPS.
+    BTCProcessorErrorTooManySignatureOperations,
+    
 };
 
 // Data source implements actual storage for blocks, block headers and transactions.
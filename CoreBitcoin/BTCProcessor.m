@@ -7,6 +7,7 @@
 #import "BTCTransaction.h"
 #import "BTCTransactionInput.h"
 #import "BTCTransactionOutput.h"
+#import "BTCUnitsAndLimits.h"
 
 NSString* const BTCProcessorErrorDomain = @"BTCProcessorErrorDomain";
 
@@ -61,6 +62,14 @@ NSString* const BTCProcessorErrorDomain = @"BTCProcessorErrorDomain";
         REJECT_BLOCK_WITH_ERROR(BTCProcessorErrorDuplicateOrphanBlock, NSLocalizedString(@"Already have orphan block %@", @""), hash);
     }
     
+    // 2. Check the number of signature operations (counted without running the scripts)
+    
+    NSUInteger sigOpCount = block.sigOpCount;
+    
+    if (sigOpCount > BTC_MAX_BLOCK_SIGOPS) {
+        REJECT_BLOCK_WITH_DOS(BTCProcessorErrorTooManySignatureOperations, 100, NSLocalizedString(@"Block has too many signature operations (%@)", @""), @(sigOpCount));
+    }
+    
     
     
     return YES;
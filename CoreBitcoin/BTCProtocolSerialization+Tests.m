@@ -22,6 +22,35 @@
     [stream close];
     NSAssert(len == requiredLength, @"Should read 1 byte");
     NSAssert(value == number, @"Should read original value");
+    
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    value = 0;
+    NSAssert(BTCDataCursorReadVarInt(&cursor, &value), @"Should read varint with cursor");
+    NSAssert(cursor.offset == requiredLength, @"Should advance cursor by varint length");
+    NSAssert(value == number, @"Should read original value");
+    
+    BTCDataCursor truncated = BTCDataCursorMake([data subdataWithRange:NSMakeRange(0, requiredLength - 1)]);
+    NSAssert(!BTCDataCursorReadVarInt(&truncated, &value), @"Should fail on truncated varint");
+    NSAssert(truncated.offset == 0, @"Should not advance cursor on failure");
+}
+
++ (void) testCursor {
+    NSData* data = BTCDataFromHex(@"0403020103aabbcc05ff");
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    
+    uint32_t u32 = 0;
+    NSAssert(BTCDataCursorReadUInt32(&cursor, &u32) && u32 == 0x01020304, @"Should read little-endian uint32");
+    
+    NSData* str = BTCDataCursorReadVarString(&cursor);
+    NSAssert([str isEqual:BTCDataFromHex(@"aabbcc")], @"Should read var string");
+    
+    // Length prefix claims 5 bytes, but only one is left.
+    NSAssert(BTCDataCursorReadVarString(&cursor) == nil, @"Should fail on truncated var string");
+    NSAssert(BTCDataCursorRemaining(&cursor) == 2, @"Should not advance cursor on failure");
+    NSAssert(BTCDataCursorSkip(&cursor, 3) == NULL, @"Should not skip past the end");
+    NSAssert(BTCDataCursorSkip(&cursor, 2) != NULL, @"Should skip to the end");
+    NSAssert(BTCDataCursorReadData(&cursor, 0).length == 0, @"Should read empty data at the end");
+    NSAssert(BTCDataCursorReadData(&cursor, 1) == nil, @"Should not read past the end");
 }
 
 + (void) runAllTests {
@@ -34,6 +63,8 @@
     [self assertNumber:1234567890ULL serializesToHex:@"fed2029649"];
     [self assertNumber:1234567890123ULL serializesToHex:@"ffcb04fb711f010000"];
     [self assertNumber:UINT64_MAX serializesToHex:@"ffffffffffffffffff"];
+    
+    [self testCursor];
 }
 
 @end
@@ -2,6 +2,47 @@
 
 #import <Foundation/Foundation.h>
 
+// Bounds-checked cursor over an in-memory buffer.
+// Used to parse protocol structures (transactions, blocks) directly from NSData bytes
+// without going through NSInputStream and without copying variable-length fields.
+// The cursor does not retain the data: the caller must keep it alive and unmodified while parsing.
+// Sub-ranges returned by BTCDataCursorReadData and BTCDataCursorReadVarString retain the underlying data themselves.
+typedef struct BTCDataCursor {
+    __unsafe_unretained NSData* data;
+    const unsigned char* bytes;
+    NSUInteger length;
+    NSUInteger offset;
+} BTCDataCursor;
+
+// Returns a cursor positioned at the beginning of the data.
+BTCDataCursor BTCDataCursorMake(NSData* data);
+
+// Number of bytes left to read.
+NSUInteger BTCDataCursorRemaining(const BTCDataCursor* cursor);
+
+// Returns a pointer to the current position and advances the cursor by length bytes.
+// Returns NULL and leaves the cursor intact if there are not enough bytes.
+const unsigned char* BTCDataCursorSkip(BTCDataCursor* cursor, NSUInteger length);
+
+// Copies length bytes into the buffer and advances the cursor. Returns NO if there are not enough bytes.
+BOOL BTCDataCursorReadBytes(BTCDataCursor* cursor, void* buffer, NSUInteger length);
+
+// Read little-endian integers. Return NO if there are not enough bytes.
+BOOL BTCDataCursorReadUInt32(BTCDataCursor* cursor, uint32_t* valueOut);
+BOOL BTCDataCursorReadUInt64(BTCDataCursor* cursor, uint64_t* valueOut);
+
+// Reads varint (CompactSize). Returns NO if the data is truncated.
+BOOL BTCDataCursorReadVarInt(BTCDataCursor* cursor, uint64_t* valueOut);
+
+// Returns a sub-range of the underlying data without copying the bytes and advances the cursor.
+// Returned object keeps the whole underlying buffer alive.
+// Returns nil if there are not enough bytes.
+NSData* BTCDataCursorReadData(BTCDataCursor* cursor, NSUInteger length);
+
+// Reads a string prepended by its length in varint format. Returns a non-copying sub-range or nil.
+NSData* BTCDataCursorReadVarString(BTCDataCursor* cursor);
+
+
 // A collection of routines dealing with parsing and writing various protocol messages.
 @interface BTCProtocolSerialization : NSObject
 
@@ -19,6 +60,7 @@
 // Attempts to read integer from data and returns amount of bytes read.
 // In case of error, returns 0.
 + (NSUInteger) readVarInt:(uint64_t*)valueOut fromData:(NSData*)data;
++ (NSUInteger) readVarInt:(uint64_t*)valueOut fromBytes:(const void*)bytes length:(NSUInteger)length;
 + (NSUInteger) readVarInt:(uint64_t*)valueOut fromStream:(NSInputStream*)stream;
 
 // Attempts to read string prepended by its length in varInt format.
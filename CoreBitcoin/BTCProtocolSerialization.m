@@ -14,25 +14,28 @@
 //  > 0xffffffff    9                  0xff followed by the value as uint64_t
 
 + (NSUInteger) readVarInt:(uint64_t*)valueOut fromData:(NSData*)data {
-    NSUInteger dataLength = data.length;
+    return [self readVarInt:valueOut fromBytes:data.bytes length:data.length];
+}
+
++ (NSUInteger) readVarInt:(uint64_t*)valueOut fromBytes:(const void*)bytes length:(NSUInteger)dataLength {
     if (dataLength == 0) return 0;
     
-    unsigned char size = ((unsigned char*)data.bytes)[0];
+    unsigned char size = ((const unsigned char*)bytes)[0];
     
     if (size < 0xfd) {
         if (valueOut) *valueOut = size;
         return 1;
     } else if (size == 0xfd) {
         if (dataLength < 3) return 0;
-        if (valueOut) *valueOut = OSReadLittleInt16(data.bytes, 1);
+        if (valueOut) *valueOut = OSReadLittleInt16(bytes, 1);
         return 3;
     } else if (size == 0xfe) {
         if (dataLength < 5) return 0;
-        if (valueOut) *valueOut = OSReadLittleInt32(data.bytes, 1);
+        if (valueOut) *valueOut = OSReadLittleInt32(bytes, 1);
         return 5;
     } else {
         if (dataLength < 9) return 0;
-        if (valueOut) *valueOut = OSReadLittleInt64(data.bytes, 1);
+        if (valueOut) *valueOut = OSReadLittleInt64(bytes, 1);
         return 9;
     }
     return 0;
@@ -145,3 +148,83 @@
 
 @end
 
+
+
+
+#pragma mark - Cursor
+
+
+
+BTCDataCursor BTCDataCursorMake(NSData* data) {
+    BTCDataCursor cursor;
+    cursor.data = data;
+    cursor.bytes = data.bytes;
+    cursor.length = data.length;
+    cursor.offset = 0;
+    return cursor;
+}
+
+NSUInteger BTCDataCursorRemaining(const BTCDataCursor* cursor) {
+    return cursor->length - cursor->offset;
+}
+
+const unsigned char* BTCDataCursorSkip(BTCDataCursor* cursor, NSUInteger length) {
+    // Compare against the remaining length so a huge length from a malformed varint cannot overflow the offset.
+    if (length > (cursor->length - cursor->offset)) return NULL;
+    const unsigned char* p = cursor->bytes + cursor->offset;
+    cursor->offset += length;
+    return p;
+}
+
+BOOL BTCDataCursorReadBytes(BTCDataCursor* cursor, void* buffer, NSUInteger length) {
+    const unsigned char* p = BTCDataCursorSkip(cursor, length);
+    if (!p) return NO;
+    memcpy(buffer, p, length);
+    return YES;
+}
+
+BOOL BTCDataCursorReadUInt32(BTCDataCursor* cursor, uint32_t* valueOut) {
+    const unsigned char* p = BTCDataCursorSkip(cursor, sizeof(uint32_t));
+    if (!p) return NO;
+    if (valueOut) *valueOut = OSReadLittleInt32(p, 0);
+    return YES;
+}
+
+BOOL BTCDataCursorReadUInt64(BTCDataCursor* cursor, uint64_t* valueOut) {
+    const unsigned char* p = BTCDataCursorSkip(cursor, sizeof(uint64_t));
+    if (!p) return NO;
+    if (valueOut) *valueOut = OSReadLittleInt64(p, 0);
+    return YES;
+}
+
+BOOL BTCDataCursorReadVarInt(BTCDataCursor* cursor, uint64_t* valueOut) {
+    NSUInteger len = [BTCProtocolSerialization readVarInt:valueOut
+                                                fromBytes:cursor->bytes + cursor->offset
+                                                   length:cursor->length - cursor->offset];
+    if (len == 0) return NO;
+    cursor->offset += len;
+    return YES;
+}
+
+NSData* BTCDataCursorReadData(BTCDataCursor* cursor, NSUInteger length) {
+    const unsigned char* p = BTCDataCursorSkip(cursor, length);
+    if (!p) return nil;
+    if (length == 0) return [NSData data];
+    
+    // Deallocator block captures the source buffer so it outlives the sub-range.
+    NSData* source = cursor->data;
+    return [[NSData alloc] initWithBytesNoCopy:(void*)p length:length deallocator:^(void *bytes, NSUInteger len) {
+        [source self];
+    }];
+}
+
+NSData* BTCDataCursorReadVarString(BTCDataCursor* cursor) {
+    NSUInteger offset = cursor->offset;
+    uint64_t length = 0;
+    if (!BTCDataCursorReadVarInt(cursor, &length)) return nil;
+    if (length > BTCDataCursorRemaining(cursor)) {
+        cursor->offset = offset;
+        return nil;
+    }
+    return BTCDataCursorReadData(cursor, (NSUInteger)length);
+}
@@ -0,0 +1,38 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+
+// Self-contained RIPEMD-160 and Hash160 (RIPEMD160(SHA256(data))) that do not depend on OpenSSL.
+// Digests are written to caller-provided 20-byte buffers, e.g. a BTC160 struct:
+//
+//     BTC160 hash;
+//     BTCHash160Bytes((unsigned char*)&hash, pubkey.bytes, pubkey.length);
+
+// Streaming RIPEMD-160 with init/update/final API.
+// Context is a plain struct: it can be copied to save an intermediate state and continue hashing from it.
+typedef struct {
+    uint32_t state[5];
+    uint64_t length;
+    unsigned char buffer[64];
+} BTCRIPEMD160Context;
+
+void BTCRIPEMD160Init(BTCRIPEMD160Context* ctx);
+void BTCRIPEMD160Update(BTCRIPEMD160Context* ctx, const void* bytes, size_t length);
+
+// Writes 20-byte digest and clears the context.
+void BTCRIPEMD160Final(unsigned char* digest, BTCRIPEMD160Context* ctx);
+
+// Writes RIPEMD160(bytes) to a 20-byte digest.
+void BTCRIPEMD160Bytes(unsigned char* digest, const void* bytes, size_t length);
+
+// Writes RIPEMD160(SHA256(bytes)) to a 20-byte digest without intermediate allocations.
+// The 32-byte SHA-256 digest always fits in a single RIPEMD-160 block, so it is hashed directly.
+void BTCHash160Bytes(unsigned char* digest, const void* bytes, size_t length);
+
+// Computes RIPEMD160(SHA256(message)) of count messages and writes 20-byte digests one after another to the output.
+// Both steps process several messages in parallel SIMD lanes (see BTCSHA256BatchLanes()).
+// Output must have room for 20*count bytes and must not overlap with the messages.
+void BTCHash160Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count);
+
+// Returns an array of BTCHash160 digests of NSData items.
+NSArray* /* [NSData] */ BTCHash160Batch(NSArray* /* [NSData] */ dataItems);
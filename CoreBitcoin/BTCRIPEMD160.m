@@ -0,0 +1,319 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCRIPEMD160.h"
+#import "BTCSHA256.h"
+#import "BTCData.h"
+
+#include <string.h>
+
+// Lane kernels are built under the same conditions as SHA-256 batch kernels,
+// so the number of lanes reported by BTCSHA256BatchLanes() always has a matching kernel here.
+#if BTCSHA256SIMDEnabled && (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define BTCRIPEMD160Lanes4Available 1
+#else
+#define BTCRIPEMD160Lanes4Available 0
+#endif
+
+#if BTCRIPEMD160Lanes4Available && defined(__x86_64__)
+#define BTCRIPEMD160LanesX86Available 1
+#else
+#define BTCRIPEMD160LanesX86Available 0
+#endif
+
+#define BTCRIPEMD160MaxLanes 16
+
+static const uint32_t BTCRIPEMD160IV[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+// Message word order and rotations for the left and the right lines.
+static const uint8_t BTCRIPEMD160RL[80] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+    1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13,
+};
+
+static const uint8_t BTCRIPEMD160RR[80] = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+    6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+    8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11,
+};
+
+static const uint8_t BTCRIPEMD160SL[80] = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+    7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+    11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6,
+};
+
+static const uint8_t BTCRIPEMD160SR[80] = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+    9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+    15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11,
+};
+
+static const uint32_t BTCRIPEMD160KL[5] = { 0x00000000, 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xa953fd4e };
+static const uint32_t BTCRIPEMD160KR[5] = { 0x50a28be6, 0x5c4dd124, 0x6d703ef3, 0x7a6d76e9, 0x00000000 };
+
+static inline uint32_t BTCRIPEMD160ReadLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void BTCRIPEMD160WriteLE32(unsigned char* p, uint32_t x) {
+    p[0] = (unsigned char)x;
+    p[1] = (unsigned char)(x >> 8);
+    p[2] = (unsigned char)(x >> 16);
+    p[3] = (unsigned char)(x >> 24);
+}
+
+
+
+
+#pragma mark - Kernels
+
+
+// Macros below work both with uint32_t and with vectors of uint32_t where each element is a separate lane.
+
+#define BTCRIPEMD160Rotl(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define BTCRIPEMD160F1(x, y, z) ((x) ^ (y) ^ (z))
+#define BTCRIPEMD160F2(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define BTCRIPEMD160F3(x, y, z) (((x) | ~(y)) ^ (z))
+#define BTCRIPEMD160F4(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define BTCRIPEMD160F5(x, y, z) ((x) ^ ((y) | ~(z)))
+
+// Runs 16 steps of both lines. Left line uses function FL, right line uses FR.
+#define BTCRIPEMD160Round(VEC, round, FL, FR) do { \
+    for (int i = 0; i < 16; i++) { \
+        int j = 16 * (round) + i; \
+        VEC t = BTCRIPEMD160Rotl(al + FL(bl, cl, dl) + x[BTCRIPEMD160RL[j]] + BTCRIPEMD160KL[round], BTCRIPEMD160SL[j]) + el; \
+        al = el; el = dl; dl = BTCRIPEMD160Rotl(cl, 10); cl = bl; bl = t; \
+        t = BTCRIPEMD160Rotl(ar + FR(br, cr, dr) + x[BTCRIPEMD160RR[j]] + BTCRIPEMD160KR[round], BTCRIPEMD160SR[j]) + er; \
+        ar = er; er = dr; dr = BTCRIPEMD160Rotl(cr, 10); cr = br; br = t; \
+    } \
+} while (0)
+
+// Compresses one block of 16 words x into the state s[5].
+#define BTCRIPEMD160Compress(VEC, s, x) do { \
+    VEC al = s[0], bl = s[1], cl = s[2], dl = s[3], el = s[4]; \
+    VEC ar = s[0], br = s[1], cr = s[2], dr = s[3], er = s[4]; \
+    BTCRIPEMD160Round(VEC, 0, BTCRIPEMD160F1, BTCRIPEMD160F5); \
+    BTCRIPEMD160Round(VEC, 1, BTCRIPEMD160F2, BTCRIPEMD160F4); \
+    BTCRIPEMD160Round(VEC, 2, BTCRIPEMD160F3, BTCRIPEMD160F3); \
+    BTCRIPEMD160Round(VEC, 3, BTCRIPEMD160F4, BTCRIPEMD160F2); \
+    BTCRIPEMD160Round(VEC, 4, BTCRIPEMD160F5, BTCRIPEMD160F1); \
+    VEC t = s[1] + cl + dr; \
+    s[1] = s[2] + dl + er; \
+    s[2] = s[3] + el + ar; \
+    s[3] = s[4] + al + br; \
+    s[4] = s[0] + bl + cr; \
+    s[0] = t; \
+} while (0)
+
+// Hashes LANES consecutive 32-byte messages (SHA-256 digests) into consecutive 20-byte digests.
+// Each message with its padding fills exactly one block.
+#define BTCRIPEMD160Digests32Lanes(VEC, LANES, output, input) do { \
+    uint32_t words[8 * LANES]; \
+    VEC s[5], x[16]; \
+    const VEC zero = {0}; \
+    for (int i = 0; i < 8; i++) { \
+        for (int l = 0; l < LANES; l++) words[i * LANES + l] = BTCRIPEMD160ReadLE32(input + 32 * l + 4 * i); \
+    } \
+    memcpy(x, words, sizeof(VEC) * 8); \
+    for (int i = 8; i < 16; i++) x[i] = zero; \
+    x[8] = zero + 0x80; \
+    x[14] = zero + 256; \
+    for (int i = 0; i < 5; i++) s[i] = zero + BTCRIPEMD160IV[i]; \
+    BTCRIPEMD160Compress(VEC, s, x); \
+    memcpy(words, s, sizeof(s)); \
+    for (int i = 0; i < 5; i++) { \
+        for (int l = 0; l < LANES; l++) BTCRIPEMD160WriteLE32(output + 20 * l + 4 * i, words[i * LANES + l]); \
+    } \
+} while (0)
+
+static void BTCRIPEMD160Transform(uint32_t* state, const unsigned char* blocks, size_t count) {
+    for (; count > 0; count--, blocks += 64) {
+        uint32_t x[16];
+        for (int i = 0; i < 16; i++) x[i] = BTCRIPEMD160ReadLE32(blocks + 4 * i);
+        BTCRIPEMD160Compress(uint32_t, state, x);
+    }
+}
+
+static void BTCRIPEMD160Digests32Lanes1(unsigned char* output, const unsigned char* input) {
+    BTCRIPEMD160Digests32Lanes(uint32_t, 1, output, input);
+}
+
+#if BTCRIPEMD160Lanes4Available
+
+typedef uint32_t BTCUInt32x4 __attribute__((vector_size(16)));
+
+static void BTCRIPEMD160Digests32Lanes4(unsigned char* output, const unsigned char* input) {
+    BTCRIPEMD160Digests32Lanes(BTCUInt32x4, 4, output, input);
+}
+
+#endif
+
+#if BTCRIPEMD160LanesX86Available
+
+typedef uint32_t BTCUInt32x8 __attribute__((vector_size(32)));
+typedef uint32_t BTCUInt32x16 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2")))
+static void BTCRIPEMD160Digests32Lanes8(unsigned char* output, const unsigned char* input) {
+    BTCRIPEMD160Digests32Lanes(BTCUInt32x8, 8, output, input);
+}
+
+__attribute__((target("avx512f")))
+static void BTCRIPEMD160Digests32Lanes16(unsigned char* output, const unsigned char* input) {
+    BTCRIPEMD160Digests32Lanes(BTCUInt32x16, 16, output, input);
+}
+
+#endif
+
+
+
+
+#pragma mark - Single Messages
+
+
+void BTCRIPEMD160Init(BTCRIPEMD160Context* ctx) {
+    memcpy(ctx->state, BTCRIPEMD160IV, sizeof(BTCRIPEMD160IV));
+    ctx->length = 0;
+}
+
+void BTCRIPEMD160Update(BTCRIPEMD160Context* ctx, const void* bytes, size_t length) {
+    const unsigned char* p = bytes;
+    size_t buffered = (size_t)(ctx->length % 64);
+    ctx->length += length;
+
+    if (buffered > 0) {
+        size_t fill = MIN(64 - buffered, length);
+        memcpy(ctx->buffer + buffered, p, fill);
+        p += fill;
+        length -= fill;
+        if (buffered + fill < 64) return;
+        BTCRIPEMD160Transform(ctx->state, ctx->buffer, 1);
+    }
+
+    if (length >= 64) {
+        BTCRIPEMD160Transform(ctx->state, p, length / 64);
+        p += length - length % 64;
+        length %= 64;
+    }
+
+    if (length > 0) memcpy(ctx->buffer, p, length);
+}
+
+void BTCRIPEMD160Final(unsigned char* digest, BTCRIPEMD160Context* ctx) {
+    uint64_t bits = ctx->length * 8;
+    size_t buffered = (size_t)(ctx->length % 64);
+    size_t blocks = (buffered < 56) ? 1 : 2;
+    unsigned char padding[128] = {0};
+    memcpy(padding, ctx->buffer, buffered);
+    padding[buffered] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        padding[64 * blocks - 8 + i] = (unsigned char)(bits >> (8 * i));
+    }
+    BTCRIPEMD160Transform(ctx->state, padding, blocks);
+
+    for (int i = 0; i < 5; i++) {
+        BTCRIPEMD160WriteLE32(digest + 4 * i, ctx->state[i]);
+    }
+    BTCSecureMemset(padding, 0, sizeof(padding));
+    BTCSecureMemset(ctx, 0, sizeof(*ctx));
+}
+
+void BTCRIPEMD160Bytes(unsigned char* digest, const void* bytes, size_t length) {
+    BTCRIPEMD160Context ctx;
+    BTCRIPEMD160Init(&ctx);
+    BTCRIPEMD160Update(&ctx, bytes, length);
+    BTCRIPEMD160Final(digest, &ctx);
+}
+
+void BTCHash160Bytes(unsigned char* digest, const void* bytes, size_t length) {
+    unsigned char sha256[32];
+    BTCSHA256Bytes(sha256, bytes, length);
+    BTCRIPEMD160Digests32Lanes1(digest, sha256);
+    BTCSecureMemset(sha256, 0, sizeof(sha256));
+}
+
+
+
+
+#pragma mark - Batch API
+
+
+void BTCHash160Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count) {
+    if (count == 0) return;
+
+    size_t lanesCount = 1;
+    void (*kernel)(unsigned char*, const unsigned char*) = BTCRIPEMD160Digests32Lanes1;
+#if BTCRIPEMD160Lanes4Available
+    if (BTCSHA256BatchLanes() >= 4) {
+        lanesCount = 4;
+        kernel = BTCRIPEMD160Digests32Lanes4;
+    }
+#endif
+#if BTCRIPEMD160LanesX86Available
+    if (BTCSHA256BatchLanes() == 8) {
+        lanesCount = 8;
+        kernel = BTCRIPEMD160Digests32Lanes8;
+    } else if (BTCSHA256BatchLanes() == 16) {
+        lanesCount = 16;
+        kernel = BTCRIPEMD160Digests32Lanes16;
+    }
+#endif
+
+    unsigned char* digests = malloc(32 * count);
+    BTCSHA256Buffers(digests, messages, lengths, count);
+
+    size_t i = 0;
+    for (; i + lanesCount <= count; i += lanesCount) {
+        kernel(output + 20 * i, digests + 32 * i);
+    }
+
+    if (i < count) {
+        // Remaining digests are padded with zeros to fill all the lanes.
+        unsigned char input[32 * BTCRIPEMD160MaxLanes] = {0};
+        unsigned char result[20 * BTCRIPEMD160MaxLanes];
+        memcpy(input, digests + 32 * i, 32 * (count - i));
+        kernel(result, input);
+        memcpy(output + 20 * i, result, 20 * (count - i));
+        BTCSecureMemset(input, 0, sizeof(input));
+        BTCSecureMemset(result, 0, sizeof(result));
+    }
+
+    BTCSecureMemset(digests, 0, 32 * count);
+    free(digests);
+}
+
+NSArray* BTCHash160Batch(NSArray* dataItems) {
+    NSUInteger count = dataItems.count;
+    if (count == 0) return @[];
+
+    const unsigned char** messages = malloc(count * sizeof(*messages));
+    size_t* lengths = malloc(count * sizeof(*lengths));
+    NSUInteger i = 0;
+    for (NSData* data in dataItems) {
+        messages[i] = data.bytes;
+        lengths[i] = data.length;
+        i++;
+    }
+
+    NSMutableData* output = [NSMutableData dataWithLength:20 * count];
+    BTCHash160Buffers(output.mutableBytes, messages, lengths, count);
+
+    NSMutableArray* digests = [NSMutableArray arrayWithCapacity:count];
+    for (i = 0; i < count; i++) {
+        [digests addObject:[NSMutableData dataWithBytes:(const unsigned char*)output.bytes + 20 * i length:20]];
+    }
+
+    BTCDataClear(output);
+    free(messages);
+    free(lengths);
+    return digests;
+}
@@ -0,0 +1,81 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+#import <CommonCrypto/CommonDigest.h>
+
+// Change to 0 to exclude SIMD kernels from the build and always hash one message at a time.
+#define BTCSHA256SIMDEnabled 1
+
+// Change to 0 to exclude SHA-NI and ARMv8 kernels from the build and always use CommonCrypto for single messages.
+#define BTCSHA256HardwareEnabled 1
+
+// Implementations of SHA-256 for single messages. Used by BTCSHA256Context and hash functions in BTCData.h.
+typedef NS_ENUM(NSInteger, BTCSHA256Implementation) {
+    // Generic implementation from CommonCrypto.
+    BTCSHA256ImplementationCommonCrypto = 0,
+
+    // Intel SHA extensions available on recent x86-64 CPUs.
+    BTCSHA256ImplementationSHANI = 1,
+
+    // ARMv8 cryptography extensions available on all 64-bit Apple CPUs.
+    BTCSHA256ImplementationARMv8 = 2,
+};
+
+// Returns the implementation currently used. The fastest one supported by the CPU is selected on first use.
+BTCSHA256Implementation BTCSHA256GetImplementation(void);
+
+// Switches implementation for new contexts. Returns NO if it is not supported by this CPU or this build.
+// Contexts keep using the implementation they were initialized with, so switching is safe at any time.
+BOOL BTCSHA256SetImplementation(BTCSHA256Implementation implementation);
+
+// Streaming SHA-256 with init/update/final API.
+// Context is a plain struct: it can be copied to save an intermediate state and continue hashing from it.
+typedef struct {
+    BTCSHA256Implementation implementation;
+    union {
+        CC_SHA256_CTX commonCrypto;
+        struct {
+            uint32_t state[8];
+            uint64_t length;
+            unsigned char buffer[64];
+        } hardware;
+    };
+} BTCSHA256Context;
+
+void BTCSHA256Init(BTCSHA256Context* ctx);
+void BTCSHA256Update(BTCSHA256Context* ctx, const void* bytes, size_t length);
+void BTCSHA256UpdateWithData(BTCSHA256Context* ctx, NSData* data);
+
+// Writes 32-byte digest and clears the context.
+void BTCSHA256Final(unsigned char* digest, BTCSHA256Context* ctx);
+
+// Writes SHA256(bytes) or SHA256(SHA256(bytes)) to a 32-byte digest.
+void BTCSHA256Bytes(unsigned char* digest, const void* bytes, size_t length);
+void BTCHash256Bytes(unsigned char* digest, const void* bytes, size_t length);
+
+
+// Batch hashing of many independent messages.
+// Messages are processed in parallel lanes of SIMD registers: 4 lanes with SSE2 or NEON,
+// 8 lanes with AVX2 and 16 lanes with AVX-512. The best kernel is selected at runtime.
+// Results are identical to BTCSHA256 and BTCHash256 from BTCData.h.
+
+// Returns the number of messages hashed in parallel on this CPU: 1, 4, 8 or 16.
+NSUInteger BTCSHA256BatchLanes(void);
+
+// Computes SHA256 of count messages and writes 32-byte digests one after another to the output.
+// Output must have room for 32*count bytes and must not overlap with the messages.
+void BTCSHA256Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count);
+
+// Computes SHA256(SHA256(message)) of count messages, like BTCSHA256Buffers.
+void BTCHash256Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count);
+
+// Computes SHA256(SHA256(pair)) for count 64-byte pairs of 32-byte hashes (merkle tree nodes)
+// stored one after another in the input. Writes count 32-byte digests to the output.
+// Output may be the same buffer as the input, so a level of a merkle tree can be computed in place.
+void BTCHash256Pairs(unsigned char* output, const unsigned char* input, size_t count);
+
+// Returns an array of BTCSHA256 digests of NSData items.
+NSArray* /* [NSData] */ BTCSHA256Batch(NSArray* /* [NSData] */ dataItems);
+
+// Returns an array of BTCHash256 digests of NSData items.
+NSArray* /* [NSData] */ BTCHash256Batch(NSArray* /* [NSData] */ dataItems);
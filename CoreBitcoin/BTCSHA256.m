@@ -0,0 +1,674 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCSHA256.h"
+#import "BTCData.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// 4-lane kernel uses 128-bit vectors which are always available on x86-64 (SSE2) and arm64 (NEON).
+#if BTCSHA256SIMDEnabled && (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define BTCSHA256Lanes4Available 1
+#else
+#define BTCSHA256Lanes4Available 0
+#endif
+
+// 8- and 16-lane kernels are compiled for AVX2 and AVX-512 and used only if the CPU supports them.
+#if BTCSHA256Lanes4Available && defined(__x86_64__)
+#define BTCSHA256LanesX86Available 1
+#else
+#define BTCSHA256LanesX86Available 0
+#endif
+
+#if BTCSHA256HardwareEnabled && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BTCSHA256SHANIAvailable 1
+#include <immintrin.h>
+#else
+#define BTCSHA256SHANIAvailable 0
+#endif
+
+#if BTCSHA256HardwareEnabled && defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define BTCSHA256ARMv8Available 1
+#include <arm_neon.h>
+#else
+#define BTCSHA256ARMv8Available 0
+#endif
+
+#define BTCSHA256MaxLanes 16
+
+static const uint32_t BTCSHA256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t BTCSHA256IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// Round constants added to the expanded schedule of the padding block of a 64-byte message.
+// The second block of every merkle node is the same, so its schedule is computed only once.
+static const uint32_t BTCSHA256Padding64KW[64] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254, 0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd, 0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537, 0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7, 0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c, 0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76,
+};
+
+static inline uint32_t BTCSHA256ReadBE32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void BTCSHA256WriteBE32(unsigned char* p, uint32_t x) {
+    p[0] = (unsigned char)(x >> 24);
+    p[1] = (unsigned char)(x >> 16);
+    p[2] = (unsigned char)(x >> 8);
+    p[3] = (unsigned char)x;
+}
+
+
+
+
+#pragma mark - Kernels
+
+
+// Macros below work both with uint32_t and with vectors of uint32_t where each element is a separate lane.
+
+#define BTCSHA256Rotr(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define BTCSHA256Ch(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define BTCSHA256Maj(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define BTCSHA256Sigma0(x) (BTCSHA256Rotr(x, 2) ^ BTCSHA256Rotr(x, 13) ^ BTCSHA256Rotr(x, 22))
+#define BTCSHA256Sigma1(x) (BTCSHA256Rotr(x, 6) ^ BTCSHA256Rotr(x, 11) ^ BTCSHA256Rotr(x, 25))
+#define BTCSHA256SmallSigma0(x) (BTCSHA256Rotr(x, 7) ^ BTCSHA256Rotr(x, 18) ^ ((x) >> 3))
+#define BTCSHA256SmallSigma1(x) (BTCSHA256Rotr(x, 17) ^ BTCSHA256Rotr(x, 19) ^ ((x) >> 10))
+
+// Compresses one block of 16 words w (overwritten with the message schedule) into the state s[8].
+#define BTCSHA256Compress(VEC, s, w) do { \
+    VEC a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7]; \
+    for (int t = 0; t < 64; t++) { \
+        if (t >= 16) { \
+            w[t & 15] += BTCSHA256SmallSigma1(w[(t + 14) & 15]) + w[(t + 9) & 15] + BTCSHA256SmallSigma0(w[(t + 1) & 15]); \
+        } \
+        VEC t1 = h + BTCSHA256Sigma1(e) + BTCSHA256Ch(e, f, g) + BTCSHA256K[t] + w[t & 15]; \
+        VEC t2 = BTCSHA256Sigma0(a) + BTCSHA256Maj(a, b, c); \
+        h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2; \
+    } \
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d; s[4] += e; s[5] += f; s[6] += g; s[7] += h; \
+} while (0)
+
+// Compresses a block with a precomputed schedule (round constants already added) into the state s[8].
+#define BTCSHA256CompressSchedule(VEC, s, kw) do { \
+    VEC a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7]; \
+    for (int t = 0; t < 64; t++) { \
+        VEC t1 = h + BTCSHA256Sigma1(e) + BTCSHA256Ch(e, f, g) + kw[t]; \
+        VEC t2 = BTCSHA256Sigma0(a) + BTCSHA256Maj(a, b, c); \
+        h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2; \
+    } \
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d; s[4] += e; s[5] += f; s[6] += g; s[7] += h; \
+} while (0)
+
+// Compresses one block per lane. The state is stored word by word: state[i*LANES + lane] is the i-th word of a lane.
+#define BTCSHA256TransformLanes(VEC, LANES, state, blocks) do { \
+    uint32_t words[16 * LANES]; \
+    VEC s[8], w[16]; \
+    for (int i = 0; i < 16; i++) { \
+        for (int l = 0; l < LANES; l++) words[i * LANES + l] = BTCSHA256ReadBE32(blocks[l] + 4 * i); \
+    } \
+    memcpy(w, words, sizeof(w)); \
+    memcpy(s, state, sizeof(s)); \
+    BTCSHA256Compress(VEC, s, w); \
+    memcpy(state, s, sizeof(s)); \
+} while (0)
+
+// Computes SHA256(SHA256(pair)) of LANES consecutive 64-byte pairs. Reads all input before writing the output.
+#define BTCSHA256Hash256PairsLanes(VEC, LANES, output, input) do { \
+    uint32_t words[16 * LANES]; \
+    VEC s[8], w[16]; \
+    const VEC zero = {0}; \
+    for (int i = 0; i < 16; i++) { \
+        for (int l = 0; l < LANES; l++) words[i * LANES + l] = BTCSHA256ReadBE32(input + 64 * l + 4 * i); \
+    } \
+    memcpy(w, words, sizeof(w)); \
+    for (int i = 0; i < 8; i++) s[i] = zero + BTCSHA256IV[i]; \
+    BTCSHA256Compress(VEC, s, w); \
+    BTCSHA256CompressSchedule(VEC, s, BTCSHA256Padding64KW); \
+    for (int i = 0; i < 8; i++) { \
+        w[i] = s[i]; \
+        w[i + 8] = zero; \
+        s[i] = zero + BTCSHA256IV[i]; \
+    } \
+    w[8] = zero + 0x80000000; \
+    w[15] = zero + 256; \
+    BTCSHA256Compress(VEC, s, w); \
+    memcpy(words, s, sizeof(s)); \
+    for (int i = 0; i < 8; i++) { \
+        for (int l = 0; l < LANES; l++) BTCSHA256WriteBE32(output + 32 * l + 4 * i, words[i * LANES + l]); \
+    } \
+} while (0)
+
+static void BTCSHA256Transform1(uint32_t* state, const unsigned char* const* blocks) {
+    BTCSHA256TransformLanes(uint32_t, 1, state, blocks);
+}
+
+static void BTCSHA256Hash256Pairs1(unsigned char* output, const unsigned char* input) {
+    BTCSHA256Hash256PairsLanes(uint32_t, 1, output, input);
+}
+
+#if BTCSHA256Lanes4Available
+
+typedef uint32_t BTCUInt32x4 __attribute__((vector_size(16)));
+
+static void BTCSHA256Transform4(uint32_t* state, const unsigned char* const* blocks) {
+    BTCSHA256TransformLanes(BTCUInt32x4, 4, state, blocks);
+}
+
+static void BTCSHA256Hash256Pairs4(unsigned char* output, const unsigned char* input) {
+    BTCSHA256Hash256PairsLanes(BTCUInt32x4, 4, output, input);
+}
+
+#endif
+
+#if BTCSHA256LanesX86Available
+
+typedef uint32_t BTCUInt32x8 __attribute__((vector_size(32)));
+typedef uint32_t BTCUInt32x16 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2")))
+static void BTCSHA256Transform8(uint32_t* state, const unsigned char* const* blocks) {
+    BTCSHA256TransformLanes(BTCUInt32x8, 8, state, blocks);
+}
+
+__attribute__((target("avx2")))
+static void BTCSHA256Hash256Pairs8(unsigned char* output, const unsigned char* input) {
+    BTCSHA256Hash256PairsLanes(BTCUInt32x8, 8, output, input);
+}
+
+__attribute__((target("avx512f")))
+static void BTCSHA256Transform16(uint32_t* state, const unsigned char* const* blocks) {
+    BTCSHA256TransformLanes(BTCUInt32x16, 16, state, blocks);
+}
+
+__attribute__((target("avx512f")))
+static void BTCSHA256Hash256Pairs16(unsigned char* output, const unsigned char* input) {
+    BTCSHA256Hash256PairsLanes(BTCUInt32x16, 16, output, input);
+}
+
+#endif
+
+
+
+
+#pragma mark - Dispatch
+
+
+typedef struct {
+    NSUInteger lanes;
+    void (*transform)(uint32_t* state, const unsigned char* const* blocks);
+    void (*hash256Pairs)(unsigned char* output, const unsigned char* input);
+} BTCSHA256Engine;
+
+static const BTCSHA256Engine BTCSHA256Engines[] = {
+    { 1, BTCSHA256Transform1, BTCSHA256Hash256Pairs1 },
+#if BTCSHA256Lanes4Available
+    { 4, BTCSHA256Transform4, BTCSHA256Hash256Pairs4 },
+#endif
+#if BTCSHA256LanesX86Available
+    { 8, BTCSHA256Transform8, BTCSHA256Hash256Pairs8 },
+    { 16, BTCSHA256Transform16, BTCSHA256Hash256Pairs16 },
+#endif
+};
+
+static const BTCSHA256Engine* BTCSHA256SelectedEngine = NULL;
+
+static void BTCSHA256SelectEngine(void) {
+    // Engines are listed in the order of preference; the last one is the widest.
+    NSUInteger index = sizeof(BTCSHA256Engines) / sizeof(BTCSHA256Engines[0]) - 1;
+#if BTCSHA256LanesX86Available
+    // Both checks also make sure the OS saves the wide registers on context switches.
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx512f")) index--;
+    if (!__builtin_cpu_supports("avx2")) index--;
+#endif
+    BTCSHA256SelectedEngine = &BTCSHA256Engines[index];
+}
+
+static const BTCSHA256Engine* BTCSHA256CurrentEngine(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, BTCSHA256SelectEngine);
+    return BTCSHA256SelectedEngine;
+}
+
+NSUInteger BTCSHA256BatchLanes(void) {
+    return BTCSHA256CurrentEngine()->lanes;
+}
+
+
+
+
+#pragma mark - Single Messages
+
+
+#if BTCSHA256SHANIAvailable
+
+// Runs 4 rounds i*4..i*4+3 with message words m.
+#define BTCSHA256SHANIRounds(i, m) do { \
+    __m128i kw = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)&BTCSHA256K[4 * (i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, kw); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(kw, 0x0E)); \
+} while (0)
+
+// Replaces m0 (words t-16..t-13) with words t..t+3 computed from the preceding 16 words.
+#define BTCSHA256SHANISchedule(m0, m1, m2, m3) \
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3)
+
+// Compresses blocks with SHA-NI instructions. The state is kept as ABEF and CDGH words as required by SHA256RNDS2.
+__attribute__((target("sha,sse4.1")))
+static void BTCSHA256TransformSHANI(uint32_t* state, const unsigned char* blocks, size_t count) {
+    const __m128i byteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+    for (; count > 0; count--, blocks += 64) {
+        __m128i abefSaved = state0;
+        __m128i cdghSaved = state1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0)), byteSwapMask);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)), byteSwapMask);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)), byteSwapMask);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)), byteSwapMask);
+
+        BTCSHA256SHANIRounds(0, m0);
+        BTCSHA256SHANIRounds(1, m1);
+        BTCSHA256SHANIRounds(2, m2);
+        BTCSHA256SHANIRounds(3, m3);
+        for (int i = 4; i < 16; i += 4) {
+            BTCSHA256SHANISchedule(m0, m1, m2, m3);
+            BTCSHA256SHANIRounds(i, m0);
+            BTCSHA256SHANISchedule(m1, m2, m3, m0);
+            BTCSHA256SHANIRounds(i + 1, m1);
+            BTCSHA256SHANISchedule(m2, m3, m0, m1);
+            BTCSHA256SHANIRounds(i + 2, m2);
+            BTCSHA256SHANISchedule(m3, m0, m1, m2);
+            BTCSHA256SHANIRounds(i + 3, m3);
+        }
+
+        state0 = _mm_add_epi32(state0, abefSaved);
+        state1 = _mm_add_epi32(state1, cdghSaved);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+#endif
+
+#if BTCSHA256ARMv8Available
+
+// Runs 4 rounds i*4..i*4+3 with message words m.
+#define BTCSHA256ARMv8Rounds(i, m) do { \
+    uint32x4_t kw = vaddq_u32(m, vld1q_u32(&BTCSHA256K[4 * (i)])); \
+    uint32x4_t abcd = state0; \
+    state0 = vsha256hq_u32(state0, state1, kw); \
+    state1 = vsha256h2q_u32(state1, abcd, kw); \
+} while (0)
+
+// Replaces m0 (words t-16..t-13) with words t..t+3 computed from the preceding 16 words.
+#define BTCSHA256ARMv8Schedule(m0, m1, m2, m3) \
+    m0 = vsha256su1q_u32(vsha256su0q_u32(m0, m1), m2, m3)
+
+// Compresses blocks with ARMv8 SHA256H/SHA256H2/SHA256SU0/SHA256SU1 instructions.
+static void BTCSHA256TransformARMv8(uint32_t* state, const unsigned char* blocks, size_t count) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; count > 0; count--, blocks += 64) {
+        uint32x4_t abcdSaved = state0;
+        uint32x4_t efghSaved = state1;
+        uint32x4_t m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 0)));
+        uint32x4_t m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16)));
+        uint32x4_t m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 32)));
+        uint32x4_t m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 48)));
+
+        BTCSHA256ARMv8Rounds(0, m0);
+        BTCSHA256ARMv8Rounds(1, m1);
+        BTCSHA256ARMv8Rounds(2, m2);
+        BTCSHA256ARMv8Rounds(3, m3);
+        for (int i = 4; i < 16; i += 4) {
+            BTCSHA256ARMv8Schedule(m0, m1, m2, m3);
+            BTCSHA256ARMv8Rounds(i, m0);
+            BTCSHA256ARMv8Schedule(m1, m2, m3, m0);
+            BTCSHA256ARMv8Rounds(i + 1, m1);
+            BTCSHA256ARMv8Schedule(m2, m3, m0, m1);
+            BTCSHA256ARMv8Rounds(i + 2, m2);
+            BTCSHA256ARMv8Schedule(m3, m0, m1, m2);
+            BTCSHA256ARMv8Rounds(i + 3, m3);
+        }
+
+        state0 = vaddq_u32(state0, abcdSaved);
+        state1 = vaddq_u32(state1, efghSaved);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+#endif
+
+static volatile BTCSHA256Implementation BTCSHA256CurrentImplementation = BTCSHA256ImplementationCommonCrypto;
+
+static BOOL BTCSHA256ImplementationAvailable(BTCSHA256Implementation implementation) {
+    switch (implementation) {
+        case BTCSHA256ImplementationCommonCrypto:
+            return YES;
+        case BTCSHA256ImplementationSHANI:
+#if BTCSHA256SHANIAvailable
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#else
+            return NO;
+#endif
+        case BTCSHA256ImplementationARMv8:
+            return BTCSHA256ARMv8Available;
+    }
+    return NO;
+}
+
+static void BTCSHA256SelectImplementation(void) {
+    if (BTCSHA256ImplementationAvailable(BTCSHA256ImplementationSHANI)) {
+        BTCSHA256CurrentImplementation = BTCSHA256ImplementationSHANI;
+    } else if (BTCSHA256ImplementationAvailable(BTCSHA256ImplementationARMv8)) {
+        BTCSHA256CurrentImplementation = BTCSHA256ImplementationARMv8;
+    }
+}
+
+static pthread_once_t BTCSHA256ImplementationOnce = PTHREAD_ONCE_INIT;
+
+BTCSHA256Implementation BTCSHA256GetImplementation(void) {
+    pthread_once(&BTCSHA256ImplementationOnce, BTCSHA256SelectImplementation);
+    return BTCSHA256CurrentImplementation;
+}
+
+BOOL BTCSHA256SetImplementation(BTCSHA256Implementation implementation) {
+    if (!BTCSHA256ImplementationAvailable(implementation)) return NO;
+    pthread_once(&BTCSHA256ImplementationOnce, BTCSHA256SelectImplementation);
+    BTCSHA256CurrentImplementation = implementation;
+    return YES;
+}
+
+static void BTCSHA256TransformHardware(BTCSHA256Implementation implementation, uint32_t* state, const unsigned char* blocks, size_t count) {
+#if BTCSHA256SHANIAvailable
+    if (implementation == BTCSHA256ImplementationSHANI) BTCSHA256TransformSHANI(state, blocks, count);
+#endif
+#if BTCSHA256ARMv8Available
+    if (implementation == BTCSHA256ImplementationARMv8) BTCSHA256TransformARMv8(state, blocks, count);
+#endif
+}
+
+void BTCSHA256Init(BTCSHA256Context* ctx) {
+    ctx->implementation = BTCSHA256GetImplementation();
+    if (ctx->implementation == BTCSHA256ImplementationCommonCrypto) {
+        CC_SHA256_Init(&ctx->commonCrypto);
+        return;
+    }
+    memcpy(ctx->hardware.state, BTCSHA256IV, sizeof(BTCSHA256IV));
+    ctx->hardware.length = 0;
+}
+
+void BTCSHA256Update(BTCSHA256Context* ctx, const void* bytes, size_t length) {
+    if (ctx->implementation == BTCSHA256ImplementationCommonCrypto) {
+        // CC_LONG is 32-bit, so very long inputs are fed in chunks.
+        while (length > 0) {
+            CC_LONG chunk = (CC_LONG)MIN(length, (size_t)0x40000000);
+            CC_SHA256_Update(&ctx->commonCrypto, bytes, chunk);
+            bytes = (const unsigned char*)bytes + chunk;
+            length -= chunk;
+        }
+        return;
+    }
+
+    const unsigned char* p = bytes;
+    size_t buffered = (size_t)(ctx->hardware.length % 64);
+    ctx->hardware.length += length;
+
+    if (buffered > 0) {
+        size_t fill = MIN(64 - buffered, length);
+        memcpy(ctx->hardware.buffer + buffered, p, fill);
+        p += fill;
+        length -= fill;
+        if (buffered + fill < 64) return;
+        BTCSHA256TransformHardware(ctx->implementation, ctx->hardware.state, ctx->hardware.buffer, 1);
+    }
+
+    if (length >= 64) {
+        BTCSHA256TransformHardware(ctx->implementation, ctx->hardware.state, p, length / 64);
+        p += length - length % 64;
+        length %= 64;
+    }
+
+    if (length > 0) memcpy(ctx->hardware.buffer, p, length);
+}
+
+void BTCSHA256UpdateWithData(BTCSHA256Context* ctx, NSData* data) {
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        BTCSHA256Update(ctx, bytes, byteRange.length);
+    }];
+}
+
+void BTCSHA256Final(unsigned char* digest, BTCSHA256Context* ctx) {
+    if (ctx->implementation == BTCSHA256ImplementationCommonCrypto) {
+        CC_SHA256_Final(digest, &ctx->commonCrypto);
+        BTCSecureMemset(ctx, 0, sizeof(*ctx));
+        return;
+    }
+
+    uint64_t bits = ctx->hardware.length * 8;
+    size_t buffered = (size_t)(ctx->hardware.length % 64);
+    size_t blocks = (buffered < 56) ? 1 : 2;
+    unsigned char padding[128] = {0};
+    memcpy(padding, ctx->hardware.buffer, buffered);
+    padding[buffered] = 0x80;
+    for (int i = 1; i <= 8; i++) {
+        padding[64 * blocks - i] = (unsigned char)(bits >> (8 * (i - 1)));
+    }
+    BTCSHA256TransformHardware(ctx->implementation, ctx->hardware.state, padding, blocks);
+
+    for (int i = 0; i < 8; i++) {
+        BTCSHA256WriteBE32(digest + 4 * i, ctx->hardware.state[i]);
+    }
+    BTCSecureMemset(padding, 0, sizeof(padding));
+    BTCSecureMemset(ctx, 0, sizeof(*ctx));
+}
+
+void BTCSHA256Bytes(unsigned char* digest, const void* bytes, size_t length) {
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256Update(&ctx, bytes, length);
+    BTCSHA256Final(digest, &ctx);
+}
+
+void BTCHash256Bytes(unsigned char* digest, const void* bytes, size_t length) {
+    BTCSHA256Bytes(digest, bytes, length);
+    BTCSHA256Bytes(digest, digest, 32);
+}
+
+
+
+
+#pragma mark - Batch API
+
+
+// Message being hashed in one of the lanes.
+typedef struct {
+    const unsigned char* message;
+    size_t fullBlocks;  // number of blocks read directly from the message
+    size_t blocks;      // total number of blocks including the padding
+    size_t block;       // index of the next block to compress
+    size_t index;       // index of the message in the batch
+    unsigned char tail[128]; // remaining bytes of the message followed by the padding
+} BTCSHA256Lane;
+
+static void BTCSHA256LaneLoad(BTCSHA256Lane* lane, const unsigned char* message, size_t length, size_t index) {
+    size_t rest = length % 64;
+    lane->message = message;
+    lane->fullBlocks = length / 64;
+    lane->blocks = lane->fullBlocks + (rest < 56 ? 1 : 2);
+    lane->block = 0;
+    lane->index = index;
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    if (rest > 0) memcpy(lane->tail, message + length - rest, rest);
+    lane->tail[rest] = 0x80;
+
+    uint64_t bits = (uint64_t)length * 8;
+    unsigned char* end = lane->tail + (lane->blocks - lane->fullBlocks) * 64;
+    for (int i = 1; i <= 8; i++) {
+        end[-i] = (unsigned char)(bits >> (8 * (i - 1)));
+    }
+}
+
+static inline const unsigned char* BTCSHA256LaneBlock(const BTCSHA256Lane* lane) {
+    if (lane->block < lane->fullBlocks) return lane->message + 64 * lane->block;
+    return lane->tail + 64 * (lane->block - lane->fullBlocks);
+}
+
+void BTCSHA256Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count) {
+    static const unsigned char idleBlock[64] = {0};
+
+    const BTCSHA256Engine* engine = BTCSHA256CurrentEngine();
+    NSUInteger lanesCount = engine->lanes;
+
+    BTCSHA256Lane lanes[BTCSHA256MaxLanes];
+    BOOL active[BTCSHA256MaxLanes];
+    const unsigned char* blocks[BTCSHA256MaxLanes];
+    uint32_t state[8 * BTCSHA256MaxLanes];
+
+    // Each lane takes the next message as soon as it finishes the previous one,
+    // so messages of different lengths keep all lanes busy until the batch runs out.
+    size_t next = 0;
+    NSUInteger activeCount = 0;
+    for (NSUInteger l = 0; l < lanesCount; l++) {
+        active[l] = (next < count);
+        if (!active[l]) continue;
+        BTCSHA256LaneLoad(&lanes[l], messages[next], lengths[next], next);
+        for (int i = 0; i < 8; i++) state[i * lanesCount + l] = BTCSHA256IV[i];
+        next++;
+        activeCount++;
+    }
+
+    while (activeCount > 0) {
+        for (NSUInteger l = 0; l < lanesCount; l++) {
+            blocks[l] = active[l] ? BTCSHA256LaneBlock(&lanes[l]) : idleBlock;
+        }
+
+        engine->transform(state, blocks);
+
+        for (NSUInteger l = 0; l < lanesCount; l++) {
+            if (!active[l] || ++lanes[l].block < lanes[l].blocks) continue;
+
+            unsigned char* digest = output + 32 * lanes[l].index;
+            for (int i = 0; i < 8; i++) BTCSHA256WriteBE32(digest + 4 * i, state[i * lanesCount + l]);
+
+            if (next < count) {
+                BTCSHA256LaneLoad(&lanes[l], messages[next], lengths[next], next);
+                for (int i = 0; i < 8; i++) state[i * lanesCount + l] = BTCSHA256IV[i];
+                next++;
+            } else {
+                active[l] = NO;
+                activeCount--;
+            }
+        }
+    }
+
+    BTCSecureMemset(lanes, 0, sizeof(lanes));
+    BTCSecureMemset(state, 0, sizeof(state));
+}
+
+void BTCHash256Buffers(unsigned char* output, const unsigned char* const* messages, const size_t* lengths, size_t count) {
+    if (count == 0) return;
+
+    BTCSHA256Buffers(output, messages, lengths, count);
+
+    // Second pass hashes copies of the 32-byte digests because they are overwritten with the results.
+    unsigned char* digests = malloc(32 * count);
+    const unsigned char** pointers = malloc(count * sizeof(*pointers));
+    size_t* digestLengths = malloc(count * sizeof(*digestLengths));
+    memcpy(digests, output, 32 * count);
+    for (size_t i = 0; i < count; i++) {
+        pointers[i] = digests + 32 * i;
+        digestLengths[i] = 32;
+    }
+
+    BTCSHA256Buffers(output, pointers, digestLengths, count);
+
+    BTCSecureMemset(digests, 0, 32 * count);
+    free(digests);
+    free(pointers);
+    free(digestLengths);
+}
+
+void BTCHash256Pairs(unsigned char* output, const unsigned char* input, size_t count) {
+    const BTCSHA256Engine* engine = BTCSHA256CurrentEngine();
+    size_t lanesCount = engine->lanes;
+
+    size_t i = 0;
+    for (; i + lanesCount <= count; i += lanesCount) {
+        engine->hash256Pairs(output + 32 * i, input + 64 * i);
+    }
+
+    if (i < count) {
+        // Remaining pairs are padded with zeros to fill all the lanes.
+        unsigned char buffer[64 * BTCSHA256MaxLanes];
+        memset(buffer, 0, sizeof(buffer));
+        memcpy(buffer, input + 64 * i, 64 * (count - i));
+        engine->hash256Pairs(buffer, buffer);
+        memcpy(output + 32 * i, buffer, 32 * (count - i));
+    }
+}
+
+static NSArray* BTCSHA256BatchWithFunction(NSArray* dataItems, void (*function)(unsigned char*, const unsigned char* const*, const size_t*, size_t)) {
+    NSUInteger count = dataItems.count;
+    if (count == 0) return @[];
+
+    const unsigned char** messages = malloc(count * sizeof(*messages));
+    size_t* lengths = malloc(count * sizeof(*lengths));
+    NSUInteger i = 0;
+    for (NSData* data in dataItems) {
+        messages[i] = data.bytes;
+        lengths[i] = data.length;
+        i++;
+    }
+
+    NSMutableData* output = [NSMutableData dataWithLength:32 * count];
+    function(output.mutableBytes, messages, lengths, count);
+
+    NSMutableArray* digests = [NSMutableArray arrayWithCapacity:count];
+    for (i = 0; i < count; i++) {
+        [digests addObject:[NSMutableData dataWithBytes:(const unsigned char*)output.bytes + 32 * i length:32]];
+    }
+
+    BTCDataClear(output);
+    free(messages);
+    free(lengths);
+    return digests;
+}
+
+NSArray* BTCSHA256Batch(NSArray* dataItems) {
+    return BTCSHA256BatchWithFunction(dataItems, BTCSHA256Buffers);
+}
+
+NSArray* BTCHash256Batch(NSArray* dataItems) {
+    return BTCSHA256BatchWithFunction(dataItems, BTCHash256Buffers);
+}
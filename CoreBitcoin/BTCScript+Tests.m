@@ -4,12 +4,14 @@
 #import "BTCData.h"
 #import "BTCBase58.h"
 #import "BTCScriptMachine.h"
+#import "BTCScriptProfile.h"
 #import "BTCScript.h"
 #import "BTCKey.h"
 #import "BTCAddress.h"
 #import "BTCTransaction.h"
 #import "BTCTransactionOutput.h"
 #import "BTCTransactionInput.h"
+#import "BTCScriptTestData.h"
 
 @implementation BTCScript (Tests)
 
@@ -20,12 +22,19 @@
     [self testBinarySerialization];
     [self testStringSerialization];
     [self testStandardScripts];
+    [self testByteTemplates];
+    [self testSigOpCount];
     
     [self testScriptModifications];
     [self testStrangeScripts];
+    [self testStackOperations];
+    [self testScriptNumbers];
     
     [self testValidBitcoinQTScripts];
     [self testInvalidBitcoinQTScripts];
+    [self testStandardTemplates];
+    [self testMultisignatureHashReuse];
+    [self testInstrumentation];
 }
 
 + (void) testP2SHMultisig {
@@ -189,6 +198,17 @@
         NSAssert([[[BTCScript alloc] initWithData:[NSData data]].data isEqual:[NSData data]], @"Empty script should be empty.");
     }
     
+    // Truncated scripts
+    {
+        NSAssert(![[BTCScript alloc] initWithHex:@"4c"], @"Missing PUSHDATA1 length should be invalid.");
+        NSAssert(![[BTCScript alloc] initWithHex:@"4d01"], @"Truncated PUSHDATA2 length should be invalid.");
+        NSAssert(![[BTCScript alloc] initWithHex:@"4e0100010001"], @"PUSHDATA4 longer than the script should be invalid.");
+        NSAssert(![[BTCScript alloc] initWithHex:@"0301"], @"Truncated pushdata should be invalid.");
+        
+        BTCScript* script = [[BTCScript alloc] initWithHex:@"4e010000000151"];
+        NSAssert(script.scriptChunks.count == 2, @"PUSHDATA4 should be parsed");
+        NSAssert([[script.scriptChunks[0] pushdata] isEqual:BTCDataFromHex(@"01")], @"PUSHDATA4 data should be parsed");
+    }
 }
 
 + (void) testStringSerialization {
@@ -264,8 +284,89 @@
     
 }
 
++ (void) testByteTemplates {
+    NSData* hash = BTCDataFromHex(@"7ab89f9fae3f8043dcee5f7b5467a0f0a6e2f7e1");
+    NSData* p2pkh = BTCDataFromHex(@"76a9147ab89f9fae3f8043dcee5f7b5467a0f0a6e2f7e188ac");
+    NSData* p2sh = BTCDataFromHex(@"a9147ab89f9fae3f8043dcee5f7b5467a0f0a6e2f7e187");
+    
+    BOOL isScriptHash = YES;
+    const unsigned char* hashBytes = BTCScriptBytesHash160(p2pkh.bytes, p2pkh.length, &isScriptHash);
+    NSAssert(hashBytes && !isScriptHash && memcmp(hashBytes, hash.bytes, 20) == 0, @"should extract pubkey hash");
+    hashBytes = BTCScriptBytesHash160(p2sh.bytes, p2sh.length, &isScriptHash);
+    NSAssert(hashBytes && isScriptHash && memcmp(hashBytes, hash.bytes, 20) == 0, @"should extract script hash");
+    NSAssert(!BTCScriptBytesHash160(p2sh.bytes, p2sh.length - 1, NULL), @"truncated script should not match");
+    
+    BTCScript* script = [[BTCScript alloc] initWithData:p2sh];
+    NSAssert(script.isPayToScriptHashScript && !script.isPayToPublicKeyHashScript, @"should be P2SH script");
+    NSAssert([script.standardHash160 isEqual:hash], @"should return script hash");
+    NSAssert([script.standardAddress isKindOfClass:[BTCScriptHashAddress class]], @"should return P2SH address");
+    
+    // P2SH is an exact byte template, the same hash pushed with OP_PUSHDATA1 does not count.
+    script = [[BTCScript alloc] initWithHex:@"a94c147ab89f9fae3f8043dcee5f7b5467a0f0a6e2f7e187"];
+    NSAssert(script && !script.isPayToScriptHashScript && !script.standardAddress, @"non-canonical push is not P2SH");
+    
+    script = [[BTCScript alloc] initWithString:@"[0102] OP_CHECKSIG"];
+    NSAssert(script.isPublicKeyScript, @"should be pubkey script");
+    NSAssert(!script.standardHash160, @"pubkey script has no standard hash");
+    
+    script = [[BTCScript alloc] initWithString:@"1 [0102] OP_CHECKSIG"];
+    NSAssert(!script.isPublicKeyScript && !script.isDataOnly, @"should not be pubkey script");
+    NSAssert([[BTCScript alloc] initWithString:@"0 1 [0102] 16"].isDataOnly, @"should be data only");
+    
+    // Scripts are shared between verification threads, lazily computed attributes must be consistent.
+    NSArray* pubkeys = @[BTCDataFromHex(@"0102"), BTCDataFromHex(@"0304"), BTCDataFromHex(@"0506")];
+    NSData* multisigData = [[BTCScript alloc] initWithPublicKeys:pubkeys signaturesRequired:2].data;
+    for (int i = 0; i < 100; i++) {
+        BTCScript* sharedScript = [[BTCScript alloc] initWithData:multisigData];
+        dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t j) {
+            NSAssert(sharedScript.isStandardMultisignatureScript, @"should be standard multisig script");
+            NSAssert(sharedScript.scriptChunks.count == 6, @"should parse chunks once");
+            NSAssert(sharedScript.compiledScript.instructionsCount == 6, @"should compile once");
+        });
+    }
+}
+
++ (void) testSigOpCount {
+    BTCScript* script = [[BTCScript alloc] initWithString:@"OP_CHECKSIG OP_IF 2 [0102] [0304] 2 OP_CHECKMULTISIGVERIFY OP_ENDIF OP_CHECKMULTISIG"];
+    NSAssert(script.sigOpCount == 41, @"legacy count should treat multisig as 20 sigops");
+    NSAssert(script.accurateSigOpCount == 23, @"accurate count should use the number of keys");
+    NSAssert([script sigOpCountWithSignatureScript:nil] == 23, @"non-P2SH script should return accurate count");
+    NSAssert([[BTCScript alloc] initWithHex:@"ac4c"] == nil && [[BTCScript alloc] initWithHex:@"ac"].sigOpCount == 1, @"should count checksig");
+    
+    NSUInteger legacyCount = 0;
+    NSUInteger accurateCount = 0;
+    NSData* truncated = BTCDataFromHex(@"ac52ae4c");
+    BTCScriptBytesCountSigOps(truncated.bytes, truncated.length, &legacyCount, &accurateCount);
+    NSAssert(legacyCount == 21 && accurateCount == 3, @"counting should stop at the truncated operation");
+    
+    NSArray* pubkeys = @[BTCDataFromHex(@"0102"), BTCDataFromHex(@"0304"), BTCDataFromHex(@"0506")];
+    BTCScript* redeemScript = [[BTCScript alloc] initWithPublicKeys:pubkeys signaturesRequired:2];
+    BTCScript* outputScript = redeemScript.scriptHashScript;
+    NSAssert(outputScript.sigOpCount == 0, @"P2SH output script has no sigops by itself");
+    
+    BTCScript* signatureScript = [[[[BTCScript alloc] initWithString:@"0 [01] [02]"] appendData:redeemScript.data] copy];
+    NSAssert([outputScript sigOpCountWithSignatureScript:signatureScript] == 3, @"should count sigops in the redeem script");
+    
+    [signatureScript appendOpcode:OP_NOP];
+    NSAssert([outputScript sigOpCountWithSignatureScript:signatureScript] == 0, @"signature script must be push-only");
+    
+    signatureScript = [[[[BTCScript alloc] initWithString:@"0"] appendData:redeemScript.data] appendOpcode:OP_1];
+    NSAssert([outputScript sigOpCountWithSignatureScript:signatureScript] == 0, @"redeem script must be the last push");
+}
+
 + (void) testScriptModifications {
-    // 
+    BTCScript* script = [[BTCScript alloc] initWithString:@"1 OP_CODESEPARATOR [0102] OP_CODESEPARATOR 2"];
+    [script deleteOccurrencesOfOpcode:OP_CODESEPARATOR];
+    NSAssert([script.data isEqual:BTCDataFromHex(@"5102010252")], @"binary data should follow deleted opcodes");
+    [script deleteOccurrencesOfData:BTCDataFromHex(@"0102")];
+    NSAssert([script.data isEqual:BTCDataFromHex(@"5152")], @"binary data should follow deleted data");
+    NSAssert([script.string isEqual:@"1 2"], @"string should follow deleted data");
+    
+    [script appendScript:[[BTCScript alloc] initWithHex:@"76"]];
+    NSAssert([script.data isEqual:BTCDataFromHex(@"515276")], @"should append script");
+    NSAssert([[script subScriptFromIndex:1].data isEqual:BTCDataFromHex(@"5276")], @"should return subscript from index");
+    NSAssert([[script subScriptToIndex:1].data isEqual:BTCDataFromHex(@"51")], @"should return subscript to index");
+    NSAssert([script subScriptFromIndex:3].data.length == 0, @"subscript from the end should be empty");
 }
 
 + (void) testStrangeScripts {
@@ -289,6 +390,58 @@
     }
 }
 
++ (void) testStackOperations {
+    BTCScriptMachine* scriptMachine = [[BTCScriptMachine alloc] init];
+    
+    NSError* error = nil;
+    BOOL result = [scriptMachine runScript:[[BTCScript alloc] initWithString:@"1 2 3 OP_ROT OP_TUCK OP_TOALTSTACK OP_2DUP OP_NIP"] error:&error];
+    NSAssert(result, @"script should run");
+    
+    // 1 2 3 -> 2 3 1 -> 2 1 3 1 -> 2 1 3 | 1 -> 2 1 3 1 3 -> 2 1 3 3
+    NSArray* expected = @[BTCDataFromHex(@"02"), BTCDataFromHex(@"01"), BTCDataFromHex(@"03"), BTCDataFromHex(@"03")];
+    NSAssert([scriptMachine.stack isEqual:expected], @"stack should contain expected items");
+    NSAssert([scriptMachine.altstack isEqual:@[BTCDataFromHex(@"01")]], @"altstack should contain expected items");
+    
+    BTCScriptMachine* copy = [scriptMachine copy];
+    NSAssert([copy.stack isEqual:expected], @"copy should have the same stack");
+    
+    result = [copy runScript:[[BTCScript alloc] initWithString:@"OP_2DROP OP_DEPTH"] error:&error];
+    NSAssert(result, @"script should run");
+    NSAssert([copy.stack isEqual:(@[BTCDataFromHex(@"02"), BTCDataFromHex(@"01"), BTCDataFromHex(@"02")])], @"copy should be modified");
+    NSAssert([scriptMachine.stack isEqual:expected], @"original stack should not be affected by the copy");
+    
+    result = [scriptMachine runScript:[[BTCScript alloc] initWithString:@"0 OP_IF 0 OP_IF OP_RETURN OP_ELSE OP_RETURN OP_ENDIF OP_ELSE 1 OP_IF OP_SHA256 OP_ENDIF OP_ENDIF"] error:&error];
+    NSAssert(result, @"nested conditions should be handled correctly");
+    NSAssert([scriptMachine.stack.lastObject isEqual:BTCSHA256(BTCDataFromHex(@"03"))], @"only the executed branch should affect the stack");
+}
+
++ (void) testScriptNumbers {
+    NSArray* tuples = @[
+                        // script, result without minimal data check, result with the check
+                        @[@"2147483647 OP_DUP OP_ADD 4294967294 OP_EQUAL", @YES, @YES],
+                        @[@"-2147483647 OP_DUP OP_ADD -4294967294 OP_EQUAL", @YES, @YES],
+                        @[@"2147483647 OP_DUP OP_ADD OP_1ADD", @NO, @NO], // 5-byte result cannot be used as an operand
+                        @[@"0x01 0x80 OP_NOT", @YES, @NO],                // negative zero
+                        @[@"0x02 0x0100 1 OP_NUMEQUAL", @YES, @NO],       // non-minimal 1
+                        @[@"0x02 0xff00 255 OP_EQUAL", @YES, @YES],       // extra byte is required for the sign bit
+                        @[@"-1 OP_ABS 1 OP_EQUAL", @YES, @YES],
+                        @[@"5 OP_NEGATE 0x01 0x85 OP_EQUAL", @YES, @YES],
+                        @[@"3 2 5 OP_WITHIN", @YES, @YES],
+                        @[@"-7 3 OP_MIN -7 OP_NUMEQUAL", @YES, @YES],
+                        ];
+    
+    for (NSArray* tuple in tuples) {
+        BTCScript* script = [[BTCScript alloc] initWithString:tuple[0]];
+        NSAssert(script, @"script should be valid");
+        for (int i = 0; i < 2; i++) {
+            BTCScriptMachine* scriptMachine = [[BTCScriptMachine alloc] init];
+            scriptMachine.verificationFlags = (i == 0) ? 0 : BTCScriptVerificationMinimalData;
+            BOOL result = [scriptMachine runScript:script error:NULL] && scriptMachine.stack.count > 0 && ((NSData*)scriptMachine.stack.lastObject).length > 0;
+            NSAssert(result == [tuple[i + 1] boolValue], @"unexpected script number evaluation result");
+        }
+    }
+}
+
 
 BTCTransaction* BuildCreditingTransaction(BTCScript* scriptPubKey) {
     BTCTransaction* txCredit = [[BTCTransaction alloc] init];
@@ -399,6 +552,225 @@ BTCTransaction* BuildSpendingTransaction(BTCScript* scriptSig, BTCTransaction* t
 }
 
 
+// Verifies the input with and without standard templates and checks that both results are the same.
++ (BOOL) verifyTransaction:(BTCTransaction*)tx outputScript:(BTCScript*)outputScript {
+    BOOL results[2];
+    NSArray* stacks[2];
+    for (int i = 0; i < 2; i++) {
+        BTCScriptMachine* sm = [[BTCScriptMachine alloc] initWithTransaction:tx inputIndex:0];
+        sm.verificationFlags = BTCScriptVerificationStrictEncoding;
+        sm.standardTemplatesEnabled = (i == 0);
+        results[i] = [sm verifyWithOutputScript:outputScript error:NULL];
+        stacks[i] = sm.stack;
+    }
+    NSAssert(results[0] == results[1], @"standard templates should give the same result as the interpreter");
+    NSAssert(!results[0] || [stacks[0] isEqual:stacks[1]], @"standard templates should leave the same stack as the interpreter");
+    return results[0];
+}
+
++ (void) testStandardTemplates {
+    // Generic scripts must not be affected by the template matching.
+    for (NSArray* tuples in @[validBitcoinQTScripts(), invalidBitcoinQTScripts()]) {
+        for (NSArray* tuple in tuples) {
+            BTCScript* inputScript = [[BTCScript alloc] initWithString:tuple[0]];
+            BTCScript* outputScript = [[BTCScript alloc] initWithString:tuple[1]];
+            if (!inputScript || !outputScript) continue;
+            [self verifyTransaction:BuildSpendingTransaction(inputScript, BuildCreditingTransaction(outputScript)) outputScript:outputScript];
+        }
+    }
+    
+    BTCKey* alice = [[BTCKey alloc] initWithPrivateKey:BTCHash256(BTCDataWithUTF8CString("alice"))];
+    BTCKey* bob   = [[BTCKey alloc] initWithPrivateKey:BTCHash256(BTCDataWithUTF8CString("bob"))];
+    BTCKey* carl  = [[BTCKey alloc] initWithPrivateKey:BTCHash256(BTCDataWithUTF8CString("carl"))];
+    BTCKey* david = [[BTCKey alloc] initWithPrivateKey:BTCHash256(BTCDataWithUTF8CString("david"))];
+    BTCSignatureHashType hashtype = BTCSignatureHashTypeAll;
+    
+    // P2PKH
+    {
+        BTCScript* outputScript = [[BTCScript alloc] initWithAddress:alice.compressedPublicKeyAddress];
+        BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+        NSData* hash = [tx signatureHashForScript:outputScript inputIndex:0 hashType:hashtype error:NULL];
+        NSData* aliceSig = [alice signatureForHash:hash hashType:hashtype];
+        NSData* bobSig = [bob signatureForHash:hash hashType:hashtype];
+        NSMutableData* brokenSig = [aliceSig mutableCopy];
+        ((unsigned char*)brokenSig.mutableBytes)[10] ^= 1;
+        
+        NSArray* cases = @[
+                           @[@YES, aliceSig, alice.compressedPublicKey],
+                           @[@NO,  aliceSig, alice.uncompressedPublicKey],
+                           @[@NO,  bobSig,   alice.compressedPublicKey],
+                           @[@NO,  aliceSig, bob.compressedPublicKey],
+                           @[@NO,  brokenSig, alice.compressedPublicKey],
+                           @[@NO,  [NSData data], alice.compressedPublicKey],
+                           @[@YES, [NSData data], aliceSig, alice.compressedPublicKey], // extra item below is allowed
+                           ];
+        for (NSArray* items in cases) {
+            BTCScript* signatureScript = [[BTCScript alloc] init];
+            for (NSData* item in [items subarrayWithRange:NSMakeRange(1, items.count - 1)]) {
+                [signatureScript appendData:item];
+            }
+            [tx.inputs[0] setSignatureScript:signatureScript];
+            NSAssert([self verifyTransaction:tx outputScript:outputScript] == [items[0] boolValue], @"unexpected P2PKH verification result");
+        }
+    }
+    
+    // Bare and P2SH multisig
+    NSArray* pubkeys = [@[alice, bob, carl] valueForKey:@"compressedPublicKey"];
+    BTCScript* multisigScript = [[BTCScript alloc] initWithPublicKeys:pubkeys signaturesRequired:2];
+    
+    for (BTCScript* outputScript in @[multisigScript, multisigScript.scriptHashScript]) {
+        BOOL p2sh = outputScript.isPayToScriptHashScript;
+        BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+        NSData* hash = [tx signatureHashForScript:multisigScript inputIndex:0 hashType:hashtype error:NULL];
+        
+        NSArray* cases = @[
+                           @[@YES, alice, bob],
+                           @[@YES, bob, carl],
+                           @[@YES, alice, carl],
+                           @[@YES, david, alice, carl],
+                           @[@YES, alice, alice, bob],
+                           @[@NO],
+                           @[@NO, alice],
+                           @[@NO, bob, alice],
+                           @[@NO, carl, carl],
+                           @[@NO, alice, david],
+                           @[@NO, alice, bob, david],
+                           ];
+        for (NSArray* items in cases) {
+            BTCScript* signatureScript = [[BTCScript alloc] init];
+            [signatureScript appendOpcode:OP_0];
+            for (BTCKey* key in [items subarrayWithRange:NSMakeRange(1, items.count - 1)]) {
+                [signatureScript appendData:[key signatureForHash:hash hashType:hashtype]];
+            }
+            if (p2sh) [signatureScript appendData:multisigScript.data];
+            [tx.inputs[0] setSignatureScript:signatureScript];
+            NSAssert([self verifyTransaction:tx outputScript:outputScript] == [items[0] boolValue], @"unexpected multisig verification result");
+        }
+    }
+    
+    // Benchmark
+    {
+        BTCScript* outputScript = [[BTCScript alloc] initWithAddress:alice.compressedPublicKeyAddress];
+        BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+        NSData* hash = [tx signatureHashForScript:outputScript inputIndex:0 hashType:hashtype error:NULL];
+        [tx.inputs[0] setSignatureScript:[[[[BTCScript alloc] init] appendData:[alice signatureForHash:hash hashType:hashtype]] appendData:alice.compressedPublicKey]];
+        
+        for (int i = 0; i < 2; i++) {
+            CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+            for (int j = 0; j < 200; j++) {
+                BTCScriptMachine* sm = [[BTCScriptMachine alloc] initWithTransaction:tx inputIndex:0];
+                sm.standardTemplatesEnabled = (i == 0);
+                NSAssert([sm verifyWithOutputScript:outputScript error:NULL], @"should verify");
+            }
+            NSLog(@"BTCScriptMachine: 200 P2PKH inputs verified in %.4f sec %@ standard templates.", CFAbsoluteTimeGetCurrent() - t0, i == 0 ? @"with" : @"without");
+        }
+    }
+}
+
+
++ (void) testMultisignatureHashReuse {
+    NSMutableArray* keys = [NSMutableArray array];
+    for (int i = 0; i < 15; i++) {
+        [keys addObject:[[BTCKey alloc] initWithPrivateKey:BTCHash256([[NSString stringWithFormat:@"key%d", i] dataUsingEncoding:NSUTF8StringEncoding])]];
+    }
+    
+    // Signatures with different hash types within one OP_CHECKMULTISIG must not share a hash.
+    // OP_CODESEPARATOR is removed from the subscript by the first hash computation, so the following ones see a different subscript.
+    BTCScript* multisigScript = [[BTCScript alloc] initWithPublicKeys:[[keys subarrayWithRange:NSMakeRange(0, 3)] valueForKey:@"compressedPublicKey"] signaturesRequired:2];
+    BTCScript* outputScript = [[[[BTCScript alloc] init] appendOpcode:OP_CODESEPARATOR] appendScript:multisigScript];
+    BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+    
+    NSArray* cases = @[
+                       @[@YES, @(SIGHASH_ALL), @(SIGHASH_ALL)],
+                       @[@YES, @(SIGHASH_ALL), @(SIGHASH_NONE)],
+                       @[@YES, @(SIGHASH_NONE | SIGHASH_ANYONECANPAY), @(SIGHASH_SINGLE)],
+                       ];
+    for (NSArray* items in cases) {
+        for (int broken = 0; broken < 2; broken++) {
+            BTCScript* signatureScript = [[[BTCScript alloc] init] appendOpcode:OP_0];
+            for (int k = 0; k < 2; k++) {
+                BTCSignatureHashType hashtype = [items[1 + k] unsignedCharValue];
+                NSData* hash = [tx signatureHashForScript:[outputScript copy] inputIndex:0 hashType:hashtype error:NULL];
+                NSMutableData* signature = [[keys[k] signatureForHash:hash hashType:hashtype] mutableCopy];
+                
+                // Claiming another hash type must invalidate the signature even if the other hash type was seen before.
+                if (broken && k == 1) ((unsigned char*)signature.mutableBytes)[signature.length - 1] = [items[1] unsignedCharValue] ^ SIGHASH_ANYONECANPAY;
+                [signatureScript appendData:signature];
+            }
+            [tx.inputs[0] setSignatureScript:signatureScript];
+            NSAssert([self verifyTransaction:tx outputScript:outputScript] == ([items[0] boolValue] && !broken), @"unexpected multisig verification result");
+        }
+    }
+    
+    // Benchmark: 11-of-15 multisig where only the last signatures match, so every key is tried.
+    {
+        BTCScript* outputScript = [[BTCScript alloc] initWithPublicKeys:[keys valueForKey:@"compressedPublicKey"] signaturesRequired:11];
+        BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+        NSData* hash = [tx signatureHashForScript:[outputScript copy] inputIndex:0 hashType:SIGHASH_ALL error:NULL];
+        BTCScript* signatureScript = [[[BTCScript alloc] init] appendOpcode:OP_0];
+        for (BTCKey* key in [keys subarrayWithRange:NSMakeRange(4, 11)]) {
+            [signatureScript appendData:[key signatureForHash:hash hashType:SIGHASH_ALL]];
+        }
+        [tx.inputs[0] setSignatureScript:signatureScript];
+        
+        CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+        for (int i = 0; i < 20; i++) {
+            BTCScriptMachine* sm = [[BTCScriptMachine alloc] initWithTransaction:tx inputIndex:0];
+            sm.standardTemplatesEnabled = NO;
+            NSAssert([sm verifyWithOutputScript:outputScript error:NULL], @"should verify");
+        }
+        NSLog(@"BTCScriptMachine: 20 11-of-15 multisig inputs verified in %.4f sec.", CFAbsoluteTimeGetCurrent() - t0);
+    }
+}
+
++ (void) testInstrumentation {
+    BTCScriptProfile* profile = [[BTCScriptProfile alloc] init];
+    NSMutableArray* trace = [NSMutableArray array];
+    
+    BTCScriptMachine* sm = [[BTCScriptMachine alloc] init];
+    sm.profile = profile;
+    sm.traceHandler = ^(BTCScriptMachine* machine, NSUInteger opIndex, BTCOpcode opcode, NSUInteger stackDepth) {
+        [trace addObject:@[@(opIndex), @(opcode), @(stackDepth)]];
+    };
+    
+    // Operations in the non-executed branch are not reported.
+    NSAssert([sm runScript:[[BTCScript alloc] initWithString:@"0 IF 2 3 ELSE 4 ENDIF"] error:NULL], @"should run");
+    NSArray* expectedTrace = @[
+                               @[@0, @(OP_0), @0],
+                               @[@1, @(OP_IF), @1],
+                               @[@4, @(OP_ELSE), @0],
+                               @[@5, @(OP_4), @0],
+                               @[@6, @(OP_ENDIF), @1],
+                               ];
+    NSAssert([trace isEqual:expectedTrace], @"should trace executed operations");
+    NSAssert(profile.scriptsCount == 1, @"should count the script");
+    NSAssert(profile.operationsCount == 5, @"should count executed operations");
+    NSAssert([profile countForOpcode:OP_IF] == 1 && [profile countForOpcode:OP_4] == 1 && [profile countForOpcode:OP_2] == 0, @"should count opcodes");
+    NSAssert([profile.dictionary[@"OP_ELSE"] isEqual:@1], @"dictionary should contain opcode counts");
+    
+    // Failing scripts are counted too.
+    NSAssert(![sm runScript:[[BTCScript alloc] initWithString:@"1 RETURN"] error:NULL], @"should fail");
+    NSAssert(profile.scriptsCount == 2 && [profile countForOpcode:OP_RETURN] == 1, @"should count failed script");
+    
+    // Signature checks are counted both by the interpreter and by standard templates.
+    BTCKey* alice = [[BTCKey alloc] initWithPrivateKey:BTCHash256(BTCDataWithUTF8CString("alice"))];
+    BTCScript* outputScript = [[BTCScript alloc] initWithAddress:alice.compressedPublicKeyAddress];
+    BTCTransaction* tx = BuildSpendingTransaction([[BTCScript alloc] init], BuildCreditingTransaction(outputScript));
+    NSData* hash = [tx signatureHashForScript:[outputScript copy] inputIndex:0 hashType:SIGHASH_ALL error:NULL];
+    [tx.inputs[0] setSignatureScript:[[[[BTCScript alloc] init] appendData:[alice signatureForHash:hash hashType:SIGHASH_ALL]] appendData:alice.compressedPublicKey]];
+    
+    for (int i = 0; i < 2; i++) {
+        [profile resetStatistics];
+        BTCScriptMachine* sm = [[BTCScriptMachine alloc] initWithTransaction:tx inputIndex:0];
+        sm.standardTemplatesEnabled = (i == 0);
+        sm.profile = profile;
+        NSAssert([sm verifyWithOutputScript:outputScript error:NULL], @"should verify");
+        NSAssert(profile.signatureChecksCount == 1, @"should count signature check");
+        NSAssert(profile.signatureCheckNanoseconds > 0, @"should measure signature check");
+        NSAssert(profile.scriptsCount == (i == 0 ? 0 : 2), @"templates should not run the interpreter");
+    }
+    NSLog(@"BTCScriptProfile: %@", profile.dictionary);
+}
 
 // Data
 
@@ -16,6 +16,7 @@ typedef NS_ENUM(NSInteger, BTCScriptSimulationOptions) {
 };
 
 @class BTCAddress;
+@class BTCCompiledScript;
 @class BTCScriptHashAddress;
 @class BTCScriptHashAddressTestnet;
 @interface BTCScriptChunk : NSObject
@@ -119,10 +120,31 @@ typedef NS_ENUM(NSInteger, BTCScriptSimulationOptions) {
 //   stop - if set to YES, stops iterating.
 - (void) enumerateOperations:(void(^)(NSUInteger opIndex, BTCOpcode opcode, NSData* pushdata, BOOL* stop))block;
 
+// Number of signature operations counted by legacy rules (see GetSigOpCount(false) in bitcoind):
+// OP_CHECKSIG and OP_CHECKSIGVERIFY count as 1, OP_CHECKMULTISIG and OP_CHECKMULTISIGVERIFY count as 20.
+// Counted once by scanning the binary data and cached until the script is modified.
+@property(nonatomic, readonly) NSUInteger sigOpCount;
+
+// Number of signature operations where OP_CHECKMULTISIG preceded by OP_<N> counts as N (see GetSigOpCount(true) in bitcoind).
+@property(nonatomic, readonly) NSUInteger accurateSigOpCount;
+
+// Returns the number of signature operations for this output script spent by a given signature script.
+// For P2SH output scripts, counts signature operations in the redeem script (the last item pushed by the signature script)
+// or returns 0 if the signature script is not push-only. For other scripts returns accurateSigOpCount.
+- (NSUInteger) sigOpCountWithSignatureScript:(BTCScript*)signatureScript;
+
+// Returns the script compiled for execution. It is built once and reused until the script is modified.
+// See BTCCompiledScript for details.
+@property(nonatomic, readonly) BTCCompiledScript* compiledScript;
+
 // Returns BTCPublicKeyAddress or BTCScriptHashAddress if the script is a standard output script for these addresses.
 // If the script is something different, returns nil.
 @property(nonatomic, readonly) BTCAddress* standardAddress;
 
+// Returns 20-byte public key hash or script hash if the script is a standard P2PKH or P2SH output script.
+// If the script is something different, returns nil.
+@property(nonatomic, readonly) NSData* standardHash160;
+
 // Wraps the recipient into an output P2SH script (OP_HASH160 <20-byte hash of the recipient> OP_EQUAL).
 @property(nonatomic, readonly) BTCScript* scriptHashScript;
 
@@ -200,3 +222,26 @@ typedef NS_ENUM(NSInteger, BTCScriptSimulationOptions) {
 
 
 @end
+
+
+// Byte-level script templates.
+// These functions compare raw script bytes with exact templates without parsing the script,
+// so they can be used to scan all outputs in a block without allocating any objects.
+
+// Returns YES if the bytes are exactly OP_DUP OP_HASH160 <20-byte hash> OP_EQUALVERIFY OP_CHECKSIG.
+BOOL BTCScriptBytesIsPayToPublicKeyHash(const void* bytes, size_t length);
+
+// Returns YES if the bytes are exactly OP_HASH160 <20-byte hash> OP_EQUAL.
+BOOL BTCScriptBytesIsPayToScriptHash(const void* bytes, size_t length);
+
+// Returns YES if the bytes are <pubkey> OP_CHECKSIG.
+BOOL BTCScriptBytesIsPublicKey(const void* bytes, size_t length);
+
+// Returns a pointer to the 20-byte hash within P2PKH or P2SH script bytes or NULL for any other script.
+// If isScriptHashOut is not NULL, it is set to YES for P2SH and NO for P2PKH.
+const unsigned char* BTCScriptBytesHash160(const void* bytes, size_t length, BOOL* isScriptHashOut);
+
+// Counts signature operations in one pass over the script bytes by legacy and accurate rules.
+// See -[BTCScript sigOpCount] and -[BTCScript accurateSigOpCount]. Either pointer may be NULL.
+// Counting stops at the first truncated operation like in bitcoind.
+void BTCScriptBytesCountSigOps(const void* bytes, size_t length, NSUInteger* sigOpCountOut, NSUInteger* accurateSigOpCountOut);
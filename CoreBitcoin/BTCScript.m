@@ -3,6 +3,7 @@
 #import "BTCScript.h"
 #import "BTCAddress.h"
 #import "BTCBigNumber.h"
+#import "BTCCompiledScript.h"
 #import "BTCErrors.h"
 #import "BTCData.h"
 #import "BTCKey.h"
@@ -38,17 +39,142 @@
 
 
 @interface BTCScript ()
+
+// Parsed chunks of the script.
+- (NSMutableArray*) chunks;
+
 @end
 
+
+// Reads an operation at the offset and moves the offset to the next operation.
+// For pushdata operations returns the location and the length of the pushed data, for other opcodes the length is zero.
+// Returns NO if the operation is truncated.
+static BOOL BTCScriptReadOperation(const unsigned char* bytes, size_t length, size_t* offset, BTCOpcode* opcodeOut, size_t* dataOffsetOut, size_t* dataLengthOut) {
+    size_t i = *offset;
+    if (i >= length) return NO;
+    
+    BTCOpcode opcode = bytes[i++];
+    size_t dataLength = 0;
+    
+    if (opcode < OP_PUSHDATA1) {
+        dataLength = opcode;
+    } else if (opcode == OP_PUSHDATA1) {
+        if (length - i < 1) return NO;
+        dataLength = bytes[i];
+        i += 1;
+    } else if (opcode == OP_PUSHDATA2) {
+        if (length - i < 2) return NO;
+        dataLength = (size_t)bytes[i] | ((size_t)bytes[i + 1] << 8);
+        i += 2;
+    } else if (opcode == OP_PUSHDATA4) {
+        if (length - i < 4) return NO;
+        dataLength = (size_t)bytes[i] | ((size_t)bytes[i + 1] << 8) | ((size_t)bytes[i + 2] << 16) | ((size_t)bytes[i + 3] << 24);
+        i += 4;
+    }
+    
+    if (length - i < dataLength) return NO;
+    
+    if (opcodeOut) *opcodeOut = opcode;
+    if (dataOffsetOut) *dataOffsetOut = i;
+    if (dataLengthOut) *dataLengthOut = dataLength;
+    *offset = i + dataLength;
+    return YES;
+}
+
+// Returns YES if all operations in the script are complete.
+static BOOL BTCScriptBytesAreValid(const unsigned char* bytes, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        if (!BTCScriptReadOperation(bytes, length, &offset, NULL, NULL, NULL)) return NO;
+    }
+    return YES;
+}
+
+BOOL BTCScriptBytesIsPayToPublicKeyHash(const void* bytes, size_t length) {
+    const unsigned char* b = bytes;
+    return length == 25
+        && b[0] == OP_DUP
+        && b[1] == OP_HASH160
+        && b[2] == 20
+        && b[23] == OP_EQUALVERIFY
+        && b[24] == OP_CHECKSIG;
+}
+
+BOOL BTCScriptBytesIsPayToScriptHash(const void* bytes, size_t length) {
+    const unsigned char* b = bytes;
+    return length == 23
+        && b[0] == OP_HASH160
+        && b[1] == 20
+        && b[22] == OP_EQUAL;
+}
+
+BOOL BTCScriptBytesIsPublicKey(const void* bytes, size_t length) {
+    size_t offset = 0;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    size_t dataLength = 0;
+    if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, NULL, &dataLength)) return NO;
+    if (opcode > OP_PUSHDATA4 || dataLength <= 1) return NO;
+    return offset + 1 == length && ((const unsigned char*)bytes)[offset] == OP_CHECKSIG;
+}
+
+void BTCScriptBytesCountSigOps(const void* bytes, size_t length, NSUInteger* sigOpCountOut, NSUInteger* accurateSigOpCountOut) {
+    // Maximum number of public keys counted for OP_CHECKMULTISIG without a preceding OP_<N>.
+    static const NSUInteger maxPublicKeys = 20;
+    
+    NSUInteger sigOpCount = 0;
+    NSUInteger accurateSigOpCount = 0;
+    size_t offset = 0;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    BTCOpcode lastOpcode = OP_INVALIDOPCODE;
+    while (BTCScriptReadOperation(bytes, length, &offset, &opcode, NULL, NULL)) {
+        if (opcode == OP_CHECKSIG || opcode == OP_CHECKSIGVERIFY) {
+            sigOpCount++;
+            accurateSigOpCount++;
+        } else if (opcode == OP_CHECKMULTISIG || opcode == OP_CHECKMULTISIGVERIFY) {
+            sigOpCount += maxPublicKeys;
+            if (lastOpcode >= OP_1 && lastOpcode <= OP_16) {
+                accurateSigOpCount += BTCSmallIntegerFromOpcode(lastOpcode);
+            } else {
+                accurateSigOpCount += maxPublicKeys;
+            }
+        }
+        lastOpcode = opcode;
+    }
+    if (sigOpCountOut) *sigOpCountOut = sigOpCount;
+    if (accurateSigOpCountOut) *accurateSigOpCountOut = accurateSigOpCount;
+}
+
+const unsigned char* BTCScriptBytesHash160(const void* bytes, size_t length, BOOL* isScriptHashOut) {
+    if (BTCScriptBytesIsPayToPublicKeyHash(bytes, length)) {
+        if (isScriptHashOut) *isScriptHashOut = NO;
+        return (const unsigned char*)bytes + 3;
+    }
+    if (BTCScriptBytesIsPayToScriptHash(bytes, length)) {
+        if (isScriptHashOut) *isScriptHashOut = YES;
+        return (const unsigned char*)bytes + 2;
+    }
+    return NULL;
+}
+
 @implementation BTCScript {
-    // An array of NSData objects (pushing data) or NSNumber objects (containing opcodes)
+    // An array of BTCScriptChunk objects.
+    // Scripts initialized with binary data parse chunks lazily, only when they are needed.
     NSMutableArray* _chunks;
     
     // Cached serialized representations for -data and -string methods.
+    // When _chunks is nil, _data is always present.
     NSData* _data;
     
     NSString* _string;
     
+    // Cached compiled representation for -compiledScript.
+    BTCCompiledScript* _compiledScript;
+    
+    // Cached signature operations counts. Valid if _sigOpsCounted is YES.
+    BOOL _sigOpsCounted;
+    NSUInteger _sigOpCount;
+    NSUInteger _accurateSigOpCount;
+    
     // Multisignature script attributes.
     // If multisig script is not detected, both are NULL.
     NSUInteger _multisigSignaturesRequired;
@@ -66,9 +192,9 @@
     if (self = [super init]) {
         // It's important to keep around original data to correctly identify the size of the script for BTC_MAX_SCRIPT_SIZE check
         // and to correctly calculate hash for the signature because in BitcoinQT scripts are not re-serialized/canonicalized.
-        _data = data ?: [NSData data];
-        _chunks = [self parseData:_data];
-        if (!_chunks) return nil;
+        // Chunks are parsed on demand, here we only check that the script can be parsed.
+        _data = [data copy] ?: [NSData data];
+        if (!BTCScriptBytesAreValid(_data.bytes, _data.length)) return nil;
     }
     return self;
 }
@@ -172,15 +298,17 @@
 }
 
 - (NSData*) data {
-    if (!_data) {
-        // When we calculate data from scratch, it's important to respect actual offsets in the chunks as they may have been copied or shifted in subScript* methods.
-        NSMutableData* md = [NSMutableData data];
-        for (BTCScriptChunk* chunk in _chunks) {
-            [md appendData:chunk.chunkData];
+    @synchronized(self) {
+        if (!_data) {
+            // When we calculate data from scratch, it's important to respect actual offsets in the chunks as they may have been copied or shifted in subScript* methods.
+            NSMutableData* md = [NSMutableData data];
+            for (BTCScriptChunk* chunk in _chunks) {
+                [md appendData:chunk.chunkData];
+            }
+            _data = md;
         }
-        _data = md;
+        return _data;
     }
-    return _data;
 }
 
 - (NSString*) hex {
@@ -188,16 +316,29 @@
 }
 
 - (NSString*) string {
-    if (!_string) {
-        NSMutableArray* buffer = [NSMutableArray array];
-        
-        for (BTCScriptChunk* chunk in _chunks) {
-            [buffer addObject:[chunk string]];
+    @synchronized(self) {
+        if (!_string) {
+            NSMutableArray* buffer = [NSMutableArray array];
+            
+            for (BTCScriptChunk* chunk in self.chunks) {
+                [buffer addObject:[chunk string]];
+            }
+            
+            _string = [buffer componentsJoinedByString:@" "];
         }
-        
-        _string = [buffer componentsJoinedByString:@" "];
+        return _string;
+    }
+}
+
+// Returns parsed chunks. Binary data is parsed on first access.
+- (NSMutableArray*) chunks {
+    @synchronized(self) {
+        if (!_chunks) {
+            // Data was validated when the script was initialized, so parsing cannot fail here.
+            _chunks = [self parseData:_data];
+        }
+        return _chunks;
     }
-    return _string;
 }
 
 - (NSMutableArray*) parseData:(NSData*)data {
@@ -436,9 +577,8 @@
 }
 
 - (BOOL) isPublicKeyScript {
-    if (_chunks.count != 2) return NO;
-    return [self pushdataAtIndex:0].length > 1
-        && [self opcodeAtIndex:1] == OP_CHECKSIG;
+    NSData* data = self.data;
+    return BTCScriptBytesIsPublicKey(data.bytes, data.length);
 }
 
 - (BOOL) isHash160Script {
@@ -446,37 +586,21 @@
 }
 
 - (BOOL) isPayToPublicKeyHashScript {
-    if (_chunks.count != 5) return NO;
-    
-    BTCScriptChunk* dataChunk = [self chunkAtIndex:2];
-    
-    return [self opcodeAtIndex:0] == OP_DUP
-        && [self opcodeAtIndex:1] == OP_HASH160
-        && !dataChunk.isOpcode
-        && dataChunk.range.length == 21
-        && [self opcodeAtIndex:3] == OP_EQUALVERIFY
-        && [self opcodeAtIndex:4] == OP_CHECKSIG;
+    NSData* data = self.data;
+    return BTCScriptBytesIsPayToPublicKeyHash(data.bytes, data.length);
 }
 
 - (BOOL) isPayToScriptHashScript {
-    // TODO: check against the original serialized form instead of parsed chunks because BIP16 defines
-    // P2SH script as an exact byte template. Scripts using OP_PUSHDATA1/2/4 are not valid P2SH scripts.
-    // To do that we have to maintain original script binary data and each chunk should keep a range in that data.
-    
-    if (_chunks.count != 3) return NO;
-    
-    BTCScriptChunk* dataChunk = [self chunkAtIndex:1];
-    
-    return [self opcodeAtIndex:0] == OP_HASH160
-        && !dataChunk.isOpcode
-        && dataChunk.range.length == 21          // this is enough to match the exact byte template, any other encoding will be larger.
-        && [self opcodeAtIndex:2] == OP_EQUAL;
+    // BIP16 defines P2SH script as an exact byte template.
+    // Scripts using OP_PUSHDATA1/2/4 are not valid P2SH scripts.
+    NSData* data = self.data;
+    return BTCScriptBytesIsPayToScriptHash(data.bytes, data.length);
 }
 
 // Returns YES if the script ends with P2SH check.
 // Not used in CoreBitcoin. Similar code is used in bitcoin-ruby. I don't know if we'll ever need it.
 - (BOOL) endsWithPayToScriptHash {
-    if (_chunks.count < 3) return NO;
+    if (self.chunks.count < 3) return NO;
     
     return [self opcodeAtIndex:-3] == OP_HASH160
         && [self pushdataAtIndex:-2].length == 20
@@ -484,44 +608,57 @@
 }
 
 - (BOOL) isStandardMultisignatureScript {
-    if (![self isMultisignatureScript]) return NO;
-    return _multisigPublicKeys.count <= 3;
+    @synchronized(self) {
+        if (![self isMultisignatureScript]) return NO;
+        return _multisigPublicKeys.count <= 3;
+    }
 }
 
 - (BOOL) isMultisignatureScript {
-    if (_multisigSignaturesRequired == 0) {
-         [self detectMultisigScript];
+    @synchronized(self) {
+        if (_multisigSignaturesRequired == 0) {
+            [self detectMultisigScript];
+        }
+        return _multisigSignaturesRequired > 0;
     }
-    return _multisigSignaturesRequired > 0;
 }
 
 // If typical multisig tx is detected, sets two ivars:
 // _multisigSignaturesRequired, _multisigPublicKeys.
+// Works on the binary data directly, so chunks are not parsed.
 - (void) detectMultisigScript {
+    NSData* data = self.data;
+    const unsigned char* bytes = data.bytes;
+    size_t length = data.length;
+    
     // multisig script must have at least 4 ops ("OP_1 <pubkey> OP_1 OP_CHECKMULTISIG")
-    if (_chunks.count < 4) return;
+    // and the last op is multisig check.
+    if (length < 4 || bytes[length - 1] != OP_CHECKMULTISIG) return;
     
-    // The last op is multisig check.
-    if ([self opcodeAtIndex:-1] != OP_CHECKMULTISIG) return;
+    size_t offset = 0;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    size_t dataOffset = 0;
+    size_t dataLength = 0;
     
-    BTCOpcode m_opcode = [self opcodeAtIndex:0];
-    BTCOpcode n_opcode = [self opcodeAtIndex:-2];
+    if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, NULL, NULL)) return;
     
-    NSInteger m = BTCSmallIntegerFromOpcode(m_opcode);
-    NSInteger n = BTCSmallIntegerFromOpcode(n_opcode);
+    NSInteger m = BTCSmallIntegerFromOpcode(opcode);
     if (m <= 0 || m == NSIntegerMax) return;
-    if (n <= 0 || n == NSIntegerMax || n < m) return;
-    
-    // We must have correct number of pubkeys in the script. 3 extra ops: OP_<M>, OP_<N> and OP_CHECKMULTISIG
-    if (_chunks.count != (3 + n)) return;
     
+    // Collect pubkeys until the first non-pushdata opcode which should be OP_<N>.
     NSMutableArray* list = [NSMutableArray array];
-    for (int i = 1; i <= n; i++) {
-        NSData* data = [self pushdataAtIndex:i];
-        if (!data) return;
-        [list addObject:data];
+    while (YES) {
+        if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, &dataOffset, &dataLength)) return;
+        if (opcode > OP_PUSHDATA4) break;
+        [list addObject:[data subdataWithRange:NSMakeRange(dataOffset, dataLength)]];
     }
     
+    NSInteger n = BTCSmallIntegerFromOpcode(opcode);
+    if (n <= 0 || n == NSIntegerMax || n < m) return;
+    
+    // We must have correct number of pubkeys in the script followed only by OP_CHECKMULTISIG.
+    if (list.count != n || offset != length - 1) return;
+    
     // Now we extracted all pubkeys and verified the numbers.
     _multisigSignaturesRequired = m;
     _multisigPublicKeys = list;
@@ -529,8 +666,14 @@
 
 - (BOOL) isDataOnly {
     // Include both PUSHDATA ops and OP_0..OP_16 literals.
-    for (BTCScriptChunk* chunk in _chunks) {
-        if (chunk.opcode > OP_16) {
+    NSData* data = self.data;
+    const unsigned char* bytes = data.bytes;
+    size_t length = data.length;
+    size_t offset = 0;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    while (offset < length) {
+        if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, NULL, NULL)) return NO;
+        if (opcode > OP_16) {
             return NO;
         }
     }
@@ -538,49 +681,140 @@
 }
 
 - (NSArray*) scriptChunks {
-    return [_chunks copy];
+    return [self.chunks copy];
 }
 
 - (void) enumerateOperations:(void(^)(NSUInteger opIndex, BTCOpcode opcode, NSData* pushdata, BOOL* stop))block {
     if (!block) return;
     
+    NSData* data = self.data;
+    const unsigned char* bytes = data.bytes;
+    size_t length = data.length;
+    size_t offset = 0;
+    
     NSUInteger opIndex = 0;
-    for (BTCScriptChunk* chunk in _chunks) {
-        if (chunk.isOpcode) {
-            BTCOpcode opcode = chunk.opcode;
-            BOOL stop = NO;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    size_t dataOffset = 0;
+    size_t dataLength = 0;
+    while (BTCScriptReadOperation(bytes, length, &offset, &opcode, &dataOffset, &dataLength)) {
+        BOOL stop = NO;
+        if (opcode > OP_PUSHDATA4) {
             block(opIndex, opcode, nil, &stop);
-            if (stop) return;
         } else {
-            NSData* data = chunk.pushdata;
-            BOOL stop = NO;
-            block(opIndex, OP_INVALIDOPCODE, data, &stop);
-            if (stop) return;
+            block(opIndex, OP_INVALIDOPCODE, [data subdataWithRange:NSMakeRange(dataOffset, dataLength)], &stop);
         }
+        if (stop) return;
         opIndex++;
     }
 }
 
 
-- (BTCAddress*) standardAddress {
-    if ([self isPayToPublicKeyHashScript]) {
-        if (_chunks.count != 5) return nil;
-        
-        BTCScriptChunk* dataChunk = [self chunkAtIndex:2];
+- (NSUInteger) sigOpCount {
+    @synchronized(self) {
+        [self countSigOps];
+        return _sigOpCount;
+    }
+}
+
+- (NSUInteger) accurateSigOpCount {
+    @synchronized(self) {
+        [self countSigOps];
+        return _accurateSigOpCount;
+    }
+}
+
+- (void) countSigOps {
+    if (_sigOpsCounted) return;
+    NSData* data = self.data;
+    BTCScriptBytesCountSigOps(data.bytes, data.length, &_sigOpCount, &_accurateSigOpCount);
+    _sigOpsCounted = YES;
+}
+
+- (NSUInteger) sigOpCountWithSignatureScript:(BTCScript*)signatureScript {
+    if (![self isPayToScriptHashScript]) return self.accurateSigOpCount;
+    
+    // Find the redeem script which is the last item pushed by the signature script.
+    NSData* data = signatureScript.data;
+    const unsigned char* bytes = data.bytes;
+    size_t length = data.length;
+    size_t offset = 0;
+    size_t dataOffset = 0;
+    size_t dataLength = 0;
+    BTCOpcode opcode = OP_INVALIDOPCODE;
+    while (offset < length) {
+        if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, &dataOffset, &dataLength)) return 0;
+        if (opcode > OP_16) return 0;
         
-        if (!dataChunk.isOpcode && dataChunk.range.length == 21) {
-            return [BTCPublicKeyAddress addressWithData:dataChunk.pushdata];
+        // OP_<N> pushes no data we can interpret as a script.
+        if (opcode > OP_PUSHDATA4) dataLength = 0;
+    }
+    
+    NSUInteger accurateSigOpCount = 0;
+    BTCScriptBytesCountSigOps(bytes + dataOffset, dataLength, NULL, &accurateSigOpCount);
+    return accurateSigOpCount;
+}
+
+- (BTCCompiledScript*) compiledScript {
+    @synchronized(self) {
+        if (!_compiledScript) {
+            _compiledScript = [self compile];
         }
-    } else if ([self isPayToScriptHashScript]) {
-        if (_chunks.count != 3) return nil;
+        return _compiledScript;
+    }
+}
+
+- (BTCCompiledScript*) compile {
+    NSData* data = self.data;
+    const unsigned char* bytes = data.bytes;
+    size_t length = data.length;
+    
+    // Every operation takes at least one byte.
+    BTCScriptInstruction* instructions = malloc(MAX(length, 1) * sizeof(BTCScriptInstruction));
+    NSUInteger count = 0;
+    size_t offset = 0;
+    while (offset < length) {
+        BTCScriptInstruction* instruction = &instructions[count];
+        BTCOpcode opcode = OP_INVALIDOPCODE;
+        size_t dataOffset = 0;
+        size_t dataLength = 0;
+        
+        memset(instruction, 0, sizeof(*instruction));
+        instruction->offset = (uint32_t)offset;
         
-        BTCScriptChunk* dataChunk = [self chunkAtIndex:1];
+        if (!BTCScriptReadOperation(bytes, length, &offset, &opcode, &dataOffset, &dataLength)) break;
         
-        if (!dataChunk.isOpcode && dataChunk.range.length == 21) {
-            return [BTCScriptHashAddress addressWithData:dataChunk.pushdata];
+        instruction->opcode = opcode;
+        if (opcode <= OP_PUSHDATA4) {
+            instruction->dataOffset = (uint32_t)dataOffset;
+            instruction->dataLength = (uint32_t)dataLength;
         }
+        count++;
     }
-    return nil;
+    
+    BTCCompiledScript* compiledScript = [[BTCCompiledScript alloc] initWithData:data instructions:instructions count:count];
+    free(instructions);
+    return compiledScript;
+}
+
+
+- (NSData*) standardHash160 {
+    NSData* data = self.data;
+    const unsigned char* hash = BTCScriptBytesHash160(data.bytes, data.length, NULL);
+    if (!hash) return nil;
+    return [NSData dataWithBytes:hash length:20];
+}
+
+- (BTCAddress*) standardAddress {
+    NSData* data = self.data;
+    BOOL isScriptHash = NO;
+    const unsigned char* hash = BTCScriptBytesHash160(data.bytes, data.length, &isScriptHash);
+    if (!hash) return nil;
+    
+    NSData* hashData = [NSData dataWithBytes:hash length:20];
+    if (isScriptHash) {
+        return [BTCScriptHashAddress addressWithData:hashData];
+    }
+    return [BTCPublicKeyAddress addressWithData:hashData];
 }
 
 
@@ -711,6 +945,8 @@
 - (void) invalidateSerialization {
     _data = nil;
     _string = nil;
+    _compiledScript = nil;
+    _sigOpsCounted = NO;
     _multisigSignaturesRequired = 0;
     _multisigPublicKeys = nil;
 }
@@ -723,7 +959,7 @@
     BTCScriptChunk* chunk = [[BTCScriptChunk alloc] init];
     chunk.scriptData = scriptData;
     chunk.range = NSMakeRange(scriptData.length - sizeof(opcode), sizeof(opcode));
-    [_chunks addObject:chunk];
+    [self.chunks addObject:chunk];
     
     // Update reference to a new data for all chunks.
     for (BTCScriptChunk* chunk in _chunks) chunk.scriptData = scriptData;
@@ -744,7 +980,7 @@
     BTCScriptChunk* chunk = [[BTCScriptChunk alloc] init];
     chunk.scriptData = scriptData;
     chunk.range = NSMakeRange(scriptData.length - addedScriptData.length, addedScriptData.length);
-    [_chunks addObject:chunk];
+    [self.chunks addObject:chunk];
     
     // Update reference to a new data for all chunks.
     for (BTCScriptChunk* chunk in _chunks) chunk.scriptData = scriptData;
@@ -763,11 +999,12 @@
     
     [scriptData appendData:otherScript.data];
     
-    for (BTCScriptChunk* chunk in otherScript->_chunks) {
+    NSMutableArray* chunks = self.chunks;
+    for (BTCScriptChunk* chunk in otherScript.chunks) {
         BTCScriptChunk* chunk2 = [[BTCScriptChunk alloc] init];
         chunk2.range = NSMakeRange(chunk.range.location + offset, chunk.range.length);
         chunk2.scriptData = scriptData;
-        [_chunks addObject:chunk2];
+        [chunks addObject:chunk2];
     }
 
     // Update reference to a new data for all chunks.
@@ -783,13 +1020,15 @@
     
     NSMutableData* md = [NSMutableData data];
     
-    for (BTCScriptChunk* chunk in _chunks) {
+    for (BTCScriptChunk* chunk in self.chunks) {
         if (![chunk.pushdata isEqual:data]) {
             [md appendData:chunk.chunkData];
         }
     }
     
-    _chunks = [self parseData:md];
+    [self invalidateSerialization];
+    _chunks = nil;
+    _data = md;
 
     return self;
 }
@@ -797,13 +1036,15 @@
 - (BTCScript*) deleteOccurrencesOfOpcode:(BTCOpcode)opcode {
     NSMutableData* md = [NSMutableData data];
     
-    for (BTCScriptChunk* chunk in _chunks) {
+    for (BTCScriptChunk* chunk in self.chunks) {
         if (chunk.opcode != opcode) {
             [md appendData:chunk.chunkData];
         }
     }
     
-    _chunks = [self parseData:md];
+    [self invalidateSerialization];
+    _chunks = nil;
+    _data = md;
 
     return self;
 }
@@ -811,19 +1052,27 @@
 
 
 - (BTCScript*) subScriptFromIndex:(NSUInteger)index {
-    NSMutableData* md = [NSMutableData data];
-    for (BTCScriptChunk* chunk in [_chunks subarrayWithRange:NSMakeRange(index, _chunks.count - index)]) {
-        [md appendData:chunk.chunkData];
-    }
-    return [[BTCScript alloc] initWithData:md];
+    NSData* data = self.data;
+    NSUInteger offset = [self offsetOfOperationAtIndex:index];
+    return [[BTCScript alloc] initWithData:[data subdataWithRange:NSMakeRange(offset, data.length - offset)]];
 }
 
 - (BTCScript*) subScriptToIndex:(NSUInteger)index {
-    NSMutableData* md = [NSMutableData data];
-    for (BTCScriptChunk* chunk in [_chunks subarrayWithRange:NSMakeRange(0, index)]) {
-        [md appendData:chunk.chunkData];
+    NSUInteger offset = [self offsetOfOperationAtIndex:index];
+    return [[BTCScript alloc] initWithData:[self.data subdataWithRange:NSMakeRange(0, offset)]];
+}
+
+// Returns the offset of the operation in binary data or the data length if index is equal to the number of operations.
+// Raises an exception if index is out of bounds.
+- (NSUInteger) offsetOfOperationAtIndex:(NSUInteger)index {
+    NSData* data = self.data;
+    size_t offset = 0;
+    for (NSUInteger i = 0; i < index; i++) {
+        if (!BTCScriptReadOperation(data.bytes, data.length, &offset, NULL, NULL, NULL)) {
+            [NSException raise:NSRangeException format:@"Operation index %@ is out of bounds.", @(index)];
+        }
     }
-    return [[BTCScript alloc] initWithData:md];
+    return offset;
 }
 
 
@@ -842,7 +1091,8 @@
 
 
 - (BTCScriptChunk*) chunkAtIndex:(NSInteger)index {
-    BTCScriptChunk* chunk = _chunks[index < 0 ? (_chunks.count + index) : index];
+    NSArray* chunks = self.chunks;
+    BTCScriptChunk* chunk = chunks[index < 0 ? (chunks.count + index) : index];
     return chunk;
 }
 
@@ -850,7 +1100,7 @@
 // If the chunk is data, not an opcode, returns OP_INVALIDOPCODE
 // Raises exception if index is out of bounds.
 - (BTCOpcode) opcodeAtIndex:(NSInteger)index {
-    BTCScriptChunk* chunk = _chunks[index < 0 ? (_chunks.count + index) : index];
+    BTCScriptChunk* chunk = [self chunkAtIndex:index];
     
     if (chunk.isOpcode) return chunk.opcode;
     
@@ -862,7 +1112,7 @@
 // If chunk is actually an opcode, returns nil.
 // Raises exception if index is out of bounds.
 - (NSData*) pushdataAtIndex:(NSInteger)index {
-    BTCScriptChunk* chunk = _chunks[index < 0 ? (_chunks.count + index) : index];
+    BTCScriptChunk* chunk = [self chunkAtIndex:index];
     
     if (chunk.isOpcode) return nil;
     
@@ -1068,75 +1318,13 @@
 }
 
 + (BTCScriptChunk*) parseChunkFromData:(NSData*)scriptData offset:(NSUInteger)offset {
-    // Data should fit at least one opcode.
-    if (scriptData.length < (offset + 1)) return nil;
+    size_t end = offset;
+    if (!BTCScriptReadOperation(scriptData.bytes, scriptData.length, &end, NULL, NULL, NULL)) return nil;
     
-    const uint8_t* bytes = ((const uint8_t*)[scriptData bytes]);
-    BTCOpcode opcode = bytes[offset];
-    
-    if (opcode <= OP_PUSHDATA4) {
-        // push data opcode
-        int length = (int)scriptData.length;
-
-        BTCScriptChunk* chunk = [[BTCScriptChunk alloc] init];
-        chunk.scriptData = scriptData;
-        
-        if (opcode < OP_PUSHDATA1) {
-            uint8_t dataLength = opcode;
-            NSUInteger chunkLength = sizeof(opcode) + dataLength;
-            
-            if (offset + chunkLength > length) return nil;
-            
-            chunk.range = NSMakeRange(offset, chunkLength);
-        } else if (opcode == OP_PUSHDATA1) {
-            uint8_t dataLength;
-            
-            if (offset + sizeof(dataLength) > length) return nil;
-            
-            memcpy(&dataLength, bytes + offset + sizeof(opcode), sizeof(dataLength));
-
-            NSUInteger chunkLength = sizeof(opcode) + sizeof(dataLength) + dataLength;
-            
-            if (offset + chunkLength > length) return nil;
-            
-            chunk.range = NSMakeRange(offset, chunkLength);
-        } else if (opcode == OP_PUSHDATA2) {
-            uint16_t dataLength;
-            
-            if (offset + sizeof(dataLength) > length) return nil;
-            
-            memcpy(&dataLength, bytes + offset + sizeof(opcode), sizeof(dataLength));
-            dataLength = CFSwapInt16LittleToHost(dataLength);
-            
-            NSUInteger chunkLength = sizeof(opcode) + sizeof(dataLength) + dataLength;
-            
-            if (offset + chunkLength > length) return nil;
-            
-            chunk.range = NSMakeRange(offset, chunkLength);
-        } else if (opcode == OP_PUSHDATA4) {
-            uint32_t dataLength;
-            
-            if (offset + sizeof(dataLength) > length) return nil;
-            
-            memcpy(&dataLength, bytes + offset + sizeof(opcode), sizeof(dataLength));
-            dataLength = CFSwapInt16LittleToHost(dataLength);
-            
-            NSUInteger chunkLength = sizeof(opcode) + sizeof(dataLength) + dataLength;
-            
-            if (offset + chunkLength > length) return nil;
-            
-            chunk.range = NSMakeRange(offset, chunkLength);
-        }
-        
-        return chunk;
-    } else {
-        // simple opcode
-        BTCScriptChunk* chunk = [[BTCScriptChunk alloc] init];
-        chunk.scriptData = scriptData;
-        chunk.range = NSMakeRange(offset, sizeof(opcode));
-        return chunk;
-    }
-    return nil;
+    BTCScriptChunk* chunk = [[BTCScriptChunk alloc] init];
+    chunk.scriptData = scriptData;
+    chunk.range = NSMakeRange(offset, end - offset);
+    return chunk;
 }
 
 
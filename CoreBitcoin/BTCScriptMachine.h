@@ -1,14 +1,28 @@
 // CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
 
 #import <Foundation/Foundation.h>
+#import "BTCOpcode.h"
+
+// Change to 0 to compile out tracing and profiling hooks from the interpreter loop.
+#define BTCScriptMachineInstrumentationEnabled 1
 
 typedef NS_ENUM(NSUInteger, BTCScriptVerification) {
     BTCScriptVerificationStrictEncoding = (1U << 1), // enforce strict conformance to DER and SEC2 for signatures and pubkeys (aka SCRIPT_VERIFY_STRICTENC)
     BTCScriptVerificationEvenS          = (1U << 2), // enforce lower S values (below curve halforder) in signatures (aka SCRIPT_VERIFY_EVEN_S, depends on STRICTENC)
+    BTCScriptVerificationMinimalData    = (1U << 3), // require numeric operands to be minimally encoded (aka SCRIPT_VERIFY_MINIMALDATA for numbers)
 };
 
 @class BTCScript;
 @class BTCTransaction;
+@class BTCSignatureCache;
+@class BTCScriptProfile;
+@class BTCScriptMachine;
+
+// Called before every executed operation. Operations in non-executed branches are not reported,
+// but OP_IF, OP_NOTIF, OP_ELSE and OP_ENDIF are always reported.
+// Opcode is the raw byte: for pushes it is the length byte or OP_PUSHDATA<1,2,4>.
+// stackDepth is the number of items on the main stack before the operation.
+typedef void(^BTCScriptMachineTraceHandler)(BTCScriptMachine* machine, NSUInteger opIndex, BTCOpcode opcode, NSUInteger stackDepth);
 
 // ScriptMachine is a stack machine (like Forth) that evaluates a predicate
 // returning a bool indicating valid or not. There are no loops.
@@ -38,6 +52,27 @@ typedef NS_ENUM(NSUInteger, BTCScriptVerification) {
 // So we try to create canonical purist transactions but have no problem accepting and working with non-canonical ones.
 @property(nonatomic) BTCScriptVerification verificationFlags;
 
+// Optional cache of valid signatures. Signatures found in the cache are not verified again.
+// Successfully verified signatures are added to the cache.
+// The same cache can be shared by many machines running on different threads. Default is nil.
+@property(nonatomic) BTCSignatureCache* signatureCache;
+
+// If YES, P2PKH, P2SH multisig and bare multisig scripts are verified by -verifyWithOutputScript:error: directly,
+// without running the generic interpreter. Scripts that do not match these templates exactly are interpreted as usual.
+// The result is always the same, this only affects performance. Default is YES.
+@property(nonatomic) BOOL standardTemplatesEnabled;
+
+// Optional handler to trace script execution. Default is nil.
+// Handler is called synchronously on the thread running the machine. It may inspect -stack and -altstack.
+// Ignored if BTCScriptMachineInstrumentationEnabled is 0.
+@property(nonatomic, copy) BTCScriptMachineTraceHandler traceHandler;
+
+// Optional profile collecting counts of executed opcodes and time spent checking signatures.
+// The same profile can be shared by many machines running on different threads. Default is nil.
+// Statistics are added to the profile when -runScript:error: or -verifyWithOutputScript:error: returns.
+// Ignored if BTCScriptMachineInstrumentationEnabled is 0.
+@property(nonatomic) BTCScriptProfile* profile;
+
 // Returns a copy of a stack in its current state. Mostly used for testing.
 @property(nonatomic, copy, readonly) NSArray* stack;
 
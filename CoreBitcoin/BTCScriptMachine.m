@@ -2,27 +2,248 @@
 
 #import "BTCScriptMachine.h"
 #import "BTCScript.h"
+#import "BTCCompiledScript.h"
 #import "BTCOpcode.h"
 #import "BTCTransaction.h"
 #import "BTCTransactionInput.h"
 #import "BTCTransactionOutput.h"
 #import "BTCKey.h"
-#import "BTCBigNumber.h"
+#import "BTCSignatureCache.h"
+#import "BTCScriptProfile.h"
 #import "BTCErrors.h"
 #import "BTCUnitsAndLimits.h"
 #import "BTCData.h"
+#import "BTCSHA256.h"
+#import "BTCRIPEMD160.h"
+#import <CommonCrypto/CommonCrypto.h>
+#if BTCScriptMachineInstrumentationEnabled
+#import <mach/mach_time.h>
+#endif
 
-@interface BTCScriptMachine ()
+// Stack items are stored back to back in one growable byte buffer and described by
+// an offset and length in that buffer. Pushing, duplicating, swapping and dropping items
+// only moves bytes and descriptors around and does not create any Objective-C objects.
+// Items are never shared: every descriptor owns its own range of bytes.
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} BTCScriptStackItem;
+
+typedef struct {
+    unsigned char* bytes;
+    size_t length;         // end of the last allocated range in `bytes`
+    size_t liveLength;     // sum of lengths of all items (length - liveLength is taken by holes)
+    size_t capacity;
+    BTCScriptStackItem* items;
+    NSUInteger count;
+    NSUInteger itemsCapacity;
+} BTCScriptStack;
+
+static void BTCScriptStackInit(BTCScriptStack* stack) {
+    stack->capacity = 1024;
+    stack->bytes = malloc(stack->capacity);
+    stack->length = 0;
+    stack->liveLength = 0;
+    stack->itemsCapacity = 32;
+    stack->items = malloc(stack->itemsCapacity * sizeof(BTCScriptStackItem));
+    stack->count = 0;
+}
+
+static void BTCScriptStackFree(BTCScriptStack* stack) {
+    free(stack->bytes);
+    free(stack->items);
+    memset(stack, 0, sizeof(*stack));
+}
+
+static inline void BTCScriptStackClear(BTCScriptStack* stack) {
+    stack->length = 0;
+    stack->liveLength = 0;
+    stack->count = 0;
+}
+
+static void BTCScriptStackReserveItems(BTCScriptStack* stack, NSUInteger count) {
+    if (count <= stack->itemsCapacity) return;
+    while (stack->itemsCapacity < count) stack->itemsCapacity *= 2;
+    stack->items = realloc(stack->items, stack->itemsCapacity * sizeof(BTCScriptStackItem));
+}
+
+// Makes room for `length` more bytes at the end of the buffer.
+// Holes left by items removed from the middle of the stack are squeezed out
+// only when the buffer would have to grow anyway.
+static void BTCScriptStackReserveBytes(BTCScriptStack* stack, size_t length) {
+    if (stack->length + length <= stack->capacity) return;
+    
+    size_t capacity = stack->capacity;
+    while (capacity < 2 * (stack->liveLength + length)) capacity *= 2;
+    
+    unsigned char* bytes = malloc(capacity);
+    size_t offset = 0;
+    for (NSUInteger i = 0; i < stack->count; i++) {
+        BTCScriptStackItem* item = stack->items + i;
+        memcpy(bytes + offset, stack->bytes + item->offset, item->length);
+        item->offset = (uint32_t)offset;
+        offset += item->length;
+    }
+    free(stack->bytes);
+    stack->bytes = bytes;
+    stack->capacity = capacity;
+    stack->length = offset;
+}
+
+// Copies items from the source stack without copying the holes between them.
+static void BTCScriptStackAssign(BTCScriptStack* stack, const BTCScriptStack* source) {
+    BTCScriptStackClear(stack);
+    BTCScriptStackReserveItems(stack, source->count);
+    BTCScriptStackReserveBytes(stack, source->liveLength);
+    for (NSUInteger i = 0; i < source->count; i++) {
+        const BTCScriptStackItem* item = source->items + i;
+        memcpy(stack->bytes + stack->length, source->bytes + item->offset, item->length);
+        stack->items[i].offset = (uint32_t)stack->length;
+        stack->items[i].length = item->length;
+        stack->length += item->length;
+    }
+    stack->liveLength = stack->length;
+    stack->count = source->count;
+}
+
+static inline const unsigned char* BTCScriptStackItemBytes(const BTCScriptStack* stack, NSUInteger index) {
+    return stack->bytes + stack->items[index].offset;
+}
+
+static inline size_t BTCScriptStackItemLength(const BTCScriptStack* stack, NSUInteger index) {
+    return stack->items[index].length;
+}
+
+// `bytes` must not point inside the stack's own buffer. Use BTCScriptStackPushCopy to duplicate items.
+static void BTCScriptStackPush(BTCScriptStack* stack, const void* bytes, size_t length) {
+    BTCScriptStackReserveItems(stack, stack->count + 1);
+    BTCScriptStackReserveBytes(stack, length);
+    if (length > 0) memcpy(stack->bytes + stack->length, bytes, length);
+    stack->items[stack->count].offset = (uint32_t)stack->length;
+    stack->items[stack->count].length = (uint32_t)length;
+    stack->count++;
+    stack->length += length;
+    stack->liveLength += length;
+}
+
+static void BTCScriptStackPushCopy(BTCScriptStack* stack, NSUInteger index) {
+    size_t length = stack->items[index].length;
+    BTCScriptStackReserveItems(stack, stack->count + 1);
+    BTCScriptStackReserveBytes(stack, length); // may move items, so read the offset afterwards.
+    memcpy(stack->bytes + stack->length, stack->bytes + stack->items[index].offset, length);
+    stack->items[stack->count].offset = (uint32_t)stack->length;
+    stack->items[stack->count].length = (uint32_t)length;
+    stack->count++;
+    stack->length += length;
+    stack->liveLength += length;
+}
+
+static void BTCScriptStackRemove(BTCScriptStack* stack, NSUInteger index) {
+    BTCScriptStackItem item = stack->items[index];
+    memmove(stack->items + index, stack->items + index + 1, (stack->count - index - 1) * sizeof(BTCScriptStackItem));
+    stack->count--;
+    stack->liveLength -= item.length;
+    if (stack->count == 0) {
+        stack->length = 0;
+    } else if (item.offset + item.length == stack->length) {
+        stack->length = item.offset;
+    }
+}
+
+static inline void BTCScriptStackPop(BTCScriptStack* stack) {
+    BTCScriptStackRemove(stack, stack->count - 1);
+}
+
+static inline void BTCScriptStackSwap(BTCScriptStack* stack, NSUInteger index1, NSUInteger index2) {
+    BTCScriptStackItem item = stack->items[index1];
+    stack->items[index1] = stack->items[index2];
+    stack->items[index2] = item;
+}
+
+// Moves the item at `from` to position `to` shifting items in between.
+static void BTCScriptStackMove(BTCScriptStack* stack, NSUInteger from, NSUInteger to) {
+    if (from == to) return;
+    BTCScriptStackItem item = stack->items[from];
+    if (from < to) {
+        memmove(stack->items + from, stack->items + from + 1, (to - from) * sizeof(BTCScriptStackItem));
+    } else {
+        memmove(stack->items + to + 1, stack->items + to, (from - to) * sizeof(BTCScriptStackItem));
+    }
+    stack->items[to] = item;
+}
+
+
+// Script numbers (aka CScriptNum in Bitcoin Core) are signed little-endian integers
+// with a sign bit in the most significant bit of the last byte. Numeric opcodes accept operands
+// of at most 4 bytes, but may produce results up to 5 bytes long, so int64_t is enough for all of them.
+#define BTCScriptNumMaxSize 4
+
+// Largest encoding of int64_t: 8 bytes of magnitude and an extra byte for the sign bit.
+#define BTCScriptNumMaxEncodedSize 9
+
+// Returns NO if the number is longer than maxSize bytes or, when requireMinimal is YES, is not minimally encoded.
+static BOOL BTCScriptNumDecode(const unsigned char* bytes, size_t length, size_t maxSize, BOOL requireMinimal, int64_t* valueOut) {
+    if (length > maxSize) return NO;
+    
+    if (requireMinimal && length > 0) {
+        // The most significant byte may be zero (or 0x80 for negative numbers) only if
+        // the next byte has its high bit set and would otherwise be interpreted as a sign bit.
+        if ((bytes[length - 1] & 0x7f) == 0) {
+            if (length <= 1 || (bytes[length - 2] & 0x80) == 0) return NO;
+        }
+    }
+    
+    if (length == 0) {
+        *valueOut = 0;
+        return YES;
+    }
+    
+    uint64_t result = 0;
+    for (size_t i = 0; i < length; i++) {
+        result |= ((uint64_t)bytes[i]) << (8 * i);
+    }
+    
+    // If the input's most significant byte has the sign bit set, the result is negative.
+    if (bytes[length - 1] & 0x80) {
+        *valueOut = -((int64_t)(result & ~(0x80ULL << (8 * (length - 1)))));
+    } else {
+        *valueOut = (int64_t)result;
+    }
+    return YES;
+}
+
+// Writes minimal encoding of the value to the buffer of BTCScriptNumMaxEncodedSize bytes and returns its length.
+static size_t BTCScriptNumEncode(int64_t value, unsigned char* buffer) {
+    if (value == 0) return 0;
+    
+    BOOL negative = value < 0;
+    uint64_t absvalue = negative ? -((uint64_t)value) : (uint64_t)value;
+    size_t length = 0;
+    while (absvalue) {
+        buffer[length++] = absvalue & 0xff;
+        absvalue >>= 8;
+    }
+    
+    // If the most significant byte is >= 0x80 and the value is positive, push a new zero byte to make it positive.
+    // If the most significant byte is >= 0x80 and the value is negative, push 0x80 byte that will be popped off when converting to an integral.
+    // If the most significant byte is < 0x80 and the value is negative, add 0x80 to it, since it will be subtracted and interpreted as a negative when converting to an integral.
+    if (buffer[length - 1] & 0x80) {
+        buffer[length++] = negative ? 0x80 : 0x00;
+    } else if (negative) {
+        buffer[length - 1] |= 0x80;
+    }
+    return length;
+}
+
+
+// Compares Hash160 of the data with a 20-byte hash without allocating an intermediate NSData.
+static BOOL BTCScriptMachineHash160Equal(NSData* data, NSData* hash) {
+    if (hash.length != 20) return NO;
+    unsigned char digest[20];
+    BTCHash160Bytes(digest, data.bytes, data.length);
+    return memcmp(digest, hash.bytes, 20) == 0;
+}
 
-// Constants
-@property(nonatomic) NSData* blobFalse;
-@property(nonatomic) NSData* blobZero;
-@property(nonatomic) NSData* blobTrue;
-@property(nonatomic) BTCBigNumber* bigNumberZero;
-@property(nonatomic) BTCBigNumber* bigNumberOne;
-@property(nonatomic) BTCBigNumber* bigNumberFalse;
-@property(nonatomic) BTCBigNumber* bigNumberTrue;
-@end
 
 // We try to match BitcoinQT code as close as possible to avoid subtle incompatibilities.
 // The design might not look optimal to everyone, but I prefer to match the behaviour first, then document it well,
@@ -31,25 +252,36 @@
 // decision they make. Proper documentation and cross-references will help this guy a lot.
 @implementation BTCScriptMachine {
     
-    // Stack contains NSData objects that are interpreted as numbers, bignums, booleans or raw data when needed.
-    NSMutableArray* _stack;
+    // Stack contains byte strings that are interpreted as numbers, bignums, booleans or raw data when needed.
+    // Items are exposed as NSData only through the public API.
+    BTCScriptStack _stack;
     
     // Used in ALTSTACK ops.
-    NSMutableArray* _altStack;
+    BTCScriptStack _altStack;
+    
+    // Snapshot of the stack after running input script. Used to evaluate P2SH redeem scripts.
+    // Kept around between runs to reuse its buffers.
+    BTCScriptStack _p2shStack;
     
-    // Holds an array of @YES and @NO values to keep track of if/else branches.
-    NSMutableArray* _conditionStack;
+    // Keeps track of if/else branches. Like in Bitcoin Core, we don't store individual values:
+    // an opcode is executed only if there is no false value on the condition stack,
+    // so it is enough to know the depth and the position of the first false value (NSNotFound if none).
+    NSUInteger _conditionStackSize;
+    NSUInteger _conditionFirstFalsePosition;
     
     // Currently executed script.
-    BTCScript* _script;
+    BTCCompiledScript* _script;
     
-    // Current opcode.
-    BTCOpcode _opcode;
+    // Bytes of the current script referenced by the instructions.
+    const unsigned char* _scriptBytes;
+    
+    // Current instruction.
+    const BTCScriptInstruction* _instruction;
     
-    // Current payload for any "push data" operation.
-    NSData* _pushdata;
+    // Current opcode or OP_INVALIDOPCODE for any "push data" operation.
+    BTCOpcode _opcode;
     
-    // Current opcode index in _script.
+    // Current instruction index in _script.
     NSUInteger _opIndex;
     
     // Index of last OP_CODESEPARATOR
@@ -57,32 +289,63 @@
     
     // Keeps number of executed operations to check for limit.
     NSInteger _opCount;
+    
+    // Signature hashes and decoded public keys reused by signature checks within one verification.
+    // OP_CHECKMULTISIG tries every signature against several keys with the same subscript,
+    // so without these it would compute the same hash and decode the same points many times.
+    NSMutableDictionary* _signatureHashes; // hash type byte + subscript -> signature hash
+    NSMutableDictionary* _publicKeys;      // public key data -> BTCKey or NSNull if the key is invalid
+    
+#if BTCScriptMachineInstrumentationEnabled
+    // YES if traceHandler or profile is set. Checked once per instruction, so the loop stays tight without them.
+    BOOL _instrumented;
+    
+    // Statistics collected since the last flush to the profile.
+    uint32_t* _opcodeCounts; // 256 counters, allocated when the profile is used for the first time
+    uint64_t _scriptsCount;
+    uint64_t _signatureChecksCount;
+    uint64_t _signatureCheckTime;
+#endif
 }
 
 - (id) init {
     if (self = [super init]) {
-        // Constants used in script execution.
-        _blobFalse = [NSData data];
-        _blobZero = _blobFalse;
-        uint8_t one = 1;
-        _blobTrue = [NSData dataWithBytes:(void*)&one length:1];
-        
-        _bigNumberZero = [[BTCBigNumber alloc] initWithInt32:0];
-        _bigNumberOne = [[BTCBigNumber alloc] initWithInt32:1];
-        _bigNumberFalse = _bigNumberZero;
-        _bigNumberTrue = _bigNumberOne;
-
         _inputIndex = 0xFFFFFFFF;
+        _standardTemplatesEnabled = YES;
         _blockTimestamp = (uint32_t)[[NSDate date] timeIntervalSince1970];
+        
+        BTCScriptStackInit(&_stack);
+        BTCScriptStackInit(&_altStack);
+        BTCScriptStackInit(&_p2shStack);
         [self resetStack];
     }
     return self;
 }
 
+- (void) dealloc {
+    BTCScriptStackFree(&_stack);
+    BTCScriptStackFree(&_altStack);
+    BTCScriptStackFree(&_p2shStack);
+#if BTCScriptMachineInstrumentationEnabled
+    free(_opcodeCounts);
+#endif
+}
+
 - (void) resetStack {
-    _stack = [NSMutableArray array];
-    _altStack = [NSMutableArray array];
-    _conditionStack = [NSMutableArray array];
+    BTCScriptStackClear(&_stack);
+    BTCScriptStackClear(&_altStack);
+    [self resetConditionStack];
+}
+
+- (void) resetConditionStack {
+    _conditionStackSize = 0;
+    _conditionFirstFalsePosition = NSNotFound;
+}
+
+// Transaction or input index may change between verifications, so memoized values are dropped.
+- (void) resetSignatureMemo {
+    [_signatureHashes removeAllObjects];
+    [_publicKeys removeAllObjects];
 }
 
 - (id) initWithTransaction:(BTCTransaction*)tx inputIndex:(uint32_t)inputIndex {
@@ -104,7 +367,11 @@
     sm.inputIndex = self.inputIndex;
     sm.blockTimestamp = self.blockTimestamp;
     sm.verificationFlags = self.verificationFlags;
-    sm->_stack = [_stack mutableCopy];
+    sm.signatureCache = self.signatureCache;
+    sm.standardTemplatesEnabled = self.standardTemplatesEnabled;
+    sm.traceHandler = self.traceHandler;
+    sm.profile = self.profile;
+    BTCScriptStackAssign(&sm->_stack, &_stack);
     return sm;
 }
 
@@ -113,6 +380,14 @@
 }
 
 - (BOOL) verifyWithOutputScript:(BTCScript*)outputScript error:(NSError**)errorOut {
+    BOOL result = [self verifyScriptsWithOutputScript:outputScript error:errorOut];
+#if BTCScriptMachineInstrumentationEnabled
+    [self flushProfile];
+#endif
+    return result;
+}
+
+- (BOOL) verifyScriptsWithOutputScript:(BTCScript*)outputScript error:(NSError**)errorOut {
     // self.inputScript allows to override transaction so we can simply testing.
     BTCScript* inputScript = self.inputScript;
     
@@ -131,6 +406,14 @@
         inputScript = txInput.signatureScript;
     }
     
+    [self resetSignatureMemo];
+    
+    // Most scripts follow a few standard templates that can be checked without running the interpreter.
+    // If the template check does not succeed, we run the scripts to get the precise result and error.
+    if (_standardTemplatesEnabled && _stack.count == 0 && [self verifyStandardTemplateWithInputScript:inputScript outputScript:outputScript]) {
+        return YES;
+    }
+    
     // First step: run the input script which typically places signatures, pubkeys and other static data needed for outputScript.
     if (![self runScript:inputScript error:errorOut]) {
         // errorOut is set by runScript
@@ -140,7 +423,9 @@
     // Make a copy of the stack if we have P2SH script.
     // We will run deserialized P2SH script on this stack if other verifications succeed.
     BOOL shouldVerifyP2SH = [self shouldVerifyP2SH] && outputScript.isPayToScriptHashScript;
-    NSMutableArray* stackForP2SH = shouldVerifyP2SH ? [_stack mutableCopy] : nil;
+    if (shouldVerifyP2SH) {
+        BTCScriptStackAssign(&_p2shStack, &_stack);
+    }
     
     // Second step: run output script to see that the input satisfies all conditions laid in the output script.
     if (![self runScript:outputScript error:errorOut]) {
@@ -168,25 +453,36 @@
             return NO;
         }
         
-        if (stackForP2SH.count == 0) {
-            // stackForP2SH cannot be empty here, because if it was the
+        if (_p2shStack.count == 0) {
+            // P2SH stack cannot be empty here, because if it was the
             // P2SH  HASH <> EQUAL  scriptPubKey would be evaluated with
             // an empty stack and the runScript: above would return NO.
-            [NSException raise:@"BTCScriptMachineException"  format:@"internal inconsistency: stackForP2SH cannot be empty at this point."];
+            [NSException raise:@"BTCScriptMachineException"  format:@"internal inconsistency: P2SH stack cannot be empty at this point."];
             return NO;
         }
         
         // Instantiate the script from the last data on the stack.
-        BTCScript* providedScript = [[BTCScript alloc] initWithData:[stackForP2SH lastObject]];
+        NSUInteger lastIndex = _p2shStack.count - 1;
+        NSData* providedScriptData = [NSData dataWithBytes:BTCScriptStackItemBytes(&_p2shStack, lastIndex)
+                                                    length:BTCScriptStackItemLength(&_p2shStack, lastIndex)];
+        // The same redeem script is usually spent by many inputs, so it is compiled only once.
+        BTCCompiledScript* providedScript = [BTCCompiledScript compiledScriptWithData:providedScriptData];
+        if (!providedScript) {
+            if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"P2SH redeem script is not a valid script.", @"")];
+            return NO;
+        }
         
         // Remove it from the stack.
-        [stackForP2SH removeObjectAtIndex:stackForP2SH.count - 1];
+        BTCScriptStackPop(&_p2shStack);
         
         // Replace current stack with P2SH stack.
+        // Buffers are swapped rather than copied, so both remain available for the next run.
         [self resetStack];
-        _stack = stackForP2SH;
+        BTCScriptStack stack = _stack;
+        _stack = _p2shStack;
+        _p2shStack = stack;
         
-        if (![self runScript:providedScript error:errorOut]) {
+        if (![self runCompiledScript:providedScript error:errorOut]) {
             return NO;
         }
         
@@ -208,47 +504,199 @@
 }
 
 
+
+#pragma mark - Standard Templates
+
+
+// Verifies P2PKH, P2SH multisig and bare multisig scripts directly, without running the interpreter.
+// Returns YES only if the interpreter would succeed too, and leaves the stack in the same state as the interpreter would.
+// Returns NO if the scripts do not match a template exactly or the check fails. In this case the interpreter must be used
+// to produce the definitive result and an error.
+- (BOOL) verifyStandardTemplateWithInputScript:(BTCScript*)inputScript outputScript:(BTCScript*)outputScript {
+    if (inputScript.data.length > BTC_MAX_SCRIPT_SIZE || outputScript.data.length > BTC_MAX_SCRIPT_SIZE) return NO;
+    
+    NSArray* pushes = [self pushesInScript:inputScript];
+    if (!pushes) return NO;
+    
+    BOOL verified = NO;
+    if (outputScript.isPayToPublicKeyHashScript) {
+        verified = [self verifyPayToPublicKeyHashWithPushes:pushes outputScript:outputScript];
+    } else if (outputScript.isPayToScriptHashScript) {
+        verified = [self verifyPayToScriptHashWithPushes:pushes outputScript:outputScript];
+    } else if (outputScript.isMultisignatureScript) {
+        verified = [self verifyMultisignatureWithPushes:pushes script:[outputScript copy]];
+    }
+    
+    if (verified) {
+        // Each template leaves a single "true" item on the stack.
+        [self resetStack];
+        [self pushBool:YES];
+    }
+    return verified;
+}
+
+// Returns items pushed by the script or nil if the script contains anything but pushdata operations
+// or any pushed item would be rejected by the interpreter.
+- (NSArray*) pushesInScript:(BTCScript*)script {
+    NSArray* chunks = script.scriptChunks;
+    NSMutableArray* pushes = [NSMutableArray arrayWithCapacity:chunks.count];
+    for (BTCScriptChunk* chunk in chunks) {
+        NSData* pushdata = chunk.pushdata;
+        if (!pushdata || pushdata.length > BTC_MAX_SCRIPT_ELEMENT_SIZE) return nil;
+        [pushes addObject:pushdata];
+    }
+    return pushes;
+}
+
+// <sig> <pubkey> | OP_DUP OP_HASH160 <hash> OP_EQUALVERIFY OP_CHECKSIG
+- (BOOL) verifyPayToPublicKeyHashWithPushes:(NSArray*)pushes outputScript:(BTCScript*)outputScript {
+    if (pushes.count != 2) return NO;
+    
+    NSData* signature = pushes[0];
+    NSData* pubkeyData = pushes[1];
+    NSData* hash = outputScript.standardHash160;
+    
+    if (!BTCScriptMachineHash160Equal(pubkeyData, hash)) return NO;
+    
+    // OP_CHECKSIG would remove the signature from the subscript. Let the interpreter deal with this case.
+    if ([signature isEqual:hash]) return NO;
+    
+    // Signature hash computation modifies the subscript, so we should not pass the output script itself.
+    return [self verifySignature:signature publicKey:pubkeyData subscript:[outputScript copy] error:NULL];
+}
+
+// OP_0 <sig> ... <sig> <redeem script> | OP_HASH160 <hash> OP_EQUAL
+- (BOOL) verifyPayToScriptHashWithPushes:(NSArray*)pushes outputScript:(BTCScript*)outputScript {
+    if (![self shouldVerifyP2SH] || pushes.count < 1) return NO;
+    
+    NSData* redeemScriptData = pushes.lastObject;
+    if (!BTCScriptMachineHash160Equal(redeemScriptData, outputScript.standardHash160)) return NO;
+    
+    BTCScript* redeemScript = [[BTCScript alloc] initWithData:redeemScriptData];
+    if (!redeemScript.isMultisignatureScript) return NO;
+    
+    return [self verifyMultisignatureWithPushes:[pushes subarrayWithRange:NSMakeRange(0, pushes.count - 1)] script:redeemScript];
+}
+
+// OP_0 <sig> ... <sig> | <M> <pubkey> ... <pubkey> <N> OP_CHECKMULTISIG
+// The script is used as a subscript for signature hashes and may be modified.
+- (BOOL) verifyMultisignatureWithPushes:(NSArray*)pushes script:(BTCScript*)script {
+    NSArray* chunks = script.scriptChunks;
+    if (chunks.count < 4) return NO;
+    
+    NSInteger sigsCount = BTCSmallIntegerFromOpcode([chunks[0] opcode]);
+    NSInteger keysCount = BTCSmallIntegerFromOpcode([chunks[chunks.count - 2] opcode]);
+    if (sigsCount < 1 || keysCount < sigsCount || keysCount > BTC_MAX_KEYS_FOR_CHECKMULTISIG || chunks.count != keysCount + 3) return NO;
+    
+    // One extra dummy item is consumed by OP_CHECKMULTISIG.
+    // With more signatures than required, the interpreter would try different pairs, so we leave this case to it.
+    if (pushes.count != sigsCount + 1) return NO;
+    
+    NSMutableArray* pubkeys = [NSMutableArray arrayWithCapacity:keysCount];
+    for (NSInteger i = 1; i <= keysCount; i++) {
+        NSData* pubkey = [chunks[i] pushdata];
+        if (!pubkey || pubkey.length > BTC_MAX_SCRIPT_ELEMENT_SIZE) return NO;
+        [pubkeys addObject:pubkey];
+    }
+    
+    // OP_CHECKMULTISIG would remove signatures from the subscript. Let the interpreter deal with this case.
+    for (NSInteger i = 1; i <= sigsCount; i++) {
+        if ([pubkeys containsObject:pushes[i]]) return NO;
+    }
+    
+    // Match signatures and keys in the same order as OP_CHECKMULTISIG does: from the last ones to the first ones.
+    NSInteger isig = sigsCount;
+    NSInteger ikey = keysCount - 1;
+    while (sigsCount > 0) {
+        if ([self verifySignature:pushes[isig] publicKey:pubkeys[ikey] subscript:script error:NULL]) {
+            isig--;
+            sigsCount--;
+        }
+        ikey--;
+        keysCount--;
+        
+        // If there are more signatures left than keys left, then too many signatures have failed.
+        if (sigsCount > keysCount) return NO;
+    }
+    return YES;
+}
+
+
+
+
 - (BOOL) runScript:(BTCScript*)script error:(NSError**)errorOut {
     if (!script) {
         [NSException raise:@"BTCScriptMachineException"  format:@"non-nil script is required for -runScript:error: method."];
         return NO;
     }
-    
+    [self resetSignatureMemo];
+    BOOL result = [self runCompiledScript:script.compiledScript error:errorOut];
+#if BTCScriptMachineInstrumentationEnabled
+    [self flushProfile];
+#endif
+    return result;
+}
+
+- (BOOL) runCompiledScript:(BTCCompiledScript*)script error:(NSError**)errorOut {
     if (script.data.length > BTC_MAX_SCRIPT_SIZE) {
         if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Script binary is too long.", @"")];
         return NO;
     }
     
     // Altstack should be reset between script runs.
-    _altStack = [NSMutableArray array];
+    BTCScriptStackClear(&_altStack);
+    [self resetConditionStack];
     
     _script = script;
+    _scriptBytes = script.data.bytes;
     _opIndex = 0;
     _opcode = 0;
-    _pushdata = nil;
     _lastCodeSeparatorIndex = 0;
     _opCount = 0;
     
-    __block BOOL opFailed = NO;
-    [script enumerateOperations:^(NSUInteger opIndex, BTCOpcode opcode, NSData *pushdata, BOOL *stop) {
+#if BTCScriptMachineInstrumentationEnabled
+    _instrumented = (_traceHandler || _profile);
+    if (_profile) {
+        if (!_opcodeCounts) _opcodeCounts = calloc(256, sizeof(uint32_t));
+        _scriptsCount++;
+    }
+#endif
+    
+    const BTCScriptInstruction* instructions = script.instructions;
+    NSUInteger count = script.instructionsCount;
+    NSUInteger i = 0;
+    
+    while (i < count) {
+        const BTCScriptInstruction* instruction = &instructions[i];
+        
+        _opIndex = i;
+        _instruction = instruction;
+        _opcode = (instruction->opcode <= OP_PUSHDATA4) ? OP_INVALIDOPCODE : instruction->opcode;
         
-        _opIndex = opIndex;
-        _opcode = opcode;
-        _pushdata = pushdata;
+#if BTCScriptMachineInstrumentationEnabled
+        if (__builtin_expect(_instrumented, 0)) [self traceInstruction:instruction];
+#endif
         
-        if (![self executeOpcodeError:errorOut])
-        {
-            opFailed = YES;
-            *stop = YES;
+        if (![self executeOpcodeError:errorOut]) {
+            // Error is already set by executeOpcode, return immediately.
+            return NO;
+        }
+        
+        i++;
+        
+        // If OP_IF, OP_NOTIF or OP_ELSE has started a non-executed branch, jump right to its end.
+        // Skipped instructions would only be counted towards the operations limit.
+        if (_conditionFirstFalsePosition != NSNotFound && instruction->branchTarget != BTCScriptInstructionNoTarget) {
+            _opCount += instruction->branchOpCount;
+            if (_opCount > BTC_MAX_OPS_PER_SCRIPT) {
+                if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Exceeded the allowed number of operations per script.", @"")];
+                return NO;
+            }
+            i = instruction->branchTarget;
         }
-    }];
-    
-    if (opFailed) {
-        // Error is already set by executeOpcode, return immediately.
-        return NO;
     }
     
-    if (_conditionStack.count > 0) {
+    if (_conditionStackSize > 0) {
         if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Condition branches not balanced.", @"")];
         return NO;
     }
@@ -256,47 +704,56 @@
     return YES;
 }
 
+#if BTCScriptMachineInstrumentationEnabled
+// Reports the instruction to the trace handler and counts it in the profile, unless it is in a non-executed branch.
+- (void) traceInstruction:(const BTCScriptInstruction*)instruction {
+    BTCOpcode opcode = instruction->opcode;
+    BOOL executed = (_conditionFirstFalsePosition == NSNotFound) || (opcode >= OP_IF && opcode <= OP_ENDIF);
+    if (!executed) return;
+    
+    if (_opcodeCounts && _profile) _opcodeCounts[opcode]++;
+    if (_traceHandler) _traceHandler(self, _opIndex, opcode, _stack.count);
+}
+
+// Adds statistics collected since the last call to the profile.
+- (void) flushProfile {
+    if (!_profile) return;
+    [_profile addOpcodeCounts:_opcodeCounts scriptsCount:_scriptsCount signatureChecksCount:_signatureChecksCount signatureCheckTime:_signatureCheckTime];
+    if (_opcodeCounts) memset(_opcodeCounts, 0, 256 * sizeof(uint32_t));
+    _scriptsCount = 0;
+    _signatureChecksCount = 0;
+    _signatureCheckTime = 0;
+}
+#endif
+
 
 - (BOOL) executeOpcodeError:(NSError**)errorOut {
     NSUInteger opcodeIndex = _opIndex;
     BTCOpcode opcode = _opcode;
-    NSData* pushdata = _pushdata;
+    const BTCScriptInstruction* instruction = _instruction;
+    BOOL isPushdata = (instruction->opcode <= OP_PUSHDATA4);
     
-    if (pushdata.length > BTC_MAX_SCRIPT_ELEMENT_SIZE) {
+    if (isPushdata && instruction->dataLength > BTC_MAX_SCRIPT_ELEMENT_SIZE) {
         if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Pushdata chunk size is too big.", @"")];
         return NO;
     }
     
-    if (opcode > OP_16 && !_pushdata && ++_opCount > BTC_MAX_OPS_PER_SCRIPT) {
+    if (opcode > OP_16 && !isPushdata && ++_opCount > BTC_MAX_OPS_PER_SCRIPT) {
         if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Exceeded the allowed number of operations per script.", @"")];
         return NO;
     }
     
     // Disabled opcodes
     
-    if (opcode == OP_CAT ||
-        opcode == OP_SUBSTR ||
-        opcode == OP_LEFT ||
-        opcode == OP_RIGHT ||
-        opcode == OP_INVERT ||
-        opcode == OP_AND ||
-        opcode == OP_OR ||
-        opcode == OP_XOR ||
-        opcode == OP_2MUL ||
-        opcode == OP_2DIV ||
-        opcode == OP_MUL ||
-        opcode == OP_DIV ||
-        opcode == OP_MOD ||
-        opcode == OP_LSHIFT ||
-        opcode == OP_RSHIFT) {
+    if (BTCOpcodeIsDisabled(opcode)) {
         if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Attempt to execute a disabled opcode.", @"")];
         return NO;
     }
     
-    BOOL shouldExecute = ([_conditionStack indexOfObject:@NO] == NSNotFound);
+    BOOL shouldExecute = (_conditionFirstFalsePosition == NSNotFound);
     
-    if (shouldExecute && pushdata) {
-        [_stack addObject:pushdata];
+    if (shouldExecute && isPushdata) {
+        BTCScriptStackPush(&_stack, _scriptBytes + instruction->dataOffset, instruction->dataLength);
     } else if (shouldExecute || (OP_IF <= opcode && opcode <= OP_ENDIF)) {
     // this basically means that OP_VERIF and OP_VERNOTIF will always fail the script, even if not executed.
         switch (opcode) {
@@ -321,8 +778,7 @@
             case OP_15:
             case OP_16: {
                 // ( -- value)
-                BTCBigNumber* bn = [[BTCBigNumber alloc] initWithInt64:(int)opcode - (int)(OP_1 - 1)];
-                [_stack addObject:bn.signedLittleEndian];
+                [self pushNumber:(int)opcode - (int)(OP_1 - 1)];
             }
             break;
                 
@@ -351,29 +807,38 @@
                     }
                     [self popFromStack];
                 }
-                [_conditionStack addObject:@(value)];
+                if (!value && _conditionFirstFalsePosition == NSNotFound) {
+                    _conditionFirstFalsePosition = _conditionStackSize;
+                }
+                _conditionStackSize++;
             }
             break;
             
             case OP_ELSE: {
-                if (_conditionStack.count == 0) {
+                if (_conditionStackSize == 0) {
                     if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Expected an OP_IF or OP_NOTIF branch before OP_ELSE.", @"")];
                     return NO;
                 }
                 
                 // Invert last condition.
-                BOOL f = [[_conditionStack lastObject] boolValue];
-                [_conditionStack removeObjectAtIndex:_conditionStack.count - 1];
-                [_conditionStack addObject:@(!f)];
+                // If there is a false value below the last one, inverting it does not change anything.
+                if (_conditionFirstFalsePosition == NSNotFound) {
+                    _conditionFirstFalsePosition = _conditionStackSize - 1;
+                } else if (_conditionFirstFalsePosition == _conditionStackSize - 1) {
+                    _conditionFirstFalsePosition = NSNotFound;
+                }
             }
             break;
                 
             case OP_ENDIF: {
-                if (_conditionStack.count == 0) {
+                if (_conditionStackSize == 0) {
                     if (errorOut) *errorOut = [self scriptError:NSLocalizedString(@"Expected an OP_IF or OP_NOTIF branch before OP_ENDIF.", @"")];
                     return NO;
                 }
-                [_conditionStack removeObjectAtIndex:_conditionStack.count - 1];
+                _conditionStackSize--;
+                if (_conditionFirstFalsePosition == _conditionStackSize) {
+                    _conditionFirstFalsePosition = NSNotFound;
+                }
             }
             break;
             
@@ -410,7 +875,8 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:1];
                     return NO;
                 }
-                [_altStack addObject:[self dataAtIndex:-1]];
+                NSUInteger index = _stack.count - 1;
+                BTCScriptStackPush(&_altStack, BTCScriptStackItemBytes(&_stack, index), BTCScriptStackItemLength(&_stack, index));
                 [self popFromStack];
             }
             break;
@@ -420,8 +886,9 @@
                     if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"%@ requires one item on altstack", @""), BTCNameForOpcode(opcode)]];
                     return NO;
                 }
-                [_stack addObject:_altStack[_altStack.count - 1]];
-                [_altStack removeObjectAtIndex:_altStack.count - 1];
+                NSUInteger index = _altStack.count - 1;
+                BTCScriptStackPush(&_stack, BTCScriptStackItemBytes(&_altStack, index), BTCScriptStackItemLength(&_altStack, index));
+                BTCScriptStackPop(&_altStack);
             }
             break;
                 
@@ -442,10 +909,8 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:2];
                     return NO;
                 }
-                NSData* data1 = [self dataAtIndex:-2];
-                NSData* data2 = [self dataAtIndex:-1];
-                [_stack addObject:data1];
-                [_stack addObject:data2];
+                [self duplicateAtIndex:-2];
+                [self duplicateAtIndex:-2];
             }
             break;
                 
@@ -455,12 +920,9 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:3];
                     return NO;
                 }
-                NSData* data1 = [self dataAtIndex:-3];
-                NSData* data2 = [self dataAtIndex:-2];
-                NSData* data3 = [self dataAtIndex:-1];
-                [_stack addObject:data1];
-                [_stack addObject:data2];
-                [_stack addObject:data3];
+                [self duplicateAtIndex:-3];
+                [self duplicateAtIndex:-3];
+                [self duplicateAtIndex:-3];
             }
             break;
                 
@@ -470,10 +932,8 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:4];
                     return NO;
                 }
-                NSData* data1 = [self dataAtIndex:-4];
-                NSData* data2 = [self dataAtIndex:-3];
-                [_stack addObject:data1];
-                [_stack addObject:data2];
+                [self duplicateAtIndex:-4];
+                [self duplicateAtIndex:-4];
             }
             break;
                 
@@ -483,11 +943,8 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:6];
                     return NO;
                 }
-                NSData* data1 = [self dataAtIndex:-6];
-                NSData* data2 = [self dataAtIndex:-5];
-                [_stack removeObjectsInRange:NSMakeRange(_stack.count-6, 2)];
-                [_stack addObject:data1];
-                [_stack addObject:data2];
+                BTCScriptStackMove(&_stack, _stack.count - 6, _stack.count - 1);
+                BTCScriptStackMove(&_stack, _stack.count - 6, _stack.count - 1);
             }
             break;
                 
@@ -510,17 +967,15 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:1];
                     return NO;
                 }
-                NSData* data = [self dataAtIndex:-1];
                 if ([self boolAtIndex:-1]) {
-                    [_stack addObject:data];
+                    [self duplicateAtIndex:-1];
                 }
             }
             break;
                 
             case OP_DEPTH: {
                 // -- stacksize
-                BTCBigNumber* bn = [[BTCBigNumber alloc] initWithInt64:_stack.count];
-                [_stack addObject:bn.signedLittleEndian];
+                [self pushNumber:_stack.count];
             }
             break;
                 
@@ -540,8 +995,7 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:1];
                     return NO;
                 }
-                NSData* data = [self dataAtIndex:-1];
-                [_stack addObject:data];
+                [self duplicateAtIndex:-1];
             }
             break;
                 
@@ -551,7 +1005,7 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:2];
                     return NO;
                 }
-                [_stack removeObjectAtIndex:_stack.count - 2];
+                [self removeAtIndex:-2];
             }
             break;
                 
@@ -561,8 +1015,7 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:2];
                     return NO;
                 }
-                NSData* data = [self dataAtIndex:-2];
-                [_stack addObject:data];
+                [self duplicateAtIndex:-2];
             }
             break;
                 
@@ -577,25 +1030,22 @@
                 
                 // Top item is a number of items to roll over.
                 // Take it and pop it from the stack.
-                BTCBigNumber* bn = [self bigNumberAtIndex:-1];
-                
-                if (!bn) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t n = 0;
+                if (![self number:&n atIndex:-1]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
-                
-                int32_t n = [bn int32value];
                 [self popFromStack];
                 
                 if (n < 0 || n >= _stack.count) {
-                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of items for %@: %d.", @""), BTCNameForOpcode(opcode), n]];
+                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of items for %@: %lld.", @""), BTCNameForOpcode(opcode), n]];
                     return NO;
                 }
-                NSData* data = [self dataAtIndex: -n - 1];
                 if (opcode == OP_ROLL) {
-                    [self removeAtIndex: -n - 1];
+                    BTCScriptStackMove(&_stack, _stack.count - n - 1, _stack.count - 1);
+                } else {
+                    [self duplicateAtIndex: -n - 1];
                 }
-                [_stack addObject:data];
             }
             break;
                 
@@ -628,8 +1078,8 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:2];
                     return NO;
                 }
-                NSData* data = [self dataAtIndex:-1];
-                [_stack insertObject:data atIndex:_stack.count - 2];
+                [self duplicateAtIndex:-1];
+                BTCScriptStackMove(&_stack, _stack.count - 1, _stack.count - 3);
             }
             break;
                 
@@ -640,8 +1090,7 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:1];
                     return NO;
                 }
-                BTCBigNumber* bn = [[BTCBigNumber alloc] initWithUInt64:[self dataAtIndex:-1].length];
-                [_stack addObject:bn.signedLittleEndian];
+                [self pushNumber:BTCScriptStackItemLength(&_stack, _stack.count - 1)];
             }
             break;
 
@@ -657,9 +1106,10 @@
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:2];
                     return NO;
                 }
-                NSData* x1 = [self dataAtIndex:-2];
-                NSData* x2 = [self dataAtIndex:-1];
-                BOOL equal = [x1 isEqual:x2];
+                NSUInteger i1 = _stack.count - 2;
+                NSUInteger i2 = _stack.count - 1;
+                BOOL equal = (BTCScriptStackItemLength(&_stack, i1) == BTCScriptStackItemLength(&_stack, i2)) &&
+                             (memcmp(BTCScriptStackItemBytes(&_stack, i1), BTCScriptStackItemBytes(&_stack, i2), BTCScriptStackItemLength(&_stack, i1)) == 0);
                 
                 // OP_NOTEQUAL is disabled because it would be too easy to say
                 // something like n != 1 and have some wiseguy pass in 1 with extra
@@ -670,7 +1120,7 @@
                 [self popFromStack];
                 [self popFromStack];
                 
-                [_stack addObject:equal ? _blobTrue : _blobFalse];
+                [self pushBool:equal];
                 
                 if (opcode == OP_EQUALVERIFY) {
                     if (equal) {
@@ -698,24 +1148,23 @@
                     return NO;
                 }
                 
-                BTCMutableBigNumber* bn = [self bigNumberAtIndex:-1];
-                
-                if (!bn) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t bn = 0;
+                if (![self number:&bn atIndex:-1]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
                 
                 switch (opcode) {
-                    case OP_1ADD:       [bn add:_bigNumberOne]; break;
-                    case OP_1SUB:       [bn subtract:_bigNumberOne]; break;
-                    case OP_NEGATE:     [bn multiply:[BTCBigNumber negativeOne]]; break;
-                    case OP_ABS:        if ([bn less:_bigNumberZero]) [bn multiply:[BTCBigNumber negativeOne]]; break;
-                    case OP_NOT:        bn.uint32value = (uint32_t)[bn isEqual:_bigNumberZero]; break;
-                    case OP_0NOTEQUAL:  bn.uint32value = (uint32_t)(![bn isEqual:_bigNumberZero]); break;
+                    case OP_1ADD:       bn += 1; break;
+                    case OP_1SUB:       bn -= 1; break;
+                    case OP_NEGATE:     bn = -bn; break;
+                    case OP_ABS:        if (bn < 0) bn = -bn; break;
+                    case OP_NOT:        bn = (bn == 0); break;
+                    case OP_0NOTEQUAL:  bn = (bn != 0); break;
                     default:            NSAssert(0, @"Invalid opcode"); break;
                 }
                 [self popFromStack];
-                [_stack addObject:bn.signedLittleEndian];
+                [self pushNumber:bn];
             }
             break;
 
@@ -738,44 +1187,37 @@
                     return NO;
                 }
                 
-                // bn1 is nil when stack is ( <00000080 00>, <> )
-
-                BTCMutableBigNumber* bn1 = [self bigNumberAtIndex:-2];
-                BTCMutableBigNumber* bn2 = [self bigNumberAtIndex:-1];
+                // Decoding fails when stack is ( <00000080 00>, <> )
                 
-                if (!bn1 || !bn2) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t bn1 = 0;
+                int64_t bn2 = 0;
+                if (![self number:&bn1 atIndex:-2] || ![self number:&bn2 atIndex:-1]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
                 
-                BTCMutableBigNumber* bn = nil;
+                int64_t bn = 0;
                 
                 switch (opcode) {
-                    case OP_ADD:
-                        bn = [bn1 add:bn2];
-                        break;
-                        
-                    case OP_SUB:
-                        bn = [bn1 subtract:bn2];
-                        break;
-                        
-                    case OP_BOOLAND:             bn = [[BTCMutableBigNumber alloc] initWithInt32:![bn1 isEqual:_bigNumberZero] && ![bn2 isEqual:_bigNumberZero]]; break;
-                    case OP_BOOLOR:              bn = [[BTCMutableBigNumber alloc] initWithInt32:![bn1 isEqual:_bigNumberZero] || ![bn2 isEqual:_bigNumberZero]]; break;
-                    case OP_NUMEQUAL:            bn = [[BTCMutableBigNumber alloc] initWithInt32: [bn1 isEqual:bn2]]; break;
-                    case OP_NUMEQUALVERIFY:      bn = [[BTCMutableBigNumber alloc] initWithInt32: [bn1 isEqual:bn2]]; break;
-                    case OP_NUMNOTEQUAL:         bn = [[BTCMutableBigNumber alloc] initWithInt32:![bn1 isEqual:bn2]]; break;
-                    case OP_LESSTHAN:            bn = [[BTCMutableBigNumber alloc] initWithInt32:[bn1 less:bn2]]; break;
-                    case OP_GREATERTHAN:         bn = [[BTCMutableBigNumber alloc] initWithInt32:[bn1 greater:bn2]]; break;
-                    case OP_LESSTHANOREQUAL:     bn = [[BTCMutableBigNumber alloc] initWithInt32:[bn1 lessOrEqual:bn2]]; break;
-                    case OP_GREATERTHANOREQUAL:  bn = [[BTCMutableBigNumber alloc] initWithInt32:[bn1 greaterOrEqual:bn2]]; break;
-                    case OP_MIN:                 bn = [[bn1 min:bn2] mutableCopy]; break;
-                    case OP_MAX:                 bn = [[bn1 max:bn2] mutableCopy]; break;
+                    case OP_ADD:                 bn = bn1 + bn2; break;
+                    case OP_SUB:                 bn = bn1 - bn2; break;
+                    case OP_BOOLAND:             bn = (bn1 != 0 && bn2 != 0); break;
+                    case OP_BOOLOR:              bn = (bn1 != 0 || bn2 != 0); break;
+                    case OP_NUMEQUAL:            bn = (bn1 == bn2); break;
+                    case OP_NUMEQUALVERIFY:      bn = (bn1 == bn2); break;
+                    case OP_NUMNOTEQUAL:         bn = (bn1 != bn2); break;
+                    case OP_LESSTHAN:            bn = (bn1 < bn2); break;
+                    case OP_GREATERTHAN:         bn = (bn1 > bn2); break;
+                    case OP_LESSTHANOREQUAL:     bn = (bn1 <= bn2); break;
+                    case OP_GREATERTHANOREQUAL:  bn = (bn1 >= bn2); break;
+                    case OP_MIN:                 bn = MIN(bn1, bn2); break;
+                    case OP_MAX:                 bn = MAX(bn1, bn2); break;
                     default:                     NSAssert(0, @"Invalid opcode"); break;
                 }
                 
                 [self popFromStack];
                 [self popFromStack];
-                [_stack addObject:bn.signedLittleEndian];
+                [self pushNumber:bn];
                 
                 if (opcode == OP_NUMEQUALVERIFY) {
                     if ([self boolAtIndex:-1]) {
@@ -795,22 +1237,21 @@
                     return NO;
                 }
                 
-                BTCMutableBigNumber* bn1 = [self bigNumberAtIndex:-3];
-                BTCMutableBigNumber* bn2 = [self bigNumberAtIndex:-2];
-                BTCMutableBigNumber* bn3 = [self bigNumberAtIndex:-1];
-                
-                if (!bn1 || !bn2 || !bn3) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t bn1 = 0;
+                int64_t bn2 = 0;
+                int64_t bn3 = 0;
+                if (![self number:&bn1 atIndex:-3] || ![self number:&bn2 atIndex:-2] || ![self number:&bn3 atIndex:-1]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
                 
-                BOOL value = ([bn2 lessOrEqual:bn1] && [bn1 less:bn3]);
+                BOOL value = (bn2 <= bn1 && bn1 < bn3);
                 
                 [self popFromStack];
                 [self popFromStack];
                 [self popFromStack];
                 
-                [_stack addObject:(value ? _bigNumberTrue : _bigNumberFalse).signedLittleEndian];
+                [self pushNumber:value];
             }
             break;
             
@@ -829,22 +1270,29 @@
                     return NO;
                 }
                 
-                NSData* data = [self dataAtIndex:-1];
-                NSData* hash = nil;
+                const unsigned char* bytes = BTCScriptStackItemBytes(&_stack, _stack.count - 1);
+                CC_LONG length = (CC_LONG)BTCScriptStackItemLength(&_stack, _stack.count - 1);
+                unsigned char hash[CC_SHA256_DIGEST_LENGTH];
+                size_t hashLength = 0;
                 
                 if (opcode == OP_RIPEMD160) {
-                    hash = BTCRIPEMD160(data);
+                    BTCRIPEMD160Bytes(hash, bytes, length);
+                    hashLength = 20;
                 } else if (opcode == OP_SHA1) {
-                    hash = BTCSHA1(data);
+                    CC_SHA1(bytes, length, hash);
+                    hashLength = CC_SHA1_DIGEST_LENGTH;
                 } else if (opcode == OP_SHA256) {
-                    hash = BTCSHA256(data);
+                    BTCSHA256Bytes(hash, bytes, length);
+                    hashLength = CC_SHA256_DIGEST_LENGTH;
                 } else if (opcode == OP_HASH160) {
-                    hash = BTCHash160(data);
+                    BTCHash160Bytes(hash, bytes, length);
+                    hashLength = 20;
                 } else if (opcode == OP_HASH256) {
-                    hash = BTCHash256(data);
+                    BTCHash256Bytes(hash, bytes, length);
+                    hashLength = CC_SHA256_DIGEST_LENGTH;
                 }
                 [self popFromStack];
-                [_stack addObject:hash];
+                BTCScriptStackPush(&_stack, hash, hashLength);
             }
             break;
             
@@ -869,8 +1317,9 @@
                     return NO;
                 }
                 
-                NSData* signature = [self dataAtIndex:-2];
-                NSData* pubkeyData = [self dataAtIndex:-1];
+                // Borrowed data is valid until the stack is modified, so we pop items only after the check.
+                NSData* signature = [self borrowedDataAtIndex:-2];
+                NSData* pubkeyData = [self borrowedDataAtIndex:-1];
                 
                 // Subset of script starting at the most recent OP_CODESEPARATOR (inclusive)
                 BTCScript* subscript = [_script subScriptFromIndex:_lastCodeSeparatorIndex];
@@ -888,24 +1337,12 @@
                 [subscript deleteOccurrencesOfData:signature];
 
                 NSError* sigerror = nil;
-                BOOL failed = NO;
-                if (_verificationFlags & BTCScriptVerificationStrictEncoding) {
-                    if (![BTCKey isCanonicalPublicKey:pubkeyData error:&sigerror]) {
-                        failed = YES;
-                    }
-                    if (!failed && ![BTCKey isCanonicalSignatureWithHashType:signature
-                                                                 verifyLowerS:!!(_verificationFlags & BTCScriptVerificationEvenS)
-                                                                       error:&sigerror]) {
-                        failed = YES;
-                    }
-                }
-                
-                BOOL success = !failed && [self checkSignature:signature publicKey:pubkeyData subscript:subscript error:&sigerror];
+                BOOL success = [self verifySignature:signature publicKey:pubkeyData subscript:subscript error:&sigerror];
                 
                 [self popFromStack];
                 [self popFromStack];
                 
-                [_stack addObject:success ? _blobTrue : _blobFalse];
+                [self pushBool:success];
                 
                 if (opcode == OP_CHECKSIGVERIFY) {
                     if (success) {
@@ -930,16 +1367,14 @@
                     return NO;
                 }
                 
-                BTCBigNumber* bn = [self bigNumberAtIndex:-i];
-                
-                if (!bn) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t keysCount = 0;
+                if (![self number:&keysCount atIndex:-i]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
 
-                int32_t keysCount = bn.int32value;
                 if (keysCount < 0 || keysCount > BTC_MAX_KEYS_FOR_CHECKMULTISIG) {
-                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of keys for %@: %d.", @""), BTCNameForOpcode(opcode), keysCount]];
+                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of keys for %@: %lld.", @""), BTCNameForOpcode(opcode), keysCount]];
                     return NO;
                 }
                 
@@ -953,7 +1388,7 @@
                 // An index of the first key
                 int ikey = ++i;
                 
-                i += keysCount;
+                i += (int)keysCount;
                 
                 if (_stack.count < i) {
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:i];
@@ -961,23 +1396,21 @@
                 }
                 
                 // Read the required number of signatures.
-                BTCBigNumber* bn2 = [self bigNumberAtIndex:-i];
-                
-                if (!bn2) {
-                    if (errorOut) *errorOut = [self scriptErrorInvalidBignum];
+                int64_t sigsCount = 0;
+                if (![self number:&sigsCount atIndex:-i]) {
+                    if (errorOut) *errorOut = [self scriptErrorInvalidNumber];
                     return NO;
                 }
 
-                int sigsCount = bn2.int32value;
                 if (sigsCount < 0 || sigsCount > keysCount) {
-                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of signatures for %@: %d.", @""), BTCNameForOpcode(opcode), keysCount]];
+                    if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Invalid number of signatures for %@: %lld.", @""), BTCNameForOpcode(opcode), sigsCount]];
                     return NO;
                 }
                 
                 // The index of the first signature
                 int isig = ++i;
                 
-                i += sigsCount;
+                i += (int)sigsCount;
                 
                 if (_stack.count < i) {
                     if (errorOut) *errorOut = [self scriptErrorOpcodeRequiresItemsOnStack:i];
@@ -991,7 +1424,7 @@
                 // Essentially this is noop because signatures are never present in scripts.
                 // See also a comment to a similar code in OP_CHECKSIG.
                 for (int k = 0; k < sigsCount; k++) {
-                    NSData* sig = [self dataAtIndex: - isig - k];
+                    NSData* sig = [self borrowedDataAtIndex: - isig - k];
                     [subscript deleteOccurrencesOfData:sig];
                 }
                 
@@ -1000,24 +1433,11 @@
 
                 // Signatures must come in the same order as their keys.
                 while (success && sigsCount > 0) {
-                    NSData* signature = [self dataAtIndex:-isig];
-                    NSData* pubkeyData = [self dataAtIndex:-ikey];
+                    NSData* signature = [self borrowedDataAtIndex:-isig];
+                    NSData* pubkeyData = [self borrowedDataAtIndex:-ikey];
                     
-                    BOOL validMatch = YES;
                     NSError* sigerror = nil;
-                    if (_verificationFlags & BTCScriptVerificationStrictEncoding) {
-                        if (![BTCKey isCanonicalPublicKey:pubkeyData error:&sigerror]) {
-                            validMatch = NO;
-                        }
-                        if (validMatch && ![BTCKey isCanonicalSignatureWithHashType:signature
-                                                                        verifyLowerS:!!(_verificationFlags & BTCScriptVerificationEvenS)
-                                                                              error:&sigerror]) {
-                            validMatch = NO;
-                        }
-                    }
-                    if (validMatch) {
-                        validMatch = [self checkSignature:signature publicKey:pubkeyData subscript:subscript error:&sigerror];
-                    }
+                    BOOL validMatch = [self verifySignature:signature publicKey:pubkeyData subscript:subscript error:&sigerror];
                     
                     if (validMatch) {
                         isig++;
@@ -1043,7 +1463,7 @@
                     [self popFromStack];
                 }
                 
-                [_stack addObject:success ? _blobTrue : _blobFalse];
+                [self pushBool:success];
                 
                 if (opcode == OP_CHECKMULTISIGVERIFY) {
                     if (success) {
@@ -1073,8 +1493,45 @@
 }
 
 
+// Checks encoding of the signature and pubkey according to verification flags and then verifies the signature.
+- (BOOL) verifySignature:(NSData*)signature publicKey:(NSData*)pubkeyData subscript:(BTCScript*)subscript error:(NSError**)errorOut {
+    if (_verificationFlags & BTCScriptVerificationStrictEncoding) {
+        if (![BTCKey isCanonicalPublicKey:pubkeyData error:errorOut]) {
+            return NO;
+        }
+        if (![BTCKey isCanonicalSignatureWithHashType:signature
+                                          verifyLowerS:!!(_verificationFlags & BTCScriptVerificationEvenS)
+                                                error:errorOut]) {
+            return NO;
+        }
+    }
+#if BTCScriptMachineInstrumentationEnabled
+    if (_profile) {
+        uint64_t startTime = mach_absolute_time();
+        BOOL result = [self checkSignature:signature publicKey:pubkeyData subscript:subscript error:errorOut];
+        _signatureCheckTime += mach_absolute_time() - startTime;
+        _signatureChecksCount++;
+        return result;
+    }
+#endif
+    return [self checkSignature:signature publicKey:pubkeyData subscript:subscript error:errorOut];
+}
+
 - (BOOL) checkSignature:(NSData*)signature publicKey:(NSData*)pubkeyData subscript:(BTCScript*)subscript error:(NSError**)errorOut {
-    BTCKey* pubkey = [[BTCKey alloc] initWithPublicKey:pubkeyData];
+    NSData* sighash = nil;
+    
+    // Signatures in the cache were verified before, so we can skip public key parsing and EC math.
+    // Only valid signatures get into the cache, so on a miss we proceed with regular checks below.
+    if (_signatureCache && signature.length > 0) {
+        BTCSignatureHashType hashType = ((unsigned char*)signature.bytes)[signature.length - 1];
+        sighash = [self signatureHashForScript:subscript hashType:hashType error:NULL];
+        NSData* rawSignature = [signature subdataWithRange:NSMakeRange(0, signature.length - 1)];
+        if (sighash && [_signatureCache containsSignature:rawSignature publicKey:pubkeyData hash:sighash]) {
+            return YES;
+        }
+    }
+    
+    BTCKey* pubkey = [self publicKeyWithData:pubkeyData];
     
     if (!pubkey) {
         if (errorOut) *errorOut = [self scriptError:[NSString stringWithFormat:NSLocalizedString(@"Public key is not valid: %@.", @""),
@@ -1094,7 +1551,9 @@
     // Strip that last byte to have a pure signature.
     signature = [signature subdataWithRange:NSMakeRange(0, signature.length - 1)];
     
-    NSData* sighash = [_transaction signatureHashForScript:subscript inputIndex:_inputIndex hashType:hashType error:errorOut];
+    if (!sighash) {
+        sighash = [self signatureHashForScript:subscript hashType:hashType error:errorOut];
+    }
     
     //NSLog(@"BTCScriptMachine: Hash for input %d [%d]: %@", _inputIndex, hashType, BTCHexFromData(sighash));
     
@@ -1108,15 +1567,57 @@
         return NO;
     }
     
+    [_signatureCache addSignature:signature publicKey:pubkeyData hash:sighash];
+    
     return YES;
 }
 
+// Returns a signature hash for the current input, reusing the one computed for the same subscript and hash type.
+// Like -[BTCTransaction signatureHashForScript:inputIndex:hashType:error:] it may remove OP_CODESEPARATOR from the subscript.
+- (NSData*) signatureHashForScript:(BTCScript*)subscript hashType:(BTCSignatureHashType)hashType error:(NSError**)errorOut {
+    NSData* scriptData = subscript.data;
+    NSMutableData* key = [NSMutableData dataWithCapacity:1 + scriptData.length];
+    [key appendBytes:&hashType length:1];
+    [key appendData:scriptData];
+    
+    NSData* sighash = _signatureHashes[key];
+    if (sighash) return sighash;
+    
+    sighash = [_transaction signatureHashForScript:subscript inputIndex:_inputIndex hashType:hashType error:errorOut];
+    if (!sighash) return nil;
+    
+    if (!_signatureHashes) _signatureHashes = [NSMutableDictionary dictionary];
+    _signatureHashes[key] = sighash;
+    return sighash;
+}
+
+// Returns a public key decoded from the data, reusing a previously decoded one. Returns nil if the key is invalid.
+- (BTCKey*) publicKeyWithData:(NSData*)pubkeyData {
+    id pubkey = _publicKeys[pubkeyData];
+    if (!pubkey) {
+        pubkey = [[BTCKey alloc] initWithPublicKey:pubkeyData] ?: [NSNull null];
+        
+        // The data may be borrowed from the stack, so the key must be a copy that owns its bytes.
+        if (!_publicKeys) _publicKeys = [NSMutableDictionary dictionary];
+        _publicKeys[[NSData dataWithData:pubkeyData]] = pubkey;
+    }
+    return (pubkey == [NSNull null]) ? nil : pubkey;
+}
+
 - (NSArray*) stack {
-    return [_stack copy] ?: @[];
+    return [self arrayWithStack:&_stack];
 }
 
 - (NSArray*) altstack {
-    return [_altStack copy] ?: @[];
+    return [self arrayWithStack:&_altStack];
+}
+
+- (NSArray*) arrayWithStack:(const BTCScriptStack*)stack {
+    NSMutableArray* array = [NSMutableArray arrayWithCapacity:stack->count];
+    for (NSUInteger i = 0; i < stack->count; i++) {
+        [array addObject:[NSData dataWithBytes:BTCScriptStackItemBytes(stack, i) length:BTCScriptStackItemLength(stack, i)]];
+    }
+    return array;
 }
 
 
@@ -1151,10 +1652,10 @@
     return [NSError errorWithDomain:BTCErrorDomain code:BTCErrorScriptError userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:NSLocalizedString(@"%@ requires %d items on stack.", @""), BTCNameForOpcode(_opcode), items]}];
 }
 
-- (NSError*) scriptErrorInvalidBignum {
+- (NSError*) scriptErrorInvalidNumber {
     return [NSError errorWithDomain:BTCErrorDomain
                                code:BTCErrorScriptError
-                           userInfo:@{NSLocalizedDescriptionKey: NSLocalizedString(@"Invalid bignum data.", @"")}];
+                           userInfo:@{NSLocalizedDescriptionKey: NSLocalizedString(@"Invalid script number.", @"")}];
 }
 
 
@@ -1165,41 +1666,52 @@
 // -1 is the last item, -2 is the pre-last item.
 #define BTCNormalizeIndex(list, i) (i < 0 ? (list.count + i) : i)
 
-- (NSData*) dataAtIndex:(NSInteger)index {
-    return _stack[BTCNormalizeIndex(_stack, index)];
+// Returns data pointing directly to the stack storage.
+// It is valid only until the stack is modified and must not be retained beyond the current operation.
+- (NSData*) borrowedDataAtIndex:(NSInteger)index {
+    NSUInteger i = BTCNormalizeIndex(_stack, index);
+    return [NSData dataWithBytesNoCopy:(void*)BTCScriptStackItemBytes(&_stack, i) length:BTCScriptStackItemLength(&_stack, i) freeWhenDone:NO];
+}
+
+- (void) pushBool:(BOOL)value {
+    static const unsigned char one = 1;
+    BTCScriptStackPush(&_stack, &one, value ? 1 : 0);
+}
+
+// Pushes a copy of the item at the specified index.
+- (void) duplicateAtIndex:(NSInteger)index {
+    BTCScriptStackPushCopy(&_stack, BTCNormalizeIndex(_stack, index));
 }
 
 - (void) swapDataAtIndex:(NSInteger)index1 withIndex:(NSInteger)index2 {
-    [_stack exchangeObjectAtIndex:BTCNormalizeIndex(_stack, index1)
-                withObjectAtIndex:BTCNormalizeIndex(_stack, index2)];
+    BTCScriptStackSwap(&_stack, BTCNormalizeIndex(_stack, index1), BTCNormalizeIndex(_stack, index2));
 }
 
-// Returns bignum from pushdata or nil.
-- (BTCMutableBigNumber*) bigNumberAtIndex:(NSInteger)index {
-    NSData* data = [self dataAtIndex:index];
-    if (!data) return nil;
-    
-    // BitcoinQT throws "CastToBigNum() : overflow" and then catches it inside EvalScript to return false.
-    // This is catched in unit test for invalid scripts: @[@"2147483648 0 ADD", @"NOP", @"arithmetic operands must be in range @[-2^31...2^31] "]
-    if (data.length > 4) {
-        return nil;
-    }
+// Decodes a script number from the stack item.
+// Returns NO if the item is longer than 4 bytes (BitcoinQT throws "CastToBigNum() : overflow" and then catches it inside EvalScript to return false)
+// or is not minimally encoded while BTCScriptVerificationMinimalData is set.
+// This is catched in unit test for invalid scripts: @[@"2147483648 0 ADD", @"NOP", @"arithmetic operands must be in range @[-2^31...2^31] "]
+- (BOOL) number:(int64_t*)valueOut atIndex:(NSInteger)index {
+    NSUInteger i = BTCNormalizeIndex(_stack, index);
+    return BTCScriptNumDecode(BTCScriptStackItemBytes(&_stack, i),
+                              BTCScriptStackItemLength(&_stack, i),
+                              BTCScriptNumMaxSize,
+                              !!(_verificationFlags & BTCScriptVerificationMinimalData),
+                              valueOut);
+}
 
-    // Get rid of extra leading zeros like BitcoinQT does:
-    // CBigNum(CBigNum(vch).getvch());
-    // FIXME: It's a cargo cult here. I haven't checked myself when do these extra zeros appear and whether they really go away. [Oleg]
-    BTCMutableBigNumber* bn = [[BTCMutableBigNumber alloc] initWithSignedLittleEndian:[[BTCBigNumber alloc] initWithSignedLittleEndian:data].signedLittleEndian];
-    return bn;
+- (void) pushNumber:(int64_t)value {
+    unsigned char buffer[BTCScriptNumMaxEncodedSize];
+    size_t length = BTCScriptNumEncode(value, buffer);
+    BTCScriptStackPush(&_stack, buffer, length);
 }
 
 - (BOOL) boolAtIndex:(NSInteger)index {
-    NSData* data = [self dataAtIndex:index];
-    if (!data) return NO;
-    
-    NSUInteger len = data.length;
+    NSUInteger itemIndex = BTCNormalizeIndex(_stack, index);
+    NSUInteger len = BTCScriptStackItemLength(&_stack, itemIndex);
     if (len == 0) return NO;
     
-    const unsigned char* bytes = data.bytes;
+    const unsigned char* bytes = BTCScriptStackItemBytes(&_stack, itemIndex);
     for (NSUInteger i = 0; i < len; i++) {
         if (bytes[i] != 0) {
             // Can be negative zero, also counts as NO
@@ -1214,12 +1726,12 @@
 
 // -1 means last item
 - (void) removeAtIndex:(NSInteger)index {
-    [_stack removeObjectAtIndex:BTCNormalizeIndex(_stack, index)];
+    BTCScriptStackRemove(&_stack, BTCNormalizeIndex(_stack, index));
 }
 
 // -1 means last item
 - (void) popFromStack {
-    [_stack removeObjectAtIndex:BTCNormalizeIndex(_stack, -1)];
+    BTCScriptStackPop(&_stack);
 }
 
 @end
@@ -0,0 +1,40 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+#import "BTCOpcode.h"
+
+// Aggregated statistics of script execution collected by BTCScriptMachine (see its `profile` property).
+// Opcodes are counted by their raw byte, so pushes are counted by their length byte or OP_PUSHDATA<1,2,4>.
+// The profile is thread-safe and may be shared by many BTCScriptMachine instances.
+@interface BTCScriptProfile : NSObject
+
+// Number of scripts run by the interpreter (input, output and P2SH redeem scripts are counted separately).
+@property(nonatomic, readonly) uint64_t scriptsCount;
+
+// Number of executed operations in all scripts.
+@property(nonatomic, readonly) uint64_t operationsCount;
+
+// Number of signature checks, including the ones resolved by a signature cache
+// and the ones done by standard templates without running the interpreter.
+@property(nonatomic, readonly) uint64_t signatureChecksCount;
+
+// Total time spent checking signatures (computing hashes, decoding keys and verifying ECDSA signatures).
+@property(nonatomic, readonly) uint64_t signatureCheckNanoseconds;
+
+// Returns the number of times the opcode was executed.
+- (uint64_t) countForOpcode:(BTCOpcode)opcode;
+
+// Returns all counters as a dictionary suitable for logging and monitoring:
+// opcode names mapped to non-zero counts (pushes of 1-75 bytes are summed as "OP_PUSHBYTES")
+// and keys "scripts", "operations", "signatureChecks" and "signatureCheckNanoseconds".
+- (NSDictionary*) dictionary;
+
+// Resets all counters to zero.
+- (void) resetStatistics;
+
+// Adds statistics collected by a machine. `opcodeCounts` has 256 elements indexed by opcode.
+// `signatureCheckTime` is measured with mach_absolute_time().
+// Used by BTCScriptMachine, you normally do not need to call it.
+- (void) addOpcodeCounts:(const uint32_t*)opcodeCounts scriptsCount:(uint64_t)scriptsCount signatureChecksCount:(uint64_t)signatureChecksCount signatureCheckTime:(uint64_t)signatureCheckTime;
+
+@end
@@ -0,0 +1,80 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCScriptProfile.h"
+#import <libkern/OSAtomic.h>
+#import <mach/mach_time.h>
+
+@implementation BTCScriptProfile {
+    volatile int64_t _opcodeCounts[256];
+    volatile int64_t _scriptsCount;
+    volatile int64_t _signatureChecksCount;
+    volatile int64_t _signatureCheckTime; // in mach_absolute_time() units
+}
+
+- (uint64_t) scriptsCount {
+    return (uint64_t)_scriptsCount;
+}
+
+- (uint64_t) operationsCount {
+    uint64_t count = 0;
+    for (int i = 0; i < 256; i++) count += (uint64_t)_opcodeCounts[i];
+    return count;
+}
+
+- (uint64_t) signatureChecksCount {
+    return (uint64_t)_signatureChecksCount;
+}
+
+- (uint64_t) signatureCheckNanoseconds {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return (uint64_t)((double)_signatureCheckTime * timebase.numer / timebase.denom);
+}
+
+- (uint64_t) countForOpcode:(BTCOpcode)opcode {
+    return (uint64_t)_opcodeCounts[opcode];
+}
+
+- (NSDictionary*) dictionary {
+    NSMutableDictionary* dict = [NSMutableDictionary dictionary];
+    for (int i = 0; i < 256; i++) {
+        uint64_t count = (uint64_t)_opcodeCounts[i];
+        if (count == 0) continue;
+        NSString* name = (i > OP_0 && i < OP_PUSHDATA1) ? @"OP_PUSHBYTES" : BTCNameForOpcode(i);
+        dict[name] = @([dict[name] unsignedLongLongValue] + count);
+    }
+    dict[@"scripts"] = @(self.scriptsCount);
+    dict[@"operations"] = @(self.operationsCount);
+    dict[@"signatureChecks"] = @(self.signatureChecksCount);
+    dict[@"signatureCheckNanoseconds"] = @(self.signatureCheckNanoseconds);
+    return dict;
+}
+
+- (void) resetStatistics {
+    for (int i = 0; i < 256; i++) _opcodeCounts[i] = 0;
+    _scriptsCount = 0;
+    _signatureChecksCount = 0;
+    _signatureCheckTime = 0;
+    OSMemoryBarrier();
+}
+
+- (void) addOpcodeCounts:(const uint32_t*)opcodeCounts scriptsCount:(uint64_t)scriptsCount signatureChecksCount:(uint64_t)signatureChecksCount signatureCheckTime:(uint64_t)signatureCheckTime {
+    if (opcodeCounts) {
+        for (int i = 0; i < 256; i++) {
+            if (opcodeCounts[i] > 0) OSAtomicAdd64(opcodeCounts[i], &_opcodeCounts[i]);
+        }
+    }
+    if (scriptsCount > 0) OSAtomicAdd64((int64_t)scriptsCount, &_scriptsCount);
+    if (signatureChecksCount > 0) OSAtomicAdd64((int64_t)signatureChecksCount, &_signatureChecksCount);
+    if (signatureCheckTime > 0) OSAtomicAdd64((int64_t)signatureCheckTime, &_signatureCheckTime);
+}
+
+- (NSString*) description {
+    return [NSString stringWithFormat:@"<%@:0x%p %@ scripts, %@ ops, %@ sigchecks in %.3f ms>", [self class], self,
+            @(self.scriptsCount), @(self.operationsCount), @(self.signatureChecksCount), self.signatureCheckNanoseconds / 1e6];
+}
+
+@end
@@ -0,0 +1,9 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCScriptVerifier.h"
+
+@interface BTCScriptVerifier (Tests)
+
++ (void) runAllTests;
+
+@end
@@ -0,0 +1,164 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCScriptVerifier+Tests.h"
+#import "BTCBlock.h"
+#import "BTCTransaction.h"
+#import "BTCTransactionInput.h"
+#import "BTCTransactionOutput.h"
+#import "BTCOutpoint.h"
+#import "BTCScript.h"
+#import "BTCKey.h"
+#import "BTCAddress.h"
+#import "BTCData.h"
+#import "BTCErrors.h"
+#import "BTCSignatureCache.h"
+
+@implementation BTCScriptVerifier (Tests)
+
++ (void) runAllTests {
+    [self testTransactionVerification];
+    [self testBlockVerification];
+    [self testSignatureCache];
+}
+
+// Creates a transaction spending `count` P2PKH outputs of a funding transaction and signs all inputs.
++ (BTCTransaction*) signedTransactionWithInputs:(NSUInteger)count funding:(BTCTransaction**)fundingOut {
+    BTCKey* key = [[BTCKey alloc] initWithPrivateKey:BTCSHA256([@"BTCScriptVerifier" dataUsingEncoding:NSUTF8StringEncoding])];
+
+    BTCTransaction* funding = [[BTCTransaction alloc] init];
+    BTCTransactionInput* fundingInput = [[BTCTransactionInput alloc] init];
+    fundingInput.previousHash = BTCSHA256([@"funding" dataUsingEncoding:NSUTF8StringEncoding]);
+    fundingInput.previousIndex = 0;
+    [funding addInput:fundingInput];
+    for (NSUInteger i = 0; i < count; i++) {
+        [funding addOutput:[[BTCTransactionOutput alloc] initWithValue:10000 address:key.compressedPublicKeyAddress]];
+    }
+
+    BTCTransaction* tx = [[BTCTransaction alloc] init];
+    for (uint32_t i = 0; i < count; i++) {
+        BTCTransactionInput* txin = [[BTCTransactionInput alloc] init];
+        txin.previousHash = funding.transactionHash;
+        txin.previousIndex = i;
+        [tx addInput:txin];
+    }
+    [tx addOutput:[[BTCTransactionOutput alloc] initWithValue:count * 10000 address:key.compressedPublicKeyAddress]];
+
+    for (uint32_t i = 0; i < count; i++) {
+        BTCScript* outputScript = [funding.outputs[i] script];
+        NSData* sighash = [tx signatureHashForScript:[outputScript copy] inputIndex:i hashType:SIGHASH_ALL error:NULL];
+        BTCScript* sigScript = [[[BTCScript alloc] init] appendData:[key signatureForHash:sighash hashType:SIGHASH_ALL]];
+        [sigScript appendData:key.compressedPublicKey];
+        ((BTCTransactionInput*)tx.inputs[i]).signatureScript = sigScript;
+    }
+
+    if (fundingOut) *fundingOut = funding;
+    return tx;
+}
+
++ (BTCScriptVerifierOutputLookup) lookupForTransaction:(BTCTransaction*)funding {
+    return ^BTCTransactionOutput*(BTCOutpoint* outpoint) {
+        if (![outpoint.txHash isEqual:funding.transactionHash] || outpoint.index >= funding.outputs.count) return nil;
+        return funding.outputs[outpoint.index];
+    };
+}
+
++ (void) breakSignatureOfInput:(BTCTransactionInput*)txin {
+    NSMutableData* signature = [[txin.signatureScript.scriptChunks[0] pushdata] mutableCopy];
+    ((unsigned char*)signature.mutableBytes)[10] ^= 1;
+    BTCScript* script = [[[BTCScript alloc] init] appendData:signature];
+    [script appendData:[txin.signatureScript.scriptChunks[1] pushdata]];
+    txin.signatureScript = script;
+}
+
++ (void) testTransactionVerification {
+    BTCTransaction* funding = nil;
+    BTCTransaction* tx = [self signedTransactionWithInputs:16 funding:&funding];
+
+    for (NSNumber* concurrency in @[@1, @4, @32]) {
+        BTCScriptVerifier* verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:[self lookupForTransaction:funding]];
+        verifier.maxConcurrentOperationCount = concurrency.unsignedIntegerValue;
+        NSError* error = nil;
+        NSAssert([verifier verifyTransaction:tx error:&error], @"signed transaction should be valid");
+        NSAssert([verifier failuresForTransaction:tx].count == 0, @"signed transaction should have no failures");
+    }
+
+    [self breakSignatureOfInput:tx.inputs[11]];
+    [self breakSignatureOfInput:tx.inputs[3]];
+
+    for (NSNumber* concurrency in @[@1, @4, @32]) {
+        BTCScriptVerifier* verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:[self lookupForTransaction:funding]];
+        verifier.maxConcurrentOperationCount = concurrency.unsignedIntegerValue;
+
+        NSError* error = nil;
+        NSAssert(![verifier verifyTransaction:tx error:&error], @"should detect invalid signatures");
+        NSAssert(error.code == BTCErrorScriptError, @"should return script error");
+        NSAssert([error.userInfo[BTCScriptVerifierInputIndexKey] isEqual:@3], @"should report the first failed input");
+
+        NSArray* failures = [verifier failuresForTransaction:tx];
+        NSAssert(failures.count == 2, @"should report all failures");
+        NSAssert([[failures valueForKeyPath:@"userInfo.BTCScriptVerifierInputIndex"] isEqual:(@[@3, @11])], @"failures should be sorted by input index");
+    }
+
+    // Missing outputs are reported as failures.
+    BTCScriptVerifier* verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:^BTCTransactionOutput*(BTCOutpoint* outpoint) {
+        return nil;
+    }];
+    NSAssert([verifier failuresForTransaction:tx].count == 16, @"every input should fail without spent outputs");
+}
+
++ (void) testSignatureCache {
+    BTCTransaction* funding = nil;
+    BTCTransaction* tx = [self signedTransactionWithInputs:16 funding:&funding];
+
+    BTCSignatureCache* cache = [[BTCSignatureCache alloc] init];
+    BTCScriptVerifier* verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:[self lookupForTransaction:funding]];
+    verifier.signatureCache = cache;
+
+    CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+    NSAssert([verifier verifyTransaction:tx error:NULL], @"should verify transaction");
+    CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+    NSAssert(cache.hits == 0 && cache.misses == 16 && cache.count == 16, @"all signatures should be added to the cache");
+
+    NSAssert([verifier verifyTransaction:tx error:NULL], @"should verify transaction again");
+    CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+    NSAssert(cache.hits == 16, @"all signatures should be found in the cache");
+    NSLog(@"BTCScriptVerifier: 16 inputs verified in %.4f sec without cache and %.4f sec with cache.", t1 - t0, t2 - t1);
+
+    // Invalid signatures are not cached.
+    [self breakSignatureOfInput:tx.inputs[5]];
+    NSAssert(![verifier verifyTransaction:tx error:NULL], @"cache should not make invalid signature valid");
+    NSAssert(cache.count == 16, @"invalid signature should not be cached");
+}
+
++ (void) testBlockVerification {
+    BTCTransaction* funding = nil;
+    BTCTransaction* tx = [self signedTransactionWithInputs:8 funding:&funding];
+
+    BTCTransaction* coinbase = [[BTCTransaction alloc] init];
+    BTCTransactionInput* coinbaseInput = [[BTCTransactionInput alloc] init];
+    coinbaseInput.coinbaseData = BTCDataFromHex(@"0102");
+    [coinbase addInput:coinbaseInput];
+    [coinbase addOutput:[[BTCTransactionOutput alloc] initWithValue:50]];
+
+    BTCBlock* block = [[BTCBlock alloc] init];
+    block.transactions = @[coinbase, funding, tx];
+
+    // Funding transaction spends an unknown output, but the main transaction spends outputs created in the same block.
+    __block NSUInteger lookups = 0;
+    BTCScriptVerifier* verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:^BTCTransactionOutput*(BTCOutpoint* outpoint) {
+        lookups++;
+        return nil;
+    }];
+
+    NSArray* failures = [verifier failuresForBlock:block];
+    NSAssert(lookups == 1, @"only the output spent by the funding transaction should be looked up");
+    NSAssert(failures.count == 1, @"only funding transaction should fail");
+    NSAssert([[failures[0] userInfo][BTCScriptVerifierTransactionIndexKey] isEqual:@1], @"should report transaction index");
+
+    block.transactions = @[coinbase, tx];
+    verifier = [[BTCScriptVerifier alloc] initWithOutputLookup:[self lookupForTransaction:funding]];
+    NSError* error = nil;
+    NSAssert([verifier verifyBlock:block error:&error], @"block with valid transaction should be valid");
+}
+
+@end
@@ -0,0 +1,62 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+#import "BTCScriptMachine.h"
+
+@class BTCBlock;
+@class BTCSignatureCache;
+@class BTCOutpoint;
+@class BTCTransaction;
+@class BTCTransactionOutput;
+
+// Keys in the userInfo of verification errors.
+extern NSString* const BTCScriptVerifierTransactionIndexKey; // NSNumber with index of the transaction in the block
+extern NSString* const BTCScriptVerifierInputIndexKey;       // NSNumber with index of the failed input in the transaction
+
+// Returns the output referenced by the outpoint or nil if it is not available.
+// Called on the thread that invoked verification, never concurrently.
+typedef BTCTransactionOutput* (^BTCScriptVerifierOutputLookup)(BTCOutpoint* outpoint);
+
+// Verifies input scripts of a transaction or a block with BTCScriptMachine.
+// Spent outputs are resolved serially via the lookup block, then scripts are checked
+// concurrently on a global GCD queue. Only scripts are verified: amounts, double spends and
+// other consensus rules are out of scope.
+@interface BTCScriptVerifier : NSObject
+
+// Block used to find outputs spent by the inputs.
+@property(nonatomic, readonly) BTCScriptVerifierOutputLookup outputLookup;
+
+// Flags passed to every BTCScriptMachine. Default is 0.
+@property(nonatomic) BTCScriptVerification verificationFlags;
+
+// Timestamp passed to every BTCScriptMachine to select protocol rules.
+// Default is 0 which means the machine's default (current time).
+// When verifying a block, the block's timestamp is used instead.
+@property(nonatomic) uint32_t blockTimestamp;
+
+// Optional signature cache shared by all script machines. Default is nil.
+@property(nonatomic) BTCSignatureCache* signatureCache;
+
+// Maximum number of scripts verified at the same time.
+// Default is the number of active processors. Set to 1 to verify serially on the calling thread.
+@property(nonatomic) NSUInteger maxConcurrentOperationCount;
+
+- (id) initWithOutputLookup:(BTCScriptVerifierOutputLookup)outputLookup;
+
+// Returns YES if all inputs are valid.
+// Otherwise returns NO and sets the error for the failed input with the lowest index.
+// Inputs after the failed one may be skipped.
+- (BOOL) verifyTransaction:(BTCTransaction*)tx error:(NSError**)errorOut;
+
+// Verifies all inputs and returns an array of errors sorted by input index. Empty array if all inputs are valid.
+- (NSArray* /* [NSError] */) failuresForTransaction:(BTCTransaction*)tx;
+
+// Verifies all transactions in the block except for the coinbase.
+// Outputs of preceding transactions in the same block are resolved without calling the lookup block.
+// Returns NO and sets the error for the first failed input in block order.
+- (BOOL) verifyBlock:(BTCBlock*)block error:(NSError**)errorOut;
+
+// Verifies all transactions in the block and returns an array of errors sorted by transaction and input index.
+- (NSArray* /* [NSError] */) failuresForBlock:(BTCBlock*)block;
+
+@end
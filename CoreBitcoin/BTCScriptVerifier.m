@@ -0,0 +1,194 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCScriptVerifier.h"
+#import "BTCScriptMachine.h"
+#import "BTCBlock.h"
+#import "BTCBlockHeader.h"
+#import "BTCTransaction.h"
+#import "BTCTransactionInput.h"
+#import "BTCTransactionOutput.h"
+#import "BTCOutpoint.h"
+#import "BTCErrors.h"
+#import <libkern/OSAtomic.h>
+
+NSString* const BTCScriptVerifierTransactionIndexKey = @"BTCScriptVerifierTransactionIndex";
+NSString* const BTCScriptVerifierInputIndexKey = @"BTCScriptVerifierInputIndex";
+
+// Single input to verify. Error is written only by the thread that runs the check.
+@interface BTCScriptVerificationJob : NSObject
+@property(nonatomic) BTCTransaction* transaction;
+@property(nonatomic) NSUInteger transactionIndex; // NSNotFound when verifying a standalone transaction
+@property(nonatomic) uint32_t inputIndex;
+@property(nonatomic) BTCScript* outputScript;
+@property(nonatomic) uint32_t blockTimestamp;
+@property(nonatomic) NSError* error;
+@end
+
+@implementation BTCScriptVerificationJob
+@end
+
+@implementation BTCScriptVerifier
+
+- (id) initWithOutputLookup:(BTCScriptVerifierOutputLookup)outputLookup {
+    if (self = [super init]) {
+        _outputLookup = [outputLookup copy];
+        _maxConcurrentOperationCount = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    return self;
+}
+
+- (BOOL) verifyTransaction:(BTCTransaction*)tx error:(NSError**)errorOut {
+    NSArray* jobs = [self jobsForTransaction:tx transactionIndex:NSNotFound timestamp:_blockTimestamp outputs:nil];
+    NSError* error = [[self runJobs:jobs stopOnFirstFailure:YES] firstObject];
+    if (error) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    return YES;
+}
+
+- (NSArray*) failuresForTransaction:(BTCTransaction*)tx {
+    NSArray* jobs = [self jobsForTransaction:tx transactionIndex:NSNotFound timestamp:_blockTimestamp outputs:nil];
+    return [self runJobs:jobs stopOnFirstFailure:NO];
+}
+
+- (BOOL) verifyBlock:(BTCBlock*)block error:(NSError**)errorOut {
+    NSError* error = [[self runJobs:[self jobsForBlock:block] stopOnFirstFailure:YES] firstObject];
+    if (error) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    return YES;
+}
+
+- (NSArray*) failuresForBlock:(BTCBlock*)block {
+    return [self runJobs:[self jobsForBlock:block] stopOnFirstFailure:NO];
+}
+
+
+
+#pragma mark - Jobs
+
+
+- (NSArray*) jobsForBlock:(BTCBlock*)block {
+    NSMutableArray* jobs = [NSMutableArray array];
+
+    // Outputs created in this block can be spent by the following transactions.
+    NSMutableDictionary* blockOutputs = [NSMutableDictionary dictionary];
+
+    NSUInteger txIndex = 0;
+    for (BTCTransaction* tx in block.transactions) {
+        if (!tx.isCoinbase) {
+            [jobs addObjectsFromArray:[self jobsForTransaction:tx transactionIndex:txIndex timestamp:block.header.time outputs:blockOutputs]];
+        }
+        NSData* txhash = tx.transactionHash;
+        uint32_t outputIndex = 0;
+        for (BTCTransactionOutput* txout in tx.outputs) {
+            blockOutputs[[[BTCOutpoint alloc] initWithHash:txhash index:outputIndex]] = txout;
+            outputIndex++;
+        }
+        txIndex++;
+    }
+    return jobs;
+}
+
+- (NSArray*) jobsForTransaction:(BTCTransaction*)tx transactionIndex:(NSUInteger)txIndex timestamp:(uint32_t)timestamp outputs:(NSDictionary*)blockOutputs {
+    NSMutableArray* jobs = [NSMutableArray arrayWithCapacity:tx.inputs.count];
+    uint32_t inputIndex = 0;
+    for (BTCTransactionInput* txin in tx.inputs) {
+        BTCScriptVerificationJob* job = [[BTCScriptVerificationJob alloc] init];
+        job.transaction = tx;
+        job.transactionIndex = txIndex;
+        job.inputIndex = inputIndex;
+        job.blockTimestamp = timestamp;
+
+        BTCOutpoint* outpoint = txin.outpoint;
+        BTCTransactionOutput* txout = blockOutputs[outpoint];
+        if (!txout && _outputLookup) {
+            txout = _outputLookup(outpoint);
+        }
+        job.outputScript = txout.script;
+        if (!job.outputScript) {
+            job.error = [self errorForJob:job underlyingError:nil description:
+                         [NSString stringWithFormat:NSLocalizedString(@"Output %@:%@ spent by input %@ is not available.", @""),
+                          outpoint.txID, @(outpoint.index), @(inputIndex)]];
+        }
+        [jobs addObject:job];
+        inputIndex++;
+    }
+    return jobs;
+}
+
+- (NSError*) errorForJob:(BTCScriptVerificationJob*)job underlyingError:(NSError*)underlyingError description:(NSString*)description {
+    NSMutableDictionary* userInfo = [NSMutableDictionary dictionary];
+    userInfo[NSLocalizedDescriptionKey] = description ?: underlyingError.localizedDescription ?: NSLocalizedString(@"Script verification failed.", @"");
+    userInfo[BTCScriptVerifierInputIndexKey] = @(job.inputIndex);
+    if (job.transactionIndex != NSNotFound) {
+        userInfo[BTCScriptVerifierTransactionIndexKey] = @(job.transactionIndex);
+    }
+    if (underlyingError) {
+        userInfo[NSUnderlyingErrorKey] = underlyingError;
+    }
+    return [NSError errorWithDomain:BTCErrorDomain code:BTCErrorScriptError userInfo:userInfo];
+}
+
+- (BOOL) runJob:(BTCScriptVerificationJob*)job {
+    if (job.error) return NO;
+
+    BTCScriptMachine* sm = [[BTCScriptMachine alloc] initWithTransaction:job.transaction inputIndex:job.inputIndex];
+    sm.verificationFlags = _verificationFlags;
+    sm.signatureCache = _signatureCache;
+    if (job.blockTimestamp > 0) sm.blockTimestamp = job.blockTimestamp;
+
+    NSError* error = nil;
+    if (![sm verifyWithOutputScript:job.outputScript error:&error]) {
+        job.error = [self errorForJob:job underlyingError:error description:nil];
+        return NO;
+    }
+    return YES;
+}
+
+// Runs jobs on up to maxConcurrentOperationCount threads and returns errors in the order of jobs.
+// Workers take jobs in order, so when stopping on the first failure, we only skip jobs after the failed one
+// and the returned error is the same as if all jobs were verified serially.
+- (NSArray*) runJobs:(NSArray*)jobs stopOnFirstFailure:(BOOL)stopOnFirstFailure {
+    NSUInteger count = jobs.count;
+    NSUInteger workers = MIN(MAX(_maxConcurrentOperationCount, 1), count);
+
+    __block volatile int64_t nextIndex = -1;
+    __block volatile int64_t firstFailure = INT64_MAX;
+
+    void (^worker)(size_t) = ^(size_t w) {
+        while (YES) {
+            int64_t i = OSAtomicIncrement64Barrier(&nextIndex);
+            if (i >= (int64_t)count) break;
+            if (stopOnFirstFailure && i > firstFailure) break;
+
+            @autoreleasepool {
+                if (![self runJob:jobs[(NSUInteger)i]]) {
+                    int64_t failure = firstFailure;
+                    while (i < failure && !OSAtomicCompareAndSwap64Barrier(failure, i, &firstFailure)) {
+                        failure = firstFailure;
+                    }
+                }
+            }
+        }
+    };
+
+    if (workers <= 1) {
+        if (count > 0) worker(0);
+    } else {
+        dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), worker);
+    }
+
+    NSMutableArray* errors = [NSMutableArray array];
+    for (BTCScriptVerificationJob* job in jobs) {
+        if (job.error) {
+            [errors addObject:job.error];
+            if (stopOnFirstFailure) break;
+        }
+    }
+    return errors;
+}
+
+@end
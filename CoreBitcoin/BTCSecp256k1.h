@@ -0,0 +1,86 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+
+// Change to 0 to exclude the native secp256k1 implementation from the build.
+// The native implementation also requires 128-bit integers which are available on all 64-bit targets.
+#define BTCSecp256k1NativeEnabled 1
+
+// Change to 1 to make BTCKey and BTCCurvePoint use the native implementation by default.
+#define BTCSecp256k1NativeByDefault 0
+
+#if BTCSecp256k1NativeEnabled && defined(__SIZEOF_INT128__)
+#define BTCSecp256k1NativeAvailable 1
+#else
+#define BTCSecp256k1NativeAvailable 0
+#endif
+
+// Implementations of elliptic curve operations used by BTCKey and BTCCurvePoint.
+typedef NS_ENUM(NSInteger, BTCSecp256k1Backend) {
+    // Generic elliptic curve code from OpenSSL.
+    BTCSecp256k1BackendOpenSSL = 0,
+
+    // Specialized implementation of secp256k1 in this file: 5x52-bit field, 4x64-bit scalars,
+    // endomorphism-accelerated verification and constant-time signing and key derivation.
+    BTCSecp256k1BackendNative = 1,
+};
+
+// Returns the backend currently used by BTCKey and BTCCurvePoint.
+BTCSecp256k1Backend BTCSecp256k1GetBackend(void);
+
+// Switches the backend for all keys and points. Returns NO if the backend is not available in this build.
+// Keys and signatures are interchangeable between backends, so switching is safe at any time.
+BOOL BTCSecp256k1SetBackend(BTCSecp256k1Backend backend);
+
+
+#if BTCSecp256k1NativeAvailable
+
+// Affine point on secp256k1 in internal representation. Never a point at infinity.
+// Functions below return NO instead of producing a point at infinity.
+typedef struct {
+    uint64_t x[5];
+    uint64_t y[5];
+} BTCSecp256k1Point;
+
+// Parses a public key: 33-byte compressed (02/03), 65-byte uncompressed (04) or hybrid (06/07) form.
+// Returns NO if the encoding is invalid or the point is not on the curve.
+BOOL BTCSecp256k1PointParse(BTCSecp256k1Point* point, const unsigned char* bytes, size_t length);
+
+// Writes 33 bytes of compressed or 65 bytes of uncompressed public key.
+void BTCSecp256k1PointSerialize(unsigned char* output, const BTCSecp256k1Point* point, BOOL compressed);
+
+// Computes scalar*G for a 32-byte big-endian scalar in constant time. Scalar is taken modulo the curve order.
+// Returns NO if the scalar is zero modulo the curve order.
+BOOL BTCSecp256k1GeneratorMultiply(BTCSecp256k1Point* result, const unsigned char* scalar32);
+
+// Computes scalar*point in constant time. Scalar is taken modulo the curve order.
+// Returns NO if the scalar is zero modulo the curve order.
+BOOL BTCSecp256k1PointMultiply(BTCSecp256k1Point* point, const unsigned char* scalar32);
+
+// Adds other point to the point. Returns NO if the sum is a point at infinity.
+BOOL BTCSecp256k1PointAdd(BTCSecp256k1Point* point, const BTCSecp256k1Point* other);
+
+// Computes point + scalar*G. Scalar multiplication is done in constant time.
+// Returns NO if the result is a point at infinity.
+BOOL BTCSecp256k1PointAddGeneratorMultiple(BTCSecp256k1Point* point, const unsigned char* scalar32);
+
+// Creates an ECDSA signature (r, s) for a 32-byte hash with a private key and a nonce (both must be in [1, n-1]).
+// S is always in the lower half of the curve order. Recovery id (0..3) is written to recid if it is not NULL.
+// Runs in constant time with respect to the private key and the nonce.
+BOOL BTCSecp256k1Sign(unsigned char* r32, unsigned char* s32, int* recid, const unsigned char* hash32, const unsigned char* seckey32, const unsigned char* nonce32);
+
+// Verifies an ECDSA signature (r, s) for a 32-byte hash. Both high and low S values are accepted.
+BOOL BTCSecp256k1Verify(const unsigned char* r32, const unsigned char* s32, const unsigned char* hash32, const BTCSecp256k1Point* pubkey);
+
+// Recovers a public key from an ECDSA signature and recovery id (0..3).
+BOOL BTCSecp256k1Recover(BTCSecp256k1Point* pubkey, const unsigned char* r32, const unsigned char* s32, const unsigned char* hash32, int recid);
+
+// Parses a strict DER-encoded signature into 32-byte big-endian r and s.
+// Accepts exactly the signatures OpenSSL accepts for verification: non-negative, minimally encoded integers
+// without trailing data. Returns NO for values that do not fit in 32 bytes (they can never be valid).
+BOOL BTCSecp256k1ParseDERSignature(unsigned char* r32, unsigned char* s32, const unsigned char* der, size_t length);
+
+// Writes a DER-encoded signature (up to 72 bytes) and returns its length.
+size_t BTCSecp256k1SerializeDERSignature(unsigned char* output, const unsigned char* r32, const unsigned char* s32);
+
+#endif
@@ -0,0 +1,1422 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCSecp256k1.h"
+#import "BTCData.h"
+
+static volatile BTCSecp256k1Backend BTCSecp256k1CurrentBackend = (BTCSecp256k1NativeByDefault && BTCSecp256k1NativeAvailable) ? BTCSecp256k1BackendNative : BTCSecp256k1BackendOpenSSL;
+
+BTCSecp256k1Backend BTCSecp256k1GetBackend(void) {
+    return BTCSecp256k1CurrentBackend;
+}
+
+BOOL BTCSecp256k1SetBackend(BTCSecp256k1Backend backend) {
+    if (backend == BTCSecp256k1BackendNative && !BTCSecp256k1NativeAvailable) return NO;
+    if (backend != BTCSecp256k1BackendNative && backend != BTCSecp256k1BackendOpenSSL) return NO;
+    BTCSecp256k1CurrentBackend = backend;
+    return YES;
+}
+
+
+#if BTCSecp256k1NativeAvailable
+
+#include <pthread.h>
+#include <string.h>
+
+typedef unsigned __int128 BTCUInt128;
+
+
+
+
+#pragma mark - Field
+
+
+
+// Element of the field modulo p = 2^256 - 2^32 - 977 in five 52-bit limbs (little-endian).
+// All functions accept and return "weakly normalized" elements: limbs are below 2^53 and the top limb is below 2^49.
+// Such element may be not fully reduced, so use BTCFieldNormalize before comparing or serializing it.
+typedef struct {
+    uint64_t n[5];
+} BTCField;
+
+#define BTCFieldMask52 0xFFFFFFFFFFFFFULL
+#define BTCFieldMask48 0xFFFFFFFFFFFFULL
+
+// 2^256 mod p
+#define BTCFieldR 0x1000003D1ULL
+
+// 2^260 mod p
+#define BTCFieldR4 0x1000003D10ULL
+
+// 4*p in the limb representation. Used to subtract without going negative.
+static const uint64_t BTCField4P[5] = {
+    0xFFFFEFFFFFC2FULL * 4, BTCFieldMask52 * 4, BTCFieldMask52 * 4, BTCFieldMask52 * 4, BTCFieldMask48 * 4
+};
+
+static inline void BTCFieldSetInt(BTCField* r, uint64_t a) {
+    r->n[0] = a;
+    r->n[1] = r->n[2] = r->n[3] = r->n[4] = 0;
+}
+
+// Brings limbs below 2^62 into the weakly normalized range.
+static inline void BTCFieldWeakNormalize(BTCField* r) {
+    uint64_t t0 = r->n[0], t1 = r->n[1], t2 = r->n[2], t3 = r->n[3], t4 = r->n[4];
+    t1 += t0 >> 52; t0 &= BTCFieldMask52;
+    t2 += t1 >> 52; t1 &= BTCFieldMask52;
+    t3 += t2 >> 52; t2 &= BTCFieldMask52;
+    t4 += t3 >> 52; t3 &= BTCFieldMask52;
+    uint64_t x = t4 >> 48; t4 &= BTCFieldMask48;
+    t0 += x * BTCFieldR;
+    t1 += t0 >> 52; t0 &= BTCFieldMask52;
+    r->n[0] = t0; r->n[1] = t1; r->n[2] = t2; r->n[3] = t3; r->n[4] = t4;
+}
+
+// Fully reduces the element modulo p. Constant time.
+static void BTCFieldNormalize(BTCField* r) {
+    uint64_t t0 = r->n[0], t1 = r->n[1], t2 = r->n[2], t3 = r->n[3], t4 = r->n[4];
+
+    // Fold everything above 2^256 twice: the second time at most 1 is carried over.
+    for (int i = 0; i < 2; i++) {
+        t1 += t0 >> 52; t0 &= BTCFieldMask52;
+        t2 += t1 >> 52; t1 &= BTCFieldMask52;
+        t3 += t2 >> 52; t2 &= BTCFieldMask52;
+        t4 += t3 >> 52; t3 &= BTCFieldMask52;
+        uint64_t x = t4 >> 48; t4 &= BTCFieldMask48;
+        t0 += x * BTCFieldR;
+    }
+    t1 += t0 >> 52; t0 &= BTCFieldMask52;
+    t2 += t1 >> 52; t1 &= BTCFieldMask52;
+    t3 += t2 >> 52; t2 &= BTCFieldMask52;
+    t4 += t3 >> 52; t3 &= BTCFieldMask52;
+
+    // Now the value is below 2^256. Subtract p if it is not below p, i.e. if value + (2^256 - p) overflows.
+    uint64_t u0 = t0 + BTCFieldR;
+    uint64_t u1 = t1 + (u0 >> 52); u0 &= BTCFieldMask52;
+    uint64_t u2 = t2 + (u1 >> 52); u1 &= BTCFieldMask52;
+    uint64_t u3 = t3 + (u2 >> 52); u2 &= BTCFieldMask52;
+    uint64_t u4 = t4 + (u3 >> 52); u3 &= BTCFieldMask52;
+    uint64_t mask = 0 - (u4 >> 48);
+    u4 &= BTCFieldMask48;
+
+    r->n[0] = (u0 & mask) | (t0 & ~mask);
+    r->n[1] = (u1 & mask) | (t1 & ~mask);
+    r->n[2] = (u2 & mask) | (t2 & ~mask);
+    r->n[3] = (u3 & mask) | (t3 & ~mask);
+    r->n[4] = (u4 & mask) | (t4 & ~mask);
+}
+
+// Loads a 32-byte big-endian number. Returns NO (leaving the value unreduced) if it is not below p.
+static BOOL BTCFieldSetBytes(BTCField* r, const unsigned char* b32) {
+    uint64_t w[4];
+    for (int i = 0; i < 4; i++) {
+        const unsigned char* b = b32 + 24 - 8 * i;
+        w[i] = ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48) | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32) |
+               ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16) | ((uint64_t)b[6] << 8) | (uint64_t)b[7];
+    }
+    r->n[0] = w[0] & BTCFieldMask52;
+    r->n[1] = ((w[0] >> 52) | (w[1] << 12)) & BTCFieldMask52;
+    r->n[2] = ((w[1] >> 40) | (w[2] << 24)) & BTCFieldMask52;
+    r->n[3] = ((w[2] >> 28) | (w[3] << 36)) & BTCFieldMask52;
+    r->n[4] = w[3] >> 16;
+    // p = FFFFFFFF FFFFFFFF FFFFFFFF FFFFFFFF FFFFFFFF FFFFFFFF FFFFFFFE FFFFFC2F
+    return !(w[3] == UINT64_MAX && w[2] == UINT64_MAX && w[1] == UINT64_MAX && w[0] >= 0xFFFFFFFEFFFFFC2FULL);
+}
+
+// Writes a normalized element as 32-byte big-endian number.
+static void BTCFieldGetBytes(unsigned char* b32, const BTCField* a) {
+    uint64_t w[4];
+    w[0] = a->n[0] | (a->n[1] << 52);
+    w[1] = (a->n[1] >> 12) | (a->n[2] << 40);
+    w[2] = (a->n[2] >> 24) | (a->n[3] << 28);
+    w[3] = (a->n[3] >> 36) | (a->n[4] << 16);
+    for (int i = 0; i < 4; i++) {
+        unsigned char* b = b32 + 24 - 8 * i;
+        for (int j = 0; j < 8; j++) b[j] = (unsigned char)(w[i] >> (56 - 8 * j));
+    }
+}
+
+static inline BOOL BTCFieldIsZero(const BTCField* a) {
+    BTCField t = *a;
+    BTCFieldNormalize(&t);
+    return (t.n[0] | t.n[1] | t.n[2] | t.n[3] | t.n[4]) == 0;
+}
+
+static inline BOOL BTCFieldIsOdd(const BTCField* a) {
+    BTCField t = *a;
+    BTCFieldNormalize(&t);
+    return t.n[0] & 1;
+}
+
+static inline BOOL BTCFieldEqual(const BTCField* a, const BTCField* b) {
+    BTCField x = *a, y = *b;
+    BTCFieldNormalize(&x);
+    BTCFieldNormalize(&y);
+    return ((x.n[0] ^ y.n[0]) | (x.n[1] ^ y.n[1]) | (x.n[2] ^ y.n[2]) | (x.n[3] ^ y.n[3]) | (x.n[4] ^ y.n[4])) == 0;
+}
+
+static inline void BTCFieldAdd(BTCField* r, const BTCField* a, const BTCField* b) {
+    for (int i = 0; i < 5; i++) r->n[i] = a->n[i] + b->n[i];
+    BTCFieldWeakNormalize(r);
+}
+
+static inline void BTCFieldSub(BTCField* r, const BTCField* a, const BTCField* b) {
+    for (int i = 0; i < 5; i++) r->n[i] = a->n[i] + BTCField4P[i] - b->n[i];
+    BTCFieldWeakNormalize(r);
+}
+
+static inline void BTCFieldNegate(BTCField* r, const BTCField* a) {
+    for (int i = 0; i < 5; i++) r->n[i] = BTCField4P[i] - a->n[i];
+    BTCFieldWeakNormalize(r);
+}
+
+// Multiplies by a small integer (up to 512).
+static inline void BTCFieldMulInt(BTCField* r, const BTCField* a, uint64_t k) {
+    for (int i = 0; i < 5; i++) r->n[i] = a->n[i] * k;
+    BTCFieldWeakNormalize(r);
+}
+
+// Reduces a product given as nine 128-bit column sums.
+static inline void BTCFieldReduce(BTCField* r, BTCUInt128 c[9]) {
+    uint64_t d[10];
+    for (int i = 0; i < 8; i++) {
+        c[i + 1] += c[i] >> 52;
+        d[i] = (uint64_t)c[i] & BTCFieldMask52;
+    }
+    d[8] = (uint64_t)c[8] & BTCFieldMask52;
+    d[9] = (uint64_t)(c[8] >> 52);
+
+    // Limbs 5..9 have weight 2^260 * 2^(52*(i-5)), and 2^260 = BTCFieldR4 (mod p).
+    BTCUInt128 r0 = (BTCUInt128)d[5] * BTCFieldR4 + d[0];
+    BTCUInt128 r1 = (BTCUInt128)d[6] * BTCFieldR4 + d[1];
+    BTCUInt128 r2 = (BTCUInt128)d[7] * BTCFieldR4 + d[2];
+    BTCUInt128 r3 = (BTCUInt128)d[8] * BTCFieldR4 + d[3];
+    BTCUInt128 r4 = (BTCUInt128)d[9] * BTCFieldR4 + d[4];
+
+    r1 += r0 >> 52; r0 &= BTCFieldMask52;
+    r2 += r1 >> 52; r1 &= BTCFieldMask52;
+    r3 += r2 >> 52; r2 &= BTCFieldMask52;
+    r4 += r3 >> 52; r3 &= BTCFieldMask52;
+
+    // Bits above 2^256 are folded back with 2^256 = BTCFieldR (mod p).
+    r0 += (r4 >> 48) * BTCFieldR; r4 &= BTCFieldMask48;
+    r1 += r0 >> 52; r0 &= BTCFieldMask52;
+    r2 += r1 >> 52; r1 &= BTCFieldMask52;
+
+    r->n[0] = (uint64_t)r0; r->n[1] = (uint64_t)r1; r->n[2] = (uint64_t)r2; r->n[3] = (uint64_t)r3; r->n[4] = (uint64_t)r4;
+}
+
+static void BTCFieldMul(BTCField* r, const BTCField* a, const BTCField* b) {
+    const uint64_t* x = a->n;
+    const uint64_t* y = b->n;
+    BTCUInt128 c[9];
+    c[0] = (BTCUInt128)x[0] * y[0];
+    c[1] = (BTCUInt128)x[0] * y[1] + (BTCUInt128)x[1] * y[0];
+    c[2] = (BTCUInt128)x[0] * y[2] + (BTCUInt128)x[1] * y[1] + (BTCUInt128)x[2] * y[0];
+    c[3] = (BTCUInt128)x[0] * y[3] + (BTCUInt128)x[1] * y[2] + (BTCUInt128)x[2] * y[1] + (BTCUInt128)x[3] * y[0];
+    c[4] = (BTCUInt128)x[0] * y[4] + (BTCUInt128)x[1] * y[3] + (BTCUInt128)x[2] * y[2] + (BTCUInt128)x[3] * y[1] + (BTCUInt128)x[4] * y[0];
+    c[5] = (BTCUInt128)x[1] * y[4] + (BTCUInt128)x[2] * y[3] + (BTCUInt128)x[3] * y[2] + (BTCUInt128)x[4] * y[1];
+    c[6] = (BTCUInt128)x[2] * y[4] + (BTCUInt128)x[3] * y[3] + (BTCUInt128)x[4] * y[2];
+    c[7] = (BTCUInt128)x[3] * y[4] + (BTCUInt128)x[4] * y[3];
+    c[8] = (BTCUInt128)x[4] * y[4];
+    BTCFieldReduce(r, c);
+}
+
+static void BTCFieldSqr(BTCField* r, const BTCField* a) {
+    const uint64_t* x = a->n;
+    uint64_t x0d = x[0] * 2, x1d = x[1] * 2, x2d = x[2] * 2, x3d = x[3] * 2;
+    BTCUInt128 c[9];
+    c[0] = (BTCUInt128)x[0] * x[0];
+    c[1] = (BTCUInt128)x0d * x[1];
+    c[2] = (BTCUInt128)x0d * x[2] + (BTCUInt128)x[1] * x[1];
+    c[3] = (BTCUInt128)x0d * x[3] + (BTCUInt128)x1d * x[2];
+    c[4] = (BTCUInt128)x0d * x[4] + (BTCUInt128)x1d * x[3] + (BTCUInt128)x[2] * x[2];
+    c[5] = (BTCUInt128)x1d * x[4] + (BTCUInt128)x2d * x[3];
+    c[6] = (BTCUInt128)x2d * x[4] + (BTCUInt128)x[3] * x[3];
+    c[7] = (BTCUInt128)x3d * x[4];
+    c[8] = (BTCUInt128)x[4] * x[4];
+    BTCFieldReduce(r, c);
+}
+
+static inline void BTCFieldSqrTimes(BTCField* r, const BTCField* a, int times) {
+    *r = *a;
+    for (int i = 0; i < times; i++) BTCFieldSqr(r, r);
+}
+
+// Computes a^(2^223 - 1) and a few smaller powers shared by inversion and square root.
+// Blocks of ones in binary p - 2 and (p + 1)/4 have lengths 1, 2, 22 and 223.
+static void BTCFieldPowerChain(BTCField* x2, BTCField* x22, BTCField* x223, const BTCField* a) {
+    BTCField x3, x6, x9, x11, x44, x88, x176, x220, t;
+    BTCFieldSqr(x2, a);          BTCFieldMul(x2, x2, a);
+    BTCFieldSqr(&x3, x2);        BTCFieldMul(&x3, &x3, a);
+    BTCFieldSqrTimes(&t, &x3, 3);   BTCFieldMul(&x6, &t, &x3);
+    BTCFieldSqrTimes(&t, &x6, 3);   BTCFieldMul(&x9, &t, &x3);
+    BTCFieldSqrTimes(&t, &x9, 2);   BTCFieldMul(&x11, &t, x2);
+    BTCFieldSqrTimes(&t, &x11, 11); BTCFieldMul(x22, &t, &x11);
+    BTCFieldSqrTimes(&t, x22, 22);  BTCFieldMul(&x44, &t, x22);
+    BTCFieldSqrTimes(&t, &x44, 44); BTCFieldMul(&x88, &t, &x44);
+    BTCFieldSqrTimes(&t, &x88, 88); BTCFieldMul(&x176, &t, &x88);
+    BTCFieldSqrTimes(&t, &x176, 44); BTCFieldMul(&x220, &t, &x44);
+    BTCFieldSqrTimes(&t, &x220, 3); BTCFieldMul(x223, &t, &x3);
+}
+
+// r = a^(p - 2) = 1/a. Constant time. Inverse of zero is zero.
+static void BTCFieldInverse(BTCField* r, const BTCField* a) {
+    BTCField x2, x22, x223, t;
+    BTCFieldPowerChain(&x2, &x22, &x223, a);
+    BTCFieldSqrTimes(&t, &x223, 23); BTCFieldMul(&t, &t, &x22);
+    BTCFieldSqrTimes(&t, &t, 5);     BTCFieldMul(&t, &t, a);
+    BTCFieldSqrTimes(&t, &t, 3);     BTCFieldMul(&t, &t, &x2);
+    BTCFieldSqrTimes(&t, &t, 2);     BTCFieldMul(r, &t, a);
+}
+
+// r = a^((p + 1)/4). Returns YES if r is a square root of a.
+static BOOL BTCFieldSqrt(BTCField* r, const BTCField* a) {
+    BTCField x2, x22, x223, t, check;
+    BTCFieldPowerChain(&x2, &x22, &x223, a);
+    BTCFieldSqrTimes(&t, &x223, 23); BTCFieldMul(&t, &t, &x22);
+    BTCFieldSqrTimes(&t, &t, 6);     BTCFieldMul(&t, &t, &x2);
+    BTCFieldSqrTimes(r, &t, 2);
+    BTCFieldSqr(&check, r);
+    return BTCFieldEqual(&check, a);
+}
+
+static inline void BTCFieldConditionalMove(BTCField* r, const BTCField* a, uint64_t flag) {
+    uint64_t mask = 0 - flag;
+    for (int i = 0; i < 5; i++) r->n[i] = (r->n[i] & ~mask) | (a->n[i] & mask);
+}
+
+
+
+
+#pragma mark - Scalar
+
+
+
+// Integer modulo the curve order n in four 64-bit limbs (little-endian). Always fully reduced.
+typedef struct {
+    uint64_t d[4];
+} BTCScalar;
+
+#define BTCScalarN0 0xBFD25E8CD0364141ULL
+#define BTCScalarN1 0xBAAEDCE6AF48A03BULL
+#define BTCScalarN2 0xFFFFFFFFFFFFFFFEULL
+#define BTCScalarN3 0xFFFFFFFFFFFFFFFFULL
+
+// 2^256 - n
+#define BTCScalarC0 0x402DA1732FC9BEBFULL
+#define BTCScalarC1 0x4551231950B75FC4ULL
+
+// n/2
+#define BTCScalarH0 0xDFE92F46681B20A0ULL
+#define BTCScalarH1 0x5D576E7357A4501DULL
+#define BTCScalarH2 0xFFFFFFFFFFFFFFFFULL
+#define BTCScalarH3 0x7FFFFFFFFFFFFFFFULL
+
+// Returns 1 if the 256-bit value is not below n. Constant time.
+static inline uint64_t BTCScalarCheckOverflow(const uint64_t d[4]) {
+    uint64_t yes = 0, no = 0;
+    no  |= (d[3] < BTCScalarN3);
+    no  |= (d[2] < BTCScalarN2);
+    yes |= (d[2] > BTCScalarN2) & ~no;
+    no  |= (d[1] < BTCScalarN1) & ~yes;
+    yes |= (d[1] > BTCScalarN1) & ~no;
+    yes |= (d[0] >= BTCScalarN0) & ~no;
+    return yes & 1;
+}
+
+// Adds overflow*(2^256 - n) modulo 2^256, i.e. subtracts n if overflow is 1.
+static inline void BTCScalarReduce(BTCScalar* r, uint64_t overflow) {
+    BTCUInt128 t = (BTCUInt128)r->d[0] + overflow * BTCScalarC0;
+    r->d[0] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)r->d[1] + overflow * BTCScalarC1;
+    r->d[1] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)r->d[2] + overflow;
+    r->d[2] = (uint64_t)t; t >>= 64;
+    t += r->d[3];
+    r->d[3] = (uint64_t)t;
+}
+
+// Loads a 32-byte big-endian number modulo n. Returns YES if it was not below n.
+static BOOL BTCScalarSetBytes(BTCScalar* r, const unsigned char* b32) {
+    for (int i = 0; i < 4; i++) {
+        const unsigned char* b = b32 + 24 - 8 * i;
+        r->d[i] = ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48) | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32) |
+                  ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16) | ((uint64_t)b[6] << 8) | (uint64_t)b[7];
+    }
+    uint64_t overflow = BTCScalarCheckOverflow(r->d);
+    BTCScalarReduce(r, overflow);
+    return (BOOL)overflow;
+}
+
+static void BTCScalarGetBytes(unsigned char* b32, const BTCScalar* a) {
+    for (int i = 0; i < 4; i++) {
+        unsigned char* b = b32 + 24 - 8 * i;
+        for (int j = 0; j < 8; j++) b[j] = (unsigned char)(a->d[i] >> (56 - 8 * j));
+    }
+}
+
+static inline BOOL BTCScalarIsZero(const BTCScalar* a) {
+    return (a->d[0] | a->d[1] | a->d[2] | a->d[3]) == 0;
+}
+
+// Returns YES if a > n/2. Constant time.
+static inline BOOL BTCScalarIsHigh(const BTCScalar* a) {
+    uint64_t yes = 0, no = 0;
+    no  |= (a->d[3] < BTCScalarH3);
+    yes |= (a->d[3] > BTCScalarH3) & ~no;
+    no  |= (a->d[2] < BTCScalarH2) & ~yes;
+    no  |= (a->d[1] < BTCScalarH1) & ~yes;
+    yes |= (a->d[1] > BTCScalarH1) & ~no;
+    yes |= (a->d[0] > BTCScalarH0) & ~no;
+    return (BOOL)(yes & 1);
+}
+
+static void BTCScalarAdd(BTCScalar* r, const BTCScalar* a, const BTCScalar* b) {
+    BTCUInt128 t = (BTCUInt128)a->d[0] + b->d[0];
+    r->d[0] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)a->d[1] + b->d[1];
+    r->d[1] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)a->d[2] + b->d[2];
+    r->d[2] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)a->d[3] + b->d[3];
+    r->d[3] = (uint64_t)t; t >>= 64;
+    BTCScalarReduce(r, (uint64_t)t | BTCScalarCheckOverflow(r->d));
+}
+
+// r = -a mod n. Constant time.
+static void BTCScalarNegate(BTCScalar* r, const BTCScalar* a) {
+    uint64_t nonzero = 0 - (uint64_t)!BTCScalarIsZero(a);
+    BTCUInt128 t = (BTCUInt128)(~a->d[0]) + BTCScalarN0 + 1;
+    r->d[0] = (uint64_t)t & nonzero; t >>= 64;
+    t += (BTCUInt128)(~a->d[1]) + BTCScalarN1;
+    r->d[1] = (uint64_t)t & nonzero; t >>= 64;
+    t += (BTCUInt128)(~a->d[2]) + BTCScalarN2;
+    r->d[2] = (uint64_t)t & nonzero; t >>= 64;
+    t += (BTCUInt128)(~a->d[3]) + BTCScalarN3;
+    r->d[3] = (uint64_t)t & nonzero;
+}
+
+// 192-bit accumulator (c0, c1, c2) used for multi-precision multiplication.
+#define BTCAccumulatorMulAdd(a, b) { \
+    BTCUInt128 product = (BTCUInt128)(a) * (b); \
+    uint64_t tl = (uint64_t)product, th = (uint64_t)(product >> 64); \
+    c0 += tl; th += (c0 < tl); \
+    c1 += th; c2 += (c1 < th); \
+}
+#define BTCAccumulatorAdd(a) { \
+    uint64_t value = (a); \
+    c0 += value; c1 += (c0 < value); c2 += (c1 == 0) & (c0 < value); \
+}
+#define BTCAccumulatorExtract(out) { \
+    (out) = c0; c0 = c1; c1 = c2; c2 = 0; \
+}
+
+// Computes 512-bit product of two 256-bit numbers.
+static void BTCScalarMul512(uint64_t l[8], const BTCScalar* a, const BTCScalar* b) {
+    uint64_t c0 = 0, c1 = 0, c2 = 0;
+    for (int k = 0; k < 7; k++) {
+        for (int i = (k < 4 ? 0 : k - 3); i <= (k < 4 ? k : 3); i++) {
+            BTCAccumulatorMulAdd(a->d[i], b->d[k - i]);
+        }
+        BTCAccumulatorExtract(l[k]);
+    }
+    l[7] = c0;
+}
+
+// Reduces a 512-bit number modulo n using 2^256 = 2^256 - n (mod n). Constant time.
+static void BTCScalarReduce512(BTCScalar* r, const uint64_t l[8]) {
+    uint64_t c0, c1, c2;
+    uint64_t m0, m1, m2, m3, m4, m5, m6;
+    uint64_t p0, p1, p2, p3, p4;
+
+    // m = l[0..3] + l[4..7] * (2^256 - n), at most 385 bits.
+    c0 = l[0]; c1 = 0; c2 = 0;
+    BTCAccumulatorMulAdd(l[4], BTCScalarC0);
+    BTCAccumulatorExtract(m0);
+    BTCAccumulatorAdd(l[1]);
+    BTCAccumulatorMulAdd(l[5], BTCScalarC0);
+    BTCAccumulatorMulAdd(l[4], BTCScalarC1);
+    BTCAccumulatorExtract(m1);
+    BTCAccumulatorAdd(l[2]);
+    BTCAccumulatorMulAdd(l[6], BTCScalarC0);
+    BTCAccumulatorMulAdd(l[5], BTCScalarC1);
+    BTCAccumulatorAdd(l[4]);
+    BTCAccumulatorExtract(m2);
+    BTCAccumulatorAdd(l[3]);
+    BTCAccumulatorMulAdd(l[7], BTCScalarC0);
+    BTCAccumulatorMulAdd(l[6], BTCScalarC1);
+    BTCAccumulatorAdd(l[5]);
+    BTCAccumulatorExtract(m3);
+    BTCAccumulatorMulAdd(l[7], BTCScalarC1);
+    BTCAccumulatorAdd(l[6]);
+    BTCAccumulatorExtract(m4);
+    BTCAccumulatorAdd(l[7]);
+    BTCAccumulatorExtract(m5);
+    m6 = c0;
+
+    // p = m[0..3] + m[4..6] * (2^256 - n), at most 258 bits.
+    c0 = m0; c1 = 0; c2 = 0;
+    BTCAccumulatorMulAdd(m4, BTCScalarC0);
+    BTCAccumulatorExtract(p0);
+    BTCAccumulatorAdd(m1);
+    BTCAccumulatorMulAdd(m5, BTCScalarC0);
+    BTCAccumulatorMulAdd(m4, BTCScalarC1);
+    BTCAccumulatorExtract(p1);
+    BTCAccumulatorAdd(m2);
+    BTCAccumulatorMulAdd(m6, BTCScalarC0);
+    BTCAccumulatorMulAdd(m5, BTCScalarC1);
+    BTCAccumulatorAdd(m4);
+    BTCAccumulatorExtract(p2);
+    BTCAccumulatorAdd(m3);
+    BTCAccumulatorMulAdd(m6, BTCScalarC1);
+    BTCAccumulatorAdd(m5);
+    BTCAccumulatorExtract(p3);
+    p4 = c0 + m6;
+
+    // r = p[0..3] + p4 * (2^256 - n), then the final subtraction.
+    BTCUInt128 t = (BTCUInt128)p0 + (BTCUInt128)BTCScalarC0 * p4;
+    r->d[0] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)p1 + (BTCUInt128)BTCScalarC1 * p4;
+    r->d[1] = (uint64_t)t; t >>= 64;
+    t += (BTCUInt128)p2 + p4;
+    r->d[2] = (uint64_t)t; t >>= 64;
+    t += p3;
+    r->d[3] = (uint64_t)t; t >>= 64;
+    BTCScalarReduce(r, (uint64_t)t + BTCScalarCheckOverflow(r->d));
+}
+
+static void BTCScalarMul(BTCScalar* r, const BTCScalar* a, const BTCScalar* b) {
+    uint64_t l[8];
+    BTCScalarMul512(l, a, b);
+    BTCScalarReduce512(r, l);
+}
+
+// r = a^(n - 2) = 1/a with a fixed 4-bit window. The exponent is public, so this is constant time.
+static void BTCScalarInverse(BTCScalar* r, const BTCScalar* a) {
+    static const uint64_t exponent[4] = { BTCScalarN0 - 2, BTCScalarN1, BTCScalarN2, BTCScalarN3 };
+    BTCScalar table[16];
+    table[0].d[0] = 1; table[0].d[1] = table[0].d[2] = table[0].d[3] = 0;
+    for (int i = 1; i < 16; i++) BTCScalarMul(&table[i], &table[i - 1], a);
+
+    BTCScalar t = table[0];
+    for (int i = 63; i >= 0; i--) {
+        for (int j = 0; j < 4; j++) BTCScalarMul(&t, &t, &t);
+        BTCScalarMul(&t, &t, &table[(exponent[i / 16] >> ((i % 16) * 4)) & 15]);
+    }
+    *r = t;
+}
+
+// Returns round(a*b / 2^384) for the endomorphism split.
+static void BTCScalarMulShift384(BTCScalar* r, const BTCScalar* a, const BTCScalar* b) {
+    uint64_t l[8];
+    BTCScalarMul512(l, a, b);
+    BTCUInt128 t = (BTCUInt128)l[6] + (l[5] >> 63);
+    r->d[0] = (uint64_t)t;
+    r->d[1] = l[7] + (uint64_t)(t >> 64);
+    r->d[2] = 0;
+    r->d[3] = 0;
+}
+
+// Constants of the endomorphism lambda*(x, y) = (beta*x, y), where lambda^3 = 1 (mod n) and beta^3 = 1 (mod p).
+static const BTCScalar BTCScalarMinusLambda = {{ 0xE0CFC810B51283CFULL, 0xA880B9FC8EC739C2ULL, 0x5AD9E3FD77ED9BA4ULL, 0xAC9C52B33FA3CF1FULL }};
+static const BTCScalar BTCScalarMinusB1 = {{ 0x6F547FA90ABFE4C3ULL, 0xE4437ED6010E8828ULL, 0, 0 }};
+static const BTCScalar BTCScalarMinusB2 = {{ 0xD765CDA83DB1562CULL, 0x8A280AC50774346DULL, 0xFFFFFFFFFFFFFFFEULL, 0xFFFFFFFFFFFFFFFFULL }};
+static const BTCScalar BTCScalarG1 = {{ 0xE893209A45DBB031ULL, 0x3DAA8A1471E8CA7FULL, 0xE86C90E49284EB15ULL, 0x3086D221A7D46BCDULL }};
+static const BTCScalar BTCScalarG2 = {{ 0x1571B4AE8AC47F71ULL, 0x221208AC9DF506C6ULL, 0x6F547FA90ABFE4C4ULL, 0xE4437ED6010E8828ULL }};
+
+// Splits k into k1 + k2*lambda (mod n) where k1 and k2 are at most 128 bits in absolute value.
+static void BTCScalarSplitLambda(BTCScalar* k1, BTCScalar* k2, const BTCScalar* k) {
+    BTCScalar c1, c2;
+    BTCScalarMulShift384(&c1, k, &BTCScalarG1);
+    BTCScalarMulShift384(&c2, k, &BTCScalarG2);
+    BTCScalarMul(&c1, &c1, &BTCScalarMinusB1);
+    BTCScalarMul(&c2, &c2, &BTCScalarMinusB2);
+    BTCScalarAdd(k2, &c1, &c2);
+    BTCScalarMul(k1, k2, &BTCScalarMinusLambda);
+    BTCScalarAdd(k1, k1, k);
+}
+
+
+
+
+#pragma mark - Group
+
+
+
+// Affine point.
+typedef struct {
+    BTCField x, y;
+    BOOL infinity;
+} BTCGroupAffine;
+
+// Jacobian point (x = X/Z^2, y = Y/Z^3). Used for variable-time operations.
+typedef struct {
+    BTCField x, y, z;
+    BOOL infinity;
+} BTCGroupJacobian;
+
+// Homogeneous projective point (x = X/Z, y = Y/Z) with Z = 0 at infinity.
+// Used with complete addition formulas for constant-time operations.
+typedef struct {
+    BTCField x, y, z;
+} BTCGroupProjective;
+
+// 3*b where b = 7 is the curve constant.
+#define BTCGroupB3 21
+
+// G = (79BE667E F9DCBBAC 55A06295 CE870B07 029BFCDB 2DCE28D9 59F2815B 16F81798,
+//      483ADA77 26A3C465 5DA4FBFC 0E1108A8 FD17B448 A6855419 9C47D08F FB10D4B8)
+static const BTCGroupAffine BTCGroupGenerator = {
+    {{ 0x2815B16F81798ULL, 0xDB2DCE28D959FULL, 0xE870B07029BFCULL, 0xBBAC55A06295CULL, 0x79BE667EF9DCULL }},
+    {{ 0x7D08FFB10D4B8ULL, 0x48A68554199C4ULL, 0xE1108A8FD17B4ULL, 0xC4655DA4FBFC0ULL, 0x483ADA7726A3ULL }},
+    NO
+};
+
+// beta = 7AE96A2B 657C0710 6E64479E AC3434E9 9CF04975 12F58995 C1396C28 719501EE
+static const BTCField BTCGroupBeta = {{ 0x96C28719501EEULL, 0x7512F58995C13ULL, 0xC3434E99CF049ULL, 0x07106E64479EAULL, 0x7AE96A2B657CULL }};
+
+// Returns YES if y^2 = x^3 + 7.
+static BOOL BTCGroupIsValidAffine(const BTCField* x, const BTCField* y) {
+    BTCField y2, x3, seven;
+    BTCFieldSqr(&y2, y);
+    BTCFieldSqr(&x3, x);
+    BTCFieldMul(&x3, &x3, x);
+    BTCFieldSetInt(&seven, 7);
+    BTCFieldAdd(&x3, &x3, &seven);
+    return BTCFieldEqual(&y2, &x3);
+}
+
+// Finds y for x with the given parity. Returns NO if x is not on the curve.
+static BOOL BTCGroupSetX(BTCGroupAffine* r, const BTCField* x, BOOL odd) {
+    BTCField x3, seven;
+    BTCFieldSqr(&x3, x);
+    BTCFieldMul(&x3, &x3, x);
+    BTCFieldSetInt(&seven, 7);
+    BTCFieldAdd(&x3, &x3, &seven);
+    if (!BTCFieldSqrt(&r->y, &x3)) return NO;
+    r->x = *x;
+    BTCFieldNormalize(&r->y);
+    if ((r->y.n[0] & 1) != (odd ? 1 : 0)) BTCFieldNegate(&r->y, &r->y);
+    r->infinity = NO;
+    return YES;
+}
+
+static void BTCGroupJacobianSetAffine(BTCGroupJacobian* r, const BTCGroupAffine* a) {
+    r->x = a->x;
+    r->y = a->y;
+    BTCFieldSetInt(&r->z, 1);
+    r->infinity = a->infinity;
+}
+
+static void BTCGroupAffineSetJacobian(BTCGroupAffine* r, const BTCGroupJacobian* a) {
+    if (a->infinity) {
+        r->infinity = YES;
+        return;
+    }
+    BTCField zi, zi2, zi3;
+    BTCFieldInverse(&zi, &a->z);
+    BTCFieldSqr(&zi2, &zi);
+    BTCFieldMul(&zi3, &zi2, &zi);
+    BTCFieldMul(&r->x, &a->x, &zi2);
+    BTCFieldMul(&r->y, &a->y, &zi3);
+    r->infinity = NO;
+}
+
+// Variable-time doubling (dbl-2009-l for a = 0).
+static void BTCGroupJacobianDouble(BTCGroupJacobian* r, const BTCGroupJacobian* a) {
+    if (a->infinity) {
+        *r = *a;
+        return;
+    }
+    BTCField A, B, C, D, E, F, t;
+    BTCFieldSqr(&A, &a->x);
+    BTCFieldSqr(&B, &a->y);
+    BTCFieldSqr(&C, &B);
+    BTCFieldAdd(&D, &a->x, &B);
+    BTCFieldSqr(&D, &D);
+    BTCFieldSub(&D, &D, &A);
+    BTCFieldSub(&D, &D, &C);
+    BTCFieldAdd(&D, &D, &D);
+    BTCFieldMulInt(&E, &A, 3);
+    BTCFieldSqr(&F, &E);
+
+    BTCFieldMul(&r->z, &a->y, &a->z);
+    BTCFieldAdd(&r->z, &r->z, &r->z);
+    BTCFieldAdd(&t, &D, &D);
+    BTCFieldSub(&r->x, &F, &t);
+    BTCFieldSub(&t, &D, &r->x);
+    BTCFieldMul(&t, &E, &t);
+    BTCFieldMulInt(&C, &C, 8);
+    BTCFieldSub(&r->y, &t, &C);
+    r->infinity = NO;
+}
+
+// Variable-time addition of a Jacobian point and an affine point.
+static void BTCGroupJacobianAddAffine(BTCGroupJacobian* r, const BTCGroupJacobian* a, const BTCGroupAffine* b) {
+    if (b->infinity) {
+        *r = *a;
+        return;
+    }
+    if (a->infinity) {
+        BTCGroupJacobianSetAffine(r, b);
+        return;
+    }
+    BTCField z2, u2, s2, h, rr, hh, hhh, v, t;
+    BTCFieldSqr(&z2, &a->z);
+    BTCFieldMul(&u2, &b->x, &z2);
+    BTCFieldMul(&s2, &b->y, &z2);
+    BTCFieldMul(&s2, &s2, &a->z);
+    BTCFieldSub(&h, &u2, &a->x);
+    BTCFieldSub(&rr, &s2, &a->y);
+    if (BTCFieldIsZero(&h)) {
+        if (BTCFieldIsZero(&rr)) {
+            BTCGroupJacobianDouble(r, a);
+        } else {
+            r->infinity = YES;
+        }
+        return;
+    }
+    BTCFieldSqr(&hh, &h);
+    BTCFieldMul(&hhh, &h, &hh);
+    BTCFieldMul(&v, &a->x, &hh);
+    BTCFieldMul(&r->z, &a->z, &h);
+
+    BTCFieldMul(&t, &a->y, &hhh);
+    BTCFieldSqr(&r->x, &rr);
+    BTCFieldSub(&r->x, &r->x, &hhh);
+    BTCFieldSub(&r->x, &r->x, &v);
+    BTCFieldSub(&r->x, &r->x, &v);
+    BTCFieldSub(&v, &v, &r->x);
+    BTCFieldMul(&r->y, &rr, &v);
+    BTCFieldSub(&r->y, &r->y, &t);
+    r->infinity = NO;
+}
+
+// Variable-time addition of two Jacobian points.
+static void BTCGroupJacobianAdd(BTCGroupJacobian* r, const BTCGroupJacobian* a, const BTCGroupJacobian* b) {
+    if (b->infinity) {
+        *r = *a;
+        return;
+    }
+    if (a->infinity) {
+        *r = *b;
+        return;
+    }
+    BTCField z1z1, z2z2, u1, u2, s1, s2, h, rr, hh, hhh, v, t;
+    BTCFieldSqr(&z1z1, &a->z);
+    BTCFieldSqr(&z2z2, &b->z);
+    BTCFieldMul(&u1, &a->x, &z2z2);
+    BTCFieldMul(&u2, &b->x, &z1z1);
+    BTCFieldMul(&s1, &a->y, &z2z2);
+    BTCFieldMul(&s1, &s1, &b->z);
+    BTCFieldMul(&s2, &b->y, &z1z1);
+    BTCFieldMul(&s2, &s2, &a->z);
+    BTCFieldSub(&h, &u2, &u1);
+    BTCFieldSub(&rr, &s2, &s1);
+    if (BTCFieldIsZero(&h)) {
+        if (BTCFieldIsZero(&rr)) {
+            BTCGroupJacobianDouble(r, a);
+        } else {
+            r->infinity = YES;
+        }
+        return;
+    }
+    BTCFieldSqr(&hh, &h);
+    BTCFieldMul(&hhh, &h, &hh);
+    BTCFieldMul(&v, &u1, &hh);
+    BTCFieldMul(&r->z, &a->z, &b->z);
+    BTCFieldMul(&r->z, &r->z, &h);
+
+    BTCFieldMul(&t, &s1, &hhh);
+    BTCFieldSqr(&r->x, &rr);
+    BTCFieldSub(&r->x, &r->x, &hhh);
+    BTCFieldSub(&r->x, &r->x, &v);
+    BTCFieldSub(&r->x, &r->x, &v);
+    BTCFieldSub(&v, &v, &r->x);
+    BTCFieldMul(&r->y, &rr, &v);
+    BTCFieldSub(&r->y, &r->y, &t);
+    r->infinity = NO;
+}
+
+// Complete mixed addition for a = 0 (Renes, Costello, Batina 2016, algorithm 8).
+// Same as below with Z2 = 1. The affine point must not be at infinity.
+static void BTCGroupProjectiveAddAffine(BTCGroupProjective* r, const BTCGroupProjective* p, const BTCGroupAffine* q) {
+    BTCField t0, t1, t2, t3, t4, x3, y3, z3;
+    BTCFieldMul(&t0, &p->x, &q->x);
+    BTCFieldMul(&t1, &p->y, &q->y);
+    BTCFieldAdd(&t3, &q->x, &q->y);
+    BTCFieldAdd(&t4, &p->x, &p->y);
+    BTCFieldMul(&t3, &t3, &t4);
+    BTCFieldAdd(&t4, &t0, &t1);
+    BTCFieldSub(&t3, &t3, &t4);
+    BTCFieldMul(&t4, &q->y, &p->z);
+    BTCFieldAdd(&t4, &t4, &p->y);
+    BTCFieldMul(&y3, &q->x, &p->z);
+    BTCFieldAdd(&y3, &y3, &p->x);
+    BTCFieldAdd(&x3, &t0, &t0);
+    BTCFieldAdd(&t0, &x3, &t0);
+    BTCFieldMulInt(&t2, &p->z, BTCGroupB3);
+    BTCFieldAdd(&z3, &t1, &t2);
+    BTCFieldSub(&t1, &t1, &t2);
+    BTCFieldMulInt(&y3, &y3, BTCGroupB3);
+    BTCFieldMul(&x3, &t4, &y3);
+    BTCFieldMul(&t2, &t3, &t1);
+    BTCFieldSub(&x3, &t2, &x3);
+    BTCFieldMul(&y3, &y3, &t0);
+    BTCFieldMul(&t1, &t1, &z3);
+    BTCFieldAdd(&y3, &t1, &y3);
+    BTCFieldMul(&t0, &t0, &t3);
+    BTCFieldMul(&z3, &z3, &t4);
+    BTCFieldAdd(&z3, &z3, &t0);
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+}
+
+// Complete addition for a = 0 (Renes, Costello, Batina 2016, algorithm 7).
+// Works for any inputs including equal points and points at infinity, without branches.
+static void BTCGroupProjectiveAdd(BTCGroupProjective* r, const BTCGroupProjective* p, const BTCGroupProjective* q) {
+    BTCField t0, t1, t2, t3, t4, x3, y3, z3;
+    BTCFieldMul(&t0, &p->x, &q->x);
+    BTCFieldMul(&t1, &p->y, &q->y);
+    BTCFieldMul(&t2, &p->z, &q->z);
+    BTCFieldAdd(&t3, &p->x, &p->y);
+    BTCFieldAdd(&t4, &q->x, &q->y);
+    BTCFieldMul(&t3, &t3, &t4);
+    BTCFieldAdd(&t4, &t0, &t1);
+    BTCFieldSub(&t3, &t3, &t4);
+    BTCFieldAdd(&t4, &p->y, &p->z);
+    BTCFieldAdd(&x3, &q->y, &q->z);
+    BTCFieldMul(&t4, &t4, &x3);
+    BTCFieldAdd(&x3, &t1, &t2);
+    BTCFieldSub(&t4, &t4, &x3);
+    BTCFieldAdd(&x3, &p->x, &p->z);
+    BTCFieldAdd(&y3, &q->x, &q->z);
+    BTCFieldMul(&x3, &x3, &y3);
+    BTCFieldAdd(&y3, &t0, &t2);
+    BTCFieldSub(&y3, &x3, &y3);
+    BTCFieldAdd(&x3, &t0, &t0);
+    BTCFieldAdd(&t0, &x3, &t0);
+    BTCFieldMulInt(&t2, &t2, BTCGroupB3);
+    BTCFieldAdd(&z3, &t1, &t2);
+    BTCFieldSub(&t1, &t1, &t2);
+    BTCFieldMulInt(&y3, &y3, BTCGroupB3);
+    BTCFieldMul(&x3, &t4, &y3);
+    BTCFieldMul(&t2, &t3, &t1);
+    BTCFieldSub(&x3, &t2, &x3);
+    BTCFieldMul(&y3, &y3, &t0);
+    BTCFieldMul(&t1, &t1, &z3);
+    BTCFieldAdd(&y3, &t1, &y3);
+    BTCFieldMul(&t0, &t0, &t3);
+    BTCFieldMul(&z3, &z3, &t4);
+    BTCFieldAdd(&z3, &z3, &t0);
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+}
+
+// Complete doubling for a = 0 (Renes, Costello, Batina 2016, algorithm 9).
+static void BTCGroupProjectiveDouble(BTCGroupProjective* r, const BTCGroupProjective* p) {
+    BTCField t0, t1, t2, x3, y3, z3;
+    BTCFieldSqr(&t0, &p->y);
+    BTCFieldMulInt(&z3, &t0, 8);
+    BTCFieldMul(&t1, &p->y, &p->z);
+    BTCFieldSqr(&t2, &p->z);
+    BTCFieldMulInt(&t2, &t2, BTCGroupB3);
+    BTCFieldMul(&x3, &t2, &z3);
+    BTCFieldAdd(&y3, &t0, &t2);
+    BTCFieldMul(&z3, &t1, &z3);
+    BTCFieldMulInt(&t2, &t2, 3);
+    BTCFieldSub(&t0, &t0, &t2);
+    BTCFieldMul(&y3, &t0, &y3);
+    BTCFieldAdd(&y3, &x3, &y3);
+    BTCFieldMul(&t1, &p->x, &p->y);
+    BTCFieldMul(&x3, &t0, &t1);
+    BTCFieldAdd(&x3, &x3, &x3);
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+}
+
+static void BTCGroupProjectiveSetAffine(BTCGroupProjective* r, const BTCGroupAffine* a) {
+    r->x = a->x;
+    r->y = a->y;
+    BTCFieldSetInt(&r->z, 1);
+}
+
+static void BTCGroupProjectiveSetInfinity(BTCGroupProjective* r) {
+    BTCFieldSetInt(&r->x, 0);
+    BTCFieldSetInt(&r->y, 1);
+    BTCFieldSetInt(&r->z, 0);
+}
+
+// Returns NO for a point at infinity.
+static BOOL BTCGroupAffineSetProjective(BTCGroupAffine* r, const BTCGroupProjective* a) {
+    if (BTCFieldIsZero(&a->z)) {
+        r->infinity = YES;
+        return NO;
+    }
+    BTCField zi;
+    BTCFieldInverse(&zi, &a->z);
+    BTCFieldMul(&r->x, &a->x, &zi);
+    BTCFieldMul(&r->y, &a->y, &zi);
+    r->infinity = NO;
+    return YES;
+}
+
+static inline void BTCGroupProjectiveConditionalMove(BTCGroupProjective* r, const BTCGroupProjective* a, uint64_t flag) {
+    BTCFieldConditionalMove(&r->x, &a->x, flag);
+    BTCFieldConditionalMove(&r->y, &a->y, flag);
+    BTCFieldConditionalMove(&r->z, &a->z, flag);
+}
+
+// Returns a 4-bit window of the scalar starting at the given bit.
+static inline unsigned int BTCScalarNibble(const BTCScalar* a, int index) {
+    return (unsigned int)(a->d[index / 16] >> ((index % 16) * 4)) & 15;
+}
+
+
+
+
+#pragma mark - Precomputed Tables
+
+
+
+// Both tables are built on first use and shared by all threads.
+// Verification needs about 11 Kb, generator multiplication about 82 Kb.
+
+// Odd multiples of G and lambda*G for wNAF multiplication: (2i + 1)*G for i in [0, 2^(w-2)).
+#define BTCGroupWindowG 8
+#define BTCGroupTableSizeG (1 << (BTCGroupWindowG - 2))
+static BTCGroupAffine BTCGroupTableG[BTCGroupTableSizeG];
+static BTCGroupAffine BTCGroupTableLambdaG[BTCGroupTableSizeG];
+
+// Table for constant-time generator multiplication: BTCGroupCombTable[i][j - 1] = j * 16^i * G for j in [1, 15].
+// Using it k*G takes 64 additions and no doublings.
+#define BTCGroupCombWindows 64
+#define BTCGroupCombEntries 15
+static BTCGroupAffine BTCGroupCombTable[BTCGroupCombWindows][BTCGroupCombEntries];
+
+// Converts Jacobian points to affine with a single inversion (Montgomery's trick). Points must not be at infinity.
+static void BTCGroupAffineSetJacobianBatch(BTCGroupAffine* r, const BTCGroupJacobian* a, size_t count) {
+    BTCField* products = malloc(count * sizeof(BTCField));
+    products[0] = a[0].z;
+    for (size_t i = 1; i < count; i++) BTCFieldMul(&products[i], &products[i - 1], &a[i].z);
+
+    BTCField inverse, zi, zi2, zi3;
+    BTCFieldInverse(&inverse, &products[count - 1]);
+    for (size_t i = count; i-- > 0;) {
+        if (i > 0) {
+            BTCFieldMul(&zi, &inverse, &products[i - 1]);
+            BTCFieldMul(&inverse, &inverse, &a[i].z);
+        } else {
+            zi = inverse;
+        }
+        BTCFieldSqr(&zi2, &zi);
+        BTCFieldMul(&zi3, &zi2, &zi);
+        BTCFieldMul(&r[i].x, &a[i].x, &zi2);
+        BTCFieldMul(&r[i].y, &a[i].y, &zi3);
+        BTCFieldNormalize(&r[i].x);
+        BTCFieldNormalize(&r[i].y);
+        r[i].infinity = NO;
+    }
+    free(products);
+}
+
+static void BTCGroupPrepareVerificationTables(void) {
+    BTCGroupJacobian multiples[BTCGroupTableSizeG], g, g2;
+    BTCGroupJacobianSetAffine(&g, &BTCGroupGenerator);
+    BTCGroupJacobianDouble(&g2, &g);
+    multiples[0] = g;
+    for (int i = 1; i < BTCGroupTableSizeG; i++) BTCGroupJacobianAdd(&multiples[i], &multiples[i - 1], &g2);
+    BTCGroupAffineSetJacobianBatch(BTCGroupTableG, multiples, BTCGroupTableSizeG);
+    for (int i = 0; i < BTCGroupTableSizeG; i++) {
+        BTCGroupTableLambdaG[i] = BTCGroupTableG[i];
+        BTCFieldMul(&BTCGroupTableLambdaG[i].x, &BTCGroupTableG[i].x, &BTCGroupBeta);
+        BTCFieldNormalize(&BTCGroupTableLambdaG[i].x);
+    }
+}
+
+static void BTCGroupPrepareCombTable(void) {
+    size_t count = BTCGroupCombWindows * BTCGroupCombEntries;
+    BTCGroupJacobian* comb = malloc(count * sizeof(BTCGroupJacobian));
+    BTCGroupJacobian base;
+    BTCGroupJacobianSetAffine(&base, &BTCGroupGenerator);
+    for (int i = 0; i < BTCGroupCombWindows; i++) {
+        BTCGroupJacobian* row = comb + i * BTCGroupCombEntries;
+        row[0] = base;
+        for (int j = 1; j < BTCGroupCombEntries; j++) BTCGroupJacobianAdd(&row[j], &row[j - 1], &base);
+        for (int j = 0; j < 4; j++) BTCGroupJacobianDouble(&base, &base);
+    }
+    BTCGroupAffineSetJacobianBatch(&BTCGroupCombTable[0][0], comb, count);
+    free(comb);
+}
+
+static void BTCGroupPrepareVerificationTablesIfNeeded(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, BTCGroupPrepareVerificationTables);
+}
+
+static void BTCGroupPrepareCombTableIfNeeded(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, BTCGroupPrepareCombTable);
+}
+
+
+
+
+#pragma mark - Multiplication
+
+
+
+// Computes k*G in constant time using the comb table.
+static void BTCGroupGeneratorMultiply(BTCGroupProjective* r, const BTCScalar* k) {
+    BTCGroupPrepareCombTableIfNeeded();
+    BTCGroupAffine entry;
+    BTCGroupProjective sum;
+    BTCGroupProjectiveSetInfinity(r);
+    for (int i = 0; i < BTCGroupCombWindows; i++) {
+        unsigned int nibble = BTCScalarNibble(k, i);
+
+        // Read every entry of the row so that the memory access pattern does not depend on the scalar.
+        entry = BTCGroupCombTable[i][0];
+        for (unsigned int j = 2; j <= BTCGroupCombEntries; j++) {
+            BTCFieldConditionalMove(&entry.x, &BTCGroupCombTable[i][j - 1].x, j == nibble);
+            BTCFieldConditionalMove(&entry.y, &BTCGroupCombTable[i][j - 1].y, j == nibble);
+        }
+
+        // The table has no entry for zero, so the sum is discarded when the nibble is zero.
+        BTCGroupProjectiveAddAffine(&sum, r, &entry);
+        BTCGroupProjectiveConditionalMove(r, &sum, nibble != 0);
+    }
+}
+
+// Computes k*P in constant time with a fixed 4-bit window.
+static void BTCGroupPointMultiply(BTCGroupProjective* r, const BTCGroupAffine* p, const BTCScalar* k) {
+    BTCGroupProjective table[16], entry;
+    BTCGroupProjectiveSetInfinity(&table[0]);
+    BTCGroupProjectiveSetAffine(&table[1], p);
+    for (int i = 2; i < 16; i++) BTCGroupProjectiveAdd(&table[i], &table[i - 1], &table[1]);
+
+    BTCGroupProjectiveSetInfinity(r);
+    for (int i = 63; i >= 0; i--) {
+        for (int j = 0; j < 4; j++) BTCGroupProjectiveDouble(r, r);
+        unsigned int nibble = BTCScalarNibble(k, i);
+        entry = table[0];
+        for (unsigned int j = 1; j < 16; j++) BTCGroupProjectiveConditionalMove(&entry, &table[j], j == nibble);
+        BTCGroupProjectiveAdd(r, r, &entry);
+    }
+}
+
+// Computes width-w non-adjacent form of a scalar below 2^129. Returns the number of digits.
+static int BTCScalarWNAF(int* wnaf, const BTCScalar* a, int w) {
+    uint64_t k[3] = { a->d[0], a->d[1], a->d[2] };
+    int length = 0;
+    while (k[0] | k[1] | k[2]) {
+        int digit = 0;
+        if (k[0] & 1) {
+            digit = (int)(k[0] & ((1U << w) - 1));
+            if (digit >= (1 << (w - 1))) digit -= (1 << w);
+            // k -= digit
+            if (digit > 0) {
+                uint64_t borrow = (k[0] < (uint64_t)digit);
+                k[0] -= (uint64_t)digit;
+                uint64_t b1 = (k[1] < borrow);
+                k[1] -= borrow;
+                k[2] -= b1;
+            } else {
+                k[0] += (uint64_t)(-digit);
+                uint64_t carry = (k[0] < (uint64_t)(-digit));
+                k[1] += carry;
+                k[2] += (k[1] < carry);
+            }
+        }
+        wnaf[length++] = digit;
+        k[0] = (k[0] >> 1) | (k[1] << 63);
+        k[1] = (k[1] >> 1) | (k[2] << 63);
+        k[2] >>= 1;
+    }
+    return length;
+}
+
+// Prepares a half of the split scalar for wNAF: makes it positive and remembers the sign.
+static int BTCScalarSplitWNAF(int* wnaf, const BTCScalar* a, int w) {
+    BTCScalar t = *a;
+    BOOL negative = BTCScalarIsHigh(&t);
+    if (negative) BTCScalarNegate(&t, &t);
+    int length = BTCScalarWNAF(wnaf, &t, w);
+    if (negative) {
+        for (int i = 0; i < length; i++) wnaf[i] = -wnaf[i];
+    }
+    return length;
+}
+
+static inline void BTCGroupJacobianNegate(BTCGroupJacobian* r, const BTCGroupJacobian* a) {
+    *r = *a;
+    BTCFieldNegate(&r->y, &a->y);
+}
+
+static inline void BTCGroupAffineNegate(BTCGroupAffine* r, const BTCGroupAffine* a) {
+    *r = *a;
+    BTCFieldNegate(&r->y, &a->y);
+}
+
+#define BTCGroupWindowP 5
+#define BTCGroupTableSizeP (1 << (BTCGroupWindowP - 2))
+
+// Computes na*P + ng*G in variable time (Strauss-wNAF with the endomorphism). For public data only.
+static void BTCGroupDoubleMultiply(BTCGroupJacobian* r, const BTCGroupAffine* p, const BTCScalar* na, const BTCScalar* ng) {
+    BTCScalar na1, na2, ng1, ng2;
+    BTCScalarSplitLambda(&na1, &na2, na);
+    BTCScalarSplitLambda(&ng1, &ng2, ng);
+
+    int wnafA1[130], wnafA2[130], wnafG1[130], wnafG2[130];
+    int lengthA1 = BTCScalarSplitWNAF(wnafA1, &na1, BTCGroupWindowP);
+    int lengthA2 = BTCScalarSplitWNAF(wnafA2, &na2, BTCGroupWindowP);
+    int lengthG1 = BTCScalarSplitWNAF(wnafG1, &ng1, BTCGroupWindowG);
+    int lengthG2 = BTCScalarSplitWNAF(wnafG2, &ng2, BTCGroupWindowG);
+    int length = MAX(MAX(lengthA1, lengthA2), MAX(lengthG1, lengthG2));
+
+    // Odd multiples of P and lambda*P.
+    BTCGroupJacobian tableP[BTCGroupTableSizeP], tableLambdaP[BTCGroupTableSizeP], p2;
+    BTCGroupJacobianSetAffine(&tableP[0], p);
+    BTCGroupJacobianDouble(&p2, &tableP[0]);
+    for (int i = 1; i < BTCGroupTableSizeP; i++) BTCGroupJacobianAdd(&tableP[i], &tableP[i - 1], &p2);
+    for (int i = 0; i < BTCGroupTableSizeP; i++) {
+        tableLambdaP[i] = tableP[i];
+        BTCFieldMul(&tableLambdaP[i].x, &tableP[i].x, &BTCGroupBeta);
+    }
+
+    r->infinity = YES;
+    BTCGroupJacobian tj;
+    BTCGroupAffine ta;
+    for (int i = length - 1; i >= 0; i--) {
+        BTCGroupJacobianDouble(r, r);
+        int digit;
+        if (i < lengthA1 && (digit = wnafA1[i])) {
+            if (digit > 0) tj = tableP[(digit - 1) / 2]; else BTCGroupJacobianNegate(&tj, &tableP[(-digit - 1) / 2]);
+            BTCGroupJacobianAdd(r, r, &tj);
+        }
+        if (i < lengthA2 && (digit = wnafA2[i])) {
+            if (digit > 0) tj = tableLambdaP[(digit - 1) / 2]; else BTCGroupJacobianNegate(&tj, &tableLambdaP[(-digit - 1) / 2]);
+            BTCGroupJacobianAdd(r, r, &tj);
+        }
+        if (i < lengthG1 && (digit = wnafG1[i])) {
+            if (digit > 0) ta = BTCGroupTableG[(digit - 1) / 2]; else BTCGroupAffineNegate(&ta, &BTCGroupTableG[(-digit - 1) / 2]);
+            BTCGroupJacobianAddAffine(r, r, &ta);
+        }
+        if (i < lengthG2 && (digit = wnafG2[i])) {
+            if (digit > 0) ta = BTCGroupTableLambdaG[(digit - 1) / 2]; else BTCGroupAffineNegate(&ta, &BTCGroupTableLambdaG[(-digit - 1) / 2]);
+            BTCGroupJacobianAddAffine(r, r, &ta);
+        }
+    }
+}
+
+
+
+
+#pragma mark - Public API
+
+
+
+static void BTCSecp256k1PointFromAffine(BTCSecp256k1Point* point, const BTCGroupAffine* a) {
+    BTCField x = a->x, y = a->y;
+    BTCFieldNormalize(&x);
+    BTCFieldNormalize(&y);
+    memcpy(point->x, x.n, sizeof(point->x));
+    memcpy(point->y, y.n, sizeof(point->y));
+}
+
+static void BTCSecp256k1PointToAffine(BTCGroupAffine* a, const BTCSecp256k1Point* point) {
+    memcpy(a->x.n, point->x, sizeof(point->x));
+    memcpy(a->y.n, point->y, sizeof(point->y));
+    a->infinity = NO;
+}
+
+BOOL BTCSecp256k1PointParse(BTCSecp256k1Point* point, const unsigned char* bytes, size_t length) {
+    if (!point || !bytes) return NO;
+
+    BTCGroupAffine a;
+    if (length == 33 && (bytes[0] == 0x02 || bytes[0] == 0x03)) {
+        BTCField x;
+        if (!BTCFieldSetBytes(&x, bytes + 1)) return NO;
+        if (!BTCGroupSetX(&a, &x, bytes[0] == 0x03)) return NO;
+    } else if (length == 65 && (bytes[0] == 0x04 || bytes[0] == 0x06 || bytes[0] == 0x07)) {
+        if (!BTCFieldSetBytes(&a.x, bytes + 1)) return NO;
+        if (!BTCFieldSetBytes(&a.y, bytes + 33)) return NO;
+        if (bytes[0] != 0x04 && (bytes[64] & 1) != (bytes[0] & 1)) return NO;
+        if (!BTCGroupIsValidAffine(&a.x, &a.y)) return NO;
+    } else {
+        return NO;
+    }
+    BTCSecp256k1PointFromAffine(point, &a);
+    return YES;
+}
+
+void BTCSecp256k1PointSerialize(unsigned char* output, const BTCSecp256k1Point* point, BOOL compressed) {
+    BTCField x, y;
+    memcpy(x.n, point->x, sizeof(x.n));
+    memcpy(y.n, point->y, sizeof(y.n));
+    BTCFieldGetBytes(output + 1, &x);
+    if (compressed) {
+        output[0] = (y.n[0] & 1) ? 0x03 : 0x02;
+    } else {
+        output[0] = 0x04;
+        BTCFieldGetBytes(output + 33, &y);
+    }
+}
+
+BOOL BTCSecp256k1GeneratorMultiply(BTCSecp256k1Point* result, const unsigned char* scalar32) {
+    BTCScalar k;
+    BTCScalarSetBytes(&k, scalar32);
+    if (BTCScalarIsZero(&k)) return NO;
+
+    BTCGroupProjective rp;
+    BTCGroupAffine ra;
+    BTCGroupGeneratorMultiply(&rp, &k);
+    BTCSecureMemset(&k, 0, sizeof(k));
+    if (!BTCGroupAffineSetProjective(&ra, &rp)) return NO;
+    BTCSecp256k1PointFromAffine(result, &ra);
+    return YES;
+}
+
+BOOL BTCSecp256k1PointMultiply(BTCSecp256k1Point* point, const unsigned char* scalar32) {
+    BTCScalar k;
+    BTCScalarSetBytes(&k, scalar32);
+    if (BTCScalarIsZero(&k)) return NO;
+
+    BTCGroupAffine a;
+    BTCGroupProjective rp;
+    BTCSecp256k1PointToAffine(&a, point);
+    BTCGroupPointMultiply(&rp, &a, &k);
+    BTCSecureMemset(&k, 0, sizeof(k));
+    if (!BTCGroupAffineSetProjective(&a, &rp)) return NO;
+    BTCSecp256k1PointFromAffine(point, &a);
+    return YES;
+}
+
+BOOL BTCSecp256k1PointAdd(BTCSecp256k1Point* point, const BTCSecp256k1Point* other) {
+    BTCGroupAffine a, b;
+    BTCGroupJacobian r;
+    BTCSecp256k1PointToAffine(&a, point);
+    BTCSecp256k1PointToAffine(&b, other);
+    BTCGroupJacobianSetAffine(&r, &a);
+    BTCGroupJacobianAddAffine(&r, &r, &b);
+    if (r.infinity) return NO;
+    BTCGroupAffineSetJacobian(&a, &r);
+    BTCSecp256k1PointFromAffine(point, &a);
+    return YES;
+}
+
+BOOL BTCSecp256k1PointAddGeneratorMultiple(BTCSecp256k1Point* point, const unsigned char* scalar32) {
+    BTCScalar k;
+    BTCScalarSetBytes(&k, scalar32);
+
+    BTCGroupProjective rp, pp;
+    BTCGroupAffine a;
+    BTCGroupGeneratorMultiply(&rp, &k);
+    BTCSecureMemset(&k, 0, sizeof(k));
+    BTCSecp256k1PointToAffine(&a, point);
+    BTCGroupProjectiveSetAffine(&pp, &a);
+    BTCGroupProjectiveAdd(&rp, &rp, &pp);
+    if (!BTCGroupAffineSetProjective(&a, &rp)) return NO;
+    BTCSecp256k1PointFromAffine(point, &a);
+    return YES;
+}
+
+BOOL BTCSecp256k1Sign(unsigned char* r32, unsigned char* s32, int* recid, const unsigned char* hash32, const unsigned char* seckey32, const unsigned char* nonce32) {
+    BTCScalar d, k, e, r, s;
+    BOOL overflow = BTCScalarSetBytes(&d, seckey32);
+    overflow |= BTCScalarSetBytes(&k, nonce32);
+    BTCScalarSetBytes(&e, hash32);
+
+    BOOL success = !overflow && !BTCScalarIsZero(&d) && !BTCScalarIsZero(&k);
+
+    // R = k*G, r = R.x mod n
+    BTCGroupProjective rp;
+    BTCGroupAffine ra;
+    unsigned char xbytes[32];
+    BTCGroupGeneratorMultiply(&rp, &k);
+    success &= BTCGroupAffineSetProjective(&ra, &rp);
+    BTCFieldNormalize(&ra.x);
+    BTCFieldNormalize(&ra.y);
+    BTCFieldGetBytes(xbytes, &ra.x);
+    BOOL rOverflow = BTCScalarSetBytes(&r, xbytes);
+    int recoveryId = (int)(ra.y.n[0] & 1) | (rOverflow ? 2 : 0);
+
+    // s = (e + r*d)/k
+    BTCScalar kinv;
+    BTCScalarMul(&s, &r, &d);
+    BTCScalarAdd(&s, &s, &e);
+    BTCScalarInverse(&kinv, &k);
+    BTCScalarMul(&s, &s, &kinv);
+
+    // Enforce low S: -s is a valid signature for the point with the opposite y.
+    BOOL high = BTCScalarIsHigh(&s);
+    BTCScalar negated;
+    BTCScalarNegate(&negated, &s);
+    uint64_t mask = 0 - (uint64_t)high;
+    for (int i = 0; i < 4; i++) s.d[i] = (s.d[i] & ~mask) | (negated.d[i] & mask);
+    recoveryId ^= high;
+
+    success &= !BTCScalarIsZero(&r) && !BTCScalarIsZero(&s);
+
+    BTCScalarGetBytes(r32, &r);
+    BTCScalarGetBytes(s32, &s);
+    if (recid) *recid = recoveryId;
+
+    BTCSecureMemset(&d, 0, sizeof(d));
+    BTCSecureMemset(&k, 0, sizeof(k));
+    BTCSecureMemset(&kinv, 0, sizeof(kinv));
+    return success;
+}
+
+// Checks that both parts of a signature are in [1, n-1].
+static BOOL BTCSecp256k1SetSignature(BTCScalar* r, BTCScalar* s, const unsigned char* r32, const unsigned char* s32) {
+    BOOL overflow = BTCScalarSetBytes(r, r32);
+    overflow |= BTCScalarSetBytes(s, s32);
+    return !overflow && !BTCScalarIsZero(r) && !BTCScalarIsZero(s);
+}
+
+BOOL BTCSecp256k1Verify(const unsigned char* r32, const unsigned char* s32, const unsigned char* hash32, const BTCSecp256k1Point* pubkey) {
+    BTCGroupPrepareVerificationTablesIfNeeded();
+    BTCScalar r, s, e, sinv, u1, u2;
+    if (!BTCSecp256k1SetSignature(&r, &s, r32, s32)) return NO;
+    BTCScalarSetBytes(&e, hash32);
+
+    BTCScalarInverse(&sinv, &s);
+    BTCScalarMul(&u1, &e, &sinv);
+    BTCScalarMul(&u2, &r, &sinv);
+
+    BTCGroupAffine q;
+    BTCGroupJacobian rj;
+    BTCSecp256k1PointToAffine(&q, pubkey);
+    BTCGroupDoubleMultiply(&rj, &q, &u2, &u1);
+    if (rj.infinity) return NO;
+
+    // Check R.x mod n == r without inversion: compare r*Z^2 with X, and (r + n)*Z^2 if r + n < p.
+    unsigned char rbytes[32];
+    BTCField rx, z2, t;
+    BTCScalarGetBytes(rbytes, &r);
+    BTCFieldSetBytes(&rx, rbytes);
+    BTCFieldSqr(&z2, &rj.z);
+    BTCFieldMul(&t, &rx, &z2);
+    if (BTCFieldEqual(&t, &rj.x)) return YES;
+
+    // p - n = 14551231950B75FC4402DA1732FC9BEBE
+    static const unsigned char pMinusN[32] = {
+        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0x01,
+        0x45,0x51,0x23,0x19,0x50,0xB7,0x5F,0xC4,0x40,0x2D,0xA1,0x72,0x2F,0xC9,0xBA,0xEE,
+    };
+    if (memcmp(rbytes, pMinusN, 32) >= 0) return NO;
+    static const unsigned char nBytes[32] = {
+        0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFE,
+        0xBA,0xAE,0xDC,0xE6,0xAF,0x48,0xA0,0x3B,0xBF,0xD2,0x5E,0x8C,0xD0,0x36,0x41,0x41,
+    };
+    BTCField n;
+    BTCFieldSetBytes(&n, nBytes);
+    BTCFieldAdd(&rx, &rx, &n);
+    BTCFieldMul(&t, &rx, &z2);
+    return BTCFieldEqual(&t, &rj.x);
+}
+
+BOOL BTCSecp256k1Recover(BTCSecp256k1Point* pubkey, const unsigned char* r32, const unsigned char* s32, const unsigned char* hash32, int recid) {
+    if (recid < 0 || recid > 3) return NO;
+    BTCGroupPrepareVerificationTablesIfNeeded();
+    BTCScalar r, s, e, rinv, u1, u2;
+    if (!BTCSecp256k1SetSignature(&r, &s, r32, s32)) return NO;
+    BTCScalarSetBytes(&e, hash32);
+
+    // R.x = r + n if the second bit of recid is set. It must be below p.
+    unsigned char xbytes[32];
+    BTCScalarGetBytes(xbytes, &r);
+    BTCField x;
+    BTCFieldSetBytes(&x, xbytes);
+    if (recid & 2) {
+        static const unsigned char nBytes[32] = {
+            0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFE,
+            0xBA,0xAE,0xDC,0xE6,0xAF,0x48,0xA0,0x3B,0xBF,0xD2,0x5E,0x8C,0xD0,0x36,0x41,0x41,
+        };
+        static const unsigned char pMinusN[32] = {
+            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0x01,
+            0x45,0x51,0x23,0x19,0x50,0xB7,0x5F,0xC4,0x40,0x2D,0xA1,0x72,0x2F,0xC9,0xBA,0xEE,
+        };
+        if (memcmp(xbytes, pMinusN, 32) >= 0) return NO;
+        BTCField n;
+        BTCFieldSetBytes(&n, nBytes);
+        BTCFieldAdd(&x, &x, &n);
+    }
+    BTCGroupAffine R;
+    if (!BTCGroupSetX(&R, &x, recid & 1)) return NO;
+
+    // Q = (s*R - e*G)/r
+    BTCScalarInverse(&rinv, &r);
+    BTCScalarMul(&u2, &s, &rinv);
+    BTCScalarMul(&u1, &e, &rinv);
+    BTCScalarNegate(&u1, &u1);
+
+    BTCGroupJacobian qj;
+    BTCGroupAffine q;
+    BTCGroupDoubleMultiply(&qj, &R, &u2, &u1);
+    if (qj.infinity) return NO;
+    BTCGroupAffineSetJacobian(&q, &qj);
+    BTCSecp256k1PointFromAffine(pubkey, &q);
+    return YES;
+}
+
+// Reads a DER integer into a 32-byte big-endian buffer. Returns NO if it is not strict DER, negative or too long.
+static BOOL BTCSecp256k1ParseDERInteger(unsigned char* out32, const unsigned char** cursor, const unsigned char* end) {
+    const unsigned char* p = *cursor;
+    if (end - p < 2 || p[0] != 0x02) return NO;
+    size_t length = p[1];
+    p += 2;
+    if (length == 0 || length >= 0x80 || (size_t)(end - p) < length) return NO;
+
+    if (p[0] & 0x80) return NO; // negative
+    if (length > 1 && p[0] == 0x00 && !(p[1] & 0x80)) return NO; // excessive padding
+
+    // Skip the sign byte.
+    const unsigned char* digits = p;
+    size_t digitsLength = length;
+    if (digits[0] == 0x00 && digitsLength > 1) {
+        digits++;
+        digitsLength--;
+    }
+    if (digitsLength > 32) return NO;
+    memset(out32, 0, 32);
+    memcpy(out32 + 32 - digitsLength, digits, digitsLength);
+    *cursor = p + length;
+    return YES;
+}
+
+BOOL BTCSecp256k1ParseDERSignature(unsigned char* r32, unsigned char* s32, const unsigned char* der, size_t length) {
+    if (!der || length < 2) return NO;
+    const unsigned char* end = der + length;
+    if (der[0] != 0x30 || der[1] >= 0x80 || (size_t)der[1] != length - 2) return NO;
+    const unsigned char* cursor = der + 2;
+    if (!BTCSecp256k1ParseDERInteger(r32, &cursor, end)) return NO;
+    if (!BTCSecp256k1ParseDERInteger(s32, &cursor, end)) return NO;
+    return cursor == end;
+}
+
+static size_t BTCSecp256k1SerializeDERInteger(unsigned char* output, const unsigned char* value32) {
+    size_t skip = 0;
+    while (skip < 31 && value32[skip] == 0) skip++;
+    BOOL padding = (value32[skip] & 0x80) != 0;
+    size_t length = 32 - skip + (padding ? 1 : 0);
+    output[0] = 0x02;
+    output[1] = (unsigned char)length;
+    if (padding) output[2] = 0x00;
+    memcpy(output + 2 + (padding ? 1 : 0), value32 + skip, 32 - skip);
+    return 2 + length;
+}
+
+size_t BTCSecp256k1SerializeDERSignature(unsigned char* output, const unsigned char* r32, const unsigned char* s32) {
+    size_t length = 2;
+    length += BTCSecp256k1SerializeDERInteger(output + length, r32);
+    length += BTCSecp256k1SerializeDERInteger(output + length, s32);
+    output[0] = 0x30;
+    output[1] = (unsigned char)(length - 2);
+    return length;
+}
+
+#endif
@@ -0,0 +1,9 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCSignatureCache.h"
+
+@interface BTCSignatureCache (Tests)
+
++ (void) runAllTests;
+
+@end
@@ -0,0 +1,67 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCSignatureCache+Tests.h"
+#import "BTCData.h"
+
+@implementation BTCSignatureCache (Tests)
+
++ (void) runAllTests {
+    [self testLookup];
+    [self testEviction];
+    [self testConcurrentAccess];
+}
+
++ (NSData*) dataWithNumber:(NSUInteger)n {
+    return BTCSHA256([NSData dataWithBytes:&n length:sizeof(n)]);
+}
+
++ (void) testLookup {
+    BTCSignatureCache* cache = [[BTCSignatureCache alloc] initWithCapacity:10];
+    NSData* sig = [self dataWithNumber:1];
+    NSData* pubkey = [self dataWithNumber:2];
+    NSData* hash = [self dataWithNumber:3];
+
+    NSAssert(![cache containsSignature:sig publicKey:pubkey hash:hash], @"empty cache should not contain anything");
+    [cache addSignature:sig publicKey:pubkey hash:hash];
+    NSAssert([cache containsSignature:sig publicKey:pubkey hash:hash], @"should find added signature");
+    NSAssert(![cache containsSignature:sig publicKey:hash hash:pubkey], @"should not find signature with other key and hash");
+    NSAssert(cache.hits == 1 && cache.misses == 2, @"should count hits and misses");
+
+    [cache addSignature:sig publicKey:pubkey hash:hash];
+    NSAssert(cache.count == 1, @"should not add the same entry twice");
+
+    [cache resetStatistics];
+    NSAssert(cache.hits == 0 && cache.misses == 0, @"should reset counters");
+
+    [cache removeAllSignatures];
+    NSAssert(![cache containsSignature:sig publicKey:pubkey hash:hash], @"should remove all signatures");
+}
+
++ (void) testEviction {
+    BTCSignatureCache* cache = [[BTCSignatureCache alloc] initWithCapacity:10];
+    for (NSUInteger i = 0; i < 100; i++) {
+        [cache addSignature:[self dataWithNumber:i] publicKey:[self dataWithNumber:0] hash:[self dataWithNumber:0]];
+    }
+    NSAssert(cache.count == 10, @"cache should be bounded");
+
+    NSUInteger found = 0;
+    for (NSUInteger i = 0; i < 100; i++) {
+        if ([cache containsSignature:[self dataWithNumber:i] publicKey:[self dataWithNumber:0] hash:[self dataWithNumber:0]]) found++;
+    }
+    NSAssert(found == 10, @"cache should contain exactly capacity entries");
+}
+
++ (void) testConcurrentAccess {
+    BTCSignatureCache* cache = [[BTCSignatureCache alloc] initWithCapacity:1000];
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t t) {
+        for (NSUInteger i = 0; i < 500; i++) {
+            NSData* sig = [self dataWithNumber:i];
+            [cache addSignature:sig publicKey:sig hash:sig];
+            NSAssert([cache containsSignature:sig publicKey:sig hash:sig], @"should find signature added on this thread");
+        }
+    });
+    NSAssert(cache.count == 500, @"concurrently added entries should not be duplicated");
+    NSAssert(cache.hits == 8 * 500, @"should count all hits");
+}
+
+@end
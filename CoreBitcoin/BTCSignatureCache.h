@@ -0,0 +1,41 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import <Foundation/Foundation.h>
+
+// Cache of successfully verified ECDSA signatures, similar to CSignatureCache in bitcoind.
+// Entries are keyed by a salted hash of (signature hash, public key, signature), so the contents
+// cannot be predicted by an attacker. When the cache is full, a random entry is evicted.
+// The cache is thread-safe and may be shared by many BTCScriptMachine instances.
+@interface BTCSignatureCache : NSObject
+
+// Maximum number of entries.
+@property(nonatomic, readonly) NSUInteger capacity;
+
+// Current number of entries.
+@property(nonatomic, readonly) NSUInteger count;
+
+// Number of lookups that found the signature in the cache.
+@property(nonatomic, readonly) uint64_t hits;
+
+// Number of lookups that did not find the signature in the cache.
+@property(nonatomic, readonly) uint64_t misses;
+
+// Cache with default capacity of 50000 entries (about 4 Mb).
+- (id) init;
+
+// Cache with the given maximum number of entries.
+- (id) initWithCapacity:(NSUInteger)capacity;
+
+// Returns YES if the signature was added to the cache. Updates hits and misses counters.
+- (BOOL) containsSignature:(NSData*)signature publicKey:(NSData*)publicKey hash:(NSData*)hash;
+
+// Adds a valid signature to the cache, evicting a random entry if the cache is full.
+- (void) addSignature:(NSData*)signature publicKey:(NSData*)publicKey hash:(NSData*)hash;
+
+// Removes all entries. Counters are not affected.
+- (void) removeAllSignatures;
+
+// Resets hits and misses counters.
+- (void) resetStatistics;
+
+@end
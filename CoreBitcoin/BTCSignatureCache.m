@@ -0,0 +1,118 @@
+// CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
+
+#import "BTCSignatureCache.h"
+#import "BTCData.h"
+#import "BTCSHA256.h"
+#import <CommonCrypto/CommonCrypto.h>
+#import <libkern/OSAtomic.h>
+#import <pthread.h>
+
+static const NSUInteger BTCSignatureCacheDefaultCapacity = 50000;
+
+@implementation BTCSignatureCache {
+    // Random salt prepended to every entry before hashing.
+    NSData* _salt;
+
+    // Set of entries for lookup and array of the same entries for random eviction.
+    NSMutableSet* _entries;
+    NSMutableArray* _entriesArray;
+
+    pthread_rwlock_t _lock;
+
+    volatile int64_t _hits;
+    volatile int64_t _misses;
+}
+
+- (id) init {
+    return [self initWithCapacity:BTCSignatureCacheDefaultCapacity];
+}
+
+- (id) initWithCapacity:(NSUInteger)capacity {
+    if (self = [super init]) {
+        _capacity = MAX(capacity, 1);
+        _salt = BTCRandomDataWithLength(32);
+        _entries = [NSMutableSet set];
+        _entriesArray = [NSMutableArray array];
+        pthread_rwlock_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void) dealloc {
+    pthread_rwlock_destroy(&_lock);
+}
+
+- (NSData*) entryForSignature:(NSData*)signature publicKey:(NSData*)publicKey hash:(NSData*)hash {
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSHA256Update(&ctx, _salt.bytes, _salt.length);
+    BTCSHA256Update(&ctx, hash.bytes, hash.length);
+    BTCSHA256Update(&ctx, publicKey.bytes, publicKey.length);
+    BTCSHA256Update(&ctx, signature.bytes, signature.length);
+    NSMutableData* entry = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    BTCSHA256Final(entry.mutableBytes, &ctx);
+    return entry;
+}
+
+- (BOOL) containsSignature:(NSData*)signature publicKey:(NSData*)publicKey hash:(NSData*)hash {
+    if (!signature || !publicKey || !hash) return NO;
+
+    NSData* entry = [self entryForSignature:signature publicKey:publicKey hash:hash];
+
+    pthread_rwlock_rdlock(&_lock);
+    BOOL found = [_entries containsObject:entry];
+    pthread_rwlock_unlock(&_lock);
+
+    OSAtomicIncrement64(found ? &_hits : &_misses);
+    return found;
+}
+
+- (void) addSignature:(NSData*)signature publicKey:(NSData*)publicKey hash:(NSData*)hash {
+    if (!signature || !publicKey || !hash) return;
+
+    NSData* entry = [self entryForSignature:signature publicKey:publicKey hash:hash];
+
+    pthread_rwlock_wrlock(&_lock);
+    if (![_entries containsObject:entry]) {
+        if (_entriesArray.count < _capacity) {
+            [_entriesArray addObject:entry];
+        } else {
+            // Replace a random entry.
+            NSUInteger i = arc4random_uniform((uint32_t)_entriesArray.count);
+            [_entries removeObject:_entriesArray[i]];
+            _entriesArray[i] = entry;
+        }
+        [_entries addObject:entry];
+    }
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void) removeAllSignatures {
+    pthread_rwlock_wrlock(&_lock);
+    [_entries removeAllObjects];
+    [_entriesArray removeAllObjects];
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (NSUInteger) count {
+    pthread_rwlock_rdlock(&_lock);
+    NSUInteger count = _entriesArray.count;
+    pthread_rwlock_unlock(&_lock);
+    return count;
+}
+
+- (uint64_t) hits {
+    return (uint64_t)_hits;
+}
+
+- (uint64_t) misses {
+    return (uint64_t)_misses;
+}
+
+- (void) resetStatistics {
+    _hits = 0;
+    _misses = 0;
+    OSMemoryBarrier();
+}
+
+@end
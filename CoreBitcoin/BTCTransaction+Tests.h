@@ -14,4 +14,7 @@
 
 + (void) runAllTests;
 
+// Serialized segwit transaction from BIP143 examples.
++ (NSData*) sampleWitnessTransactionData;
+
 @end
@@ -26,6 +26,12 @@ typedef enum : NSUInteger {
 
 + (void) runAllTests {
     [self testSerialization];
+    [self testCursorParsing];
+    [self testPayloadCaching];
+    [self testSignatureHash];
+    [self testWitnessSerialization];
+    [self testWitnessSignatureHash];
+    [self testParsingBenchmark];
     [self testFees];
     [self testSpendCoins:BTCAPIChain];
     [self testSpendCoins:BTCAPIBlockchain];
@@ -221,6 +227,279 @@ typedef enum : NSUInteger {
 }
 
 
++ (NSData*) sampleTransactionData {
+    return BTCDataFromHex(@"0100000002e7131826715b36b47b149177b0f2f3169af74b9188d3d02433d7f3b5e6c796a701000000fdfd0000473044022032e7b327ccf5e7f19029134c50d881daa178a1233d09ac9e6e93081e8f33efaf02202e2bf8b57d1c34554f65fac9c6df4986d31b3f6a7bee6cbab9a3ed835e3f57c301483045022100a355f5cde0b7643a1cbb813df4b29ddca13ddd7ee3685e77b1972179832bbd9a0220391bb9661fdab9f38bcce2abaebde39f3b5874b65758b61e1961c64f8b74d288014c6952210378d430274f8c5ec1321338151e9f27f4c676a008bdf8638d07c0b6be9ab35c7121026a361b855808aeba02d3143b3ec884f709b24d5391c515bd4eafd69d1afae337210355e9d91d63acb15a75c1a9205fc4c0a0878778e08e0a9ca22adb0c2c33fa880153aeffffffff12780cf6595ce7d34ca2e2c104dad5a2ea8709348a280cefc2246bdbd0bf142a01000000fdfd0000483045022100a6967dcd995712007a647d5466131ebc2f5cd3f46c7b314ccf428ea4e46684c502202716cf49125a67627dc2837b747898b38e8c4f58abb13cd3c1c362f0f4094ff301473044022056fc5265f4508e1baf4d837894d5e6e3df8925c68c1f2f8ca83476b73fabd64202200ad5c9928db2d7096a3d19ac2d6fc9eab3db69cd00b9dbcb923bb2e709c5b64f014c6952210378d430274f8c5ec1321338151e9f27f4c676a008bdf8638d07c0b6be9ab35c7121026a361b855808aeba02d3143b3ec884f709b24d5391c515bd4eafd69d1afae337210355e9d91d63acb15a75c1a9205fc4c0a0878778e08e0a9ca22adb0c2c33fa880153aeffffffff03e80300000000000017a914df91b0c30b7d6ec20c50e066c07add242dcfcc1d87e80300000000000017a914df91b0c30b7d6ec20c50e066c07add242dcfcc1d87c60700000000000017a914df91b0c30b7d6ec20c50e066c07add242dcfcc1d8700000000");
+}
+
++ (void) testCursorParsing {
+    NSData* txdata = [self sampleTransactionData];
+
+    NSInputStream* stream = [NSInputStream inputStreamWithData:txdata];
+    [stream open];
+    BTCTransaction* streamTx = [[BTCTransaction alloc] initWithStream:stream];
+    [stream close];
+
+    BTCTransaction* tx = [[BTCTransaction alloc] initWithData:txdata];
+
+    NSAssert(tx, @"Should parse transaction from data");
+    NSAssert(streamTx, @"Should parse transaction from stream");
+    NSAssert([tx.data isEqual:txdata], @"Should serialize back to the same bytes");
+    NSAssert([tx.data isEqual:streamTx.data], @"Cursor and stream parsers should produce the same transaction");
+    NSAssert(tx.inputs.count == 2 && tx.outputs.count == 3, @"Should parse all inputs and outputs");
+
+    // Two transactions back to back are parsed from a single cursor.
+    NSMutableData* twoTxs = [txdata mutableCopy];
+    [twoTxs appendData:txdata];
+    BTCDataCursor cursor = BTCDataCursorMake(twoTxs);
+    BTCTransaction* tx1 = [[BTCTransaction alloc] initWithCursor:&cursor];
+    NSAssert(cursor.offset == txdata.length, @"Cursor should stop right after the first transaction");
+    BTCTransaction* tx2 = [[BTCTransaction alloc] initWithCursor:&cursor];
+    NSAssert(BTCDataCursorRemaining(&cursor) == 0, @"Cursor should consume both transactions");
+    NSAssert([tx1.transactionID isEqual:tx.transactionID] && [tx2.transactionID isEqual:tx.transactionID], @"Should parse the same tx twice");
+
+    // Every truncated prefix must fail cleanly.
+    for (NSUInteger len = 0; len < txdata.length; len += 7) {
+        NSAssert([[BTCTransaction alloc] initWithData:[txdata subdataWithRange:NSMakeRange(0, len)]] == nil, @"Truncated transaction must not parse");
+    }
+}
+
++ (void) testPayloadCaching {
+    BTCTransaction* tx = [[BTCTransaction alloc] initWithData:[self sampleTransactionData]];
+    NSAssert(tx, @"should parse");
+
+    NSData* txhash = tx.transactionHash;
+    NSAssert(tx.transactionHash == txhash, @"hash should be cached");
+    NSAssert(tx.data == tx.data, @"payload should be cached");
+    NSAssert([tx.data isEqual:[self sampleTransactionData]], @"cached payload should match original data");
+
+    tx.lockTime = 1;
+    NSAssert(![tx.transactionHash isEqual:txhash], @"changing lock time should invalidate hash");
+    tx.lockTime = 0;
+    NSAssert([tx.transactionHash isEqual:txhash], @"restoring lock time should restore hash");
+
+    BTCTransactionInput* txin = tx.inputs[0];
+    uint32_t sequence = txin.sequence;
+    txin.sequence = sequence - 1;
+    NSAssert(![tx.transactionHash isEqual:txhash], @"changing input sequence should invalidate hash");
+    txin.sequence = sequence;
+    NSAssert([tx.transactionHash isEqual:txhash], @"restoring input sequence should restore hash");
+
+    BTCTransactionOutput* txout = tx.outputs[0];
+    BTCAmount value = txout.value;
+    txout.value = value + 1;
+    NSAssert(![tx.transactionHash isEqual:txhash], @"changing output value should invalidate hash");
+    txout.value = value;
+    NSAssert([tx.transactionHash isEqual:txhash], @"restoring output value should restore hash");
+
+    [txout.script appendOpcode:OP_NOP];
+    NSAssert([tx.transactionHash isEqual:txhash], @"in-place script mutation is not tracked");
+    [tx invalidatePayload];
+    NSAssert(![tx.transactionHash isEqual:txhash], @"explicit invalidation should recompute hash");
+
+    BTCTransaction* tx2 = [tx copy];
+    NSAssert([tx2.transactionHash isEqual:tx.transactionHash], @"copy should have the same hash");
+    ((BTCTransactionInput*)tx2.inputs[0]).sequence = sequence - 2;
+    NSAssert(![tx2.transactionHash isEqual:tx.transactionHash], @"modifying a copy should invalidate only the copy");
+}
+
+// Straightforward signature hash implementation which copies and modifies the transaction.
+// Used as a reference for the streaming implementation.
++ (NSData*) referenceSignatureHashForTransaction:(BTCTransaction*)transaction script:(BTCScript*)subscript inputIndex:(uint32_t)inputIndex hashType:(BTCSignatureHashType)hashType {
+    BTCTransaction* tx = [transaction copy];
+
+    [subscript deleteOccurrencesOfOpcode:OP_CODESEPARATOR];
+
+    for (BTCTransactionInput* txin in tx.inputs) {
+        txin.signatureScript = [[BTCScript alloc] init];
+    }
+    ((BTCTransactionInput*)tx.inputs[inputIndex]).signatureScript = subscript;
+
+    if ((hashType & SIGHASH_OUTPUT_MASK) == SIGHASH_NONE) {
+        [tx removeAllOutputs];
+        for (NSUInteger i = 0; i < tx.inputs.count; i++) {
+            if (i != inputIndex) ((BTCTransactionInput*)tx.inputs[i]).sequence = 0;
+        }
+    } else if ((hashType & SIGHASH_OUTPUT_MASK) == SIGHASH_SINGLE) {
+        if (inputIndex >= tx.outputs.count) {
+            static unsigned char littleEndianOne[32] = {1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+            return [NSData dataWithBytes:littleEndianOne length:32];
+        }
+        BTCTransactionOutput* myOutput = tx.outputs[inputIndex];
+        [tx removeAllOutputs];
+        for (int i = 0; i < inputIndex; i++) {
+            [tx addOutput:[[BTCTransactionOutput alloc] init]];
+        }
+        [tx addOutput:myOutput];
+        for (NSUInteger i = 0; i < tx.inputs.count; i++) {
+            if (i != inputIndex) ((BTCTransactionInput*)tx.inputs[i]).sequence = 0;
+        }
+    }
+
+    if (hashType & SIGHASH_ANYONECANPAY) {
+        BTCTransactionInput* input = tx.inputs[inputIndex];
+        [tx removeAllInputs];
+        [tx addInput:input];
+    }
+
+    NSMutableData* fulldata = [tx.data mutableCopy];
+    uint32_t hashType32 = OSSwapHostToLittleInt32((uint32_t)hashType);
+    [fulldata appendBytes:&hashType32 length:sizeof(hashType32)];
+    return BTCHash256(fulldata);
+}
+
++ (BTCTransaction*) sampleTransactionWithInputs:(NSUInteger)inputsCount outputs:(NSUInteger)outputsCount {
+    BTCTransaction* tx = [[BTCTransaction alloc] init];
+    tx.lockTime = 123456;
+    for (NSUInteger i = 0; i < inputsCount; i++) {
+        BTCTransactionInput* txin = [[BTCTransactionInput alloc] init];
+        txin.previousHash = BTCHash256([NSData dataWithBytes:&i length:sizeof(i)]);
+        txin.previousIndex = (uint32_t)i;
+        txin.sequence = 0xFFFFFFFF - (uint32_t)i;
+        txin.signatureScript = [[[BTCScript alloc] init] appendData:BTCRandomDataWithLength(72)];
+        [tx addInput:txin];
+    }
+    for (NSUInteger i = 0; i < outputsCount; i++) {
+        BTCKey* key = [[BTCKey alloc] initWithPrivateKey:BTCHash256([NSData dataWithBytes:&i length:sizeof(i)])];
+        [tx addOutput:[[BTCTransactionOutput alloc] initWithValue:1000 * (i + 1) address:key.address]];
+    }
+    return tx;
+}
+
++ (void) testSignatureHash {
+    BTCTransaction* tx = [self sampleTransactionWithInputs:5 outputs:3];
+    BTCScript* script = [[BTCScript alloc] initWithString:@"OP_DUP OP_HASH160 5a73e920b7836c74f9e740a5bb885e8580557038 OP_EQUALVERIFY OP_CHECKSIG"];
+
+    NSArray* hashTypes = @[@0, @(SIGHASH_ALL), @(SIGHASH_NONE), @(SIGHASH_SINGLE), @4,
+                           @(SIGHASH_ALL | SIGHASH_ANYONECANPAY), @(SIGHASH_NONE | SIGHASH_ANYONECANPAY), @(SIGHASH_SINGLE | SIGHASH_ANYONECANPAY)];
+
+    for (NSNumber* hashType in hashTypes) {
+        for (uint32_t i = 0; i < tx.inputs.count; i++) {
+            NSData* expected = [self referenceSignatureHashForTransaction:tx script:[script copy] inputIndex:i hashType:hashType.intValue];
+            NSData* actual = [tx signatureHashForScript:[script copy] inputIndex:i hashType:hashType.intValue error:NULL];
+            NSAssert([actual isEqual:expected], @"streaming signature hash must match reference implementation");
+        }
+    }
+
+    // Cached parts must be recomputed when transaction changes.
+    NSData* hash1 = [tx signatureHashForScript:[script copy] inputIndex:1 hashType:SIGHASH_ALL error:NULL];
+    ((BTCTransactionInput*)tx.inputs[3]).sequence = 7;
+    NSData* hash2 = [tx signatureHashForScript:[script copy] inputIndex:1 hashType:SIGHASH_ALL error:NULL];
+    NSAssert(![hash1 isEqual:hash2], @"signature hash must reflect modified sequence of other input");
+    NSAssert([hash2 isEqual:[self referenceSignatureHashForTransaction:tx script:[script copy] inputIndex:1 hashType:SIGHASH_ALL]], @"must match reference after modification");
+
+    // Benchmark
+    BTCTransaction* bigtx = [self sampleTransactionWithInputs:300 outputs:2];
+    CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+    for (uint32_t i = 0; i < bigtx.inputs.count; i++) {
+        [self referenceSignatureHashForTransaction:bigtx script:[script copy] inputIndex:i hashType:SIGHASH_ALL];
+    }
+    CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+    for (uint32_t i = 0; i < bigtx.inputs.count; i++) {
+        [bigtx signatureHashForScript:[script copy] inputIndex:i hashType:SIGHASH_ALL error:NULL];
+    }
+    CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+    NSLog(@"BTCTransaction: signature hashes for %@ inputs: copying %.3f sec, streaming %.3f sec.", @(bigtx.inputs.count), t1 - t0, t2 - t1);
+}
+
+// Example from BIP143: native P2WPKH.
++ (NSData*) sampleWitnessTransactionData {
+    return BTCDataFromHex(@"01000000000102fff7f7881a8099afa6940d42d1e7f6362bec38171ea3edf433541db4e4ad969f00000000494830450221008b9d1dc26ba6a9cb62127b02742fa9d754cd3bebf337f7a55d114c8e5cdd30be022040529b194ba3f9281a99f2b1c0a19c0489bc22ede944ccf4ecbab4cc618ef3ed01eeffffffef51e1b804cc89d182d279655c3aa89e815b1b309fe287d9b2b55d57b90ec68a0100000000ffffffff02202cb206000000001976a9148280b37df378db99f66f85c95a783a76ac7a6d5988ac9093510d000000001976a9143bde42dbee7e4dbe6a21b2d50ce2f0167faa815988ac000247304402203609e17b84f6a7d30c80bfa610b5b4542f32a8a0d5447a12fb1366d7f01cc44a0220573a954c4518331561406f90300e8f3358f51928d43c212a8caed02de67eebee0121025476c2e83188368da1ff3e292e7acafcdb3566bb0ad253f62fc70f07aeee635711000000");
+}
+
++ (void) testWitnessSerialization {
+    NSData* txdata = [self sampleWitnessTransactionData];
+    BTCTransaction* tx = [[BTCTransaction alloc] initWithData:txdata];
+    NSAssert(tx, @"should parse segwit transaction");
+    NSAssert(tx.hasWitness, @"should have witness");
+    NSAssert(tx.inputs.count == 2 && tx.outputs.count == 2, @"should parse inputs and outputs");
+    NSAssert([tx.inputs[0] witness].count == 0, @"first input has no witness");
+    NSAssert([tx.inputs[1] witness].count == 2, @"second input has signature and pubkey in witness");
+    NSAssert(tx.lockTime == 0x11, @"should parse lock time");
+    NSAssert([tx.data isEqual:txdata], @"should serialize with witness");
+    NSAssert([tx.transactionID isEqual:@"e8151a2af31c368a35053ddd4bdb285a8595c769a3ad83e0fa02314a602d4609"], @"txid should not cover witness");
+    NSAssert([tx.witnessTransactionID isEqual:@"c36c38370907df2324d9ce9d149d191192f338b37665a82e78e76a12c909b762"], @"wtxid should cover witness");
+
+    BTCTransaction* stripped = [[BTCTransaction alloc] initWithData:tx.dataWithoutWitness];
+    NSAssert(stripped && !stripped.hasWitness, @"should parse stripped transaction");
+    NSAssert([stripped.transactionHash isEqual:tx.transactionHash], @"stripped transaction should have the same txid");
+    NSAssert([stripped.witnessHash isEqual:stripped.transactionHash], @"wtxid == txid without witness");
+
+    NSInputStream* stream = [NSInputStream inputStreamWithData:txdata];
+    [stream open];
+    BTCTransaction* tx2 = [[BTCTransaction alloc] initWithStream:stream];
+    [stream close];
+    NSAssert([tx2.data isEqual:txdata], @"should parse segwit transaction from stream");
+
+    NSAssert([tx.dictionary[@"in"][1][@"witness"] count] == 2, @"dictionary should contain witness");
+    BTCTransactionInput* txin = [[BTCTransactionInput alloc] initWithDictionary:[tx.inputs[1] dictionary]];
+    NSAssert([txin.witness isEqual:[tx.inputs[1] witness]], @"witness should be restored from dictionary");
+
+    BTCTransaction* copy = [tx copy];
+    NSAssert([copy.data isEqual:txdata], @"copy should preserve witness");
+    ((BTCTransactionInput*)copy.inputs[1]).witness = @[];
+    NSAssert(!copy.hasWitness, @"removing witness should switch to legacy serialization");
+    NSAssert([copy.data isEqual:tx.dataWithoutWitness], @"should serialize without witness");
+
+    // Marker with all-empty witnesses is not allowed.
+    NSMutableData* superfluous = [copy.dataWithoutWitness mutableCopy];
+    [superfluous replaceBytesInRange:NSMakeRange(4, 0) withBytes:"\x00\x01" length:2];
+    [superfluous replaceBytesInRange:NSMakeRange(superfluous.length - 4, 0) withBytes:"\x00\x00" length:2];
+    NSAssert(![[BTCTransaction alloc] initWithData:superfluous], @"should reject superfluous witness record");
+
+    // Empty transaction is still serialized and parsed as before.
+    BTCTransaction* empty = [[BTCTransaction alloc] init];
+    NSAssert([[[BTCTransaction alloc] initWithData:empty.data].data isEqual:empty.data], @"empty transaction should round-trip");
+}
+
++ (void) testWitnessSignatureHash {
+    // Unsigned transaction from the BIP143 native P2WPKH example.
+    BTCTransaction* tx = [[BTCTransaction alloc] initWithHex:@"0100000002fff7f7881a8099afa6940d42d1e7f6362bec38171ea3edf433541db4e4ad969f0000000000eeffffffef51e1b804cc89d182d279655c3aa89e815b1b309fe287d9b2b55d57b90ec68a0100000000ffffffff02202cb206000000001976a9148280b37df378db99f66f85c95a783a76ac7a6d5988ac9093510d000000001976a9143bde42dbee7e4dbe6a21b2d50ce2f0167faa815988ac11000000"];
+    NSAssert(tx, @"should parse unsigned transaction");
+
+    BTCScript* scriptCode = [[BTCScript alloc] initWithData:BTCDataFromHex(@"76a9141d0f172a0ecb48aee1be1f2687d2963ae33f71a188ac")];
+    NSData* sighash = [tx witnessSignatureHashForScript:scriptCode inputIndex:1 amount:600000000 hashType:SIGHASH_ALL error:NULL];
+    NSAssert([sighash isEqual:BTCDataFromHex(@"c37af31116d1b27caf68aae9e3ac82f1477929014d5b917657d0eb49478cb670")], @"should match BIP143 example");
+
+    // Adding signatures does not change the hash.
+    ((BTCTransactionInput*)tx.inputs[1]).witness = @[BTCDataFromHex(@"00"), BTCDataFromHex(@"01")];
+    ((BTCTransactionInput*)tx.inputs[0]).signatureScript = [[[BTCScript alloc] init] appendOpcode:OP_1];
+    NSAssert([[tx witnessSignatureHashForScript:scriptCode inputIndex:1 amount:600000000 hashType:SIGHASH_ALL error:NULL] isEqual:sighash], @"signatures should not affect signature hash");
+
+    // Other inputs' sequence is committed in SIGHASH_ALL but not in SIGHASH_SINGLE.
+    NSData* single = [tx witnessSignatureHashForScript:scriptCode inputIndex:1 amount:600000000 hashType:SIGHASH_SINGLE error:NULL];
+    ((BTCTransactionInput*)tx.inputs[0]).sequence = 1;
+    NSAssert(![[tx witnessSignatureHashForScript:scriptCode inputIndex:1 amount:600000000 hashType:SIGHASH_ALL error:NULL] isEqual:sighash], @"sequence change should be reflected");
+    NSAssert([[tx witnessSignatureHashForScript:scriptCode inputIndex:1 amount:600000000 hashType:SIGHASH_SINGLE error:NULL] isEqual:single], @"SIGHASH_SINGLE does not commit to other sequences");
+
+    NSAssert(![tx witnessSignatureHashForScript:scriptCode inputIndex:2 amount:0 hashType:SIGHASH_ALL error:NULL], @"should fail for out of bounds input");
+}
+
++ (void) testParsingBenchmark {
+    NSData* txdata = [self sampleTransactionData];
+    const int iterations = 2000;
+
+    CFAbsoluteTime t0 = CFAbsoluteTimeGetCurrent();
+    for (int i = 0; i < iterations; i++) {
+        @autoreleasepool {
+            NSInputStream* stream = [NSInputStream inputStreamWithData:txdata];
+            [stream open];
+            BTCTransaction* tx = [[BTCTransaction alloc] initWithStream:stream];
+            [stream close];
+            NSAssert(tx, @"Should parse");
+        }
+    }
+    CFAbsoluteTime t1 = CFAbsoluteTimeGetCurrent();
+    for (int i = 0; i < iterations; i++) {
+        @autoreleasepool {
+            BTCTransaction* tx = [[BTCTransaction alloc] initWithData:txdata];
+            NSAssert(tx, @"Should parse");
+        }
+    }
+    CFAbsoluteTime t2 = CFAbsoluteTimeGetCurrent();
+
+    NSLog(@"BTCTransaction parsing x%d: stream %.1f ms, cursor %.1f ms", iterations, (t1 - t0)*1000.0, (t2 - t1)*1000.0);
+}
+
 + (void) testSpendCoins:(BTCAPI)btcAPI {
     // For safety I'm not putting a private key in the source code, but copy-paste here from Keychain on each run.
     printf("Private key in hex:\n");
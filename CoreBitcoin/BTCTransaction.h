@@ -3,6 +3,7 @@
 #import <Foundation/Foundation.h>
 #import "BTCUnitsAndLimits.h"
 #import "BTCSignatureHashType.h"
+#import "BTCProtocolSerialization.h"
 
 static const uint32_t BTCTransactionCurrentVersion = 1;
 static const BTCAmount BTCTransactionDefaultFeeRate = 10000; // 10K satoshis per 1000 bytes
@@ -29,7 +30,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
  */
 @interface BTCTransaction : NSObject<NSCopying>
 
-// Raw transaction hash SHA256(SHA256(payload))
+// Raw transaction hash SHA256(SHA256(payload without witness))
 @property(nonatomic, readonly) NSData* transactionHash;
 
 /*!
@@ -43,6 +44,17 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
  */
 @property(nonatomic, readonly) NSString* transactionID;
 
+/*!
+ * Hash of the transaction including witness data (BIP141), aka "wtxid".
+ * Equals `-transactionHash` if the transaction has no witness.
+ */
+@property(nonatomic, readonly) NSData* witnessHash;
+
+/*!
+ * Hex representation of reversed `-witnessHash`.
+ */
+@property(nonatomic, readonly) NSString* witnessTransactionID;
+
 // Array of BTCTransactionInput objects
 @property(nonatomic) NSArray* inputs;
 
@@ -57,8 +69,15 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
 @property(nonatomic) uint32_t lockTime; // aka "lock_time"
 
 // Binary representation on tx ready to be sent over the wire (aka "payload")
+// If any input has a witness, transaction is serialized with marker, flag and witnesses as specified in BIP144.
 @property(nonatomic, readonly) NSData* data;
 
+// Binary representation of tx without witness data. Used to compute transaction hash.
+@property(nonatomic, readonly) NSData* dataWithoutWitness;
+
+// Returns YES if any of the inputs has a non-empty witness.
+@property(nonatomic, readonly) BOOL hasWitness;
+
 // Binary representiation in hex.
 @property(nonatomic, readonly) NSString* hex;
 
@@ -121,6 +140,11 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
 // Parses input stream (useful when parsing many transactions from a single source, e.g. a block).
 - (id) initWithStream:(NSInputStream*)stream;
 
+// Parses tx from the cursor and advances it past the transaction.
+// Hashes and scripts reference the cursor's buffer without copying.
+// This is the fastest way to parse many transactions from a single buffer (e.g. a block).
+- (id) initWithCursor:(BTCDataCursor*)cursor;
+
 // Constructs transaction from its dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary;
 
@@ -128,6 +152,12 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
 // You should supply the output script of the previous transaction, desired hash type and input index in this transaction.
 - (NSData*) signatureHashForScript:(BTCScript*)subscript inputIndex:(uint32_t)inputIndex hashType:(BTCSignatureHashType)hashType error:(NSError**)errorOut;
 
+// Hash for signing a segwit input (BIP143).
+// Script code is the script being executed (e.g. P2PKH script for P2WPKH or witness script for P2WSH),
+// amount is the value of the output spent by this input.
+// Hashes of all prevouts, sequences and outputs are computed once and reused for all inputs.
+- (NSData*) witnessSignatureHashForScript:(BTCScript*)scriptCode inputIndex:(uint32_t)inputIndex amount:(BTCAmount)amount hashType:(BTCSignatureHashType)hashType error:(NSError**)errorOut;
+
 // Adds input script
 - (void) addInput:(BTCTransactionInput*)input;
 
@@ -140,9 +170,26 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) DEPRECATED_ATTRIBUTE;
 // Replaces outputs with an empty array.
 - (void) removeAllOutputs;
 
+// Discards cached serialized payload and transaction hash.
+// Serialization and hash are computed once and cached until the transaction or any of its inputs or outputs change.
+// Changes via properties of the transaction, inputs and outputs are tracked automatically.
+// Call this method only if you mutate a script of an already added input or output in place (e.g. with -appendData:).
+- (void) invalidatePayload;
+
 // Returns YES if this txin generates new coins.
 @property(nonatomic, readonly) BOOL isCoinbase;
 
+// Number of signature operations in all input and output scripts counted by legacy rules.
+// See GetLegacySigOpCount() in bitcoind.
+@property(nonatomic, readonly) NSUInteger sigOpCount;
+
+// Number of signature operations in P2SH redeem scripts provided by the inputs.
+// See GetP2SHSigOpCount() in bitcoind.
+// Outputs is an array of BTCTransactionOutput objects spent by the inputs (in the same order).
+// If outputs is nil, `transactionOutput` of each input is used. Inputs with unknown outputs are not counted.
+// Returns 0 for coinbase transaction.
+- (NSUInteger) P2SHSigOpCountWithSpentOutputs:(NSArray*)outputs;
+
 // Computes estimated fee for this tx size using default fee rate.
 // @see BTCTransactionDefaultFeeRate.
 @property(nonatomic, readonly) BTCAmount estimatedFee;
@@ -5,9 +5,42 @@
 #import "BTCTransactionOutput.h"
 #import "BTCProtocolSerialization.h"
 #import "BTCData.h"
+#import "BTCSHA256.h"
 #import "BTCScript.h"
 #import "BTCErrors.h"
 #import "BTCHashID.h"
+#import <CommonCrypto/CommonCrypto.h>
+
+// Length of an input with empty script: outpoint (32+4 bytes), script length (1 byte) and sequence (4 bytes).
+static const NSUInteger BTCBlankedInputLength = 32 + 4 + 1 + 4;
+
+// Parts of the SIGHASH_ALL preimage shared by all inputs of the transaction.
+@interface BTCTransactionSignatureHashCache : NSObject
+// Serialized inputs with empty scripts.
+@property(nonatomic) NSData* blankedInputs;
+// Serialized outputs prefixed with their count.
+@property(nonatomic) NSData* outputs;
+// SHA-256 contexts (BTCSHA256Context) after hashing version, inputs count and blanked inputs preceding each input.
+@property(nonatomic) NSData* midstates;
+@end
+
+@implementation BTCTransactionSignatureHashCache
+@end
+
+// Parts of the BIP143 preimage shared by all inputs of the transaction.
+@interface BTCTransactionWitnessSignatureHashCache : NSObject
+@property(nonatomic) NSData* hashPrevouts;
+@property(nonatomic) NSData* hashSequence;
+@property(nonatomic) NSData* hashOutputs;
+@end
+
+@implementation BTCTransactionWitnessSignatureHashCache
+@end
+
+static NSMutableData* BTCSignatureHashFinalDouble(BTCSHA256Context* ctx);
+static void BTCSignatureHashUpdateUInt32(BTCSHA256Context* ctx, uint32_t value);
+static void BTCSignatureHashUpdateVarInt(BTCSHA256Context* ctx, uint64_t value);
+static void BTCSignatureHashUpdateInput(BTCSHA256Context* ctx, BTCTransactionInput* txin, NSData* scriptData, uint32_t sequence);
 
 NSData* BTCTransactionHashFromID(NSString* txid) {
     return BTCHashFromID(txid);
@@ -20,7 +53,17 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
 @interface BTCTransaction ()
 @end
 
-@implementation BTCTransaction
+@implementation BTCTransaction {
+    // Cached serialized payload and its hash. Reset by -invalidatePayload.
+    NSData* _payload;
+    NSData* _payloadWithoutWitness;
+    NSData* _transactionHash;
+    NSData* _witnessHash;
+    
+    // Cached parts of signature hash preimages. Reset by -invalidatePayload.
+    BTCTransactionSignatureHashCache* _signatureHashCache;
+    BTCTransactionWitnessSignatureHashCache* _witnessSignatureHashCache;
+}
 
 - (id) init {
     if (self = [super init]) {
@@ -59,6 +102,14 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     return self;
 }
 
+// Parses tx from the cursor and advances it past the transaction.
+- (id) initWithCursor:(BTCDataCursor*)cursor {
+    if (self = [self init]) {
+        if (![self parseCursor:cursor]) return nil;
+    }
+    return self;
+}
+
 // Constructs transaction from dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary {
     if (self = [self init]) {
@@ -69,6 +120,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         for (id dict in dictionary[@"in"]) {
             BTCTransactionInput* txin = [[BTCTransactionInput alloc] initWithDictionary:dict];
             if (!txin) return nil;
+            [self linkInput:txin];
             [ins addObject:txin];
         }
         _inputs = ins;
@@ -77,6 +129,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         for (id dict in dictionary[@"out"]) {
             BTCTransactionOutput* txout = [[BTCTransactionOutput alloc] initWithDictionary:dict];
             if (!txout) return nil;
+            [self linkOutput:txout];
             [outs addObject:txout];
         }
         _outputs = outs;
@@ -126,10 +179,10 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     tx->_inputs = [[NSArray alloc] initWithArray:self.inputs copyItems:YES]; // so each element is copied individually
     tx->_outputs = [[NSArray alloc] initWithArray:self.outputs copyItems:YES]; // so each element is copied individually
     for (BTCTransactionInput* txin in tx.inputs) {
-        txin.transaction = self;
+        txin.transaction = tx;
     }
     for (BTCTransactionOutput* txout in tx.outputs) {
-        txout.transaction = self;
+        txout.transaction = tx;
     }
     tx.version = self.version;
     tx.lockTime = self.lockTime;
@@ -150,7 +203,21 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
 
 
 - (NSData*) transactionHash {
-    return BTCHash256(self.data);
+    if (!_transactionHash) {
+        _transactionHash = [BTCHash256(self.dataWithoutWitness) copy];
+    }
+    return _transactionHash;
+}
+
+- (NSData*) witnessHash {
+    if (!_witnessHash) {
+        _witnessHash = [BTCHash256(self.data) copy];
+    }
+    return _witnessHash;
+}
+
+- (NSString*) witnessTransactionID {
+    return BTCIDFromHash(self.witnessHash);
 }
 
 - (NSString*) displayTransactionHash { // deprecated
@@ -170,20 +237,69 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
 }
 
 - (NSData*) data {
-    return [self computePayload];
+    if (!_payload) {
+        _payload = [[self computePayloadWithWitness:self.hasWitness] copy];
+    }
+    return _payload;
+}
+
+- (NSData*) dataWithoutWitness {
+    if (!self.hasWitness) {
+        return self.data;
+    }
+    if (!_payloadWithoutWitness) {
+        _payloadWithoutWitness = [[self computePayloadWithWitness:NO] copy];
+    }
+    return _payloadWithoutWitness;
+}
+
+- (BOOL) hasWitness {
+    for (BTCTransactionInput* txin in _inputs) {
+        if (txin.witness.count > 0) return YES;
+    }
+    return NO;
+}
+
+- (void) invalidatePayload {
+    [self invalidatePayloadPreservingSignatureHashes];
+    _signatureHashCache = nil;
+    _witnessSignatureHashCache = nil;
+}
+
+- (void) invalidatePayloadPreservingSignatureHashes {
+    _payload = nil;
+    _payloadWithoutWitness = nil;
+    _transactionHash = nil;
+    _witnessHash = nil;
+}
+
+- (void) setVersion:(uint32_t)version {
+    _version = version;
+    [self invalidatePayload];
+}
+
+- (void) setLockTime:(uint32_t)lockTime {
+    _lockTime = lockTime;
+    [self invalidatePayload];
 }
 
 - (NSString*) hex {
     return BTCHexFromData(self.data);
 }
 
-- (NSData*) computePayload {
+- (NSData*) computePayloadWithWitness:(BOOL)withWitness {
     NSMutableData* payload = [NSMutableData data];
     
     // 4-byte version
     uint32_t ver = _version;
     [payload appendBytes:&ver length:4];
     
+    // BIP144 marker (zero inputs count) and flag.
+    if (withWitness) {
+        const unsigned char markerAndFlag[2] = {0x00, 0x01};
+        [payload appendBytes:markerAndFlag length:2];
+    }
+    
     // varint with number of inputs
     [payload appendData:[BTCProtocolSerialization dataForVarInt:_inputs.count]];
     
@@ -200,6 +316,13 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         [payload appendData:output.data];
     }
     
+    // witness for each input
+    if (withWitness) {
+        for (BTCTransactionInput* input in _inputs) {
+            [payload appendData:input.witnessData];
+        }
+    }
+    
     // 4-byte lock_time
     uint32_t lt = _lockTime;
     [payload appendBytes:&lt length:4];
@@ -216,6 +339,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     if (!input) return;
     [self linkInput:input];
     _inputs = [_inputs arrayByAddingObject:input];
+    [self invalidatePayload];
 }
 
 - (void) linkInput:(BTCTransactionInput*)input {
@@ -231,6 +355,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     if (!output) return;
     [self linkOutput:output];
     _outputs = [_outputs arrayByAddingObject:output];
+    [self invalidatePayload];
 }
 
 - (void) linkOutput:(BTCTransactionOutput*)output {
@@ -262,6 +387,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         txin.transaction = nil;
     }
     _inputs = @[];
+    [self invalidatePayload];
 }
 
 - (void) removeAllOutputs {
@@ -269,6 +395,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         txout.transaction = nil;
     }
     _outputs = @[];
+    [self invalidatePayload];
 }
 
 - (BOOL) isCoinbase {
@@ -276,6 +403,39 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     return (_inputs.count == 1 && [(BTCTransactionInput*)_inputs[0] isCoinbase]);
 }
 
+- (NSUInteger) sigOpCount {
+    NSUInteger count = 0;
+    for (BTCTransactionInput* txin in _inputs) {
+        if (txin.signatureScript) {
+            count += txin.signatureScript.sigOpCount;
+        } else {
+            // Coinbase script is counted too, though it is never executed.
+            NSUInteger coinbaseCount = 0;
+            BTCScriptBytesCountSigOps(txin.coinbaseData.bytes, txin.coinbaseData.length, &coinbaseCount, NULL);
+            count += coinbaseCount;
+        }
+    }
+    for (BTCTransactionOutput* txout in _outputs) {
+        count += txout.script.sigOpCount;
+    }
+    return count;
+}
+
+- (NSUInteger) P2SHSigOpCountWithSpentOutputs:(NSArray*)outputs {
+    if (self.isCoinbase) return 0;
+    
+    NSUInteger count = 0;
+    NSUInteger inputIndex = 0;
+    for (BTCTransactionInput* txin in _inputs) {
+        BTCTransactionOutput* txout = outputs ? (inputIndex < outputs.count ? outputs[inputIndex] : nil) : txin.transactionOutput;
+        if ([txout isKindOfClass:[BTCTransactionOutput class]] && txout.script.isPayToScriptHashScript) {
+            count += [txout.script sigOpCountWithSignatureScript:txin.signatureScript];
+        }
+        inputIndex++;
+    }
+    return count;
+}
+
 
 #pragma mark - Serialization and parsing
 
@@ -283,11 +443,90 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
 
 - (BOOL) parseData:(NSData*)data {
     if (!data) return NO;
-    NSInputStream* stream = [NSInputStream inputStreamWithData:data];
-    [stream open];
-    BOOL result = [self parseStream:stream];
-    [stream close];
-    return result;
+    data = [data copy]; // so mutable data can't be changed under our zero-copy scripts and hashes.
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    return [self parseCursor:&cursor];
+}
+
+- (BOOL) parseCursor:(BTCDataCursor*)cursor {
+    if (!BTCDataCursorReadUInt32(cursor, &_version)) return NO;
+    
+    uint64_t inputsCount = 0;
+    if (!BTCDataCursorReadVarInt(cursor, &inputsCount)) return NO;
+    
+    // BIP144: zero inputs count is a marker of extended serialization followed by a non-zero flag byte.
+    // As in bitcoind, a transaction with zero inputs and a zero flag is read without outputs.
+    unsigned char flags = 0;
+    BOOL extended = NO;
+    if (inputsCount == 0) {
+        if (!BTCDataCursorReadBytes(cursor, &flags, 1)) return NO;
+        extended = YES;
+        if (flags != 0) {
+            if (!BTCDataCursorReadVarInt(cursor, &inputsCount)) return NO;
+        }
+    }
+    
+    {
+        // Each input takes at least 41 bytes, so a bogus count can't make us allocate a huge array.
+        if (inputsCount > BTCDataCursorRemaining(cursor) / 41) return NO;
+        
+        NSMutableArray* ins = [NSMutableArray arrayWithCapacity:(NSUInteger)inputsCount];
+        for (uint64_t i = 0; i < inputsCount; i++)
+        {
+            BTCTransactionInput* input = [[BTCTransactionInput alloc] initWithCursor:cursor];
+            if (!input) return NO;
+            [self linkInput:input];
+            [ins addObject:input];
+        }
+        _inputs = ins;
+    }
+    
+    if (!extended || flags != 0) {
+        uint64_t outputsCount = 0;
+        if (!BTCDataCursorReadVarInt(cursor, &outputsCount)) return NO;
+        
+        // Each output takes at least 9 bytes.
+        if (outputsCount > BTCDataCursorRemaining(cursor) / 9) return NO;
+        
+        NSMutableArray* outs = [NSMutableArray arrayWithCapacity:(NSUInteger)outputsCount];
+        for (uint64_t i = 0; i < outputsCount; i++)
+        {
+            BTCTransactionOutput* output = [[BTCTransactionOutput alloc] initWithCursor:cursor];
+            if (!output) return NO;
+            [self linkOutput:output];
+            [outs addObject:output];
+        }
+        _outputs = outs;
+    }
+    
+    if (flags & 1) {
+        flags ^= 1;
+        for (BTCTransactionInput* input in _inputs) {
+            uint64_t itemsCount = 0;
+            if (!BTCDataCursorReadVarInt(cursor, &itemsCount)) return NO;
+            
+            // Each item takes at least 1 byte.
+            if (itemsCount > BTCDataCursorRemaining(cursor)) return NO;
+            
+            NSMutableArray* witness = [NSMutableArray arrayWithCapacity:(NSUInteger)itemsCount];
+            for (uint64_t i = 0; i < itemsCount; i++) {
+                NSData* item = BTCDataCursorReadVarString(cursor);
+                if (!item) return NO;
+                [witness addObject:item];
+            }
+            input.witness = witness;
+        }
+        
+        // Superfluous witness record is not allowed.
+        if (!self.hasWitness) return NO;
+    }
+    
+    // Unknown optional data.
+    if (flags != 0) return NO;
+    
+    if (!BTCDataCursorReadUInt32(cursor, &_lockTime)) return NO;
+    
+    return YES;
 }
 
 - (BOOL) parseStream:(NSInputStream*)stream {
@@ -297,10 +536,21 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     
     if ([stream read:(uint8_t*)&_version maxLength:sizeof(_version)] != sizeof(_version)) return NO;
     
+    uint64_t inputsCount = 0;
+    if ([BTCProtocolSerialization readVarInt:&inputsCount fromStream:stream] == 0) return NO;
+    
+    // See comments in -parseCursor:.
+    uint8_t flags = 0;
+    BOOL extended = NO;
+    if (inputsCount == 0) {
+        if ([stream read:&flags maxLength:1] != 1) return NO;
+        extended = YES;
+        if (flags != 0) {
+            if ([BTCProtocolSerialization readVarInt:&inputsCount fromStream:stream] == 0) return NO;
+        }
+    }
+    
     {
-        uint64_t inputsCount = 0;
-        if ([BTCProtocolSerialization readVarInt:&inputsCount fromStream:stream] == 0) return NO;
-        
         NSMutableArray* ins = [NSMutableArray array];
         for (uint64_t i = 0; i < inputsCount; i++)
         {
@@ -312,7 +562,7 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         _inputs = ins;
     }
 
-    {
+    if (!extended || flags != 0) {
         uint64_t outputsCount = 0;
         if ([BTCProtocolSerialization readVarInt:&outputsCount fromStream:stream] == 0) return NO;
             
@@ -327,6 +577,25 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
         _outputs = outs;
     }
     
+    if (flags & 1) {
+        flags ^= 1;
+        for (BTCTransactionInput* input in _inputs) {
+            uint64_t itemsCount = 0;
+            if ([BTCProtocolSerialization readVarInt:&itemsCount fromStream:stream] == 0) return NO;
+            
+            NSMutableArray* witness = [NSMutableArray array];
+            for (uint64_t i = 0; i < itemsCount; i++) {
+                NSData* item = [BTCProtocolSerialization readVarStringFromStream:stream];
+                if (!item) return NO;
+                [witness addObject:item];
+            }
+            input.witness = witness;
+        }
+        if (!self.hasWitness) return NO;
+    }
+    
+    if (flags != 0) return NO;
+    
     if ([stream read:(uint8_t*)&_lockTime maxLength:sizeof(_lockTime)] != sizeof(_lockTime)) return NO;
     
     return YES;
@@ -340,12 +609,9 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
 // Hash for signing a transaction.
 // You should supply the output script of the previous transaction, desired hash type and input index in this transaction.
 - (NSData*) signatureHashForScript:(BTCScript*)subscript inputIndex:(uint32_t)inputIndex hashType:(BTCSignatureHashType)hashType error:(NSError**)errorOut {
-    // Create a temporary copy of the transaction to apply modifications to it.
-    BTCTransaction* tx = [self copy];
-    
     // We may have a scriptmachine instantiated without a transaction (for testing),
     // but it should not use signature checks then.
-    if (!tx || inputIndex == 0xFFFFFFFF) {
+    if (inputIndex == 0xFFFFFFFF) {
         if (errorOut) *errorOut = [NSError errorWithDomain:BTCErrorDomain
                                                       code:BTCErrorScriptError
                                                   userInfo:@{NSLocalizedDescriptionKey: NSLocalizedString(@"Transaction and valid input index must be provided for signature verification.", @"")}];
@@ -355,12 +621,12 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     // Note: BitcoinQT returns a 256-bit little-endian number 1 in such case, but it does not matter
     // because it would crash before that in CScriptCheck::operator()(). We normally won't enter this condition
     // if script machine is instantiated with initWithTransaction:inputIndex:, but if it was just -init-ed, it's better to check.
-    if (inputIndex >= tx.inputs.count) {
+    if (inputIndex >= _inputs.count) {
         if (errorOut) *errorOut = [NSError errorWithDomain:BTCErrorDomain
                                                       code:BTCErrorScriptError
                                                   userInfo:@{NSLocalizedDescriptionKey:[NSString stringWithFormat:
                                                      NSLocalizedString(@"Input index is out of bounds for transaction: %d >= %d.", @""),
-                                                                                        (int)inputIndex, (int)tx.inputs.count]}];
+                                                                                        (int)inputIndex, (int)_inputs.count]}];
         return nil;
     }
     
@@ -371,79 +637,280 @@ NSString* BTCTransactionIDFromHash(NSData* txhash) {
     // Also: we modify the same subscript which is used several times for multisig check, but that's what BitcoinQT does as well.
     [subscript deleteOccurrencesOfOpcode:OP_CODESEPARATOR];
     
-    // Blank out other inputs' signature scripts
-    // and replace our input script with a subscript (which is typically a full output script from the previous transaction).
-    for (BTCTransactionInput* txin in tx.inputs) {
-        txin.signatureScript = [[BTCScript alloc] init];
+    BTCSignatureHashType outputMode = hashType & SIGHASH_OUTPUT_MASK;
+    BOOL anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY) != 0;
+    
+    // Single mode assumes we sign an output at the same index as an input.
+    // If outputIndex is out of bounds, BitcoinQT is returning a 256-bit little-endian 0x01 instead of failing with error.
+    // We should do the same to stay compatible.
+    if (outputMode == SIGHASH_SINGLE && inputIndex >= _outputs.count) {
+        static unsigned char littleEndianOne[32] = {1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+        return [NSData dataWithBytes:littleEndianOne length:32];
+    }
+    
+    // Instead of copying and modifying the transaction, we stream the modified serialization
+    // directly into SHA-256 context. Other inputs have their scripts blanked out
+    // and our input has its script replaced with a subscript (which is typically a full output script from the previous transaction).
+    NSData* subscriptData = subscript.data ?: [NSData data];
+    BTCTransactionInput* txin = _inputs[inputIndex];
+    BTCSHA256Context ctx;
+    
+    BTCTransactionSignatureHashCache* cache = nil;
+    if (!anyoneCanPay && outputMode != SIGHASH_NONE && outputMode != SIGHASH_SINGLE) {
+        cache = [self signatureHashCache];
     }
-    ((BTCTransactionInput*)tx.inputs[inputIndex]).signatureScript = subscript;
     
-    // Blank out some of the outputs depending on BTCSignatureHashType
-    // Default is SIGHASH_ALL - all inputs and outputs are signed.
-    if ((hashType & SIGHASH_OUTPUT_MASK) == SIGHASH_NONE) {
-        // Wildcard payee - we can pay anywhere.
-        [tx removeAllOutputs];
+    if (cache) {
+        // Default SIGHASH_ALL mode: start with a midstate after all preceding blanked inputs,
+        // hash our input and continue with the following blanked inputs and all outputs.
+        ctx = ((const BTCSHA256Context*)cache.midstates.bytes)[inputIndex];
+        BTCSignatureHashUpdateInput(&ctx, txin, subscriptData, txin.sequence);
+        NSUInteger suffixOffset = (inputIndex + 1) * BTCBlankedInputLength;
+        BTCSHA256Update(&ctx, (const unsigned char*)cache.blankedInputs.bytes + suffixOffset, cache.blankedInputs.length - suffixOffset);
+        BTCSHA256Update(&ctx, cache.outputs.bytes, cache.outputs.length);
+    } else {
+        BTCSHA256Init(&ctx);
+        BTCSignatureHashUpdateUInt32(&ctx, _version);
         
-        // Blank out others' input sequence numbers to let others update transaction at will.
-        for (NSUInteger i = 0; i < tx.inputs.count; i++) {
-            if (i != inputIndex) {
-                ((BTCTransactionInput*)tx.inputs[i]).sequence = 0;
+        if (anyoneCanPay) {
+            // Blank out other inputs completely. This is not recommended for open transactions.
+            BTCSignatureHashUpdateVarInt(&ctx, 1);
+            BTCSignatureHashUpdateInput(&ctx, txin, subscriptData, txin.sequence);
+        } else {
+            BTCSignatureHashUpdateVarInt(&ctx, _inputs.count);
+            for (NSUInteger i = 0; i < _inputs.count; i++) {
+                BTCTransactionInput* input = _inputs[i];
+                if (i == inputIndex) {
+                    BTCSignatureHashUpdateInput(&ctx, input, subscriptData, input.sequence);
+                } else {
+                    // In NONE and SINGLE modes blank out others' input sequence numbers to let others update transaction at will.
+                    BOOL blankSequence = (outputMode == SIGHASH_NONE || outputMode == SIGHASH_SINGLE);
+                    BTCSignatureHashUpdateInput(&ctx, input, nil, blankSequence ? 0 : input.sequence);
+                }
             }
         }
-    } else if ((hashType & SIGHASH_OUTPUT_MASK) == SIGHASH_SINGLE) {
-        // Single mode assumes we sign an output at the same index as an input.
-        // Outputs before the one we need are blanked out. All outputs after are simply removed.
-        // Only lock-in the txout payee at same index as txin.
-        uint32_t outputIndex = inputIndex;
-        
-        // If outputIndex is out of bounds, BitcoinQT is returning a 256-bit little-endian 0x01 instead of failing with error.
-        // We should do the same to stay compatible.
-        if (outputIndex >= tx.outputs.count) {
-            static unsigned char littleEndianOne[32] = {1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-            return [NSData dataWithBytes:littleEndianOne length:32];
-        }
-        
-        // All outputs before the one we need are blanked out. All outputs after are simply removed.
-        // This is equivalent to replacing outputs with (i-1) empty outputs and a i-th original one.
-        BTCTransactionOutput* myOutput = tx.outputs[outputIndex];
-        [tx removeAllOutputs];
-        for (int i = 0; i < outputIndex; i++) {
-            [tx addOutput:[[BTCTransactionOutput alloc] init]];
-        }
-        [tx addOutput:myOutput];
         
-        // Blank out others' input sequence numbers to let others update transaction at will.
-        for (NSUInteger i = 0; i < tx.inputs.count; i++) {
-            if (i != inputIndex) {
-                ((BTCTransactionInput*)tx.inputs[i]).sequence = 0;
+        if (outputMode == SIGHASH_NONE) {
+            // Wildcard payee - we can pay anywhere.
+            BTCSignatureHashUpdateVarInt(&ctx, 0);
+        } else if (outputMode == SIGHASH_SINGLE) {
+            // Only lock-in the txout payee at same index as txin.
+            // All outputs before the one we need are blanked out (value -1 and empty script). All outputs after are simply removed.
+            BTCSignatureHashUpdateVarInt(&ctx, inputIndex + 1);
+            static const unsigned char blankOutput[9] = {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0x00};
+            for (uint32_t i = 0; i < inputIndex; i++) {
+                BTCSHA256Update(&ctx, blankOutput, sizeof(blankOutput));
+            }
+            NSData* outputData = [_outputs[inputIndex] data];
+            BTCSHA256Update(&ctx, outputData.bytes, outputData.length);
+        } else {
+            // Default is SIGHASH_ALL - all inputs and outputs are signed.
+            BTCSignatureHashUpdateVarInt(&ctx, _outputs.count);
+            for (BTCTransactionOutput* txout in _outputs) {
+                NSData* outputData = txout.data;
+                BTCSHA256Update(&ctx, outputData.bytes, outputData.length);
             }
         }
     }
     
-    // Blank out other inputs completely. This is not recommended for open transactions.
-    if (hashType & SIGHASH_ANYONECANPAY) {
-        BTCTransactionInput* input = tx.inputs[inputIndex];
-        [tx removeAllInputs];
-        [tx addInput:input];
-    }
+    BTCSignatureHashUpdateUInt32(&ctx, _lockTime);
     
     // Important: we have to hash transaction together with its hash type.
     // Hash type is appended as little endian uint32 unlike 1-byte suffix of the signature.
-    NSMutableData* fulldata = [tx.data mutableCopy];
-    uint32_t hashType32 = OSSwapHostToLittleInt32((uint32_t)hashType);
-    [fulldata appendBytes:&hashType32 length:sizeof(hashType32)];
+    BTCSignatureHashUpdateUInt32(&ctx, (uint32_t)hashType);
     
-    NSData* hash = BTCHash256(fulldata);
+    return BTCSignatureHashFinalDouble(&ctx);
+}
+
+// Hash for signing a segwit input (BIP143).
+- (NSData*) witnessSignatureHashForScript:(BTCScript*)scriptCode inputIndex:(uint32_t)inputIndex amount:(BTCAmount)amount hashType:(BTCSignatureHashType)hashType error:(NSError**)errorOut {
+    if (inputIndex >= _inputs.count) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:BTCErrorDomain
+                                                      code:BTCErrorScriptError
+                                                  userInfo:@{NSLocalizedDescriptionKey:[NSString stringWithFormat:
+                                                     NSLocalizedString(@"Input index is out of bounds for transaction: %d >= %d.", @""),
+                                                                                        (int)inputIndex, (int)_inputs.count]}];
+        return nil;
+    }
+    
+    BTCSignatureHashType outputMode = hashType & SIGHASH_OUTPUT_MASK;
+    BOOL anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY) != 0;
+    BTCTransactionWitnessSignatureHashCache* cache = [self witnessSignatureHashCache];
+    BTCTransactionInput* txin = _inputs[inputIndex];
+    static const unsigned char zeroHash[32] = {0};
+    
+    BTCSHA256Context ctx;
+    BTCSHA256Init(&ctx);
+    BTCSignatureHashUpdateUInt32(&ctx, _version);
     
-//    NSLog(@"\n----------------------\n");
-//    NSLog(@"TX: %@", BTCHexFromData(fulldata));
-//    NSLog(@"TX SUBSCRIPT: %@ (%@)", BTCHexFromData(subscript.data), subscript);
-//    NSLog(@"TX HASH: %@", BTCHexFromData(hash));
-//    NSLog(@"TX PLIST: %@", tx.dictionary);
+    // Prevouts are committed unless ANYONECANPAY is used.
+    BTCSHA256Update(&ctx, anyoneCanPay ? zeroHash : cache.hashPrevouts.bytes, 32);
     
+    // Sequences are committed only in SIGHASH_ALL mode without ANYONECANPAY.
+    BOOL commitSequences = !anyoneCanPay && outputMode != SIGHASH_SINGLE && outputMode != SIGHASH_NONE;
+    BTCSHA256Update(&ctx, commitSequences ? cache.hashSequence.bytes : zeroHash, 32);
+    
+    // Outpoint, script code, amount and sequence of this input.
+    NSData* previousHash = txin.previousHash;
+    BTCSHA256Update(&ctx, previousHash.bytes, previousHash.length);
+    BTCSignatureHashUpdateUInt32(&ctx, txin.previousIndex);
+    NSData* scriptData = scriptCode.data ?: [NSData data];
+    BTCSignatureHashUpdateVarInt(&ctx, scriptData.length);
+    BTCSHA256Update(&ctx, scriptData.bytes, scriptData.length);
+    uint64_t amount64 = OSSwapHostToLittleInt64((uint64_t)amount);
+    BTCSHA256Update(&ctx, &amount64, sizeof(amount64));
+    BTCSignatureHashUpdateUInt32(&ctx, txin.sequence);
+    
+    // All outputs, only the output with the same index (SIGHASH_SINGLE) or none.
+    // Unlike legacy hash, SIGHASH_SINGLE without a corresponding output simply commits to zero hash.
+    if (outputMode != SIGHASH_SINGLE && outputMode != SIGHASH_NONE) {
+        BTCSHA256Update(&ctx, cache.hashOutputs.bytes, 32);
+    } else if (outputMode == SIGHASH_SINGLE && inputIndex < _outputs.count) {
+        NSData* hashOutput = BTCHash256([_outputs[inputIndex] data]);
+        BTCSHA256Update(&ctx, hashOutput.bytes, 32);
+    } else {
+        BTCSHA256Update(&ctx, zeroHash, 32);
+    }
+    
+    BTCSignatureHashUpdateUInt32(&ctx, _lockTime);
+    BTCSignatureHashUpdateUInt32(&ctx, (uint32_t)hashType);
+    
+    return BTCSignatureHashFinalDouble(&ctx);
+}
+
+// Computes (once per transaction state) hashPrevouts, hashSequence and hashOutputs for BIP143 signature hashes.
+- (BTCTransactionWitnessSignatureHashCache*) witnessSignatureHashCache {
+    @synchronized(self) {
+        if (_witnessSignatureHashCache) return _witnessSignatureHashCache;
+        
+        BTCSHA256Context prevoutsCtx;
+        BTCSHA256Context sequenceCtx;
+        BTCSHA256Context outputsCtx;
+        BTCSHA256Init(&prevoutsCtx);
+        BTCSHA256Init(&sequenceCtx);
+        BTCSHA256Init(&outputsCtx);
+        
+        for (BTCTransactionInput* txin in _inputs) {
+            NSData* previousHash = txin.previousHash;
+            BTCSHA256Update(&prevoutsCtx, previousHash.bytes, previousHash.length);
+            BTCSignatureHashUpdateUInt32(&prevoutsCtx, txin.previousIndex);
+            BTCSignatureHashUpdateUInt32(&sequenceCtx, txin.sequence);
+        }
+        for (BTCTransactionOutput* txout in _outputs) {
+            NSData* outputData = txout.data;
+            BTCSHA256Update(&outputsCtx, outputData.bytes, outputData.length);
+        }
+        
+        BTCTransactionWitnessSignatureHashCache* cache = [[BTCTransactionWitnessSignatureHashCache alloc] init];
+        cache.hashPrevouts = BTCSignatureHashFinalDouble(&prevoutsCtx);
+        cache.hashSequence = BTCSignatureHashFinalDouble(&sequenceCtx);
+        cache.hashOutputs = BTCSignatureHashFinalDouble(&outputsCtx);
+        _witnessSignatureHashCache = cache;
+        return cache;
+    }
+}
+
+// Builds (once per transaction state) data shared by SIGHASH_ALL signature hashes of all inputs.
+// Returns nil if transaction has inputs which cannot be represented by fixed-size blanked inputs (e.g. coinbase).
+- (BTCTransactionSignatureHashCache*) signatureHashCache {
+    @synchronized(self) {
+        if (_signatureHashCache) return _signatureHashCache;
+        
+        NSUInteger count = _inputs.count;
+        NSMutableData* blankedInputs = [NSMutableData dataWithLength:count * BTCBlankedInputLength];
+        NSMutableData* midstates = [NSMutableData dataWithLength:count * sizeof(BTCSHA256Context)];
+        unsigned char* blankedPtr = blankedInputs.mutableBytes;
+        BTCSHA256Context* midstatesPtr = midstates.mutableBytes;
+        
+        BTCSHA256Context ctx;
+        BTCSHA256Init(&ctx);
+        BTCSignatureHashUpdateUInt32(&ctx, _version);
+        BTCSignatureHashUpdateVarInt(&ctx, count);
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            BTCTransactionInput* txin = _inputs[i];
+            if (txin.isCoinbase || txin.previousHash.length != 32) return nil;
+            
+            unsigned char* blanked = blankedPtr + i * BTCBlankedInputLength;
+            uint32_t index = OSSwapHostToLittleInt32(txin.previousIndex);
+            uint32_t sequence = OSSwapHostToLittleInt32(txin.sequence);
+            memcpy(blanked, txin.previousHash.bytes, 32);
+            memcpy(blanked + 32, &index, 4);
+            blanked[36] = 0; // empty script
+            memcpy(blanked + 37, &sequence, 4);
+            
+            midstatesPtr[i] = ctx;
+            BTCSHA256Update(&ctx, blanked, BTCBlankedInputLength);
+        }
+        
+        NSMutableData* outputs = [[BTCProtocolSerialization dataForVarInt:_outputs.count] mutableCopy];
+        for (BTCTransactionOutput* txout in _outputs) {
+            [outputs appendData:txout.data];
+        }
+        
+        BTCTransactionSignatureHashCache* cache = [[BTCTransactionSignatureHashCache alloc] init];
+        cache.blankedInputs = blankedInputs;
+        cache.midstates = midstates;
+        cache.outputs = outputs;
+        _signatureHashCache = cache;
+        return cache;
+    }
+}
+
+// Finalizes SHA-256 and hashes the result once more.
+static NSMutableData* BTCSignatureHashFinalDouble(BTCSHA256Context* ctx) {
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    BTCSHA256Final(digest, ctx);
+    NSMutableData* hash = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    BTCSHA256Bytes(hash.mutableBytes, digest, CC_SHA256_DIGEST_LENGTH);
     return hash;
 }
 
+static void BTCSignatureHashUpdateUInt32(BTCSHA256Context* ctx, uint32_t value) {
+    value = OSSwapHostToLittleInt32(value);
+    BTCSHA256Update(ctx, &value, sizeof(value));
+}
+
+static void BTCSignatureHashUpdateVarInt(BTCSHA256Context* ctx, uint64_t value) {
+    unsigned char buffer[9];
+    size_t length;
+    if (value < 0xfd) {
+        buffer[0] = (unsigned char)value;
+        length = 1;
+    } else if (value <= 0xffff) {
+        uint16_t v = OSSwapHostToLittleInt16((uint16_t)value);
+        buffer[0] = 0xfd;
+        memcpy(buffer + 1, &v, 2);
+        length = 3;
+    } else if (value <= 0xffffffffUL) {
+        uint32_t v = OSSwapHostToLittleInt32((uint32_t)value);
+        buffer[0] = 0xfe;
+        memcpy(buffer + 1, &v, 4);
+        length = 5;
+    } else {
+        uint64_t v = OSSwapHostToLittleInt64(value);
+        buffer[0] = 0xff;
+        memcpy(buffer + 1, &v, 8);
+        length = 9;
+    }
+    BTCSHA256Update(ctx, buffer, length);
+}
+
+// Hashes input with a given script and sequence. Coinbase inputs are always hashed with their coinbase data, as in -[BTCTransactionInput data].
+static void BTCSignatureHashUpdateInput(BTCSHA256Context* ctx, BTCTransactionInput* txin, NSData* scriptData, uint32_t sequence) {
+    NSData* previousHash = txin.previousHash;
+    BTCSHA256Update(ctx, previousHash.bytes, previousHash.length);
+    BTCSignatureHashUpdateUInt32(ctx, txin.previousIndex);
+    if (txin.isCoinbase) {
+        scriptData = txin.coinbaseData;
+    }
+    BTCSignatureHashUpdateVarInt(ctx, scriptData.length);
+    if (scriptData.length > 0) {
+        BTCSHA256Update(ctx, scriptData.bytes, scriptData.length);
+    }
+    BTCSignatureHashUpdateUInt32(ctx, sequence);
+}
+
 
 
 
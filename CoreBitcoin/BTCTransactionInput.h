@@ -1,6 +1,7 @@
 // CoreBitcoin by Oleg Andreev <oleganza@gmail.com>, WTFPL.
 
 #import <Foundation/Foundation.h>
+#import "BTCProtocolSerialization.h"
 
 @class BTCScript;
 @class BTCOutpoint;
@@ -38,9 +39,17 @@
 // Currently, for DoS and security reasons, nodes do not store timelocked transactions making the sequence number meaningless.
 @property(nonatomic) uint32_t sequence;
 
-// Serialized binary representation of the txin.
+// Segregated witness (BIP141): array of NSData items pushed on the stack before verifying the witness program.
+// Witness is serialized separately from the input (see BIP144) and does not affect the transaction ID.
+// Default is an empty array.
+@property(nonatomic) NSArray* witness;
+
+// Serialized binary representation of the txin (without witness).
 @property(nonatomic, readonly) NSData* data;
 
+// Serialized witness: number of items followed by each item prefixed with its length.
+@property(nonatomic, readonly) NSData* witnessData;
+
 
 // Informational properties
 // ------------------------
@@ -69,6 +78,10 @@
 // Read tx input from the stream.
 - (id) initWithStream:(NSInputStream*)stream;
 
+// Reads tx input from the cursor and advances it.
+// Previous hash and script data reference the cursor's buffer without copying.
+- (id) initWithCursor:(BTCDataCursor*)cursor;
+
 // Constructs transaction input from a dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary;
 
@@ -12,6 +12,11 @@
 @interface BTCTransactionInput ()
 @end
 
+@interface BTCTransaction (BTCTransactionInput)
+// Signature scripts and witnesses are not covered by signature hashes, so their cached parts can be kept.
+- (void) invalidatePayloadPreservingSignatureHashes;
+@end
+
 static const uint32_t BTCInvalidIndex = 0xFFFFFFFF; // aka "(unsigned int) -1" in BitcoinQT.
 static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
 
@@ -24,6 +29,7 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
         _previousIndex = BTCInvalidIndex;
         _signatureScript = [[BTCScript alloc] init];
         _sequence = BTCMaxSequence; // max
+        _witness = @[];
         _value = -1;
     }
     return self;
@@ -45,6 +51,14 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
     return self;
 }
 
+// Reads tx input from the cursor and advances it.
+- (id) initWithCursor:(BTCDataCursor*)cursor {
+    if (self = [self init]) {
+        if (![self parseCursor:cursor]) return nil;
+    }
+    return self;
+}
+
 // Constructs transaction input from a dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary {
     if (self = [self init]) {
@@ -77,6 +91,14 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
         NSNumber* seqNumber = dictionary[@"sequence"];
         if (seqNumber) _sequence = [seqNumber unsignedIntValue];
         
+        NSMutableArray* witness = [NSMutableArray array];
+        for (NSString* itemHex in dictionary[@"witness"]) {
+            NSData* item = BTCDataFromHex(itemHex);
+            if (!item) return nil;
+            [witness addObject:item];
+        }
+        _witness = witness;
+        
     }
     return self;
 }
@@ -86,7 +108,9 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
     txin.previousHash = [self.previousHash copy];
     txin.previousIndex = self.previousIndex;
     txin.signatureScript = [self.signatureScript copy];
+    txin.coinbaseData = [self.coinbaseData copy];
     txin.sequence = self.sequence;
+    txin.witness = [self.witness copy];
 
     txin.transaction = _transaction;
     txin.transactionOutput = _transactionOutput;
@@ -99,6 +123,15 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
     return [self computePayload];
 }
 
+- (NSData*) witnessData {
+    NSMutableData* payload = [NSMutableData data];
+    [payload appendData:[BTCProtocolSerialization dataForVarInt:_witness.count]];
+    for (NSData* item in _witness) {
+        [payload appendData:[BTCProtocolSerialization dataForVarString:item]];
+    }
+    return payload;
+}
+
 - (NSData*) computePayload {
     NSMutableData* payload = [NSMutableData data];
     
@@ -119,6 +152,38 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
     return payload;
 }
 
+// Every change of serialized fields invalidates cached payload of the owning transaction.
+
+- (void) setPreviousHash:(NSData *)previousHash {
+    _previousHash = previousHash;
+    [_transaction invalidatePayload];
+}
+
+- (void) setPreviousIndex:(uint32_t)previousIndex {
+    _previousIndex = previousIndex;
+    [_transaction invalidatePayload];
+}
+
+- (void) setSignatureScript:(BTCScript *)signatureScript {
+    _signatureScript = signatureScript;
+    [_transaction invalidatePayloadPreservingSignatureHashes];
+}
+
+- (void) setCoinbaseData:(NSData *)coinbaseData {
+    _coinbaseData = coinbaseData;
+    [_transaction invalidatePayloadPreservingSignatureHashes];
+}
+
+- (void) setSequence:(uint32_t)sequence {
+    _sequence = sequence;
+    [_transaction invalidatePayload];
+}
+
+- (void) setWitness:(NSArray *)witness {
+    _witness = witness ?: @[];
+    [_transaction invalidatePayloadPreservingSignatureHashes];
+}
+
 - (BTCOutpoint*) outpoint {
     return [[BTCOutpoint alloc] initWithHash:self.previousHash index:self.previousIndex];
 }
@@ -160,6 +225,14 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
     if (_sequence != BTCMaxSequence) {
         dict[@"sequence"] = [NSString stringWithFormat:@"%08x", _sequence];
     }
+    
+    if (_witness.count > 0) {
+        NSMutableArray* witness = [NSMutableArray array];
+        for (NSData* item in _witness) {
+            [witness addObject:BTCHexFromData(item)];
+        }
+        dict[@"witness"] = witness;
+    }
     return dict;
 }
 
@@ -176,11 +249,33 @@ static const uint32_t BTCMaxSequence = 0xFFFFFFFF;
 
 - (BOOL) parseData:(NSData*)data {
     if (!data) return NO;
-    NSInputStream* stream = [NSInputStream inputStreamWithData:data];
-    [stream open];
-    BOOL result = [self parseStream:stream];
-    [stream close];
-    return result;
+    data = [data copy]; // so mutable data can't be changed under our zero-copy fields.
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    return [self parseCursor:&cursor];
+}
+
+- (BOOL) parseCursor:(BTCDataCursor*)cursor {
+    // Read previousHash
+    _previousHash = BTCDataCursorReadData(cursor, 32);
+    if (!_previousHash) return NO;
+    
+    // Read previousIndex
+    if (!BTCDataCursorReadUInt32(cursor, &_previousIndex)) return NO;
+    
+    // Read signature script
+    NSData* scriptdata = BTCDataCursorReadVarString(cursor);
+    if (!scriptdata) return NO;
+    
+    if ([self isCoinbase]) {
+        _coinbaseData = scriptdata;
+    } else {
+        _signatureScript = [[BTCScript alloc] initWithData:scriptdata];
+    }
+    
+    // Read sequence
+    if (!BTCDataCursorReadUInt32(cursor, &_sequence)) return NO;
+    
+    return YES;
 }
 
 - (BOOL) parseStream:(NSInputStream*)stream {
@@ -2,6 +2,7 @@
 
 #import <Foundation/Foundation.h>
 #import "BTCUnitsAndLimits.h"
+#import "BTCProtocolSerialization.h"
 
 @class BTCScript;
 @class BTCAddress;
@@ -86,6 +87,10 @@ static uint32_t const BTCTransactionOutputIndexUnknown = 0xffffffff;
 // Reads tx output from the stream.
 - (id) initWithStream:(NSInputStream*)stream;
 
+// Reads tx output from the cursor and advances it.
+// Script data references the cursor's buffer without copying.
+- (id) initWithCursor:(BTCDataCursor*)cursor;
+
 // Makes tx output from a dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary;
 
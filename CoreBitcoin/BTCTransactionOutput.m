@@ -54,6 +54,14 @@
     return self;
 }
 
+// Reads tx output from the cursor and advances it.
+- (id) initWithCursor:(BTCDataCursor*)cursor {
+    if (self = [self init]) {
+        if (![self parseCursor:cursor]) return nil;
+    }
+    return self;
+}
+
 // Constructs transaction input from a dictionary representation
 - (id) initWithDictionary:(NSDictionary*)dictionary {
     if (self = [self init]) {
@@ -108,6 +116,18 @@
     return payload;
 }
 
+// Every change of serialized fields invalidates cached payload of the owning transaction.
+
+- (void) setValue:(BTCAmount)value {
+    _value = value;
+    [_transaction invalidatePayload];
+}
+
+- (void) setScript:(BTCScript *)script {
+    _script = script;
+    [_transaction invalidatePayload];
+}
+
 - (NSString*) description {
     NSData* txhash = self.transactionHash;
     return [NSString stringWithFormat:@"<%@:0x%p%@%@ %@ BTC '%@'%@>", [self class], self,
@@ -169,11 +189,23 @@
 
 - (BOOL) parseData:(NSData*)data {
     if (!data) return NO;
-    NSInputStream* stream = [NSInputStream inputStreamWithData:data];
-    [stream open];
-    BOOL result = [self parseStream:stream];
-    [stream close];
-    return result;
+    data = [data copy]; // so mutable data can't be changed under our zero-copy script.
+    BTCDataCursor cursor = BTCDataCursorMake(data);
+    return [self parseCursor:&cursor];
+}
+
+- (BOOL) parseCursor:(BTCDataCursor*)cursor {
+    // Read value
+    uint64_t value = 0;
+    if (!BTCDataCursorReadUInt64(cursor, &value)) return NO;
+    _value = (BTCAmount)value;
+    
+    // Read script
+    NSData* scriptData = BTCDataCursorReadVarString(cursor);
+    if (!scriptData) return NO;
+    _script = [[BTCScript alloc] initWithData:scriptData];
+    
+    return YES;
 }
 
 - (BOOL) parseStream:(NSInputStream*)stream {
@@ -8,9 +8,11 @@
 #import <CoreBitcoin/BTCAssetType.h>
 #import <CoreBitcoin/BTCBase58.h>
 #import <CoreBitcoin/BTCBigNumber.h>
+#import <CoreBitcoin/BTCBigNumberPool.h>
 #import <CoreBitcoin/BTCBitcoinURL.h>
 #import <CoreBitcoin/BTCBlindSignature.h>
 #import <CoreBitcoin/BTCBlock.h>
+#import <CoreBitcoin/BTCBlockFileReader.h>
 #import <CoreBitcoin/BTCBlockchainInfo.h>
 #import <CoreBitcoin/BTCBlockHeader.h>
 #import <CoreBitcoin/BTCChainCom.h>
@@ -22,6 +24,7 @@
 #import <CoreBitcoin/BTCErrors.h>
 #import <CoreBitcoin/BTCFancyEncryptedMessage.h>
 #import <CoreBitcoin/BTCHashID.h>
+#import <CoreBitcoin/BTCHex.h>
 #import <CoreBitcoin/BTCKey.h>
 #import <CoreBitcoin/BTCKeychain.h>
 #import <CoreBitcoin/BTCMerkleTree.h>
@@ -39,9 +42,16 @@
 #import <CoreBitcoin/BTCProcessor.h>
 #import <CoreBitcoin/BTCProtocolBuffers.h>
 #import <CoreBitcoin/BTCProtocolSerialization.h>
+#import <CoreBitcoin/BTCRIPEMD160.h>
 #import <CoreBitcoin/BTCQRCode.h>
 #import <CoreBitcoin/BTCScript.h>
+#import <CoreBitcoin/BTCCompiledScript.h>
 #import <CoreBitcoin/BTCScriptMachine.h>
+#import <CoreBitcoin/BTCScriptVerifier.h>
+#import <CoreBitcoin/BTCSignatureCache.h>
+#import <CoreBitcoin/BTCScriptProfile.h>
+#import <CoreBitcoin/BTCSHA256.h>
+#import <CoreBitcoin/BTCSecp256k1.h>
 #import <CoreBitcoin/BTCSecretSharing.h>
 #import <CoreBitcoin/BTCSignatureHashType.h>
 #import <CoreBitcoin/BTCTransaction.h>
@@ -14,10 +14,8 @@
 - (NSData*) SHA256;
 - (NSData*) BTCHash256;  // SHA256(SHA256(self)) aka Hash or Hash256 in BitcoinQT
 
-#if BTCDataRequiresOpenSSL
 - (NSData*) RIPEMD160;
 - (NSData*) BTCHash160; // RIPEMD160(SHA256(self)) aka Hash160 in BitcoinQT
-#endif
 
 // Formats data as a lowercase hex string
 - (NSString*) hex;
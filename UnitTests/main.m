@@ -15,10 +15,15 @@
 #import "BTCEncryptedMessage+Tests.h"
 #import "BTCFancyEncryptedMessage+Tests.h"
 #import "BTCScript+Tests.h"
+#import "BTCCompiledScript+Tests.h"
+#import "BTCScriptVerifier+Tests.h"
+#import "BTCSignatureCache+Tests.h"
 #import "BTCTransaction+Tests.h"
 #import "BTCBlockchainInfo+Tests.h"
 #import "BTCPriceSource+Tests.h"
 #import "BTCMerkleTree+Tests.h"
+#import "BTCBlock+Tests.h"
+#import "BTCBlockFileReader+Tests.h"
 #import "BTCBitcoinURL+Tests.h"
 #import "BTCCurrencyConverter+Tests.h"
 
@@ -41,7 +46,12 @@ int main(int argc, const char * argv[])
         [BTCEncryptedMessage runAllTests];
         [BTCFancyEncryptedMessage runAllTests];
         [BTCScript runAllTests];
+        [BTCCompiledScript runAllTests];
+        [BTCSignatureCache runAllTests];
+        [BTCScriptVerifier runAllTests];
         [BTCMerkleTree runAllTests];
+        [BTCBlock runAllTests];
+        [BTCBlockFileReader runAllTests];
         [BTCBlockchainInfo runAllTests];
         [BTCPriceSource runAllTests];
         [BTCBitcoinURL runAllTests];